@@ -325,6 +325,39 @@ typedef struct {
 #endif
 
 
+/* Atomic operations abstraction layer definition */
+
+/* Without them, osip_fifo_t is protected by a mutex. */
+#if defined(OSIP_NO_ATOMICS)
+
+#elif defined(__GNUC__) && ((__GNUC__ > 4) || (__GNUC__ == 4 && __GNUC_MINOR__ >= 7))
+#define OSIP_HAVE_ATOMICS 1
+#define osip_atomic_load_int(p) __atomic_load_n ((p), __ATOMIC_SEQ_CST)
+#define osip_atomic_add_int(p, v) __atomic_add_fetch ((p), (v), __ATOMIC_SEQ_CST)
+#define osip_atomic_exchange_int(p, v) __atomic_exchange_n ((p), (v), __ATOMIC_SEQ_CST)
+#define osip_atomic_store_int(p, v) __atomic_store_n ((p), (v), __ATOMIC_SEQ_CST)
+#define osip_atomic_load_ptr(pp) __atomic_load_n ((pp), __ATOMIC_SEQ_CST)
+#define osip_atomic_store_ptr(pp, v) __atomic_store_n ((pp), (v), __ATOMIC_SEQ_CST)
+#define osip_atomic_exchange_ptr(pp, v) __atomic_exchange_n ((pp), (v), __ATOMIC_SEQ_CST)
+#define osip_atomic_cas_ptr(pp, old, v) __osip_atomic_cas_ptr ((void **) (pp), (void *) (old), (void *) (v))
+static __inline int
+__osip_atomic_cas_ptr (void **pp, void *old, void *v)
+{
+  return __atomic_compare_exchange_n (pp, &old, v, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+#elif defined(WIN32) && !defined(_WIN32_WCE) && !defined(HAVE_PTHREAD_WIN32)
+#define OSIP_HAVE_ATOMICS 1
+#define osip_atomic_load_int(p) InterlockedCompareExchange ((LONG volatile *) (p), 0, 0)
+#define osip_atomic_add_int(p, v) (InterlockedExchangeAdd ((LONG volatile *) (p), (v)) + (v))
+#define osip_atomic_exchange_int(p, v) InterlockedExchange ((LONG volatile *) (p), (v))
+#define osip_atomic_store_int(p, v) InterlockedExchange ((LONG volatile *) (p), (v))
+#define osip_atomic_load_ptr(pp) InterlockedCompareExchangePointer ((PVOID volatile *) (pp), NULL, NULL)
+#define osip_atomic_store_ptr(pp, v) InterlockedExchangePointer ((PVOID volatile *) (pp), (v))
+#define osip_atomic_exchange_ptr(pp, v) InterlockedExchangePointer ((PVOID volatile *) (pp), (v))
+#define osip_atomic_cas_ptr(pp, old, v) (InterlockedCompareExchangePointer ((PVOID volatile *) (pp), (v), (old)) == (PVOID) (old))
+#endif
+
 #endif /* #ifndef OSIP_MONOTHREAD */
 
 #endif /* #ifndef DOXYGEN */
@@ -21,10 +21,6 @@
 #ifndef _OSIP_H_
 #define _OSIP_H_
 
-#if defined(HAVE_DICT_DICT_H)
-#include <dict/dict.h>
-#endif
-
 #include <osipparser2/osip_const.h>
 
 /* Time-related functions and data types */
@@ -148,6 +144,7 @@ extern "C" {
     SND_STATUS_3456XX,           /**< Event is an outgoing final response (not 2XX) */
 
     KILL_TRANSACTION,            /**< Event to 'kill' the transaction before termination */
+    TRANSPORT_ERROR,             /**< (internal) Event reporting the failure of a message sent by batch */
     UNKNOWN_EVT                  /**< Max event */
   } type_t;
 
@@ -341,6 +338,49 @@ extern "C" {
     struct osip_srv_record sipsctp_record;  /**< sctp SRV result */
   };
 
+  struct osip_timer_wheel;
+  struct osip_transaction_index;
+  struct osip_ready_queue;
+  struct osip_executor;
+  struct osip_executor_worker;
+
+/**
+ * Structure for an entry in a timer wheel.
+ * @var osip_timer_entry_t
+ */
+  typedef struct osip_timer_entry osip_timer_entry_t;
+
+/**
+ * Structure for an entry in a timer wheel.
+ * @struct osip_timer_entry
+ */
+  struct osip_timer_entry {
+    osip_timer_entry_t *next;           /**< (internal) next entry in slot, NULL if not armed */
+    osip_timer_entry_t *prev;           /**< (internal) previous entry in slot */
+    unsigned int expires;               /**< (internal) expiration tick */
+    struct osip_timer_wheel *wheel;     /**< (internal) wheel managing this entry */
+    void *data;                         /**< (internal) element owning this entry */
+    int detached;                       /**< (internal) moved out of the wheel to an expired list */
+  };
+
+/**
+ * Structure for an entry in a queue of transactions with pending events.
+ * @var osip_ready_entry_t
+ */
+  typedef struct osip_ready_entry osip_ready_entry_t;
+
+/**
+ * Structure for an entry in a queue of transactions with pending events.
+ * @struct osip_ready_entry
+ */
+  struct osip_ready_entry {
+    osip_ready_entry_t *next;           /**< (internal) next entry in queue, NULL if not queued */
+    osip_ready_entry_t *prev;           /**< (internal) previous entry in queue */
+    struct osip_ready_queue *queue;     /**< (internal) queue of the osip_t managing this entry */
+    struct osip_executor_worker *worker;        /**< (internal) worker processing the events, if any */
+    void *data;                         /**< (internal) element owning this entry */
+  };
+
 /**
  * Structure for transaction handling.
  * @var osip_transaction_t
@@ -383,8 +423,17 @@ extern "C" {
     osip_nict_t *nict_context;          /**< internal nict context */
     osip_nist_t *nist_context;          /**< internal nist context */
 
-    osip_srv_record_t record;           /**< memory space for SRV record */
+    osip_srv_record_t *record;          /**< shared SRV record (read only) */
+    int record_index;                   /**< index of the SRV entry in use */
     osip_naptr_t *naptr_record;         /**< memory space for NAPTR record */
+    osip_timer_entry_t timers;          /**< (internal) next timer in the timer wheel of osip_t */
+    osip_ready_entry_t ready;           /**< (internal) entry in the ready queue of osip_t */
+#ifndef OSIP_LIST_ARRAY
+    __node_t **list_link;               /**< (internal) link to the node of the transaction in its list of osip_t */
+#else
+    int list_pos;                       /**< (internal) position of the transaction in its list of osip_t */
+#endif
+    struct osip_tombstone *tombstone;   /**< (internal) compact state, see osip_set_tombstone_mode */
     void *reserved1;                    /**< User Defined Pointer. */
     void *reserved2;                    /**< User Defined Pointer. */
     void *reserved3;                    /**< User Defined Pointer. */
@@ -531,9 +580,34 @@ extern "C" {
     int port;                           /**< destination port */
     int sock;                           /**< socket to use */
     int counter;                        /**< start at 7 */
+    osip_timer_entry_t timer;           /**< (internal) next retransmission in the timer wheel of osip_t */
+    int indexed;                        /**< (internal) chained by the identity of its dialog */
+    unsigned int hash;                  /**< (internal) hash of the identity of its dialog */
+    ixt_t *next_by_key;                 /**< (internal) next ixt with the same hash of identity */
+    ixt_t *next_by_dialog;              /**< (internal) next ixt with the same hash of dialog */
   };
 
 
+/**
+ * Structure for a message of an outbound batch.
+ * @var osip_batch_message_t
+ */
+  typedef struct osip_batch_message osip_batch_message_t;
+
+/**
+ * Structure for a message of an outbound batch.
+ * @struct osip_batch_message
+ */
+  struct osip_batch_message {
+    const char *buf;            /**< message as sent on the wire */
+    size_t length;              /**< length of buf */
+    char *host;                 /**< destination host */
+    int port;                   /**< destination port */
+    int out_socket;             /**< socket of the transaction */
+    int transactionid;          /**< id of the sending transaction, 0 for osip_retransmissions_execute() */
+    int result;                 /**< set by the callback: 0 if sent, or an OSIP error code */
+  };
+
 /**
  * Structure for osip handling.
  * In order to use osip, you have to manage at least one global instance
@@ -557,27 +631,58 @@ extern "C" {
     void *nist_fastmutex;          /**< mutex for NIST transaction */
     void *ixt_fastmutex;           /**< mutex for IXT transaction */
     void *id_mutex;                /**< mutex for unique transaction id generation */
-    int transactionid;             /**< previous unique transaction id generation */
+    int transactionid;             /**< next unique transaction id (atomic counter when available) */
 
-    /* list of transactions for ict, ist, nict, nist */
+    /* list of transactions for ict, ist, nict, nist: in the order they
+       were added; the application may read them (with the lock of the
+       list held) but must never modify them with osip_list_* methods */
     osip_list_t osip_ict_transactions;          /**< list of ict transactions */
     osip_list_t osip_ist_transactions;          /**< list of ist transactions */
     osip_list_t osip_nict_transactions;         /**< list of nict transactions */
     osip_list_t osip_nist_transactions;         /**< list of nist transactions */
 
-    osip_list_t ixt_retransmissions;            /**< list of ixt elements */
-
     osip_message_cb_t msg_callbacks[OSIP_MESSAGE_CALLBACK_COUNT];                /**< message callbacks */
     osip_kill_transaction_cb_t kill_callbacks[OSIP_KILL_CALLBACK_COUNT];         /**< kill callbacks */
     osip_transport_error_cb_t tp_error_callbacks[OSIP_TRANSPORT_ERROR_CALLBACK_COUNT];     /**< transport error callback */
 
     int (*cb_send_message) (osip_transaction_t *, osip_message_t *, char *, int, int);     /**< callback to send message */
 
-#if defined(HAVE_DICT_DICT_H)
-    dict *osip_ict_hastable;                              /**< htable of ict transactions */
-    dict *osip_ist_hastable;                              /**< htable of ist transactions */
-    dict *osip_nict_hastable;                             /**< htable of nict transactions */
-    dict *osip_nist_hastable;                             /**< htable of nist transactions */
+    struct osip_timer_wheel *ict_timers;        /**< timers of ict transactions */
+    struct osip_timer_wheel *ist_timers;        /**< timers of ist transactions */
+    struct osip_timer_wheel *nict_timers;       /**< timers of nict transactions */
+    struct osip_timer_wheel *nist_timers;       /**< timers of nist transactions */
+
+    struct osip_transaction_index *ict_index;   /**< index of ict transactions */
+    struct osip_transaction_index *ist_index;   /**< index of ist transactions */
+    struct osip_transaction_index *nict_index;  /**< index of nict transactions */
+    struct osip_transaction_index *nist_index;  /**< index of nist transactions */
+
+    struct osip_ready_queue *ict_ready;         /**< ict transactions with pending events */
+    struct osip_ready_queue *ist_ready;         /**< ist transactions with pending events */
+    struct osip_ready_queue *nict_ready;        /**< nict transactions with pending events */
+    struct osip_ready_queue *nist_ready;        /**< nist transactions with pending events */
+
+    struct osip_executor *executor;     /**< threads processing the events, if started */
+
+    int (*cb_send_raw) (osip_transaction_t *, const char *, size_t, char *, int, int);    /**< callback to send retransmissions */
+
+    int (*cb_send_batch) (osip_t *, osip_batch_message_t *, int);      /**< callback to send a batch of messages */
+    struct osip_send_batch *send_batch;         /**< messages not handed to cb_send_batch yet */
+
+    int tombstone_mode;                         /**< compact the completed server transactions */
+
+    struct osip_wakeup *wakeup;                 /**< notifier of an external event loop */
+    struct osip_ixt_table *ixt_table;           /**< ixt elements by dialog, and their timers */
+
+    struct osip_transaction_pool *transaction_pool;     /**< released transactions kept for reuse */
+
+    struct osip_transaction_index *ids;         /**< transactions by id */
+
+#ifndef OSIP_LIST_ARRAY
+    __node_t **ict_tail;                /**< (internal) end of the list of ict transactions */
+    __node_t **ist_tail;                /**< (internal) end of the list of ist transactions */
+    __node_t **nict_tail;               /**< (internal) end of the list of nict transactions */
+    __node_t **nist_tail;               /**< (internal) end of the list of nist transactions */
 #endif
   };
 
@@ -623,6 +728,8 @@ extern "C" {
     type_t type;                     /**< Event Type */
     int transactionid;               /**< identifier of the related osip transaction */
     osip_message_t *sip;             /**< SIP message (optional) */
+    osip_fifo_node_t node;           /**< (internal) node in the fifo of the transaction */
+    int error;                       /**< (internal) error of a TRANSPORT_ERROR event */
   };
 
 
@@ -681,6 +788,9 @@ extern "C" {
 
 /**
  * Add a SIP event in the fifo of a osip_transaction_t element.
+ * The transaction is also queued so that the next call to
+ * osip_*_execute() processes it. Events added directly in
+ * transactionff with osip_fifo_add() queue the transaction too.
  * @param transaction The element to work on.
  * @param evt The event to add.
  */
@@ -815,6 +925,9 @@ extern "C" {
 
 /**
  * Set SRV lookup information to be used by state machine.
+ * The results are kept in the DNS cache (osip_dns_cache_add_srv()):
+ * transactions with the same results share a single read only record.
+ * record_index of the transaction is initialized with the index of record.
  *
  * @param transaction The element to work on.
  * @param record The SRV lookup results for this transaction.
@@ -829,6 +942,124 @@ extern "C" {
  */
   int osip_transaction_set_naptr_record (osip_transaction_t * transaction, osip_naptr_t * record);
 
+#define OSIP_DNS_CACHE_DEFAULT_TTL 60  /**< ttl of records set with osip_transaction_set_srv_record() */
+
+/**
+ * Add SRV lookup results in the DNS cache.
+ * The result replaces the previous one for the same name and protocol.
+ * Transactions using the previous record keep it until they are released.
+ * The returned record is read only and must be released with
+ * osip_dns_cache_release_srv().
+ *
+ * @param record The SRV lookup results.
+ * @param ttl Time to live in seconds (0 to not keep the record in cache).
+ */
+  osip_srv_record_t *osip_dns_cache_add_srv (const osip_srv_record_t * record, int ttl);
+
+/**
+ * Get SRV lookup results from the DNS cache.
+ * The returned record is read only and must be released with
+ * osip_dns_cache_release_srv().
+ *
+ * @param name The name of the SRV record.
+ * @param protocol The transport protocol.
+ * Returns NULL if the name is unknown or its record has expired.
+ */
+  osip_srv_record_t *osip_dns_cache_get_srv (const char *name, const char *protocol);
+
+/**
+ * Release a record returned by the DNS cache.
+ *
+ * @param record The element to release.
+ */
+  void osip_dns_cache_release_srv (osip_srv_record_t * record);
+
+/**
+ * Remove all records from the DNS cache.
+ * Records in use by transactions are kept until they are released.
+ */
+  void osip_dns_cache_flush (void);
+
+/**
+ * Resolver used by the DNS cache.
+ * The resolver starts the NAPTR and SRV lookups for naptr->domain and
+ * returns OSIP_SUCCESS. When they are done, from any thread, it gives the
+ * result with osip_dns_cache_resolved(). The result can also be given
+ * before the resolver returns.
+ * @var osip_dns_resolver_t
+ */
+  typedef int osip_dns_resolver_t (osip_naptr_t * naptr, void *arg);
+
+/**
+ * Callback called when a NAPTR lookup of the DNS cache is done.
+ * @var osip_dns_callback_t
+ */
+  typedef void osip_dns_callback_t (osip_naptr_t * naptr, void *arg);
+
+/**
+ * Set the resolver used by the DNS cache.
+ *
+ * @param resolver The resolver (NULL to disable new lookups).
+ * @param arg The argument given to the resolver.
+ */
+  void osip_dns_cache_set_resolver (osip_dns_resolver_t * resolver, void *arg);
+
+/**
+ * Set the time after which a resolution still in progress is forgotten:
+ * the next lookup of the domain starts a new one (32 seconds by default).
+ *
+ * @param timeout The timeout in seconds.
+ */
+  int osip_dns_cache_set_pending_timeout (int timeout);
+
+/**
+ * Look up the NAPTR and SRV records of a domain in the DNS cache.
+ * If the domain is not cached, the resolver is started. Lookups of a
+ * domain already being resolved wait for the same result: its naptr_state
+ * is OSIP_NAPTR_STATE_INPROGRESS until the callback is called. Failures
+ * (OSIP_NAPTR_STATE_NOTSUPPORTED or OSIP_NAPTR_STATE_RETRYLATER) are
+ * cached as well as results.
+ * The returned record is read only once its lookup is done, and must be
+ * released with osip_dns_cache_release_naptr().
+ *
+ * @param domain The domain to resolve.
+ * @param cb Callback for a lookup in progress, may be called before
+ * osip_dns_cache_lookup returns (or NULL).
+ * @param arg The argument given to cb.
+ * Returns NULL on error or when no resolver is set.
+ */
+  osip_naptr_t *osip_dns_cache_lookup (const char *domain, osip_dns_callback_t * cb, void *arg);
+
+/**
+ * Give the result of a lookup started by the resolver of the DNS cache.
+ * The state of naptr becomes the state of result, or
+ * OSIP_NAPTR_STATE_RETRYLATER when result is NULL. Completed SRV records
+ * of result are added to the cache for osip_transaction_set_srv_record().
+ *
+ * @param naptr The record given to the resolver.
+ * @param result The lookup result (NULL on failure).
+ * @param ttl Time to live of the result in seconds (0 to not keep it).
+ */
+  int osip_dns_cache_resolved (osip_naptr_t * naptr, const osip_naptr_t * result, int ttl);
+
+/**
+ * Release a record returned by osip_dns_cache_lookup().
+ *
+ * @param naptr The element to release.
+ */
+  void osip_dns_cache_release_naptr (osip_naptr_t * naptr);
+
+/**
+ * Select the next entry to try in a SRV record (RFC 2782).
+ * Entries with the lowest priority are selected first; among them, an
+ * entry is selected at random with a probability proportional to its weight.
+ *
+ * @param record The SRV record.
+ * @param tried The entries already tried (bit i set for srventry[i]).
+ * Returns the index of the entry, or OSIP_NOTFOUND when all were tried.
+ */
+  int osip_dns_srv_select (const osip_srv_record_t * record, int tried);
+
 /**
  * Set the socket for incoming message.
  *
@@ -881,6 +1112,28 @@ extern "C" {
   int osip_remove_transaction (osip_t * osip, osip_transaction_t * ict);
 
 
+#ifndef OSIP_MONOTHREAD
+/**
+ * Start threads to consume the osip_event_t added in the fifos of
+ * transactions, instead of osip_ict_execute(), osip_ist_execute(),
+ * osip_nict_execute() and osip_nist_execute().
+ * The events of one transaction are never processed by two threads at
+ * the same time, and in the order they were added. A thread with no
+ * transaction to process takes some from the other threads.
+ * Timers must still be checked with osip_timers_*_execute(). A
+ * transaction must not be released before the kill callback is called.
+ * @param osip The element to work on.
+ * @param nthreads The number of threads.
+ */
+  int osip_executor_start (osip_t * osip, int nthreads);
+/**
+ * Stop the threads started with osip_executor_start().
+ * Events not consumed yet are left for osip_*_execute().
+ * @param osip The element to work on.
+ */
+  int osip_executor_stop (osip_t * osip);
+#endif
+
 /**
  * Consume ALL pending osip_event_t previously added in the fifos of ict transactions.
  * @param osip The element to work on.
@@ -941,6 +1194,35 @@ extern "C" {
  */
   osip_transaction_t *osip_transaction_find (osip_list_t * transactions, osip_event_t * evt);
 
+/**
+ * Get the transaction with this id (field transactionid).
+ * The transaction is found while it belongs to the osip_t, from its
+ * creation until it is removed with osip_remove_transaction() or
+ * osip_transaction_free(). Ids are given by a counter of osip_t: an id
+ * is only given again after the counter wraps around.
+ * Nothing keeps the returned transaction from being released (or
+ * recycled) by another thread.
+ * @deprecated Use osip_transaction_call_by_id(), which runs a function
+ * on the transaction while it can't be released.
+ * @param osip The element to work on.
+ * @param transactionid The id of the transaction.
+ */
+  osip_transaction_t *osip_transaction_get_by_id (osip_t * osip, int transactionid);
+/**
+ * Call a function on the transaction with this id (field transactionid).
+ * The function is called with the lock of the list of the transaction
+ * held, so the transaction can't be removed or released while it runs.
+ * It may call osip_transaction_add_event(), but it must not remove or
+ * release the transaction, nor call the osip_*_execute() and
+ * osip_timers_*_execute() methods.
+ * Return OSIP_NOTFOUND if no transaction of the osip_t has this id.
+ * @param osip The element to work on.
+ * @param transactionid The id of the transaction.
+ * @param func The function to call.
+ * @param arg The argument given to func.
+ */
+  int osip_transaction_call_by_id (osip_t * osip, int transactionid, void (*func) (osip_transaction_t *, void *), void *arg);
+
 
 #ifndef DOXYGEN
 /**
@@ -1035,12 +1317,152 @@ extern "C" {
  */
   void osip_event_free (osip_event_t * event);
 
+/**
+ * Structure for the statistics of the pool of events.
+ * @var osip_event_pool_stats_t
+ */
+  typedef struct osip_event_pool_stats osip_event_pool_stats_t;
+
+/**
+ * Structure for the statistics of the pool of events.
+ * @struct osip_event_pool_stats
+ */
+  struct osip_event_pool_stats {
+    unsigned long allocations;  /**< number of events allocated */
+    unsigned long frees;        /**< number of events released */
+    unsigned long hits;         /**< allocations served with a released event */
+    unsigned long cached;       /**< released events kept in the depot */
+    unsigned long max_cached;   /**< maximum number of events kept in the depot */
+  };
+
+/**
+ * Get the statistics of the pool of events.
+ * The events created by osip_parse(), osip_new_outgoing_sipmessage()
+ * and the timers are kept for the next allocations when they are
+ * released by the stack or with osip_event_free(). Counters of a
+ * thread are added in batches, so they may lag behind a little: the
+ * number of events in use is about allocations - frees.
+ * @param stats The structure to fill.
+ * Returns OSIP_NOTFOUND when the pool is not compiled in (OSIP_NO_POOL,
+ * DEBUG_MEM or custom osip_malloc macros).
+ */
+  int osip_event_pool_get_stats (osip_event_pool_stats_t * stats);
+/**
+ * Set the maximum number of released events kept in the depot shared
+ * by the threads (4096 by default). Each thread also keeps up to 64
+ * events in its own cache.
+ * @param max_cached The maximum number of events.
+ */
+  int osip_event_pool_set_max (unsigned long max_cached);
+/**
+ * Give the events cached by the calling thread back to the depot.
+ * Call this method before a thread processing events exits.
+ */
+  void osip_event_pool_thread_release (void);
+
 /**
  * Register the callback used to send SIP message.
  * @param cf The osip element attached to the transaction.
  * @param cb The method we want to register.
  */
   void osip_set_cb_send_message (osip_t * cf, int (*cb) (osip_transaction_t *, osip_message_t *, char *, int, int));
+/**
+ * Register the callback used to send retransmissions.
+ * Retransmissions are given to this callback as the buffer of the
+ * message built once by osip_message_to_str() instead of the message
+ * structure: the callback receives the transaction (NULL for the
+ * retransmissions of 2xx and ACK), the buffer, its length, the host,
+ * the port and the socket. It returns the same values as the callback
+ * registered with osip_set_cb_send_message(), which is still used for
+ * the first transmissions and for all messages if no callback is set.
+ * @param cf The osip element attached to the transaction.
+ * @param cb The method we want to register (NULL to remove it).
+ */
+  void osip_set_cb_send_raw (osip_t * cf, int (*cb) (osip_transaction_t *, const char *, size_t, char *, int, int));
+/**
+ * Register the callback used to send messages by batch.
+ * When this callback is set, the messages sent by the transactions
+ * (first transmissions and retransmissions) are copied into a batch
+ * and the callback receives the whole batch at the end of
+ * osip_ict_execute(), osip_ist_execute(), osip_nict_execute(),
+ * osip_nist_execute() and osip_retransmissions_execute(), when an
+ * executor thread becomes idle, or when the batch is full. The
+ * buffers are released when the callback returns. The callback sets
+ * the result of each message it could not send: the error is then
+ * reported to the transaction (transport error callback and
+ * termination), as for a message sent with cb_send_message. When the
+ * callback returns an error, it is reported for all the messages
+ * whose result was not set.
+ * @param cf The osip element attached to the transaction.
+ * @param cb The method we want to register (NULL to remove it).
+ */
+  void osip_set_cb_send_batch (osip_t * cf, int (*cb) (osip_t *, osip_batch_message_t *, int));
+/**
+ * Compact the server transactions which only absorb retransmissions.
+ * A NIST entering NIST_COMPLETED and an IST entering IST_CONFIRMED
+ * release orig_request, last_response, ack and their from, to and
+ * callid elements: they only keep the top Via and the CSeq to match
+ * the requests, and the last response as sent on the wire to answer
+ * the retransmissions of a NIST. Then, the callbacks receive the
+ * retransmitted request for OSIP_NIST_REQUEST_RECEIVED_AGAIN and NULL
+ * for the responses sent again, and the kill callbacks find these
+ * elements NULL.
+ * Only the transactions created by RFC3261 compliant requests are
+ * compacted, and a NIST only if a callback is registered with
+ * osip_set_cb_send_raw() or osip_set_cb_send_batch(). If both
+ * callbacks are removed later, a compacted NIST receiving a
+ * retransmission is terminated with a transport error.
+ * @param osip The osip element.
+ * @param enabled 1 to enable the mode, 0 to disable it.
+ */
+  void osip_set_tombstone_mode (osip_t * osip, int enabled);
+/**
+ * Give the messages of the batch to the callback registered with
+ * osip_set_cb_send_batch(). This is needed only when the events
+ * are processed with osip_transaction_execute().
+ * @param osip The osip element.
+ * Returns the value returned by the callback, or 0 if the batch is empty.
+ */
+  int osip_send_batch_flush (osip_t * osip);
+
+/**
+ * Get a file descriptor to wait for the events of the transactions
+ * from an external event loop (epoll, poll, select). It is an eventfd
+ * becoming readable when an event is added to a transaction: then,
+ * call osip_wakeup_clear() and the osip_*_execute() methods.
+ * This must be called before any event is added to the transactions.
+ * @param osip The osip element.
+ * Returns the file descriptor, or OSIP_UNDEFINED_ERROR if the
+ * platform has no eventfd.
+ */
+  int osip_get_wakeup_fd (osip_t * osip);
+/**
+ * Get a file descriptor becoming readable when the earliest timer of
+ * the transactions and of the retransmissions of 2xx and ACK expires:
+ * then, call osip_wakeup_clear(), the osip_timers_*_execute() methods
+ * and osip_retransmissions_execute(). It is a timerfd re-armed when
+ * the timers are executed, which replaces osip_timers_gettimeout().
+ * @param osip The osip element.
+ * Returns the file descriptor, or OSIP_UNDEFINED_ERROR if the
+ * platform has no timerfd.
+ */
+  int osip_get_timer_fd (osip_t * osip);
+/**
+ * Reset the file descriptors returned by osip_get_wakeup_fd() and
+ * osip_get_timer_fd() before the events and timers are executed.
+ * @param osip The osip element.
+ */
+  int osip_wakeup_clear (osip_t * osip);
+/**
+ * Keep up to high_water released transactions of a type, with their
+ * fifo and the context of their state machine, to recycle them in
+ * osip_transaction_init(). When the pool is used, the transactions
+ * of this type must be released before osip_release().
+ * @param osip The osip element.
+ * @param type The type of transactions.
+ * @param high_water The maximum number of idle transactions (0 to disable the pool).
+ */
+  int osip_set_transaction_pool (osip_t * osip, osip_fsm_type_t type, int high_water);
 
 /* FOR INCOMING TRANSACTION */
 /**
@@ -30,7 +30,9 @@
  * @brief oSIP fifo Routines
  *
  * This is a very simple implementation of a fifo.
- * <BR>There is not much to say about it...
+ * <BR>When the compiler provides atomic operations, elements are
+ * added without lock: only the threads getting elements from the
+ * same fifo wait for each other.
  */
 
 /**
@@ -50,6 +52,22 @@ extern "C" {
 
 #endif
 
+/**
+ * Structure for a node of a fifo.
+ * @var osip_fifo_node_t
+ */
+  typedef struct osip_fifo_node osip_fifo_node_t;
+
+/**
+ * Structure for a node of a fifo.
+ * @struct osip_fifo_node
+ */
+  struct osip_fifo_node {
+    osip_fifo_node_t *next;                /**< (internal) next node */
+    void *element;                         /**< (internal) element */
+    int allocated;                         /**< (internal) node allocated by the fifo */
+  };
+
 /**
  * Structure for referencing a fifo.
  * @var osip_fifo_t
@@ -62,12 +80,17 @@ extern "C" {
  */
   struct osip_fifo {
 #ifndef OSIP_MONOTHREAD
-    struct osip_mutex *qislocked;          /**< mutex for fifo */
-    struct osip_sem *qisempty;             /**< semaphore for fifo */
+    struct osip_mutex *qislocked;          /**< mutex for fifo (without atomic operations) */
+    struct osip_sem *qisempty;             /**< semaphore for fifo (created by osip_fifo_get) */
+    int waiters;                           /**< threads blocked in osip_fifo_get */
+    int consumer;                          /**< lock for getting elements */
 #endif
-    osip_list_t queue;                     /**< list of nodes containing elements */
+    osip_fifo_node_t *head;                /**< (internal) next node to get */
+    osip_fifo_node_t *tail;                /**< (internal) last node added */
+    osip_fifo_node_t stub;                 /**< (internal) node of the empty fifo */
     int nb_elt;                            /**< nb of elements */
-    osip_fifo_state state;                 /**< state of the fifo */
+    void (*added) (void *);                /**< (internal) called after an element is added */
+    void *added_arg;                       /**< (internal) argument of added */
   };
 
 /**
@@ -97,6 +120,15 @@ extern "C" {
  * @param element The pointer on the element to add.
  */
   int osip_fifo_add (osip_fifo_t * ff, void *element);
+/**
+ * Add an element in a fifo, using a node provided by the caller
+ * instead of allocating one.
+ * The node must remain valid until the element is taken from the fifo.
+ * @param ff The element to work on.
+ * @param node The node to use.
+ * @param element The pointer on the element to add.
+ */
+  int osip_fifo_add_node (osip_fifo_t * ff, osip_fifo_node_t * node, void *element);
 /**
  * Get the number of element in a fifo.
  * @param ff The element to work on.
@@ -46,6 +46,7 @@
   {
     char *method;    /**< CSeq method */
     char *number;    /**< CSeq number */
+    int method_code; /**< code of CSeq method, set with it by osip_cseq_set_method */
   };
 
 #ifdef __cplusplus
@@ -94,6 +95,8 @@ extern "C"
   char *osip_cseq_get_number (osip_cseq_t * header);
 /**
  * Set the method in the CSeq element.
+ * The code of the method is computed here: do not modify the
+ * method field directly.
  * @param header The element to work on.
  * @param value The value of the element.
  */
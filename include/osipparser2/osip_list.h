@@ -30,6 +30,11 @@
  * @brief oSIP list Routines
  *
  * This is a simple implementation of a linked list.
+ * <BR>When OSIP_LIST_ARRAY is defined (configure --enable-array-list),
+ * the elements are kept in a growable circular array instead: adding
+ * at both ends, removing the first element and getting an element by
+ * its index are done in constant time. Applications must be compiled
+ * with the same definition as the library.
  */
 
 /**
@@ -41,7 +46,7 @@
 extern "C" {
 #endif
 
-#ifndef DOXYGEN
+#if !defined(DOXYGEN) && !defined(OSIP_LIST_ARRAY)
 /**
  * Structure for referencing a node in a osip_list_t element.
  * @var __node_t
@@ -69,8 +74,10 @@ extern "C" {
  * @var osip_list_iterator_t
  */
   typedef struct {
+#ifndef OSIP_LIST_ARRAY
     __node_t *actual; /**< actual */
     __node_t **prev;  /**< prev */
+#endif
     osip_list_t *li;  /**< li */
     int pos;          /**< pos */
   } osip_list_iterator_t;
@@ -82,7 +89,13 @@ extern "C" {
   struct osip_list {
 
     int nb_elt;                 /**< Number of element in the list */
+#ifndef OSIP_LIST_ARRAY
     __node_t *node;             /**< Next node containing element  */
+#else
+    void **array;               /**< Elements, from index start    */
+    int size;                   /**< Allocated size (power of 2)   */
+    int start;                  /**< Index of the first element    */
+#endif
 
   };
 
@@ -151,7 +164,11 @@ extern "C" {
  * Check current iterator state.
  * @param it The element to work on.
  */
+#ifndef OSIP_LIST_ARRAY
 #define osip_list_iterator_has_elem( it ) ( 0 != (it).actual && (it).pos < (it).li->nb_elt )
+#else
+#define osip_list_iterator_has_elem( it ) ( 0 != (it).li && (it).pos < (it).li->nb_elt )
+#endif
 /**
  * Get first iterator from list.
  * @param li The element to work on.
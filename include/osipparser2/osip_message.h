@@ -42,6 +42,30 @@
 extern "C" {
 #endif
 
+/**
+ * Enumeration for the methods known by the parser.
+ * Methods are compared with their code instead of their name;
+ * the name is still used for methods not listed here.
+ * @var osip_method_code_t
+ */
+  typedef enum osip_method_code {
+    OSIP_METHOD_UNKNOWN = 0,    /**< unknown method or not computed */
+    OSIP_METHOD_INVITE,         /**< INVITE method */
+    OSIP_METHOD_ACK,            /**< ACK method */
+    OSIP_METHOD_REGISTER,       /**< REGISTER method */
+    OSIP_METHOD_BYE,            /**< BYE method */
+    OSIP_METHOD_OPTIONS,        /**< OPTIONS method */
+    OSIP_METHOD_INFO,           /**< INFO method */
+    OSIP_METHOD_CANCEL,         /**< CANCEL method */
+    OSIP_METHOD_REFER,          /**< REFER method */
+    OSIP_METHOD_NOTIFY,         /**< NOTIFY method */
+    OSIP_METHOD_SUBSCRIBE,      /**< SUBSCRIBE method */
+    OSIP_METHOD_MESSAGE,        /**< MESSAGE method */
+    OSIP_METHOD_PRACK,          /**< PRACK method */
+    OSIP_METHOD_UPDATE,         /**< UPDATE method */
+    OSIP_METHOD_PUBLISH         /**< PUBLISH method */
+  } osip_method_code_t;
+
 /**
  * Structure for SIP Message (REQUEST and RESPONSE).
  * @var osip_message_t
@@ -56,6 +80,7 @@ extern "C" {
     char *sip_version;                            /**< SIP version (SIP request only) */
     osip_uri_t *req_uri;                          /**< Request-Uri (SIP request only) */
     char *sip_method;                             /**< METHOD (SIP request only) */
+    int sip_method_code;                          /**< code of METHOD, set with it by osip_message_set_method */
 
     int status_code;                              /**< Status Code (SIP answer only) */
     char *reason_phrase;                          /**< Reason Phrase (SIP answer only) */
@@ -97,6 +122,8 @@ extern "C" {
     osip_list_t www_authenticates;                /**< WWW-Authenticate headers */
 
     osip_list_t headers;                          /**< Other headers */
+    osip_list_t lazy_headers;                     /**< Known headers not parsed yet */
+    unsigned int lazy_mask[2];                    /**< (internal) known headers whose parsing is delayed */
 
     osip_list_t bodies;                           /**< List of attachements */
 
@@ -107,6 +134,7 @@ extern "C" {
     int message_property;                         /**< internal value */
     char *message;                                /**< internal value */
     size_t message_length;                        /**< internal value */
+    struct osip_arena *arena;                     /**< internal value */
 
     void *application_data;                       /**< can be used by upper layer*/
   };
@@ -130,6 +158,21 @@ extern "C" {
  * @param sip The element to allocate.
  */
   int osip_message_init (osip_message_t ** sip);
+/**
+ * Allocate a osip_message_t element using its own memory arena.
+ * The message and all the elements allocated while parsing it are
+ * taken from a few pages that are released at once by
+ * osip_message_free(). Elements of such a message must be cloned
+ * if they are needed after the message is freed.
+ * Such a message is meant to be read: its elements must not be freed
+ * or replaced, and elements added to it (except by
+ * osip_message_fix_last_via_header()) are not released by
+ * osip_message_free(). osip_message_clone() gives a copy allocated
+ * with osip_message_init() that can be modified.
+ * Without arena support, this is the same as osip_message_init().
+ * @param sip The element to allocate.
+ */
+  int osip_message_init_arena (osip_message_t ** sip);
 /**
  * Free all resource in a osip_message_t element.
  * @param sip The element to free.
@@ -142,6 +185,21 @@ extern "C" {
  * @param length The length of the buffer to parse.
  */
   int osip_message_parse (osip_message_t * sip, const char *buf, size_t length);
+/**
+ * Parse a osip_message_t element directly inside the caller's buffer.
+ * Unlike osip_message_parse(), no private copy of the message is made
+ * and header names/values are not duplicated before being dispatched
+ * to the header parsers: buf is modified in place (LWS are folded and
+ * header values are NUL terminated). buf MUST be writable and hold at
+ * least length+1 bytes. Its content is undefined after the call.
+ * This is not a zero-copy parser: the elements of the message (uri,
+ * parameters, header values...) are still allocated and the message
+ * does not refer to buf after the call.
+ * @param sip The resulting element.
+ * @param buf The buffer to parse.
+ * @param length The length of the message in buf.
+ */
+  int osip_message_parse_view (osip_message_t * sip, char *buf, size_t length);
 /**
  * Parse a message/sipfrag part and store it in an osip_message_t element.
  * @param sip The resulting element.
@@ -195,10 +253,18 @@ extern "C" {
   int osip_message_get_status_code (const osip_message_t * sip);
 /**
  * Set the method. You can set any string here.
+ * The MSG_IS_* macros use the code of the method computed here: do
+ * not modify the sip_method field directly.
  * @param sip The element to work on.
  * @param method The method name.
  */
   void osip_message_set_method (osip_message_t * sip, char *method);
+/**
+ * Get the code of a method name (OSIP_METHOD_UNKNOWN for other methods).
+ * Method names are case-sensitive.
+ * @param method The method name.
+ */
+  int osip_method_code (const char *method);
 /**
  * Get the method name.
  * @param sip The element to work on.
@@ -242,94 +308,90 @@ extern "C" {
  */
 #define MSG_IS_REQUEST(msg)  ((msg)->status_code==0)
 
+#ifndef DOXYGEN
+/* compare the code of the method, or its name when no code was
+   computed (unknown method, or sip_method set without the setter
+   on a message without method) */
+#define __MSG_IS_METHOD(msg,code,name) (MSG_IS_REQUEST(msg) && \
+			      ((msg)->sip_method_code!=OSIP_METHOD_UNKNOWN ? \
+			       (msg)->sip_method_code==(code) : \
+			       0==strcmp((msg)->sip_method,(name))))
+#endif
+
 /**
  * Test if the message is an INVITE REQUEST
  * @param msg the SIP message.
  */
-#define MSG_IS_INVITE(msg)   (MSG_IS_REQUEST(msg) && \
-			      0==strcmp((msg)->sip_method,"INVITE"))
+#define MSG_IS_INVITE(msg)   __MSG_IS_METHOD(msg,OSIP_METHOD_INVITE,"INVITE")
 /**
  * Test if the message is an ACK REQUEST
  * @param msg the SIP message.
  */
-#define MSG_IS_ACK(msg)      (MSG_IS_REQUEST(msg) && \
-			      0==strcmp((msg)->sip_method,"ACK"))
+#define MSG_IS_ACK(msg)      __MSG_IS_METHOD(msg,OSIP_METHOD_ACK,"ACK")
 /**
  * Test if the message is a REGISTER REQUEST
  * @param msg the SIP message.
  */
-#define MSG_IS_REGISTER(msg) (MSG_IS_REQUEST(msg) && \
-			      0==strcmp((msg)->sip_method,"REGISTER"))
+#define MSG_IS_REGISTER(msg) __MSG_IS_METHOD(msg,OSIP_METHOD_REGISTER,"REGISTER")
 /**
  * Test if the message is a BYE REQUEST
  * @param msg the SIP message.
  */
-#define MSG_IS_BYE(msg)      (MSG_IS_REQUEST(msg) && \
-			      0==strcmp((msg)->sip_method,"BYE"))
+#define MSG_IS_BYE(msg)      __MSG_IS_METHOD(msg,OSIP_METHOD_BYE,"BYE")
 /**
  * Test if the message is an OPTIONS REQUEST
  * @param msg the SIP message.
  */
-#define MSG_IS_OPTIONS(msg)  (MSG_IS_REQUEST(msg) && \
-			      0==strcmp((msg)->sip_method,"OPTIONS"))
+#define MSG_IS_OPTIONS(msg)  __MSG_IS_METHOD(msg,OSIP_METHOD_OPTIONS,"OPTIONS")
 /**
  * Test if the message is an INFO REQUEST
  * @param msg the SIP message.
  */
-#define MSG_IS_INFO(msg)     (MSG_IS_REQUEST(msg) && \
-			      0==strcmp((msg)->sip_method,"INFO"))
+#define MSG_IS_INFO(msg)     __MSG_IS_METHOD(msg,OSIP_METHOD_INFO,"INFO")
 /**
  * Test if the message is a CANCEL REQUEST
  * @param msg the SIP message.
  */
-#define MSG_IS_CANCEL(msg)   (MSG_IS_REQUEST(msg) && \
-			      0==strcmp((msg)->sip_method,"CANCEL"))
+#define MSG_IS_CANCEL(msg)   __MSG_IS_METHOD(msg,OSIP_METHOD_CANCEL,"CANCEL")
 /**
  * Test if the message is a REFER REQUEST
  * @param msg the SIP message.
  */
-#define MSG_IS_REFER(msg)   (MSG_IS_REQUEST(msg) && \
-			      0==strcmp((msg)->sip_method,"REFER"))
+#define MSG_IS_REFER(msg)   __MSG_IS_METHOD(msg,OSIP_METHOD_REFER,"REFER")
 /**
  * Test if the message is a NOTIFY REQUEST
  * @param msg the SIP message.
  */
-#define MSG_IS_NOTIFY(msg)   (MSG_IS_REQUEST(msg) && \
-			      0==strcmp((msg)->sip_method,"NOTIFY"))
+#define MSG_IS_NOTIFY(msg)   __MSG_IS_METHOD(msg,OSIP_METHOD_NOTIFY,"NOTIFY")
 /**
  * Test if the message is a SUBSCRIBE REQUEST
  * @def MSG_IS_SUBSCRIBE
  * @param msg the SIP message.
  */
-#define MSG_IS_SUBSCRIBE(msg)  (MSG_IS_REQUEST(msg) && \
-			      0==strcmp((msg)->sip_method,"SUBSCRIBE"))
+#define MSG_IS_SUBSCRIBE(msg)  __MSG_IS_METHOD(msg,OSIP_METHOD_SUBSCRIBE,"SUBSCRIBE")
 /**
  * Test if the message is a MESSAGE REQUEST
  * @param msg the SIP message.
  */
-#define MSG_IS_MESSAGE(msg)  (MSG_IS_REQUEST(msg) && \
-			      0==strcmp((msg)->sip_method,"MESSAGE"))
+#define MSG_IS_MESSAGE(msg)  __MSG_IS_METHOD(msg,OSIP_METHOD_MESSAGE,"MESSAGE")
 /**
  * Test if the message is a PRACK REQUEST  (!! PRACK IS NOT SUPPORTED by the fsm!!)
  * @param msg the SIP message.
  */
-#define MSG_IS_PRACK(msg)    (MSG_IS_REQUEST(msg) && \
-			      0==strcmp((msg)->sip_method,"PRACK"))
+#define MSG_IS_PRACK(msg)    __MSG_IS_METHOD(msg,OSIP_METHOD_PRACK,"PRACK")
 
 
 /**
  * Test if the message is an UPDATE REQUEST
  * @param msg the SIP message.
  */
-#define MSG_IS_UPDATE(msg)    (MSG_IS_REQUEST(msg) && \
-			      0==strcmp((msg)->sip_method,"UPDATE"))
+#define MSG_IS_UPDATE(msg)    __MSG_IS_METHOD(msg,OSIP_METHOD_UPDATE,"UPDATE")
 
 /**
  * Test if the message is an UPDATE REQUEST
  * @param msg the SIP message.
  */
-#define MSG_IS_PUBLISH(msg)    (MSG_IS_REQUEST(msg) && \
-			      0==strcmp((msg)->sip_method,"PUBLISH"))
+#define MSG_IS_PUBLISH(msg)    __MSG_IS_METHOD(msg,OSIP_METHOD_PUBLISH,"PUBLISH")
 
 
 /**
@@ -44,6 +44,82 @@ extern "C" {
  */
   int parser_init (void);
 
+/**
+ * Delay the parsing of a header of a message.
+ * When enabled, osip_message_parse() only keeps the raw value of
+ * the header: the header is parsed by osip_message_parse_lazy_header(),
+ * osip_message_parse_lazy_headers() or osip_message_to_str(). Until
+ * then, the list of the header in osip_message_t is empty and its
+ * accessors (osip_message_get_call_info()...) do not find it: they
+ * never modify the message.
+ * Only headers whose syntax errors are ignored by the parser can be
+ * delayed (Route and Record-Route excepted); the compact form of the
+ * header is delayed with it. Call before parsing the message.
+ * @param sip The element to work on.
+ * @param hname The header name (ie: "Call-Info").
+ * @param lazy 1 to delay parsing, 0 to parse while parsing the message.
+ */
+  int osip_message_set_lazy_header (osip_message_t * sip, const char *hname, int lazy);
+
+/**
+ * Parse the headers of a message with this name whose parsing was delayed.
+ * @param sip The element to work on.
+ * @param hname The header name (ie: "Call-Info").
+ */
+  int osip_message_parse_lazy_header (osip_message_t * sip, const char *hname);
+
+/**
+ * Parse all headers of a message whose parsing was delayed.
+ * @param sip The element to work on.
+ */
+  int osip_message_parse_lazy_headers (osip_message_t * sip);
+
+/**
+ * Structure for framing SIP messages received on a stream (TCP/TLS).
+ * @var osip_stream_parser_t
+ */
+  typedef struct osip_stream_parser osip_stream_parser_t;
+
+/**
+ * Allocate a osip_stream_parser_t element for one connection.
+ * @param parser The element to allocate.
+ * @param max_size The maximum size of one message (0 for 65536 bytes).
+ */
+  int osip_stream_parser_init (osip_stream_parser_t ** parser, size_t max_size);
+/**
+ * Free all resource in a osip_stream_parser_t element.
+ * @param parser The element to free.
+ */
+  void osip_stream_parser_free (osip_stream_parser_t * parser);
+/**
+ * Append bytes received on the stream. Data may be split anywhere:
+ * messages are extracted with osip_stream_parser_get_message().
+ * @param parser The element to work on.
+ * @param buf The received bytes.
+ * @param length The number of bytes in buf.
+ */
+  int osip_stream_parser_feed (osip_stream_parser_t * parser, const char *buf, size_t length);
+/**
+ * Get the next complete message received on the stream.
+ * Bytes already examined are not scanned again: the end of headers is
+ * searched in new data only and the body is framed with Content-Length.
+ * Returns OSIP_NOTFOUND when more data is needed, OSIP_SYNTAXERROR when
+ * a complete message could not be parsed (it is discarded and the
+ * stream can still be used) and OSIP_WRONG_STATE when the stream can't
+ * be framed anymore (the connection must be closed).
+ * Use osip_new_incoming_sipmessage() to build the matching osip_event_t.
+ * @param parser The element to work on.
+ * @param sip A pointer on the new message.
+ */
+  int osip_stream_parser_get_message (osip_stream_parser_t * parser, osip_message_t ** sip);
+/**
+ * Get the number of RFC 5626 keep-alive "ping" (double CRLF) received
+ * between messages since the last call. Each of them must be answered
+ * with a single CRLF. Single CRLF ("pong") are silently discarded.
+ * @param parser The element to work on.
+ */
+  int osip_stream_parser_get_pings (osip_stream_parser_t * parser);
+
 /**
  * Fix the via header for INCOMING requests only.
  * a copy of ip_addr is done.
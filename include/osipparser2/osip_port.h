@@ -95,6 +95,25 @@ extern "C" {
 #else
 
 #ifndef MINISIZE
+#if defined(__GNUC__) && !defined(osip_malloc) && !defined(osip_realloc) && !defined(osip_free)
+  /* per-message memory arenas (see osip_message_init_arena) */
+#define OSIP_ARENA
+
+  struct osip_arena;
+
+  extern int osip_arena_used;
+
+  void *__osip_arena_malloc (size_t size);
+  void *__osip_arena_realloc (void *ptr, size_t size);
+  void __osip_arena_free (void *ptr);
+  struct osip_arena *__osip_arena_create (void);
+  void __osip_arena_release (struct osip_arena *arena);
+  struct osip_arena *__osip_arena_bind (struct osip_arena *arena);
+
+#define osip_malloc(S) (osip_arena_used?__osip_arena_malloc(S):osip_malloc_func?osip_malloc_func(S):malloc(S))
+#define osip_realloc(P,S) (osip_arena_used?__osip_arena_realloc(P,S):osip_realloc_func?osip_realloc_func(P,S):realloc(P,S))
+#define osip_free(P) { if (P!=NULL) { if (osip_arena_used) __osip_arena_free(P); else if (osip_free_func) osip_free_func(P); else free(P);} }
+#endif
 #ifndef osip_malloc
 #define osip_malloc(S) (osip_malloc_func?osip_malloc_func(S):malloc(S))
 #endif
@@ -145,6 +164,64 @@ extern "C" {
 
 #endif
 
+/**************************/
+/* small objects pools    */
+/**************************/
+
+#define OSIP_POOL_NB_CLASSES 4
+#define OSIP_POOL_MAX_SIZE 64
+
+#if defined(OSIP_ARENA) && !defined(OSIP_NO_POOL)
+  /* list nodes, parameters and headers are taken from pools */
+#define OSIP_POOL
+
+  void *__osip_pool_malloc (size_t size);
+  void __osip_pool_free (void *ptr, size_t size);
+#else
+#define __osip_pool_malloc(S) osip_malloc(S)
+#define __osip_pool_free(P,S) osip_free(P)
+#endif
+
+/**
+ * Structure for the statistics of a size class of the small objects pools.
+ * @var osip_pool_stats_t
+ */
+  typedef struct osip_pool_stats osip_pool_stats_t;
+
+/**
+ * Structure for the statistics of a size class of the small objects pools.
+ * @struct osip_pool_stats
+ */
+  struct osip_pool_stats {
+    size_t object_size;         /**< size of objects in this class */
+    unsigned long allocations;  /**< number of objects allocated */
+    unsigned long frees;        /**< number of objects released */
+    unsigned long hits;         /**< allocations served with a released object */
+    size_t resident_bytes;      /**< memory held by the pages of this class */
+  };
+
+/**
+ * Get the statistics of a size class of the small objects pools.
+ * List nodes, url and generic parameters and headers are allocated
+ * in pools: released objects are kept for the next allocation of the
+ * same size class instead of going back to the heap. Counters of a
+ * thread are added in batches, so they may lag behind a little.
+ * @param size_class The size class, from 0 to OSIP_POOL_NB_CLASSES-1.
+ * @param stats The structure to fill.
+ * Returns OSIP_NOTFOUND for an unknown class or when pools are not
+ * compiled in (OSIP_NO_POOL, DEBUG_MEM or custom osip_malloc macros).
+ */
+  int osip_pool_get_stats (int size_class, osip_pool_stats_t * stats);
+
+/**
+ * Give the objects cached by the calling thread back to the pools.
+ * A thread releasing small objects keeps a few of them for its next
+ * allocations. With pthreads, they are given back when the thread
+ * exits; otherwise call this method before the thread exits so that
+ * they can be reused by the other threads.
+ */
+  void osip_pool_thread_release (void);
+
 #ifdef WIN32
 #define alloca _alloca
 #endif
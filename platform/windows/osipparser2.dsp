@@ -224,6 +224,10 @@ SOURCE=..\..\src\osipparser2\osip_route.c
 # End Source File
 # Begin Source File
 
+SOURCE=..\..\src\osipparser2\osip_stream.c
+# End Source File
+# Begin Source File
+
 SOURCE=..\..\src\osipparser2\osip_to.c
 # End Source File
 # Begin Source File
@@ -29,8 +29,22 @@
 
 typedef struct osip_statemachine osip_statemachine_t;
 
+#define FSM_NB_STATES 5         /* states of a transaction type are consecutive */
+
+typedef void (*osip_fsm_method_t) (void *, void *);
+
+#define FSM_METHOD(method) ((osip_fsm_method_t) &method)
+
+/* The rows of methods are written positionally in the order of the
+   type_t enumeration: this fails to compile if an event is added
+   without updating the four state machines. */
+typedef char osip_fsm_nb_events_check[(UNKNOWN_EVT == 24) ? 1 : -1];
+
+/* The definition of a state machine: the method to call, indexed by
+   state (relative to first_state) and event type. */
 struct osip_statemachine {
-  struct _transition_t *transitions;
+  state_t first_state;
+  osip_fsm_method_t methods[FSM_NB_STATES][UNKNOWN_EVT];
 };
 
 /**
@@ -40,23 +54,19 @@ struct osip_statemachine {
  * @param transactionid The transaction id for this event.
  */
 osip_event_t *__osip_event_new (type_t type, int transactionid);
+/**
+ * Release a sipevent (without its message) to the pool of events.
+ * NOTE: THIS IS AN INTERNAL METHOD ONLY
+ * @param evt The event to release.
+ */
+void __osip_event_release (osip_event_t * evt);
 
 
 /* This is for internal use only.                      */
 type_t evt_set_type_incoming_sipmessage (osip_message_t * sip);
 type_t evt_set_type_outgoing_sipmessage (osip_message_t * sip);
 
-typedef struct _transition_t transition_t;
-
-struct _transition_t {
-  state_t state;
-  type_t type;
-  void (*method) (void *, void *);
-  struct _transition_t *next;
-  struct _transition_t *parent;
-};
-
-int fsm_callmethod (type_t type, state_t state, osip_statemachine_t * statemachine, void *sipevent, void *transaction);
+int fsm_callmethod (type_t type, state_t state, const osip_statemachine_t * statemachine, void *sipevent, void *transaction);
 
 
 /*!! THESE ARE FOR INTERNAL USE ONLY!! */
@@ -76,6 +86,7 @@ void ict_rcv_2xx (osip_transaction_t * ict, osip_event_t * evt);
 osip_message_t *ict_create_ack (osip_transaction_t * ict, osip_message_t * response);
 void ict_rcv_3456xx (osip_transaction_t * ict, osip_event_t * evt);
 void ict_retransmit_ack (osip_transaction_t * ict, osip_event_t * evt);
+void ict_rcv_transport_error (osip_transaction_t * ict, osip_event_t * evt);
 
 /************************/
 /* FSM  ---- > IST      */
@@ -89,6 +100,7 @@ void ist_snd_1xx (osip_transaction_t * ist, osip_event_t * evt);
 void ist_snd_2xx (osip_transaction_t * ist, osip_event_t * evt);
 void ist_snd_3456xx (osip_transaction_t * ist, osip_event_t * evt);
 void ist_rcv_ack (osip_transaction_t * ist, osip_event_t * evt);
+void ist_rcv_transport_error (osip_transaction_t * ist, osip_event_t * evt);
 
 /***********************/
 /* FSM  ---- > NICT    */
@@ -100,6 +112,7 @@ void osip_nict_timeout_f_event (osip_transaction_t * nict, osip_event_t * evt);
 void osip_nict_timeout_k_event (osip_transaction_t * nict, osip_event_t * evt);
 void nict_rcv_1xx (osip_transaction_t * nict, osip_event_t * evt);
 void nict_rcv_23456xx (osip_transaction_t * nict, osip_event_t * evt);
+void nict_rcv_transport_error (osip_transaction_t * nict, osip_event_t * evt);
 
 /* void nict_rcv_23456xx2(osip_transaction_t *nict, osip_event_t *evt); */
 
@@ -111,6 +124,7 @@ void nist_rcv_request (osip_transaction_t * nist, osip_event_t * evt);
 void nist_snd_1xx (osip_transaction_t * nist, osip_event_t * evt);
 void nist_snd_23456xx (osip_transaction_t * nist, osip_event_t * evt);
 void osip_nist_timeout_j_event (osip_transaction_t * nist, osip_event_t * evt);
+void nist_rcv_transport_error (osip_transaction_t * nist, osip_event_t * evt);
 
 /************************/
 /* Internal Methods     */
@@ -150,6 +164,36 @@ int
 osip_event_t *__osip_transaction_need_timer_x_event (void *xixt, struct timeval *timer, int cond_state, int transactionid, int TIMER_VAL);
 
 int __osip_transaction_snd_xxx (osip_transaction_t * ist, osip_message_t * msg);
+/* retransmit the last response of a server transaction */
+int __osip_transaction_resnd_xxx (osip_transaction_t * ist, osip_message_t * msg);
+/* send msg with cb_send_batch if registered, or with cb_send_message */
+int __osip_transaction_send (osip_t * osip, osip_transaction_t * tr, osip_message_t * msg, char *host, int port, int out_socket);
+/* retransmit msg with cb_send_batch or cb_send_raw if registered, or with cb_send_message */
+int __osip_transaction_resend (osip_t * osip, osip_transaction_t * tr, osip_message_t * msg, char *host, int port, int out_socket);
+
+/* compact state of a server transaction in NIST_COMPLETED or IST_CONFIRMED */
+struct osip_tombstone {
+  int status_code;              /* of the last response */
+  char *response;               /* last response as sent on the wire, or NULL */
+  size_t length;
+  char *host;                   /* destination of the response */
+  int port;
+};
+
+/* replace the messages of a completed server transaction by a tombstone */
+int __osip_transaction_compact (osip_transaction_t * tr);
+/* retransmit the response kept in the tombstone */
+int __osip_transaction_resnd_tombstone (osip_transaction_t * tr);
+
+int __osip_send_batch_init (struct osip_send_batch **batch);
+void __osip_send_batch_free (struct osip_send_batch *batch);
+
+int __osip_transaction_pool_init (struct osip_transaction_pool **pool);
+void __osip_transaction_pool_free (struct osip_transaction_pool *pool);
+/* take an idle transaction of this type, or NULL */
+osip_transaction_t *__osip_transaction_pool_get (osip_t * osip, osip_fsm_type_t type);
+/* keep a released transaction, or OSIP_UNDEFINED_ERROR if the pool is not used */
+int __osip_transaction_pool_put (osip_transaction_t * tr);
 
 #endif
 
@@ -31,7 +31,8 @@ __osip_ict_init (osip_ict_t ** ict, osip_t * osip, osip_message_t * invite)
 
   OSIP_TRACE (osip_trace (__FILE__, __LINE__, OSIP_INFO2, NULL, "allocating ICT context\n"));
 
-  *ict = (osip_ict_t *) osip_malloc (sizeof (osip_ict_t));
+  if (*ict == NULL)             /* not recycled by the pool of transactions */
+    *ict = (osip_ict_t *) osip_malloc (sizeof (osip_ict_t));
   if (*ict == NULL)
     return OSIP_NOMEM;
 
@@ -44,11 +45,13 @@ __osip_ict_init (osip_ict_t ** ict, osip_t * osip, osip_message_t * invite)
     i = osip_message_get_via (invite, 0, &via); /* get top via */
     if (i < 0) {
       osip_free (*ict);
+      *ict = NULL;
       return i;
     }
     proto = via_get_protocol (via);
     if (proto == NULL) {
       osip_free (*ict);
+      *ict = NULL;
       return OSIP_SYNTAXERROR;
     }
 #ifdef USE_BLOCKINGSOCKET
@@ -23,68 +23,99 @@
 #include "fsm.h"
 #include "xixt.h"
 
-transition_t ict_transition[11] = {
+/* methods indexed by [state - ICT_PRE_CALLING][event type] */
+const osip_statemachine_t ict_fsm = {
+  ICT_PRE_CALLING,
   {
-   ICT_PRE_CALLING,
-   SND_REQINVITE,
-   (void (*)(void *, void *)) &ict_snd_invite,
-   &ict_transition[1], NULL}
-  ,
-  {
-   ICT_CALLING,
-   TIMEOUT_A,
-   (void (*)(void *, void *)) &osip_ict_timeout_a_event,
-   &ict_transition[2], NULL}
-  ,
-  {
-   ICT_CALLING,
-   TIMEOUT_B,
-   (void (*)(void *, void *)) &osip_ict_timeout_b_event,
-   &ict_transition[3], NULL}
-  ,
-  {ICT_CALLING,
-   RCV_STATUS_1XX,
-   (void (*)(void *, void *)) &ict_rcv_1xx,
-   &ict_transition[4], NULL}
-  ,
-  {ICT_CALLING,
-   RCV_STATUS_2XX,
-   (void (*)(void *, void *)) &ict_rcv_2xx,
-   &ict_transition[5], NULL}
-  ,
-  {ICT_CALLING,
-   RCV_STATUS_3456XX,
-   (void (*)(void *, void *)) &ict_rcv_3456xx,
-   &ict_transition[6], NULL}
-  ,
-  {ICT_PROCEEDING,
-   RCV_STATUS_1XX,
-   (void (*)(void *, void *)) &ict_rcv_1xx,
-   &ict_transition[7], NULL}
-  ,
-  {ICT_PROCEEDING,
-   RCV_STATUS_2XX,
-   (void (*)(void *, void *)) &ict_rcv_2xx,
-   &ict_transition[8], NULL}
-  ,
-  {ICT_PROCEEDING,
-   RCV_STATUS_3456XX,
-   (void (*)(void *, void *)) &ict_rcv_3456xx,
-   &ict_transition[9], NULL}
-  ,
-  {ICT_COMPLETED,
-   RCV_STATUS_3456XX,
-   (void (*)(void *, void *)) &ict_retransmit_ack,
-   &ict_transition[10], NULL}
-  ,
-  {ICT_COMPLETED,
-   TIMEOUT_D,
-   (void (*)(void *, void *)) &osip_ict_timeout_d_event,
-   NULL, NULL}
+   /* ICT_PRE_CALLING */
+   {
+    /* TIMEOUT_A, TIMEOUT_B, TIMEOUT_D */
+    NULL, NULL, NULL,
+    /* TIMEOUT_E, TIMEOUT_F, TIMEOUT_K */
+    NULL, NULL, NULL,
+    /* TIMEOUT_G, TIMEOUT_H, TIMEOUT_I */
+    NULL, NULL, NULL,
+    /* TIMEOUT_J */
+    NULL,
+    /* RCV_REQINVITE, RCV_REQACK, RCV_REQUEST */
+    NULL, NULL, NULL,
+    /* RCV_STATUS_1XX, RCV_STATUS_2XX, RCV_STATUS_3456XX */
+    NULL, NULL, NULL,
+    /* SND_REQINVITE, SND_REQACK, SND_REQUEST */
+    FSM_METHOD (ict_snd_invite), NULL, NULL,
+    /* SND_STATUS_1XX, SND_STATUS_2XX, SND_STATUS_3456XX */
+    NULL, NULL, NULL,
+    /* KILL_TRANSACTION, TRANSPORT_ERROR */
+    NULL, FSM_METHOD (ict_rcv_transport_error)
+   },
+   /* ICT_CALLING */
+   {
+    /* TIMEOUT_A, TIMEOUT_B, TIMEOUT_D */
+    FSM_METHOD (osip_ict_timeout_a_event), FSM_METHOD (osip_ict_timeout_b_event), NULL,
+    /* TIMEOUT_E, TIMEOUT_F, TIMEOUT_K */
+    NULL, NULL, NULL,
+    /* TIMEOUT_G, TIMEOUT_H, TIMEOUT_I */
+    NULL, NULL, NULL,
+    /* TIMEOUT_J */
+    NULL,
+    /* RCV_REQINVITE, RCV_REQACK, RCV_REQUEST */
+    NULL, NULL, NULL,
+    /* RCV_STATUS_1XX, RCV_STATUS_2XX, RCV_STATUS_3456XX */
+    FSM_METHOD (ict_rcv_1xx), FSM_METHOD (ict_rcv_2xx), FSM_METHOD (ict_rcv_3456xx),
+    /* SND_REQINVITE, SND_REQACK, SND_REQUEST */
+    NULL, NULL, NULL,
+    /* SND_STATUS_1XX, SND_STATUS_2XX, SND_STATUS_3456XX */
+    NULL, NULL, NULL,
+    /* KILL_TRANSACTION, TRANSPORT_ERROR */
+    NULL, FSM_METHOD (ict_rcv_transport_error)
+   },
+   /* ICT_PROCEEDING */
+   {
+    /* TIMEOUT_A, TIMEOUT_B, TIMEOUT_D */
+    NULL, NULL, NULL,
+    /* TIMEOUT_E, TIMEOUT_F, TIMEOUT_K */
+    NULL, NULL, NULL,
+    /* TIMEOUT_G, TIMEOUT_H, TIMEOUT_I */
+    NULL, NULL, NULL,
+    /* TIMEOUT_J */
+    NULL,
+    /* RCV_REQINVITE, RCV_REQACK, RCV_REQUEST */
+    NULL, NULL, NULL,
+    /* RCV_STATUS_1XX, RCV_STATUS_2XX, RCV_STATUS_3456XX */
+    FSM_METHOD (ict_rcv_1xx), FSM_METHOD (ict_rcv_2xx), FSM_METHOD (ict_rcv_3456xx),
+    /* SND_REQINVITE, SND_REQACK, SND_REQUEST */
+    NULL, NULL, NULL,
+    /* SND_STATUS_1XX, SND_STATUS_2XX, SND_STATUS_3456XX */
+    NULL, NULL, NULL,
+    /* KILL_TRANSACTION, TRANSPORT_ERROR */
+    NULL, FSM_METHOD (ict_rcv_transport_error)
+   },
+   /* ICT_COMPLETED */
+   {
+    /* TIMEOUT_A, TIMEOUT_B, TIMEOUT_D */
+    NULL, NULL, FSM_METHOD (osip_ict_timeout_d_event),
+    /* TIMEOUT_E, TIMEOUT_F, TIMEOUT_K */
+    NULL, NULL, NULL,
+    /* TIMEOUT_G, TIMEOUT_H, TIMEOUT_I */
+    NULL, NULL, NULL,
+    /* TIMEOUT_J */
+    NULL,
+    /* RCV_REQINVITE, RCV_REQACK, RCV_REQUEST */
+    NULL, NULL, NULL,
+    /* RCV_STATUS_1XX, RCV_STATUS_2XX, RCV_STATUS_3456XX */
+    NULL, NULL, FSM_METHOD (ict_retransmit_ack),
+    /* SND_REQINVITE, SND_REQACK, SND_REQUEST */
+    NULL, NULL, NULL,
+    /* SND_STATUS_1XX, SND_STATUS_2XX, SND_STATUS_3456XX */
+    NULL, NULL, NULL,
+    /* KILL_TRANSACTION, TRANSPORT_ERROR */
+    NULL, FSM_METHOD (ict_rcv_transport_error)
+   },
+   /* ICT_TERMINATED */
+   {NULL}
+  }
 };
 
-osip_statemachine_t ict_fsm = { ict_transition };
-
 static void
 ict_handle_transport_error (osip_transaction_t * ict, int err)
 {
@@ -94,6 +125,13 @@ ict_handle_transport_error (osip_transaction_t * ict, int err)
   /* TODO: MUST BE DELETED NOW */
 }
 
+/* a message sent by batch could not be sent */
+void
+ict_rcv_transport_error (osip_transaction_t * ict, osip_event_t * evt)
+{
+  ict_handle_transport_error (ict, evt->error);
+}
+
 void
 ict_snd_invite (osip_transaction_t * ict, osip_event_t * evt)
 {
@@ -103,7 +141,7 @@ ict_snd_invite (osip_transaction_t * ict, osip_event_t * evt)
   /* Here we have ict->orig_request == NULL */
   ict->orig_request = evt->sip;
 
-  i = osip->cb_send_message (ict, evt->sip, ict->ict_context->destination, ict->ict_context->port, ict->out_socket);
+  i = __osip_transaction_send (osip, ict, evt->sip, ict->ict_context->destination, ict->ict_context->port, ict->out_socket);
 
   if (i < 0) {
     ict_handle_transport_error (ict, i);
@@ -151,9 +189,10 @@ osip_ict_timeout_a_event (osip_transaction_t * ict, osip_event_t * evt)
   ict->ict_context->timer_a_length = ict->ict_context->timer_a_length * 2;
   osip_gettimeofday (&ict->ict_context->timer_a_start, NULL);
   add_gettimeofday (&ict->ict_context->timer_a_start, ict->ict_context->timer_a_length);
+  __osip_transaction_update_timers (ict);
 
   /* retransmit REQUEST */
-  i = osip->cb_send_message (ict, ict->orig_request, ict->ict_context->destination, ict->ict_context->port, ict->out_socket);
+  i = __osip_transaction_resend (osip, ict, ict->orig_request, ict->ict_context->destination, ict->ict_context->port, ict->out_socket);
   if (i < 0) {
     ict_handle_transport_error (ict, i);
     return;
@@ -182,6 +221,7 @@ osip_ict_timeout_a_event (osip_transaction_t * ict, osip_event_t * evt)
     else {                      /* reliable protocol is used: */
       ict->ict_context->timer_a_length = -1;    /* A is not ACTIVE */
       ict->ict_context->timer_a_start.tv_sec = -1;
+      __osip_transaction_update_timers (ict);
     }
   }
 #endif
@@ -262,18 +302,17 @@ ict_create_ack (osip_transaction_t * ict, osip_message_t * response)
     return NULL;
   }
   osip_free (ack->cseq->method);
-  ack->cseq->method = osip_strdup ("ACK");
+  osip_cseq_set_method (ack->cseq, osip_strdup ("ACK"));
   if (ack->cseq->method == NULL) {
     osip_message_free (ack);
     return NULL;
   }
 
-  ack->sip_method = (char *) osip_malloc (5);
+  osip_message_set_method (ack, osip_strdup ("ACK"));
   if (ack->sip_method == NULL) {
     osip_message_free (ack);
     return NULL;
   }
-  sprintf (ack->sip_method, "ACK");
   ack->sip_version = osip_strdup (ict->orig_request->sip_version);
   if (ack->sip_version == NULL) {
     osip_message_free (ack);
@@ -398,7 +437,7 @@ ict_rcv_3456xx (osip_transaction_t * ict, osip_event_t * evt)
           osip_ict_set_destination (ict->ict_context, osip_strdup (ack->req_uri->host), port);
       }
     }
-    i = osip->cb_send_message (ict, ack, ict->ict_context->destination, ict->ict_context->port, ict->out_socket);
+    i = __osip_transaction_send (osip, ict, ack, ict->ict_context->destination, ict->ict_context->port, ict->out_socket);
     if (i != 0) {
       ict_handle_transport_error (ict, i);
       return;
@@ -445,7 +484,7 @@ ict_retransmit_ack (osip_transaction_t * ict, osip_event_t * evt)
 
   osip_message_free (evt->sip);
 
-  i = osip->cb_send_message (ict, ict->ack, ict->ict_context->destination, ict->ict_context->port, ict->out_socket);
+  i = __osip_transaction_resend (osip, ict, ict->ack, ict->ict_context->destination, ict->ict_context->port, ict->out_socket);
 
   if (i == 0) {
     __osip_message_callback (OSIP_ICT_ACK_SENT_AGAIN, ict, ict->ack);
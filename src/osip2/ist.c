@@ -29,7 +29,8 @@ __osip_ist_init (osip_ist_t ** ist, osip_t * osip, osip_message_t * invite)
 
   OSIP_TRACE (osip_trace (__FILE__, __LINE__, OSIP_INFO2, NULL, "allocating IST context\n"));
 
-  *ist = (osip_ist_t *) osip_malloc (sizeof (osip_ist_t));
+  if (*ist == NULL)             /* not recycled by the pool of transactions */
+    *ist = (osip_ist_t *) osip_malloc (sizeof (osip_ist_t));
   if (*ist == NULL)
     return OSIP_NOMEM;
   memset (*ist, 0, sizeof (osip_ist_t));
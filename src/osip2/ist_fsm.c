@@ -22,76 +22,99 @@
 
 #include "fsm.h"
 
-transition_t ist_transition[11] = {
+/* methods indexed by [state - IST_PRE_PROCEEDING][event type] */
+const osip_statemachine_t ist_fsm = {
+  IST_PRE_PROCEEDING,
   {
-   IST_PRE_PROCEEDING,
-   RCV_REQINVITE,
-   (void (*)(void *, void *)) &ist_rcv_invite,
-   &ist_transition[1], NULL}
-  ,
-  {
-   IST_PROCEEDING,
-   RCV_REQINVITE,
-   (void (*)(void *, void *)) &ist_rcv_invite,
-   &ist_transition[2], NULL}
-  ,
-  {
-   IST_COMPLETED,
-   RCV_REQINVITE,
-   (void (*)(void *, void *)) &ist_rcv_invite,
-   &ist_transition[3], NULL}
-  ,
-  {
-   IST_COMPLETED,
-   TIMEOUT_G,
-   (void (*)(void *, void *)) &osip_ist_timeout_g_event,
-   &ist_transition[4], NULL}
-  ,
-  {
-   IST_COMPLETED,
-   TIMEOUT_H,
-   (void (*)(void *, void *)) &osip_ist_timeout_h_event,
-   &ist_transition[5], NULL}
-  ,
-  {
-   IST_PROCEEDING,
-   SND_STATUS_1XX,
-   (void (*)(void *, void *)) &ist_snd_1xx,
-   &ist_transition[6], NULL}
-  ,
-  {
-   IST_PROCEEDING,
-   SND_STATUS_2XX,
-   (void (*)(void *, void *)) &ist_snd_2xx,
-   &ist_transition[7], NULL}
-  ,
-  {
-   IST_PROCEEDING,
-   SND_STATUS_3456XX,
-   (void (*)(void *, void *)) &ist_snd_3456xx,
-   &ist_transition[8], NULL}
-  ,
-  {
-   IST_COMPLETED,
-   RCV_REQACK,
-   (void (*)(void *, void *)) &ist_rcv_ack,
-   &ist_transition[9], NULL}
-  ,
-  {
-   IST_CONFIRMED,
-   RCV_REQACK,
-   (void (*)(void *, void *)) &ist_rcv_ack,
-   &ist_transition[10], NULL}
-  ,
-  {
-   IST_CONFIRMED,
-   TIMEOUT_I,
-   (void (*)(void *, void *)) &osip_ist_timeout_i_event,
-   NULL, NULL}
+   /* IST_PRE_PROCEEDING */
+   {
+    /* TIMEOUT_A, TIMEOUT_B, TIMEOUT_D */
+    NULL, NULL, NULL,
+    /* TIMEOUT_E, TIMEOUT_F, TIMEOUT_K */
+    NULL, NULL, NULL,
+    /* TIMEOUT_G, TIMEOUT_H, TIMEOUT_I */
+    NULL, NULL, NULL,
+    /* TIMEOUT_J */
+    NULL,
+    /* RCV_REQINVITE, RCV_REQACK, RCV_REQUEST */
+    FSM_METHOD (ist_rcv_invite), NULL, NULL,
+    /* RCV_STATUS_1XX, RCV_STATUS_2XX, RCV_STATUS_3456XX */
+    NULL, NULL, NULL,
+    /* SND_REQINVITE, SND_REQACK, SND_REQUEST */
+    NULL, NULL, NULL,
+    /* SND_STATUS_1XX, SND_STATUS_2XX, SND_STATUS_3456XX */
+    NULL, NULL, NULL,
+    /* KILL_TRANSACTION, TRANSPORT_ERROR */
+    NULL, FSM_METHOD (ist_rcv_transport_error)
+   },
+   /* IST_PROCEEDING */
+   {
+    /* TIMEOUT_A, TIMEOUT_B, TIMEOUT_D */
+    NULL, NULL, NULL,
+    /* TIMEOUT_E, TIMEOUT_F, TIMEOUT_K */
+    NULL, NULL, NULL,
+    /* TIMEOUT_G, TIMEOUT_H, TIMEOUT_I */
+    NULL, NULL, NULL,
+    /* TIMEOUT_J */
+    NULL,
+    /* RCV_REQINVITE, RCV_REQACK, RCV_REQUEST */
+    FSM_METHOD (ist_rcv_invite), NULL, NULL,
+    /* RCV_STATUS_1XX, RCV_STATUS_2XX, RCV_STATUS_3456XX */
+    NULL, NULL, NULL,
+    /* SND_REQINVITE, SND_REQACK, SND_REQUEST */
+    NULL, NULL, NULL,
+    /* SND_STATUS_1XX, SND_STATUS_2XX, SND_STATUS_3456XX */
+    FSM_METHOD (ist_snd_1xx), FSM_METHOD (ist_snd_2xx), FSM_METHOD (ist_snd_3456xx),
+    /* KILL_TRANSACTION, TRANSPORT_ERROR */
+    NULL, FSM_METHOD (ist_rcv_transport_error)
+   },
+   /* IST_COMPLETED */
+   {
+    /* TIMEOUT_A, TIMEOUT_B, TIMEOUT_D */
+    NULL, NULL, NULL,
+    /* TIMEOUT_E, TIMEOUT_F, TIMEOUT_K */
+    NULL, NULL, NULL,
+    /* TIMEOUT_G, TIMEOUT_H, TIMEOUT_I */
+    FSM_METHOD (osip_ist_timeout_g_event), FSM_METHOD (osip_ist_timeout_h_event), NULL,
+    /* TIMEOUT_J */
+    NULL,
+    /* RCV_REQINVITE, RCV_REQACK, RCV_REQUEST */
+    FSM_METHOD (ist_rcv_invite), FSM_METHOD (ist_rcv_ack), NULL,
+    /* RCV_STATUS_1XX, RCV_STATUS_2XX, RCV_STATUS_3456XX */
+    NULL, NULL, NULL,
+    /* SND_REQINVITE, SND_REQACK, SND_REQUEST */
+    NULL, NULL, NULL,
+    /* SND_STATUS_1XX, SND_STATUS_2XX, SND_STATUS_3456XX */
+    NULL, NULL, NULL,
+    /* KILL_TRANSACTION, TRANSPORT_ERROR */
+    NULL, FSM_METHOD (ist_rcv_transport_error)
+   },
+   /* IST_CONFIRMED */
+   {
+    /* TIMEOUT_A, TIMEOUT_B, TIMEOUT_D */
+    NULL, NULL, NULL,
+    /* TIMEOUT_E, TIMEOUT_F, TIMEOUT_K */
+    NULL, NULL, NULL,
+    /* TIMEOUT_G, TIMEOUT_H, TIMEOUT_I */
+    NULL, NULL, FSM_METHOD (osip_ist_timeout_i_event),
+    /* TIMEOUT_J */
+    NULL,
+    /* RCV_REQINVITE, RCV_REQACK, RCV_REQUEST */
+    NULL, FSM_METHOD (ist_rcv_ack), NULL,
+    /* RCV_STATUS_1XX, RCV_STATUS_2XX, RCV_STATUS_3456XX */
+    NULL, NULL, NULL,
+    /* SND_REQINVITE, SND_REQACK, SND_REQUEST */
+    NULL, NULL, NULL,
+    /* SND_STATUS_1XX, SND_STATUS_2XX, SND_STATUS_3456XX */
+    NULL, NULL, NULL,
+    /* KILL_TRANSACTION, TRANSPORT_ERROR */
+    NULL, FSM_METHOD (ist_rcv_transport_error)
+   },
+   /* IST_TERMINATED */
+   {NULL}
+  }
 };
 
-osip_statemachine_t ist_fsm = { ist_transition };
-
 static void
 ist_handle_transport_error (osip_transaction_t * ist, int err)
 {
@@ -101,6 +124,13 @@ ist_handle_transport_error (osip_transaction_t * ist, int err)
   /* TODO: MUST BE DELETED NOW */
 }
 
+/* a message sent by batch could not be sent */
+void
+ist_rcv_transport_error (osip_transaction_t * ist, osip_event_t * evt)
+{
+  ist_handle_transport_error (ist, evt->error);
+}
+
 void
 ist_rcv_invite (osip_transaction_t * ist, osip_event_t * evt)
 {
@@ -119,7 +149,7 @@ ist_rcv_invite (osip_transaction_t * ist, osip_event_t * evt)
 
     __osip_message_callback (OSIP_IST_INVITE_RECEIVED_AGAIN, ist, ist->orig_request);
     if (ist->last_response != NULL) {   /* retransmit last response */
-      i = __osip_transaction_snd_xxx (ist, ist->last_response);
+      i = __osip_transaction_resnd_xxx (ist, ist->last_response);
       if (i != 0) {
         ist_handle_transport_error (ist, i);
         return;
@@ -150,8 +180,9 @@ osip_ist_timeout_g_event (osip_transaction_t * ist, osip_event_t * evt)
     ist->ist_context->timer_g_length = 4000;
   osip_gettimeofday (&ist->ist_context->timer_g_start, NULL);
   add_gettimeofday (&ist->ist_context->timer_g_start, ist->ist_context->timer_g_length);
+  __osip_transaction_update_timers (ist);
 
-  i = __osip_transaction_snd_xxx (ist, ist->last_response);
+  i = __osip_transaction_resnd_xxx (ist, ist->last_response);
   if (i != 0) {
     ist_handle_transport_error (ist, i);
     return;
@@ -263,18 +294,25 @@ ist_snd_3456xx (osip_transaction_t * ist, osip_event_t * evt)
 void
 ist_rcv_ack (osip_transaction_t * ist, osip_event_t * evt)
 {
-  if (ist->ack != NULL) {
-    osip_message_free (ist->ack);
-  }
+  if (ist->tombstone == NULL) {
+    if (ist->ack != NULL) {
+      osip_message_free (ist->ack);
+    }
 
-  ist->ack = evt->sip;
+    ist->ack = evt->sip;
+  }
 
   if (ist->state == IST_COMPLETED)
-    __osip_message_callback (OSIP_IST_ACK_RECEIVED, ist, ist->ack);
+    __osip_message_callback (OSIP_IST_ACK_RECEIVED, ist, evt->sip);
   else                          /* IST_CONFIRMED */
-    __osip_message_callback (OSIP_IST_ACK_RECEIVED_AGAIN, ist, ist->ack);
+    __osip_message_callback (OSIP_IST_ACK_RECEIVED_AGAIN, ist, evt->sip);
   /* set the timer to 0 for reliable, and T4 for unreliable (already set) */
   osip_gettimeofday (&ist->ist_context->timer_i_start, NULL);
   add_gettimeofday (&ist->ist_context->timer_i_start, ist->ist_context->timer_i_length);
   __osip_transaction_set_state (ist, IST_CONFIRMED);
+
+  if (ist->tombstone != NULL)   /* the ACK is not kept */
+    osip_message_free (evt->sip);
+  else
+    __osip_transaction_compact (ist);
 }
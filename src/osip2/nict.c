@@ -31,7 +31,8 @@ __osip_nict_init (osip_nict_t ** nict, osip_t * osip, osip_message_t * request)
 
   OSIP_TRACE (osip_trace (__FILE__, __LINE__, OSIP_INFO2, NULL, "allocating NICT context\n"));
 
-  *nict = (osip_nict_t *) osip_malloc (sizeof (osip_nict_t));
+  if (*nict == NULL)            /* not recycled by the pool of transactions */
+    *nict = (osip_nict_t *) osip_malloc (sizeof (osip_nict_t));
   if (*nict == NULL)
     return OSIP_NOMEM;
 
@@ -22,82 +22,99 @@
 
 #include "fsm.h"
 
-transition_t nict_transition[12] = {
+/* methods indexed by [state - NICT_PRE_TRYING][event type] */
+const osip_statemachine_t nict_fsm = {
+  NICT_PRE_TRYING,
   {
-   NICT_PRE_TRYING,
-   SND_REQUEST,
-   (void (*)(void *, void *)) &nict_snd_request,
-   &nict_transition[1], NULL}
-  ,
-  {
-   NICT_TRYING,
-   TIMEOUT_F,
-   (void (*)(void *, void *)) &osip_nict_timeout_f_event,
-   &nict_transition[2], NULL}
-  ,
-  {
-   NICT_TRYING,
-   TIMEOUT_E,
-   (void (*)(void *, void *)) &osip_nict_timeout_e_event,
-   &nict_transition[3], NULL}
-  ,
-  {
-   NICT_TRYING,
-   RCV_STATUS_1XX,
-   (void (*)(void *, void *)) &nict_rcv_1xx,
-   &nict_transition[4], NULL}
-  ,
-  {
-   NICT_TRYING,
-   RCV_STATUS_2XX,
-   (void (*)(void *, void *)) &nict_rcv_23456xx,
-   &nict_transition[5], NULL}
-  ,
-  {
-   NICT_TRYING,
-   RCV_STATUS_3456XX,
-   (void (*)(void *, void *)) &nict_rcv_23456xx,
-   &nict_transition[6], NULL}
-  ,
-  {
-   NICT_PROCEEDING,
-   TIMEOUT_F,
-   (void (*)(void *, void *)) &osip_nict_timeout_f_event,
-   &nict_transition[7], NULL}
-  ,
-  {
-   NICT_PROCEEDING,
-   TIMEOUT_E,
-   (void (*)(void *, void *)) &osip_nict_timeout_e_event,
-   &nict_transition[8], NULL}
-  ,
-  {
-   NICT_PROCEEDING,
-   RCV_STATUS_1XX,
-   (void (*)(void *, void *)) &nict_rcv_1xx,
-   &nict_transition[9], NULL}
-  ,
-  {
-   NICT_PROCEEDING,
-   RCV_STATUS_2XX,
-   (void (*)(void *, void *)) &nict_rcv_23456xx,
-   &nict_transition[10], NULL}
-  ,
-  {
-   NICT_PROCEEDING,
-   RCV_STATUS_3456XX,
-   (void (*)(void *, void *)) &nict_rcv_23456xx,
-   &nict_transition[11], NULL}
-  ,
-  {
-   NICT_COMPLETED,
-   TIMEOUT_K,
-   (void (*)(void *, void *)) &osip_nict_timeout_k_event,
-   NULL, NULL}
+   /* NICT_PRE_TRYING */
+   {
+    /* TIMEOUT_A, TIMEOUT_B, TIMEOUT_D */
+    NULL, NULL, NULL,
+    /* TIMEOUT_E, TIMEOUT_F, TIMEOUT_K */
+    NULL, NULL, NULL,
+    /* TIMEOUT_G, TIMEOUT_H, TIMEOUT_I */
+    NULL, NULL, NULL,
+    /* TIMEOUT_J */
+    NULL,
+    /* RCV_REQINVITE, RCV_REQACK, RCV_REQUEST */
+    NULL, NULL, NULL,
+    /* RCV_STATUS_1XX, RCV_STATUS_2XX, RCV_STATUS_3456XX */
+    NULL, NULL, NULL,
+    /* SND_REQINVITE, SND_REQACK, SND_REQUEST */
+    NULL, NULL, FSM_METHOD (nict_snd_request),
+    /* SND_STATUS_1XX, SND_STATUS_2XX, SND_STATUS_3456XX */
+    NULL, NULL, NULL,
+    /* KILL_TRANSACTION, TRANSPORT_ERROR */
+    NULL, FSM_METHOD (nict_rcv_transport_error)
+   },
+   /* NICT_TRYING */
+   {
+    /* TIMEOUT_A, TIMEOUT_B, TIMEOUT_D */
+    NULL, NULL, NULL,
+    /* TIMEOUT_E, TIMEOUT_F, TIMEOUT_K */
+    FSM_METHOD (osip_nict_timeout_e_event), FSM_METHOD (osip_nict_timeout_f_event), NULL,
+    /* TIMEOUT_G, TIMEOUT_H, TIMEOUT_I */
+    NULL, NULL, NULL,
+    /* TIMEOUT_J */
+    NULL,
+    /* RCV_REQINVITE, RCV_REQACK, RCV_REQUEST */
+    NULL, NULL, NULL,
+    /* RCV_STATUS_1XX, RCV_STATUS_2XX, RCV_STATUS_3456XX */
+    FSM_METHOD (nict_rcv_1xx), FSM_METHOD (nict_rcv_23456xx), FSM_METHOD (nict_rcv_23456xx),
+    /* SND_REQINVITE, SND_REQACK, SND_REQUEST */
+    NULL, NULL, NULL,
+    /* SND_STATUS_1XX, SND_STATUS_2XX, SND_STATUS_3456XX */
+    NULL, NULL, NULL,
+    /* KILL_TRANSACTION, TRANSPORT_ERROR */
+    NULL, FSM_METHOD (nict_rcv_transport_error)
+   },
+   /* NICT_PROCEEDING */
+   {
+    /* TIMEOUT_A, TIMEOUT_B, TIMEOUT_D */
+    NULL, NULL, NULL,
+    /* TIMEOUT_E, TIMEOUT_F, TIMEOUT_K */
+    FSM_METHOD (osip_nict_timeout_e_event), FSM_METHOD (osip_nict_timeout_f_event), NULL,
+    /* TIMEOUT_G, TIMEOUT_H, TIMEOUT_I */
+    NULL, NULL, NULL,
+    /* TIMEOUT_J */
+    NULL,
+    /* RCV_REQINVITE, RCV_REQACK, RCV_REQUEST */
+    NULL, NULL, NULL,
+    /* RCV_STATUS_1XX, RCV_STATUS_2XX, RCV_STATUS_3456XX */
+    FSM_METHOD (nict_rcv_1xx), FSM_METHOD (nict_rcv_23456xx), FSM_METHOD (nict_rcv_23456xx),
+    /* SND_REQINVITE, SND_REQACK, SND_REQUEST */
+    NULL, NULL, NULL,
+    /* SND_STATUS_1XX, SND_STATUS_2XX, SND_STATUS_3456XX */
+    NULL, NULL, NULL,
+    /* KILL_TRANSACTION, TRANSPORT_ERROR */
+    NULL, FSM_METHOD (nict_rcv_transport_error)
+   },
+   /* NICT_COMPLETED */
+   {
+    /* TIMEOUT_A, TIMEOUT_B, TIMEOUT_D */
+    NULL, NULL, NULL,
+    /* TIMEOUT_E, TIMEOUT_F, TIMEOUT_K */
+    NULL, NULL, FSM_METHOD (osip_nict_timeout_k_event),
+    /* TIMEOUT_G, TIMEOUT_H, TIMEOUT_I */
+    NULL, NULL, NULL,
+    /* TIMEOUT_J */
+    NULL,
+    /* RCV_REQINVITE, RCV_REQACK, RCV_REQUEST */
+    NULL, NULL, NULL,
+    /* RCV_STATUS_1XX, RCV_STATUS_2XX, RCV_STATUS_3456XX */
+    NULL, NULL, NULL,
+    /* SND_REQINVITE, SND_REQACK, SND_REQUEST */
+    NULL, NULL, NULL,
+    /* SND_STATUS_1XX, SND_STATUS_2XX, SND_STATUS_3456XX */
+    NULL, NULL, NULL,
+    /* KILL_TRANSACTION, TRANSPORT_ERROR */
+    NULL, FSM_METHOD (nict_rcv_transport_error)
+   },
+   /* NICT_TERMINATED */
+   {NULL}
+  }
 };
 
-osip_statemachine_t nict_fsm = { nict_transition };
-
 static void
 nict_handle_transport_error (osip_transaction_t * nict, int err)
 {
@@ -107,6 +124,13 @@ nict_handle_transport_error (osip_transaction_t * nict, int err)
   /* TODO: MUST BE DELETED NOW */
 }
 
+/* a message sent by batch could not be sent */
+void
+nict_rcv_transport_error (osip_transaction_t * nict, osip_event_t * evt)
+{
+  nict_handle_transport_error (nict, evt->error);
+}
+
 void
 nict_snd_request (osip_transaction_t * nict, osip_event_t * evt)
 {
@@ -116,7 +140,7 @@ nict_snd_request (osip_transaction_t * nict, osip_event_t * evt)
   /* Here we have ict->orig_request == NULL */
   nict->orig_request = evt->sip;
 
-  i = osip->cb_send_message (nict, evt->sip, nict->nict_context->destination, nict->nict_context->port, nict->out_socket);
+  i = __osip_transaction_send (osip, nict, evt->sip, nict->nict_context->destination, nict->nict_context->port, nict->out_socket);
 
   if (i >= 0) {
     /* invoke the right callback! */
@@ -191,9 +215,10 @@ osip_nict_timeout_e_event (osip_transaction_t * nict, osip_event_t * evt)
 
   osip_gettimeofday (&nict->nict_context->timer_e_start, NULL);
   add_gettimeofday (&nict->nict_context->timer_e_start, nict->nict_context->timer_e_length);
+  __osip_transaction_update_timers (nict);
 
   /* retransmit REQUEST */
-  i = osip->cb_send_message (nict, nict->orig_request, nict->nict_context->destination, nict->nict_context->port, nict->out_socket);
+  i = __osip_transaction_resend (osip, nict, nict->orig_request, nict->nict_context->destination, nict->nict_context->port, nict->out_socket);
   if (i < 0) {
     nict_handle_transport_error (nict, i);
     return;
@@ -222,6 +247,7 @@ osip_nict_timeout_e_event (osip_transaction_t * nict, osip_event_t * evt)
     else {                      /* reliable protocol is used: */
       nict->nict_context->timer_e_length = -1;  /* E is not ACTIVE */
       nict->nict_context->timer_e_start.tv_sec = -1;
+      __osip_transaction_update_timers (nict);
     }
   }
 #endif
@@ -30,7 +30,8 @@ __osip_nist_init (osip_nist_t ** nist, osip_t * osip, osip_message_t * invite)
 
   OSIP_TRACE (osip_trace (__FILE__, __LINE__, OSIP_INFO2, NULL, "allocating NIST context\n"));
 
-  *nist = (osip_nist_t *) osip_malloc (sizeof (osip_nist_t));
+  if (*nist == NULL)            /* not recycled by the pool of transactions */
+    *nist = (osip_nist_t *) osip_malloc (sizeof (osip_nist_t));
   if (*nist == NULL)
     return OSIP_NOMEM;
   memset (*nist, 0, sizeof (osip_nist_t));
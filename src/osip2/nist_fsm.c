@@ -22,70 +22,99 @@
 
 #include "fsm.h"
 
-transition_t nist_transition[10] = {
+/* methods indexed by [state - NIST_PRE_TRYING][event type] */
+const osip_statemachine_t nist_fsm = {
+  NIST_PRE_TRYING,
   {
-   NIST_PRE_TRYING,
-   RCV_REQUEST,
-   (void (*)(void *, void *)) &nist_rcv_request,
-   &nist_transition[1], NULL}
-  ,
-  {
-   NIST_TRYING,
-   SND_STATUS_1XX,
-   (void (*)(void *, void *)) &nist_snd_1xx,
-   &nist_transition[2], NULL}
-  ,
-  {
-   NIST_TRYING,
-   SND_STATUS_2XX,
-   (void (*)(void *, void *)) &nist_snd_23456xx,
-   &nist_transition[3], NULL}
-  ,
-  {
-   NIST_TRYING,
-   SND_STATUS_3456XX,
-   (void (*)(void *, void *)) &nist_snd_23456xx,
-   &nist_transition[4], NULL}
-  ,
-  {
-   NIST_PROCEEDING,
-   SND_STATUS_1XX,
-   (void (*)(void *, void *)) &nist_snd_1xx,
-   &nist_transition[5], NULL}
-  ,
-  {
-   NIST_PROCEEDING,
-   SND_STATUS_2XX,
-   (void (*)(void *, void *)) &nist_snd_23456xx,
-   &nist_transition[6], NULL}
-  ,
-  {
-   NIST_PROCEEDING,
-   SND_STATUS_3456XX,
-   (void (*)(void *, void *)) &nist_snd_23456xx,
-   &nist_transition[7], NULL}
-  ,
-  {
-   NIST_PROCEEDING,
-   RCV_REQUEST,
-   (void (*)(void *, void *)) &nist_rcv_request,
-   &nist_transition[8], NULL}
-  ,
-  {
-   NIST_COMPLETED,
-   TIMEOUT_J,
-   (void (*)(void *, void *)) &osip_nist_timeout_j_event,
-   &nist_transition[9], NULL}
-  ,
-  {
-   NIST_COMPLETED,
-   RCV_REQUEST,
-   (void (*)(void *, void *)) &nist_rcv_request,
-   NULL, NULL}
+   /* NIST_PRE_TRYING */
+   {
+    /* TIMEOUT_A, TIMEOUT_B, TIMEOUT_D */
+    NULL, NULL, NULL,
+    /* TIMEOUT_E, TIMEOUT_F, TIMEOUT_K */
+    NULL, NULL, NULL,
+    /* TIMEOUT_G, TIMEOUT_H, TIMEOUT_I */
+    NULL, NULL, NULL,
+    /* TIMEOUT_J */
+    NULL,
+    /* RCV_REQINVITE, RCV_REQACK, RCV_REQUEST */
+    NULL, NULL, FSM_METHOD (nist_rcv_request),
+    /* RCV_STATUS_1XX, RCV_STATUS_2XX, RCV_STATUS_3456XX */
+    NULL, NULL, NULL,
+    /* SND_REQINVITE, SND_REQACK, SND_REQUEST */
+    NULL, NULL, NULL,
+    /* SND_STATUS_1XX, SND_STATUS_2XX, SND_STATUS_3456XX */
+    NULL, NULL, NULL,
+    /* KILL_TRANSACTION, TRANSPORT_ERROR */
+    NULL, FSM_METHOD (nist_rcv_transport_error)
+   },
+   /* NIST_TRYING */
+   {
+    /* TIMEOUT_A, TIMEOUT_B, TIMEOUT_D */
+    NULL, NULL, NULL,
+    /* TIMEOUT_E, TIMEOUT_F, TIMEOUT_K */
+    NULL, NULL, NULL,
+    /* TIMEOUT_G, TIMEOUT_H, TIMEOUT_I */
+    NULL, NULL, NULL,
+    /* TIMEOUT_J */
+    NULL,
+    /* RCV_REQINVITE, RCV_REQACK, RCV_REQUEST */
+    NULL, NULL, NULL,
+    /* RCV_STATUS_1XX, RCV_STATUS_2XX, RCV_STATUS_3456XX */
+    NULL, NULL, NULL,
+    /* SND_REQINVITE, SND_REQACK, SND_REQUEST */
+    NULL, NULL, NULL,
+    /* SND_STATUS_1XX, SND_STATUS_2XX, SND_STATUS_3456XX */
+    FSM_METHOD (nist_snd_1xx), FSM_METHOD (nist_snd_23456xx), FSM_METHOD (nist_snd_23456xx),
+    /* KILL_TRANSACTION, TRANSPORT_ERROR */
+    NULL, FSM_METHOD (nist_rcv_transport_error)
+   },
+   /* NIST_PROCEEDING */
+   {
+    /* TIMEOUT_A, TIMEOUT_B, TIMEOUT_D */
+    NULL, NULL, NULL,
+    /* TIMEOUT_E, TIMEOUT_F, TIMEOUT_K */
+    NULL, NULL, NULL,
+    /* TIMEOUT_G, TIMEOUT_H, TIMEOUT_I */
+    NULL, NULL, NULL,
+    /* TIMEOUT_J */
+    NULL,
+    /* RCV_REQINVITE, RCV_REQACK, RCV_REQUEST */
+    NULL, NULL, FSM_METHOD (nist_rcv_request),
+    /* RCV_STATUS_1XX, RCV_STATUS_2XX, RCV_STATUS_3456XX */
+    NULL, NULL, NULL,
+    /* SND_REQINVITE, SND_REQACK, SND_REQUEST */
+    NULL, NULL, NULL,
+    /* SND_STATUS_1XX, SND_STATUS_2XX, SND_STATUS_3456XX */
+    FSM_METHOD (nist_snd_1xx), FSM_METHOD (nist_snd_23456xx), FSM_METHOD (nist_snd_23456xx),
+    /* KILL_TRANSACTION, TRANSPORT_ERROR */
+    NULL, FSM_METHOD (nist_rcv_transport_error)
+   },
+   /* NIST_COMPLETED */
+   {
+    /* TIMEOUT_A, TIMEOUT_B, TIMEOUT_D */
+    NULL, NULL, NULL,
+    /* TIMEOUT_E, TIMEOUT_F, TIMEOUT_K */
+    NULL, NULL, NULL,
+    /* TIMEOUT_G, TIMEOUT_H, TIMEOUT_I */
+    NULL, NULL, NULL,
+    /* TIMEOUT_J */
+    FSM_METHOD (osip_nist_timeout_j_event),
+    /* RCV_REQINVITE, RCV_REQACK, RCV_REQUEST */
+    NULL, NULL, FSM_METHOD (nist_rcv_request),
+    /* RCV_STATUS_1XX, RCV_STATUS_2XX, RCV_STATUS_3456XX */
+    NULL, NULL, NULL,
+    /* SND_REQINVITE, SND_REQACK, SND_REQUEST */
+    NULL, NULL, NULL,
+    /* SND_STATUS_1XX, SND_STATUS_2XX, SND_STATUS_3456XX */
+    NULL, NULL, NULL,
+    /* KILL_TRANSACTION, TRANSPORT_ERROR */
+    NULL, FSM_METHOD (nist_rcv_transport_error)
+   },
+   /* NIST_TERMINATED */
+   {NULL}
+  }
 };
 
-osip_statemachine_t nist_fsm = { nist_transition };
-
 static void
 nist_handle_transport_error (osip_transaction_t * nist, int err)
 {
@@ -95,6 +124,13 @@ nist_handle_transport_error (osip_transaction_t * nist, int err)
   /* TODO: MUST BE DELETED NOW */
 }
 
+/* a message sent by batch could not be sent */
+void
+nist_rcv_transport_error (osip_transaction_t * nist, osip_event_t * evt)
+{
+  nist_handle_transport_error (nist, evt->error);
+}
+
 void
 nist_rcv_request (osip_transaction_t * nist, osip_event_t * evt)
 {
@@ -121,6 +157,21 @@ nist_rcv_request (osip_transaction_t * nist, osip_event_t * evt)
     else
       __osip_message_callback (OSIP_NIST_UNKNOWN_REQUEST_RECEIVED, nist, nist->orig_request);
   }
+  else if (nist->tombstone != NULL) {   /* NIST_COMPLETED without its messages */
+    __osip_message_callback (OSIP_NIST_REQUEST_RECEIVED_AGAIN, nist, evt->sip);
+    osip_message_free (evt->sip);
+
+    i = __osip_transaction_resnd_tombstone (nist);
+    if (i != 0) {
+      nist_handle_transport_error (nist, i);
+      return;
+    }
+    if (nist->tombstone->status_code < 300)
+      __osip_message_callback (OSIP_NIST_STATUS_2XX_SENT_AGAIN, nist, NULL);
+    else
+      __osip_message_callback (OSIP_NIST_STATUS_3456XX_SENT_AGAIN, nist, NULL);
+    return;
+  }
   else {                        /* NIST_PROCEEDING or NIST_COMPLETED */
 
     /* delete retransmission */
@@ -128,7 +179,7 @@ nist_rcv_request (osip_transaction_t * nist, osip_event_t * evt)
 
     __osip_message_callback (OSIP_NIST_REQUEST_RECEIVED_AGAIN, nist, nist->orig_request);
     if (nist->last_response != NULL) {  /* retransmit last response */
-      i = __osip_transaction_snd_xxx (nist, nist->last_response);
+      i = __osip_transaction_resnd_xxx (nist, nist->last_response);
       if (i != 0) {
         nist_handle_transport_error (nist, i);
         return;
@@ -206,6 +257,7 @@ nist_snd_23456xx (osip_transaction_t * nist, osip_event_t * evt)
   }
 
   __osip_transaction_set_state (nist, NIST_COMPLETED);
+  __osip_transaction_compact (nist);
 }
 
 
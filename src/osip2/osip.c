@@ -25,6 +25,13 @@
 
 #include <osip2/osip_dialog.h>
 
+#if defined(HAVE_SYS_EVENTFD_H) && defined(HAVE_SYS_TIMERFD_H)
+#define OSIP_WAKEUP
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#endif
+
 void
 osip_response_get_destination (osip_message_t * response, char **address, int *portnum)
 {
@@ -115,32 +122,343 @@ osip_id_mutex_unlock (osip_t * osip)
 #endif
 }
 
-/* these are for transactions that would need retransmission not handled by state machines */
+#ifdef OSIP_WAKEUP
+
+/*
+  Notification of an external event loop: the eventfd is written once
+  when a transaction gets pending events, until osip_wakeup_clear() is
+  called. The timerfd is armed on the earliest deadline known: adding
+  a timer can only make it earlier, and the deadline is computed again
+  after the timers are executed.
+
+  The lock of the list of a type of transaction may be held when the
+  lock of the notifier is taken, never the reverse.
+*/
+
+struct osip_wakeup {
+#ifndef OSIP_MONOTHREAD
+  struct osip_mutex *mutex;
+#endif
+  int event_fd;
+  int timer_fd;
+  int signalled;                /* the eventfd is readable */
+  struct timeval deadline;      /* of the timerfd, tv_sec == -1 if disarmed */
+};
+
+static struct osip_wakeup *
+__osip_wakeup_get (osip_t * osip)
+{
+  struct osip_wakeup *wakeup;
+
+  osip_id_mutex_lock (osip);
+  wakeup = osip->wakeup;
+  if (wakeup == NULL) {
+    wakeup = (struct osip_wakeup *) osip_malloc (sizeof (struct osip_wakeup));
+    if (wakeup != NULL) {
+      wakeup->event_fd = eventfd (0, EFD_NONBLOCK | EFD_CLOEXEC);
+      wakeup->timer_fd = timerfd_create (CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+      wakeup->signalled = 0;
+      wakeup->deadline.tv_sec = -1;
+      wakeup->deadline.tv_usec = 0;
+#ifndef OSIP_MONOTHREAD
+      wakeup->mutex = osip_mutex_init ();
+#endif
+      osip->wakeup = wakeup;
+    }
+  }
+  osip_id_mutex_unlock (osip);
+  return wakeup;
+}
+
 static void
-osip_add_ixt (osip_t * osip, ixt_t * ixt)
+__osip_wakeup_free (struct osip_wakeup *wakeup)
 {
-  /* add in list osip_t->ixt */
-  osip_ixt_lock (osip);
-  osip_list_add (&osip->ixt_retransmissions, (void *) ixt, 0);
-  osip_ixt_unlock (osip);
+  if (wakeup == NULL)
+    return;
+  if (wakeup->event_fd >= 0)
+    close (wakeup->event_fd);
+  if (wakeup->timer_fd >= 0)
+    close (wakeup->timer_fd);
+#ifndef OSIP_MONOTHREAD
+  osip_mutex_destroy (wakeup->mutex);
+#endif
+  osip_free (wakeup);
 }
 
+static void __osip_wakeup_rearm (osip_t * osip);
+
+/* events were added to a transaction */
 static void
-osip_remove_ixt (osip_t * osip, ixt_t * ixt)
+__osip_wakeup_signal (osip_t * osip)
 {
-  int i;
-  ixt_t *tmp;
+  struct osip_wakeup *wakeup = osip->wakeup;
 
-  /* add in list osip_t->ixt */
-  osip_ixt_lock (osip);
-  for (i = 0; !osip_list_eol (&osip->ixt_retransmissions, i); i++) {
-    tmp = (ixt_t *) osip_list_get (&osip->ixt_retransmissions, i);
-    if (tmp == ixt) {
-      osip_list_remove (&osip->ixt_retransmissions, i);
+  if (wakeup == NULL || wakeup->event_fd < 0)
+    return;
+#ifndef OSIP_MONOTHREAD
+  osip_mutex_lock (wakeup->mutex);
+#endif
+  if (wakeup->signalled == 0) {
+    uint64_t one = 1;
+
+    if (write (wakeup->event_fd, &one, sizeof (one)) == sizeof (one))
+      wakeup->signalled = 1;
+  }
+#ifndef OSIP_MONOTHREAD
+  osip_mutex_unlock (wakeup->mutex);
+#endif
+}
+
+/* the lock of the notifier must be held */
+static void
+__osip_wakeup_arm (struct osip_wakeup *wakeup, const struct timeval *now, const struct timeval *deadline)
+{
+  struct itimerspec its;
+  long sec = deadline->tv_sec - now->tv_sec;
+  long usec = deadline->tv_usec - now->tv_usec;
+
+  if (usec < 0) {
+    usec += 1000000;
+    sec--;
+  }
+  if (sec < 0) {
+    sec = 0;
+    usec = 0;
+  }
+  memset (&its, 0, sizeof (its));
+  its.it_value.tv_sec = sec;
+  its.it_value.tv_nsec = usec * 1000;
+  if (sec == 0 && usec == 0)
+    its.it_value.tv_nsec = 1;   /* expired: 0 would disarm the timer */
+  if (timerfd_settime (wakeup->timer_fd, 0, &its, NULL) == 0) {
+    wakeup->deadline.tv_sec = deadline->tv_sec;
+    wakeup->deadline.tv_usec = deadline->tv_usec;
+  }
+}
+
+/* a timer was added: its deadline may be the earliest one */
+static void
+__osip_wakeup_timer (osip_t * osip, const struct timeval *deadline)
+{
+  struct osip_wakeup *wakeup = osip->wakeup;
+  struct timeval now;
+
+  if (wakeup == NULL || wakeup->timer_fd < 0)
+    return;
+#ifndef OSIP_MONOTHREAD
+  osip_mutex_lock (wakeup->mutex);
+#endif
+  if (wakeup->deadline.tv_sec == -1 || osip_timercmp (deadline, &wakeup->deadline, <)) {
+    osip_gettimeofday (&now, NULL);
+    __osip_wakeup_arm (wakeup, &now, deadline);
+  }
+#ifndef OSIP_MONOTHREAD
+  osip_mutex_unlock (wakeup->mutex);
+#endif
+}
+
+#else
+
+#define __osip_wakeup_signal(osip) ((void) (osip))
+#define __osip_wakeup_timer(osip, deadline)
+#define __osip_wakeup_rearm(osip)
+
+#endif
+
+/*
+  Retransmissions of 2xx and ACK not handled by the state machines (ixt).
+
+  The ixt are chained in two hash tables: by the identity of their
+  dialog, the Call-ID and the remote tag compared by
+  osip_dialog_match_as_uas() (an ACK finds its 2xx without visiting the
+  other ones), and by the address of the dialog. Their retransmissions
+  are scheduled in a timer wheel. All of them are protected by the
+  ixt lock.
+*/
+
+#define IXT_MIN_SIZE 64
+
+struct osip_ixt_table {
+  unsigned int size;            /* power of 2 */
+  unsigned int count;
+  ixt_t **by_key;               /* ixt with a dialog, by hash of its identity */
+  ixt_t **by_dialog;            /* all ixt, by address of their dialog */
+  struct osip_timer_wheel *timers;
+};
+
+static unsigned int __osip_index_hash (unsigned int hash, const char *str);
+
+#define __osip_ixt_dialog_hash(dialog) ((unsigned int) (((unsigned long) (dialog)) >> 4) * 2654435761u)
+
+/* hash of the Call-ID as returned by osip_call_id_to_str and of the remote tag */
+static unsigned int
+__osip_ixt_key (const char *number, const char *host, const char *tag)
+{
+  unsigned int h;
+
+  h = __osip_index_hash (2166136261u, number);
+  if (host != NULL) {
+    h = __osip_index_hash (h, "@");
+    h = __osip_index_hash (h, host);
+  }
+  if (tag != NULL)
+    h = __osip_index_hash (h ^ 0xff, tag);
+  return h;
+}
+
+static void
+__osip_ixt_table_free (struct osip_ixt_table *table)
+{
+  if (table == NULL)
+    return;
+  osip_free (table->by_key);
+  osip_free (table->by_dialog);
+  __osip_timer_wheel_free (table->timers);
+  osip_free (table);
+}
+
+static int
+__osip_ixt_table_init (struct osip_ixt_table **table)
+{
+  *table = (struct osip_ixt_table *) osip_malloc (sizeof (struct osip_ixt_table));
+  if (*table == NULL)
+    return OSIP_NOMEM;
+  memset (*table, 0, sizeof (struct osip_ixt_table));
+  (*table)->size = IXT_MIN_SIZE;
+  (*table)->by_key = (ixt_t **) osip_malloc (IXT_MIN_SIZE * sizeof (ixt_t *));
+  (*table)->by_dialog = (ixt_t **) osip_malloc (IXT_MIN_SIZE * sizeof (ixt_t *));
+  if ((*table)->by_key == NULL || (*table)->by_dialog == NULL || __osip_timer_wheel_init (&(*table)->timers) != OSIP_SUCCESS) {
+    __osip_ixt_table_free (*table);
+    *table = NULL;
+    return OSIP_NOMEM;
+  }
+  memset ((*table)->by_key, 0, IXT_MIN_SIZE * sizeof (ixt_t *));
+  memset ((*table)->by_dialog, 0, IXT_MIN_SIZE * sizeof (ixt_t *));
+  return OSIP_SUCCESS;
+}
+
+static void
+__osip_ixt_table_link (struct osip_ixt_table *table, ixt_t * ixt)
+{
+  ixt_t **bucket;
+
+  if (ixt->indexed) {
+    bucket = &table->by_key[ixt->hash & (table->size - 1)];
+    ixt->next_by_key = *bucket;
+    *bucket = ixt;
+  }
+  bucket = &table->by_dialog[__osip_ixt_dialog_hash (ixt->dialog) & (table->size - 1)];
+  ixt->next_by_dialog = *bucket;
+  *bucket = ixt;
+}
+
+static void
+__osip_ixt_table_resize (struct osip_ixt_table *table, unsigned int size)
+{
+  ixt_t **by_key;
+  ixt_t **by_dialog;
+  ixt_t *list = NULL;
+  unsigned int i;
+
+  by_key = (ixt_t **) osip_malloc (size * sizeof (ixt_t *));
+  by_dialog = (ixt_t **) osip_malloc (size * sizeof (ixt_t *));
+  if (by_key == NULL || by_dialog == NULL) {
+    osip_free (by_key);
+    osip_free (by_dialog);
+    return;                     /* keep the longer chains */
+  }
+  memset (by_key, 0, size * sizeof (ixt_t *));
+  memset (by_dialog, 0, size * sizeof (ixt_t *));
+  /* every ixt is in by_dialog */
+  for (i = 0; i < table->size; i++) {
+    while (table->by_dialog[i] != NULL) {
+      ixt_t *ixt = table->by_dialog[i];
+
+      table->by_dialog[i] = ixt->next_by_dialog;
+      ixt->next_by_dialog = list;
+      list = ixt;
+    }
+  }
+  osip_free (table->by_key);
+  osip_free (table->by_dialog);
+  table->by_key = by_key;
+  table->by_dialog = by_dialog;
+  table->size = size;
+  while (list != NULL) {
+    ixt_t *ixt = list;
+
+    list = ixt->next_by_dialog;
+    __osip_ixt_table_link (table, ixt);
+  }
+}
+
+/* the ixt lock must be held */
+static void
+__osip_ixt_table_add (struct osip_ixt_table *table, ixt_t * ixt)
+{
+  osip_dialog_t *dialog = ixt->dialog;
+
+  ixt->indexed = 0;
+  if (dialog != NULL && dialog->call_id != NULL) {
+    ixt->hash = __osip_index_hash (2166136261u, dialog->call_id);
+    if (dialog->remote_tag != NULL)
+      ixt->hash = __osip_index_hash (ixt->hash ^ 0xff, dialog->remote_tag);
+    ixt->indexed = 1;
+  }
+  if (table->count + 1 > table->size)
+    __osip_ixt_table_resize (table, table->size * 2);
+  __osip_ixt_table_link (table, ixt);
+  table->count++;
+
+  ixt->timer.wheel = table->timers;
+  ixt->timer.data = ixt;
+  __osip_timer_wheel_add (&ixt->timer, &ixt->start);
+}
+
+/* the ixt lock must be held */
+static void
+__osip_ixt_table_remove (struct osip_ixt_table *table, ixt_t * ixt)
+{
+  ixt_t **pixt;
+
+  if (ixt->indexed) {
+    for (pixt = &table->by_key[ixt->hash & (table->size - 1)]; *pixt != NULL; pixt = &(*pixt)->next_by_key) {
+      if (*pixt == ixt) {
+        *pixt = ixt->next_by_key;
+        break;
+      }
+    }
+  }
+  for (pixt = &table->by_dialog[__osip_ixt_dialog_hash (ixt->dialog) & (table->size - 1)]; *pixt != NULL; pixt = &(*pixt)->next_by_dialog) {
+    if (*pixt == ixt) {
+      *pixt = ixt->next_by_dialog;
+      table->count--;
       break;
     }
   }
+  __osip_timer_wheel_del (&ixt->timer);
+}
+
+/* the ixt lock must be held */
+static ixt_t *
+__osip_ixt_table_find (struct osip_ixt_table *table, unsigned int hash, osip_message_t * ack)
+{
+  ixt_t *ixt;
+
+  for (ixt = table->by_key[hash & (table->size - 1)]; ixt != NULL; ixt = ixt->next_by_key) {
+    if (ixt->hash == hash && osip_dialog_match_as_uas (ixt->dialog, ack) == 0)
+      return ixt;
+  }
+  return NULL;
+}
+
+static void
+osip_add_ixt (osip_t * osip, ixt_t * ixt)
+{
+  osip_ixt_lock (osip);
+  __osip_ixt_table_add (osip->ixt_table, ixt);
   osip_ixt_unlock (osip);
+  __osip_wakeup_timer (osip, &ixt->start);
 }
 
 static int
@@ -151,6 +469,7 @@ ixt_init (ixt_t ** ixt)
   *ixt = pixt = (ixt_t *) osip_malloc (sizeof (ixt_t));
   if (pixt == NULL)
     return OSIP_NOMEM;
+  memset (pixt, 0, sizeof (ixt_t));
   pixt->dialog = NULL;
   pixt->msg2xx = NULL;
   pixt->ack = NULL;
@@ -209,18 +528,28 @@ struct osip_dialog *
 osip_stop_200ok_retransmissions (osip_t * osip, osip_message_t * ack)
 {
   osip_dialog_t *dialog = NULL;
-  int i;
+  osip_generic_param_t *tag = NULL;
+  unsigned int hash;
   ixt_t *ixt;
 
+  if (ack == NULL || ack->call_id == NULL || ack->call_id->number == NULL || ack->from == NULL)
+    return NULL;
+  osip_from_get_tag (ack->from, &tag);
+  if (tag != NULL && tag->gvalue == NULL)
+    tag = NULL;
+
   osip_ixt_lock (osip);
-  for (i = 0; !osip_list_eol (&osip->ixt_retransmissions, i); i++) {
-    ixt = (ixt_t *) osip_list_get (&osip->ixt_retransmissions, i);
-    if (osip_dialog_match_as_uas (ixt->dialog, ack) == 0) {
-      osip_list_remove (&osip->ixt_retransmissions, i);
-      dialog = ixt->dialog;
-      ixt_free (ixt);
-      break;
-    }
+  hash = __osip_ixt_key (ack->call_id->number, ack->call_id->host, tag != NULL ? tag->gvalue : NULL);
+  ixt = __osip_ixt_table_find (osip->ixt_table, hash, ack);
+  if (ixt == NULL && tag != NULL) {
+    /* dialog created by a response without tag */
+    hash = __osip_ixt_key (ack->call_id->number, ack->call_id->host, NULL);
+    ixt = __osip_ixt_table_find (osip->ixt_table, hash, ack);
+  }
+  if (ixt != NULL) {
+    __osip_ixt_table_remove (osip->ixt_table, ixt);
+    dialog = ixt->dialog;
+    ixt_free (ixt);
   }
   osip_ixt_unlock (osip);
   return dialog;
@@ -231,58 +560,63 @@ osip_stop_200ok_retransmissions (osip_t * osip, osip_message_t * ack)
 void
 osip_stop_retransmissions_from_dialog (osip_t * osip, osip_dialog_t * dialog)
 {
-  int i;
+  struct osip_ixt_table *table = osip->ixt_table;
   ixt_t *ixt;
 
   osip_ixt_lock (osip);
-  for (i = 0; !osip_list_eol (&osip->ixt_retransmissions, i); i++) {
-    ixt = (ixt_t *) osip_list_get (&osip->ixt_retransmissions, i);
+  ixt = table->by_dialog[__osip_ixt_dialog_hash (dialog) & (table->size - 1)];
+  while (ixt != NULL) {
+    ixt_t *next = ixt->next_by_dialog;
+
     if (ixt->dialog == dialog) {
-      osip_list_remove (&osip->ixt_retransmissions, i);
+      __osip_ixt_table_remove (table, ixt);
       ixt_free (ixt);
-      i--;
     }
+    ixt = next;
   }
   osip_ixt_unlock (osip);
 }
 
 static void
-ixt_retransmit (osip_t * osip, ixt_t * ixt, struct timeval *current)
+ixt_retransmit (osip_t * osip, ixt_t * ixt)
 {
-  if (osip_timercmp (current, &ixt->start, >)) {
-    ixt->interval = ixt->interval * 2;
-    if (ixt->interval > 4000)
-      ixt->interval = 4000;
-    add_gettimeofday (&ixt->start, ixt->interval);
-    if (ixt->ack != NULL)
-      osip->cb_send_message (NULL, ixt->ack, ixt->dest, ixt->port, ixt->sock);
-    else if (ixt->msg2xx != NULL)
-      osip->cb_send_message (NULL, ixt->msg2xx, ixt->dest, ixt->port, ixt->sock);
-    ixt->counter--;
-  }
+  ixt->interval = ixt->interval * 2;
+  if (ixt->interval > 4000)
+    ixt->interval = 4000;
+  add_gettimeofday (&ixt->start, ixt->interval);
+  if (ixt->ack != NULL)
+    __osip_transaction_resend (osip, NULL, ixt->ack, ixt->dest, ixt->port, ixt->sock);
+  else if (ixt->msg2xx != NULL)
+    __osip_transaction_resend (osip, NULL, ixt->msg2xx, ixt->dest, ixt->port, ixt->sock);
+  ixt->counter--;
 }
 
 void
 osip_retransmissions_execute (osip_t * osip)
 {
-  int i;
-  ixt_t *ixt;
+  osip_timer_entry_t expired;
+  osip_timer_entry_t *entry;
   struct timeval current;
 
   osip_gettimeofday (&current, NULL);
 
   osip_ixt_lock (osip);
-  for (i = 0; !osip_list_eol (&osip->ixt_retransmissions, i); i++) {
-    ixt = (ixt_t *) osip_list_get (&osip->ixt_retransmissions, i);
-    ixt_retransmit (osip, ixt, &current);
+  __osip_timer_wheel_expire (osip->ixt_table->timers, &current, &expired);
+  while ((entry = __osip_timer_wheel_pop (&expired)) != NULL) {
+    ixt_t *ixt = (ixt_t *) entry->data;
+
+    ixt_retransmit (osip, ixt);
     if (ixt->counter == 0) {
       /* remove it */
-      osip_list_remove (&osip->ixt_retransmissions, i);
+      __osip_ixt_table_remove (osip->ixt_table, ixt);
       ixt_free (ixt);
-      i--;
     }
+    else
+      __osip_timer_wheel_add (&ixt->timer, &ixt->start);
   }
   osip_ixt_unlock (osip);
+  __osip_wakeup_rearm (osip);
+  osip_send_batch_flush (osip);
 }
 
 int
@@ -365,343 +699,1455 @@ osip_nist_unlock (osip_t * osip)
 #endif
 }
 
-#if defined(HAVE_DICT_DICT_H)
-#define HSIZE           200
-
-unsigned s_hash (const unsigned char *p);
+/*
+  Index of transactions, so that incoming messages are matched without
+  walking the list of transactions: open addressing with linear probing.
+
+  The key is the branch and the method of the top Via of the request
+  that created the transaction and, for server transactions, its sent-by
+  (RFC 3261 17.1.3 and 17.2.3). Candidates with the same hash are then
+  checked with the complete matching rules.
+
+  The index is split in shards selected by the hash of the key, each
+  one with its own lock: threads receiving messages for different
+  transactions don't wait for each other, nor for the lock of the list
+  of transactions. The list is still protected by its own lock and a
+  transaction is added to (removed from) its shard while this lock is
+  held.
+
+  Server transactions created by RFC 2543 elements (no magic cookie in
+  the branch) can't be indexed: they are counted, and the list is still
+  searched while some of them are alive.
+*/
 
-unsigned
-s_hash (const unsigned char *p)
-{
-  unsigned hash = 0;
+#define INDEX_MIN_SIZE 64
 
-  while (*p) {
-    hash *= 31;
-    hash ^= *p++;
-  }
-  return hash;
-}
+#ifndef OSIP_INDEX_SHARDS
+#ifdef OSIP_MONOTHREAD
+#define OSIP_INDEX_SHARDS 1
+#else
+#define OSIP_INDEX_SHARDS 16
+#endif
 #endif
 
-int
-__osip_add_ict (osip_t * osip, osip_transaction_t * ict)
-{
+struct osip_index_slot {
+  unsigned int hash;
+  osip_transaction_t *tr;       /* NULL when the slot is free */
+};
+
+struct osip_index_shard {
 #ifndef OSIP_MONOTHREAD
-  osip_mutex_lock (osip->ict_fastmutex);
+  struct osip_mutex *mutex;
 #endif
-#if defined(HAVE_DICT_DICT_H)
-  {
-    osip_generic_param_t *b_request = NULL;
-    int rv = -99;
+  unsigned int size;            /* power of 2 */
+  unsigned int count;
+  struct osip_index_slot *slots;
+};
 
-    osip_via_param_get_byname (ict->topvia, "branch", &b_request);
-    if (b_request != NULL && b_request->gvalue != NULL)
-      rv = dict_insert (osip->osip_ict_hastable, b_request->gvalue, (void *) ict, FALSE);
+struct osip_transaction_index {
+  int server;                   /* index of ist or nist transactions */
+  int legacy;                   /* transactions not indexed (read and written with the lock of the list held) */
+  struct osip_index_shard shards[OSIP_INDEX_SHARDS];
+};
 
-    if (rv == 0) {
-      OSIP_TRACE (osip_trace (__FILE__, __LINE__, OSIP_INFO1, NULL, "New key inserted in ict hastable `%s'\n", b_request->gvalue));
-    }
-    else if (rv != -99) {
-      OSIP_TRACE (osip_trace (__FILE__, __LINE__, OSIP_WARNING, NULL, "already inserted `%s'\n", b_request->gvalue));
-    }
+static unsigned int
+__osip_index_hash (unsigned int hash, const char *str)
+{
+  /* FNV-1a */
+  while (*str != '\0') {
+    hash ^= (unsigned char) *str++;
+    hash *= 16777619u;
   }
-#endif
-  osip_list_add (&osip->osip_ict_transactions, ict, -1);
-#ifndef OSIP_MONOTHREAD
-  osip_mutex_unlock (osip->ict_fastmutex);
-#endif
+  return hash;
+}
+
+static int
+__osip_index_key (int server, osip_via_t * via, const char *method, unsigned int *hash)
+{
+  osip_generic_param_t *branch = NULL;
+  unsigned int h;
+
+  if (via == NULL || method == NULL)
+    return OSIP_BADPARAMETER;
+  osip_via_param_get_byname (via, "branch", &branch);
+  if (branch == NULL || branch->gvalue == NULL)
+    return OSIP_NOTFOUND;
+  if (server) {
+    if (0 != strncmp (branch->gvalue, "z9hG4bK", 7) || via_get_host (via) == NULL)
+      return OSIP_NOTFOUND;
+    if (0 == strcmp (method, "ACK"))
+      method = "INVITE";        /* ACK for a non 2xx final response */
+  }
+
+  h = __osip_index_hash (2166136261u, branch->gvalue);
+  h = __osip_index_hash (h ^ 0xff, method);
+  if (server) {
+    h = __osip_index_hash (h ^ 0xff, via_get_host (via));
+    h = __osip_index_hash (h ^ 0xff, via_get_port (via) != NULL ? via_get_port (via) : "5060");
+  }
+  *hash = h;
   return OSIP_SUCCESS;
 }
 
-int
-__osip_add_ist (osip_t * osip, osip_transaction_t * ist)
+/* low bits of the hash select the slot: use the high bits */
+#define __osip_index_shard(index, hash) (&(index)->shards[((hash) >> 16) % OSIP_INDEX_SHARDS])
+
+void
+__osip_transaction_index_free (struct osip_transaction_index *index)
 {
-#ifndef OSIP_MONOTHREAD
-  osip_mutex_lock (osip->ist_fastmutex);
-#endif
-#if defined(HAVE_DICT_DICT_H)
-  {
-    osip_generic_param_t *b_request = NULL;
-    int rv = -99;
+  int i;
 
-    osip_via_param_get_byname (ist->topvia, "branch", &b_request);
-    if (b_request != NULL && b_request->gvalue != NULL)
-      rv = dict_insert (osip->osip_ist_hastable, b_request->gvalue, (void *) ist, FALSE);
-    if (rv == 0) {
-      OSIP_TRACE (osip_trace (__FILE__, __LINE__, OSIP_INFO1, NULL, "New key inserted in ist hastable `%s'\n", b_request->gvalue));
-    }
-    else if (rv != -99) {
-      OSIP_TRACE (osip_trace (__FILE__, __LINE__, OSIP_WARNING, NULL, "already inserted `%s'\n", b_request->gvalue));
-    }
-  }
-#endif
-  osip_list_add (&osip->osip_ist_transactions, ist, -1);
+  if (index == NULL)
+    return;
+  for (i = 0; i < OSIP_INDEX_SHARDS; i++) {
 #ifndef OSIP_MONOTHREAD
-  osip_mutex_unlock (osip->ist_fastmutex);
+    if (index->shards[i].mutex != NULL)
+      osip_mutex_destroy (index->shards[i].mutex);
 #endif
-  return OSIP_SUCCESS;
+    osip_free (index->shards[i].slots);
+  }
+  osip_free (index);
 }
 
 int
-__osip_add_nict (osip_t * osip, osip_transaction_t * nict)
+__osip_transaction_index_init (struct osip_transaction_index **index, int server)
 {
-#ifndef OSIP_MONOTHREAD
-  osip_mutex_lock (osip->nict_fastmutex);
-#endif
-#if defined(HAVE_DICT_DICT_H)
-  {
-    osip_generic_param_t *b_request = NULL;
-    int rv = -99;
+  int i;
 
-    osip_via_param_get_byname (nict->topvia, "branch", &b_request);
-    if (b_request != NULL && b_request->gvalue != NULL)
-      rv = dict_insert (osip->osip_nict_hastable, b_request->gvalue, (void *) nict, FALSE);
+  *index = (struct osip_transaction_index *) osip_malloc (sizeof (struct osip_transaction_index));
+  if (*index == NULL)
+    return OSIP_NOMEM;
+  memset (*index, 0, sizeof (struct osip_transaction_index));
+  (*index)->server = server;
+  for (i = 0; i < OSIP_INDEX_SHARDS; i++) {
+    struct osip_index_shard *shard = &(*index)->shards[i];
 
-    if (rv == 0) {
-      OSIP_TRACE (osip_trace (__FILE__, __LINE__, OSIP_INFO1, NULL, "New key inserted in nict hastable `%s'\n", b_request->gvalue));
-    }
-    else if (rv != -99) {
-      OSIP_TRACE (osip_trace (__FILE__, __LINE__, OSIP_WARNING, NULL, "already inserted `%s'\n", b_request->gvalue));
-    }
-  }
-#endif
-  osip_list_add (&osip->osip_nict_transactions, nict, -1);
 #ifndef OSIP_MONOTHREAD
-  osip_mutex_unlock (osip->nict_fastmutex);
+    shard->mutex = osip_mutex_init ();
+    if (shard->mutex == NULL)
+      break;
 #endif
+    shard->slots = (struct osip_index_slot *) osip_malloc (INDEX_MIN_SIZE * sizeof (struct osip_index_slot));
+    if (shard->slots == NULL)
+      break;
+    memset (shard->slots, 0, INDEX_MIN_SIZE * sizeof (struct osip_index_slot));
+    shard->size = INDEX_MIN_SIZE;
+  }
+  if (i < OSIP_INDEX_SHARDS) {
+    __osip_transaction_index_free (*index);
+    *index = NULL;
+    return OSIP_NOMEM;
+  }
   return OSIP_SUCCESS;
 }
 
-int
-__osip_add_nist (osip_t * osip, osip_transaction_t * nist)
+static int
+__osip_index_resize (struct osip_index_shard *shard, unsigned int size)
 {
-#ifndef OSIP_MONOTHREAD
-  osip_mutex_lock (osip->nist_fastmutex);
-#endif
-#if defined(HAVE_DICT_DICT_H)
-  {
-    osip_generic_param_t *b_request = NULL;
-    int rv = -99;
+  struct osip_index_slot *slots;
+  unsigned int i;
 
-    osip_via_param_get_byname (nist->topvia, "branch", &b_request);
-    if (b_request != NULL && b_request->gvalue != NULL)
-      rv = dict_insert (osip->osip_nist_hastable, b_request->gvalue, (void *) nist, FALSE);
-    if (rv == 0) {
-      OSIP_TRACE (osip_trace (__FILE__, __LINE__, OSIP_INFO1, NULL, "New key inserted in ict hastable `%s'\n", b_request->gvalue));
-    }
-    else if (rv != -99) {
-      OSIP_TRACE (osip_trace (__FILE__, __LINE__, OSIP_WARNING, NULL, "already inserted `%s'\n", b_request->gvalue));
-    }
+  slots = (struct osip_index_slot *) osip_malloc (size * sizeof (struct osip_index_slot));
+  if (slots == NULL)
+    return OSIP_NOMEM;
+  memset (slots, 0, size * sizeof (struct osip_index_slot));
+  for (i = 0; i < shard->size; i++) {
+    unsigned int j;
+
+    if (shard->slots[i].tr == NULL)
+      continue;
+    for (j = shard->slots[i].hash & (size - 1); slots[j].tr != NULL; j = (j + 1) & (size - 1));
+    slots[j] = shard->slots[i];
+  }
+  osip_free (shard->slots);
+  shard->slots = slots;
+  shard->size = size;
+  return OSIP_SUCCESS;
+}
+
+void
+__osip_transaction_index_add (struct osip_transaction_index *index, osip_transaction_t * tr)
+{
+  struct osip_index_shard *shard;
+  unsigned int hash;
+  unsigned int i;
+
+  if (index == NULL)
+    return;
+  if (tr->cseq == NULL || __osip_index_key (index->server, tr->topvia, tr->cseq->method, &hash) != OSIP_SUCCESS) {
+    index->legacy++;
+    return;
   }
+  shard = __osip_index_shard (index, hash);
+#ifndef OSIP_MONOTHREAD
+  osip_mutex_lock (shard->mutex);
 #endif
-  osip_list_add (&osip->osip_nist_transactions, nist, -1);
+  /* keep the load factor under 1/2 */
+  if ((shard->count + 1) * 2 > shard->size && __osip_index_resize (shard, shard->size * 2) != OSIP_SUCCESS && shard->count + 1 >= shard->size) {
+    index->legacy++;
+  }
+  else {
+    for (i = hash & (shard->size - 1); shard->slots[i].tr != NULL; i = (i + 1) & (shard->size - 1));
+    shard->slots[i].hash = hash;
+    shard->slots[i].tr = tr;
+    shard->count++;
+  }
 #ifndef OSIP_MONOTHREAD
-  osip_mutex_unlock (osip->nist_fastmutex);
+  osip_mutex_unlock (shard->mutex);
 #endif
-  return OSIP_SUCCESS;
 }
 
-int
-osip_remove_transaction (osip_t * osip, osip_transaction_t * tr)
+static void
+__osip_index_delete_slot (struct osip_index_shard *shard, unsigned int i)
 {
-  int i = -1;
+  unsigned int mask = shard->size - 1;
+  unsigned int j = i;
 
-  if (tr == NULL)
-    return OSIP_BADPARAMETER;
-  if (tr->ctx_type == ICT)
-    i = __osip_remove_ict_transaction (osip, tr);
-  else if (tr->ctx_type == IST)
-    i = __osip_remove_ist_transaction (osip, tr);
-  else if (tr->ctx_type == NICT)
-    i = __osip_remove_nict_transaction (osip, tr);
-  else if (tr->ctx_type == NIST)
-    i = __osip_remove_nist_transaction (osip, tr);
-  else
-    return OSIP_BADPARAMETER;
-  return i;
+  /* move back the following entries that can't be reached any more */
+  for (;;) {
+    unsigned int k;
+
+    j = (j + 1) & mask;
+    if (shard->slots[j].tr == NULL)
+      break;
+    k = shard->slots[j].hash & mask;
+    if ((i <= j) ? (i < k && k <= j) : (i < k || k <= j))
+      continue;
+    shard->slots[i] = shard->slots[j];
+    i = j;
+  }
+  shard->slots[i].tr = NULL;
+  shard->count--;
 }
 
-int
-__osip_remove_ict_transaction (osip_t * osip, osip_transaction_t * ict)
+static int
+__osip_index_shard_remove (struct osip_index_shard *shard, unsigned int hash, osip_transaction_t * tr)
 {
-  osip_list_iterator_t iterator;
-  osip_transaction_t *tmp;
+  unsigned int i;
+  int found = OSIP_SUCCESS;
 
 #ifndef OSIP_MONOTHREAD
-  osip_mutex_lock (osip->ict_fastmutex);
+  osip_mutex_lock (shard->mutex);
 #endif
-
-#if defined(HAVE_DICT_DICT_H)
-  {
-    osip_generic_param_t *b_request = NULL;
-    int rv;
-
-    osip_via_param_get_byname (ict->topvia, "branch", &b_request);
-    if (b_request != NULL && b_request->gvalue != NULL) {
-      rv = dict_remove (osip->osip_ict_hastable, b_request->gvalue, TRUE);
-      if (rv == 0) {
-        OSIP_TRACE (osip_trace (__FILE__, __LINE__, OSIP_INFO1, NULL, "New key deleted in ict hastable `%s'\n", b_request->gvalue));
-      }
-      else {
-        OSIP_TRACE (osip_trace (__FILE__, __LINE__, OSIP_WARNING, NULL, "key not removed `%s'\n", b_request->gvalue));
-      }
-    }
+  for (i = hash & (shard->size - 1); shard->slots[i].tr != NULL; i = (i + 1) & (shard->size - 1)) {
+    if (shard->slots[i].tr == tr)
+      break;
   }
-#endif
-
-  tmp = (osip_transaction_t *) osip_list_get_first (&osip->osip_ict_transactions, &iterator);
-  while (osip_list_iterator_has_elem (iterator)) {
-    if (tmp->transactionid == ict->transactionid) {
-      osip_list_iterator_remove (&iterator);
-#ifndef OSIP_MONOTHREAD
-      osip_mutex_unlock (osip->ict_fastmutex);
-#endif
-      return OSIP_SUCCESS;
-    }
-    tmp = (osip_transaction_t *) osip_list_get_next (&iterator);
+  if (shard->slots[i].tr == NULL) {
+    for (i = 0; i < shard->size && shard->slots[i].tr != tr; i++);
+    if (i == shard->size)
+      found = OSIP_NOTFOUND;
+  }
+  if (found == OSIP_SUCCESS) {
+    __osip_index_delete_slot (shard, i);
+    if (shard->size > INDEX_MIN_SIZE && shard->count * 8 < shard->size)
+      __osip_index_resize (shard, shard->size / 2);
   }
 #ifndef OSIP_MONOTHREAD
-  osip_mutex_unlock (osip->ict_fastmutex);
+  osip_mutex_unlock (shard->mutex);
 #endif
-  return OSIP_UNDEFINED_ERROR;
+  return found;
 }
 
-int
-__osip_remove_ist_transaction (osip_t * osip, osip_transaction_t * ist)
+void
+__osip_transaction_index_remove (struct osip_transaction_index *index, osip_transaction_t * tr)
+{
+  struct osip_index_shard *shard;
+  unsigned int hash;
+  int i;
+
+  if (index == NULL)
+    return;
+  if (tr->cseq == NULL || __osip_index_key (index->server, tr->topvia, tr->cseq->method, &hash) != OSIP_SUCCESS) {
+    index->legacy--;
+    return;
+  }
+  shard = __osip_index_shard (index, hash);
+  if (__osip_index_shard_remove (shard, hash, tr) == OSIP_SUCCESS)
+    return;
+  /* the Via was modified: search the other shards */
+  for (i = 0; i < OSIP_INDEX_SHARDS; i++) {
+    if (&index->shards[i] != shard && __osip_index_shard_remove (&index->shards[i], hash, tr) == OSIP_SUCCESS)
+      return;
+  }
+  /* the transaction was not indexed */
+  index->legacy--;
+}
+
+/* OSIP_NOTFOUND when the index can't be used for this message. When
+   consume is set, the event is added to the transaction before the lock
+   of the shard is released. When the transaction is not found, only
+   the transactions out of the index (legacy) may still match. */
+static int
+__osip_transaction_index_find (struct osip_transaction_index *index, osip_event_t * evt, int consume, osip_transaction_t ** transaction)
+{
+  struct osip_index_shard *shard;
+  osip_message_t *sip = evt->sip;
+  unsigned int hash;
+  unsigned int i;
+
+  *transaction = NULL;
+  if (index == NULL || sip->cseq == NULL)
+    return OSIP_NOTFOUND;
+  if (__osip_index_key (index->server, osip_list_get (&sip->vias, 0), sip->cseq->method, &hash) != OSIP_SUCCESS)
+    return OSIP_NOTFOUND;
+
+  shard = __osip_index_shard (index, hash);
+#ifndef OSIP_MONOTHREAD
+  osip_mutex_lock (shard->mutex);
+#endif
+  for (i = hash & (shard->size - 1); shard->slots[i].tr != NULL; i = (i + 1) & (shard->size - 1)) {
+    osip_transaction_t *tr = shard->slots[i].tr;
+
+    if (shard->slots[i].hash != hash)
+      continue;
+    if ((index->server && 0 == __osip_transaction_matching_request_osip_to_xist_17_2_3 (tr, sip))
+        || (!index->server && 0 == __osip_transaction_matching_response_osip_to_xict_17_1_3 (tr, sip))) {
+      *transaction = tr;
+      if (consume == 1)
+        osip_transaction_add_event (tr, evt);
+      break;
+    }
+  }
+#ifndef OSIP_MONOTHREAD
+  osip_mutex_unlock (shard->mutex);
+#endif
+  return OSIP_SUCCESS;
+}
+
+/*
+  Table of the transactions by id, in shards like the index above. Ids
+  are consecutive, so that the low bits of an id select its shard and
+  the next bits its slot. A slot matches only the exact id: an id kept
+  after its transaction was removed doesn't resolve to another one,
+  until the counter of ids wraps around.
+
+  A transaction is added to (removed from) the table while the lock of
+  its list is held. When the table can't grow, the transaction is only
+  counted in legacy and found in the lists.
+*/
+
+#define __osip_ids_shard(ids, id) (&(ids)->shards[(unsigned int) (id) % OSIP_INDEX_SHARDS])
+#define __osip_ids_hash(id) ((unsigned int) (id) / OSIP_INDEX_SHARDS)
+
+static void
+__osip_transaction_ids_add (osip_t * osip, osip_transaction_t * tr)
+{
+  struct osip_transaction_index *ids = osip->ids;
+  struct osip_index_shard *shard;
+  unsigned int hash = __osip_ids_hash (tr->transactionid);
+  unsigned int i;
+  int full = 0;
+
+  if (ids == NULL)
+    return;
+  shard = __osip_ids_shard (ids, tr->transactionid);
+#ifndef OSIP_MONOTHREAD
+  osip_mutex_lock (shard->mutex);
+#endif
+  if ((shard->count + 1) * 2 > shard->size && __osip_index_resize (shard, shard->size * 2) != OSIP_SUCCESS && shard->count + 1 >= shard->size) {
+    full = 1;
+  }
+  else {
+    for (i = hash & (shard->size - 1); shard->slots[i].tr != NULL; i = (i + 1) & (shard->size - 1));
+    shard->slots[i].hash = hash;
+    shard->slots[i].tr = tr;
+    shard->count++;
+  }
+#ifndef OSIP_MONOTHREAD
+  osip_mutex_unlock (shard->mutex);
+#endif
+  if (full) {
+    osip_id_mutex_lock (osip);
+    ids->legacy++;
+    osip_id_mutex_unlock (osip);
+  }
+}
+
+/* OSIP_NOTFOUND if the transaction is not in the table */
+static int
+__osip_transaction_ids_remove (osip_t * osip, osip_transaction_t * tr)
+{
+  struct osip_transaction_index *ids = osip->ids;
+  struct osip_index_shard *shard;
+  unsigned int hash = __osip_ids_hash (tr->transactionid);
+  unsigned int i;
+  int found = OSIP_NOTFOUND;
+
+  if (ids == NULL)
+    return OSIP_NOTFOUND;
+  shard = __osip_ids_shard (ids, tr->transactionid);
+#ifndef OSIP_MONOTHREAD
+  osip_mutex_lock (shard->mutex);
+#endif
+  for (i = hash & (shard->size - 1); shard->slots[i].tr != NULL; i = (i + 1) & (shard->size - 1)) {
+    if (shard->slots[i].tr == tr) {
+      __osip_index_delete_slot (shard, i);
+      if (shard->size > INDEX_MIN_SIZE && shard->count * 8 < shard->size)
+        __osip_index_resize (shard, shard->size / 2);
+      found = OSIP_SUCCESS;
+      break;
+    }
+  }
+#ifndef OSIP_MONOTHREAD
+  osip_mutex_unlock (shard->mutex);
+#endif
+  return found;
+}
+
+/* the transaction was found in its list, but not in the table */
+static void
+__osip_transaction_ids_remove_legacy (osip_t * osip)
+{
+  osip_id_mutex_lock (osip);
+  osip->ids->legacy--;
+  osip_id_mutex_unlock (osip);
+}
+
+/* some transactions may only be found in the lists */
+static int
+__osip_transaction_ids_has_legacy (osip_t * osip)
+{
+  int legacy;
+
+  osip_id_mutex_lock (osip);
+  legacy = osip->ids->legacy;
+  osip_id_mutex_unlock (osip);
+  return legacy > 0;
+}
+
+static osip_transaction_t *
+__osip_transaction_list_get_by_id (osip_list_t * transactions, int transactionid)
 {
   osip_list_iterator_t iterator;
-  osip_transaction_t *tmp;
+  osip_transaction_t *tr;
+
+  tr = (osip_transaction_t *) osip_list_get_first (transactions, &iterator);
+  while (osip_list_iterator_has_elem (iterator)) {
+    if (tr->transactionid == transactionid)
+      return tr;
+    tr = (osip_transaction_t *) osip_list_get_next (&iterator);
+  }
+  return NULL;
+}
+
+/* the type of the transaction is read with the lock of the shard held */
+static osip_transaction_t *
+__osip_transaction_ids_get (osip_t * osip, int transactionid, osip_fsm_type_t * type)
+{
+  struct osip_index_shard *shard;
+  osip_transaction_t *tr = NULL;
+  unsigned int hash = __osip_ids_hash (transactionid);
+  unsigned int i;
+
+  shard = __osip_ids_shard (osip->ids, transactionid);
+#ifndef OSIP_MONOTHREAD
+  osip_mutex_lock (shard->mutex);
+#endif
+  for (i = hash & (shard->size - 1); shard->slots[i].tr != NULL; i = (i + 1) & (shard->size - 1)) {
+    if (shard->slots[i].hash == hash) {
+      tr = shard->slots[i].tr;
+      *type = tr->ctx_type;
+      break;
+    }
+  }
+#ifndef OSIP_MONOTHREAD
+  osip_mutex_unlock (shard->mutex);
+#endif
+  return tr;
+}
+
+osip_transaction_t *
+osip_transaction_get_by_id (osip_t * osip, int transactionid)
+{
+  osip_transaction_t *tr;
+  osip_fsm_type_t type;
+
+  if (osip == NULL || osip->ids == NULL)
+    return NULL;
+  tr = __osip_transaction_ids_get (osip, transactionid, &type);
+  if (tr != NULL || !__osip_transaction_ids_has_legacy (osip))
+    return tr;
+
+  osip_ict_lock (osip);
+  tr = __osip_transaction_list_get_by_id (&osip->osip_ict_transactions, transactionid);
+  osip_ict_unlock (osip);
+  if (tr != NULL)
+    return tr;
+  osip_ist_lock (osip);
+  tr = __osip_transaction_list_get_by_id (&osip->osip_ist_transactions, transactionid);
+  osip_ist_unlock (osip);
+  if (tr != NULL)
+    return tr;
+  osip_nict_lock (osip);
+  tr = __osip_transaction_list_get_by_id (&osip->osip_nict_transactions, transactionid);
+  osip_nict_unlock (osip);
+  if (tr != NULL)
+    return tr;
+  osip_nist_lock (osip);
+  tr = __osip_transaction_list_get_by_id (&osip->osip_nist_transactions, transactionid);
+  osip_nist_unlock (osip);
+  return tr;
+}
+
+static void
+__osip_transaction_type_lock (osip_t * osip, osip_fsm_type_t type)
+{
+  if (type == ICT)
+    osip_ict_lock (osip);
+  else if (type == IST)
+    osip_ist_lock (osip);
+  else if (type == NICT)
+    osip_nict_lock (osip);
+  else
+    osip_nist_lock (osip);
+}
+
+static void
+__osip_transaction_type_unlock (osip_t * osip, osip_fsm_type_t type)
+{
+  if (type == ICT)
+    osip_ict_unlock (osip);
+  else if (type == IST)
+    osip_ist_unlock (osip);
+  else if (type == NICT)
+    osip_nict_unlock (osip);
+  else
+    osip_nist_unlock (osip);
+}
+
+static int
+__osip_transaction_list_call_by_id (osip_t * osip, osip_fsm_type_t type, osip_list_t * transactions, int transactionid, void (*func) (osip_transaction_t *, void *), void *arg)
+{
+  osip_transaction_t *tr;
+
+  __osip_transaction_type_lock (osip, type);
+  tr = __osip_transaction_list_get_by_id (transactions, transactionid);
+  if (tr != NULL)
+    func (tr, arg);
+  __osip_transaction_type_unlock (osip, type);
+  return (tr != NULL) ? OSIP_SUCCESS : OSIP_NOTFOUND;
+}
+
+/* A transaction is removed from osip_t (before it is released) with the
+   lock of its list held: func is called with this lock held. The type
+   of the transaction tells which lock to take; the transaction is then
+   searched again, as it may have been removed in between. */
+int
+osip_transaction_call_by_id (osip_t * osip, int transactionid, void (*func) (osip_transaction_t *, void *), void *arg)
+{
+  osip_transaction_t *tr;
+  osip_fsm_type_t type;
+  osip_fsm_type_t locked;
+
+  if (osip == NULL || osip->ids == NULL || func == NULL)
+    return OSIP_BADPARAMETER;
+
+  tr = __osip_transaction_ids_get (osip, transactionid, &type);
+  if (tr != NULL) {
+    __osip_transaction_type_lock (osip, type);
+    if (__osip_transaction_ids_get (osip, transactionid, &locked) != tr || locked != type) {
+      __osip_transaction_type_unlock (osip, type);
+      return OSIP_NOTFOUND;
+    }
+    func (tr, arg);
+    __osip_transaction_type_unlock (osip, type);
+    return OSIP_SUCCESS;
+  }
+  if (!__osip_transaction_ids_has_legacy (osip))
+    return OSIP_NOTFOUND;
+
+  if (__osip_transaction_list_call_by_id (osip, ICT, &osip->osip_ict_transactions, transactionid, func, arg) == OSIP_SUCCESS)
+    return OSIP_SUCCESS;
+  if (__osip_transaction_list_call_by_id (osip, IST, &osip->osip_ist_transactions, transactionid, func, arg) == OSIP_SUCCESS)
+    return OSIP_SUCCESS;
+  if (__osip_transaction_list_call_by_id (osip, NICT, &osip->osip_nict_transactions, transactionid, func, arg) == OSIP_SUCCESS)
+    return OSIP_SUCCESS;
+  return __osip_transaction_list_call_by_id (osip, NIST, &osip->osip_nist_transactions, transactionid, func, arg);
+}
+
+/*
+  Ready queues: transactions with pending events, so that osip_*_execute
+  doesn't visit every transaction. A transaction is queued by
+  osip_transaction_add_event while it belongs to osip_t, and is queued
+  at most once.
+*/
+
+struct osip_ready_queue {
+#ifndef OSIP_MONOTHREAD
+  struct osip_mutex *mutex;
+#endif
+  osip_ready_entry_t head;      /* sentinel of a circular list */
+  int count;
+};
+
+static int
+__osip_ready_queue_init (struct osip_ready_queue **queue)
+{
+  *queue = (struct osip_ready_queue *) osip_malloc (sizeof (struct osip_ready_queue));
+  if (*queue == NULL)
+    return OSIP_NOMEM;
+  memset (*queue, 0, sizeof (struct osip_ready_queue));
+#ifndef OSIP_MONOTHREAD
+  (*queue)->mutex = osip_mutex_init ();
+  if ((*queue)->mutex == NULL) {
+    osip_free (*queue);
+    *queue = NULL;
+    return OSIP_NOMEM;
+  }
+#endif
+  (*queue)->head.next = &(*queue)->head;
+  (*queue)->head.prev = &(*queue)->head;
+  return OSIP_SUCCESS;
+}
+
+static void
+__osip_ready_queue_free (struct osip_ready_queue *queue)
+{
+  if (queue == NULL)
+    return;
+#ifndef OSIP_MONOTHREAD
+  osip_mutex_destroy (queue->mutex);
+#endif
+  osip_free (queue);
+}
+
+/* the lock of the queue must be held: returns 1 if the entry was not queued yet */
+static int
+__osip_ready_queue_push (struct osip_ready_queue *queue, osip_ready_entry_t * entry)
+{
+  if (entry->next != NULL)
+    return 0;                   /* already queued */
+  entry->next = &queue->head;
+  entry->prev = queue->head.prev;
+  queue->head.prev->next = entry;
+  queue->head.prev = entry;
+  queue->count++;
+  return 1;
+}
+
+/* the lock of the queue must be held */
+static void
+__osip_ready_queue_unlink (struct osip_ready_queue *queue, osip_ready_entry_t * entry)
+{
+  if (entry->next == NULL)
+    return;
+  entry->prev->next = entry->next;
+  entry->next->prev = entry->prev;
+  entry->next = NULL;
+  entry->prev = NULL;
+  queue->count--;
+}
+
+#ifndef OSIP_MONOTHREAD
+
+/*
+  Executor: threads consuming the events of transactions. Each thread
+  owns a queue of transactions; a transaction is always queued in the
+  queue of the same thread (its "home") and a thread with an empty
+  queue takes transactions from the queues of the others.
+
+  The lock of the home queue protects the state of the entry of the
+  transaction: queued (next != NULL) or being processed by a thread
+  (worker != NULL). A transaction is not queued while it is processed:
+  the thread processing it releases it when its fifo is empty.
+*/
+
+struct osip_executor_worker {
+  struct osip_executor *executor;
+  struct osip_thread *thread;
+  int index;
+  struct osip_ready_queue *queue;
+  osip_transaction_t *current;  /* NULL when removed from osip_t meanwhile */
+};
+
+struct osip_executor {
+  osip_t *osip;
+  int nthreads;
+  struct osip_mutex *mutex;     /* protects stop */
+  int stop;
+  struct osip_sem *sem;         /* posted once per queued transaction */
+  struct osip_executor_worker *workers;
+};
+
+#define __osip_executor_home(executor, tr) ((executor)->workers[(unsigned int) (tr)->transactionid % (executor)->nthreads].queue)
+
+/* the lock of the queue of the type of transaction must be held */
+static void
+__osip_executor_push (struct osip_executor *executor, osip_transaction_t * tr)
+{
+  struct osip_ready_queue *home = __osip_executor_home (executor, tr);
+  int queued = 0;
+
+  osip_mutex_lock (home->mutex);
+  if (tr->ready.next == NULL && tr->ready.worker == NULL) {
+    __osip_ready_queue_push (home, &tr->ready);
+    queued = 1;
+  }
+  osip_mutex_unlock (home->mutex);
+  if (queued)
+    osip_sem_post (executor->sem);
+}
+
+#endif
+
+static void
+__osip_ready_queue_attach (struct osip_ready_queue *queue, osip_transaction_t * tr)
+{
+#ifndef OSIP_MONOTHREAD
+  osip_mutex_lock (queue->mutex);
+#endif
+  tr->ready.queue = queue;
+  tr->ready.data = tr;
+  if (osip_fifo_size (tr->transactionff) > 0) {
+    osip_t *osip = (osip_t *) tr->config;
+
+#ifndef OSIP_MONOTHREAD
+    if (osip->executor != NULL)
+      __osip_executor_push (osip->executor, tr);
+    else
+#endif
+    if (__osip_ready_queue_push (queue, &tr->ready))
+      __osip_wakeup_signal (osip);
+  }
+#ifndef OSIP_MONOTHREAD
+  osip_mutex_unlock (queue->mutex);
+#endif
+}
+
+static void
+__osip_ready_queue_detach (struct osip_ready_queue *queue, osip_transaction_t * tr)
+{
+#ifndef OSIP_MONOTHREAD
+  osip_t *osip = (osip_t *) tr->config;
+
+  osip_mutex_lock (queue->mutex);
+  if (tr->ready.queue == queue && osip->executor != NULL) {
+    struct osip_ready_queue *home = __osip_executor_home (osip->executor, tr);
+
+    osip_mutex_lock (home->mutex);
+    __osip_ready_queue_unlink (home, &tr->ready);
+    /* the thread processing it must not access it any more */
+    if (tr->ready.worker != NULL)
+      tr->ready.worker->current = NULL;
+    tr->ready.worker = NULL;
+    osip_mutex_unlock (home->mutex);
+    tr->ready.queue = NULL;
+  }
+#endif
+  if (tr->ready.queue == queue) {
+    __osip_ready_queue_unlink (queue, &tr->ready);
+    tr->ready.queue = NULL;
+  }
+#ifndef OSIP_MONOTHREAD
+  osip_mutex_unlock (queue->mutex);
+#endif
+}
+
+void
+__osip_transaction_set_ready (osip_transaction_t * tr)
+{
+  osip_t *osip = (osip_t *) tr->config;
+  struct osip_ready_queue *queue = NULL;
+
+  if (osip == NULL)
+    return;
+  if (tr->ctx_type == ICT)
+    queue = osip->ict_ready;
+  else if (tr->ctx_type == IST)
+    queue = osip->ist_ready;
+  else if (tr->ctx_type == NICT)
+    queue = osip->nict_ready;
+  else if (tr->ctx_type == NIST)
+    queue = osip->nist_ready;
+  if (queue == NULL)
+    return;
+
+#ifndef OSIP_MONOTHREAD
+  osip_mutex_lock (queue->mutex);
+#endif
+  /* not queued when the transaction was removed from osip_t */
+  if (tr->ready.queue == queue) {
+#ifndef OSIP_MONOTHREAD
+    if (osip->executor != NULL)
+      __osip_executor_push (osip->executor, tr);
+    else
+#endif
+    if (__osip_ready_queue_push (queue, &tr->ready))
+      __osip_wakeup_signal (osip);
+  }
+#ifndef OSIP_MONOTHREAD
+  osip_mutex_unlock (queue->mutex);
+#endif
+}
+
+static int
+__osip_ready_queue_execute (struct osip_ready_queue *queue)
+{
+  int count;
+
+  /* transactions queued while this one is running wait for the next call */
+#ifndef OSIP_MONOTHREAD
+  osip_mutex_lock (queue->mutex);
+#endif
+  count = queue->count;
+#ifndef OSIP_MONOTHREAD
+  osip_mutex_unlock (queue->mutex);
+#endif
+
+  while (count-- > 0) {
+    osip_ready_entry_t *entry;
+    osip_transaction_t *transaction;
+    osip_event_t *se;
+
+#ifndef OSIP_MONOTHREAD
+    osip_mutex_lock (queue->mutex);
+#endif
+    entry = queue->head.next;
+    if (entry != &queue->head)
+      __osip_ready_queue_unlink (queue, entry);
+#ifndef OSIP_MONOTHREAD
+    osip_mutex_unlock (queue->mutex);
+#endif
+    if (entry == &queue->head)
+      break;
+
+    /* an event added from now on queues the transaction again */
+    transaction = (osip_transaction_t *) entry->data;
+    while ((se = (osip_event_t *) osip_fifo_tryget (transaction->transactionff)) != NULL)
+      osip_transaction_execute (transaction, se);
+  }
+  return OSIP_SUCCESS;
+}
+
+#ifndef OSIP_MONOTHREAD
+
+static void *
+__osip_executor_thread (void *arg)
+{
+  struct osip_executor_worker *self = (struct osip_executor_worker *) arg;
+  struct osip_executor *executor = self->executor;
+
+  for (;;) {
+    struct osip_ready_queue *home = NULL;
+    osip_transaction_t *transaction = NULL;
+    int i;
+
+    if (osip_sem_trywait (executor->sem) != 0) {
+      /* nothing else to do: send the messages of the batch */
+      osip_send_batch_flush (executor->osip);
+      osip_sem_wait (executor->sem);
+    }
+    osip_mutex_lock (executor->mutex);
+    i = executor->stop;
+    osip_mutex_unlock (executor->mutex);
+    if (i)
+      break;
+
+    /* own queue first, then the queues of the other threads */
+    for (i = 0; i < executor->nthreads && transaction == NULL; i++) {
+      osip_ready_entry_t *entry;
+
+      home = executor->workers[(self->index + i) % executor->nthreads].queue;
+      osip_mutex_lock (home->mutex);
+      entry = home->head.next;
+      if (entry != &home->head) {
+        __osip_ready_queue_unlink (home, entry);
+        entry->worker = self;
+        transaction = (osip_transaction_t *) entry->data;
+        self->current = transaction;
+      }
+      osip_mutex_unlock (home->mutex);
+    }
+
+    while (transaction != NULL) {
+      osip_event_t *se = NULL;
+
+      osip_mutex_lock (home->mutex);
+      if (self->current != NULL) {
+        se = (osip_event_t *) osip_fifo_tryget (transaction->transactionff);
+        if (se == NULL) {
+          /* a new event will queue the transaction again */
+          transaction->ready.worker = NULL;
+          self->current = NULL;
+        }
+      }
+      osip_mutex_unlock (home->mutex);
+      if (se == NULL)
+        break;
+      osip_transaction_execute (transaction, se);
+    }
+  }
+  osip_event_pool_thread_release ();
+  osip_pool_thread_release ();
+  return NULL;
+}
+
+static void
+__osip_executor_free (struct osip_executor *executor)
+{
+  int i;
+
+  for (i = 0; i < executor->nthreads; i++)
+    __osip_ready_queue_free (executor->workers[i].queue);
+  if (executor->sem != NULL)
+    osip_sem_destroy (executor->sem);
+  if (executor->mutex != NULL)
+    osip_mutex_destroy (executor->mutex);
+  osip_free (executor->workers);
+  osip_free (executor);
+}
+
+static void
+__osip_executor_lock_all (osip_t * osip)
+{
+  osip_mutex_lock (osip->ict_ready->mutex);
+  osip_mutex_lock (osip->ist_ready->mutex);
+  osip_mutex_lock (osip->nict_ready->mutex);
+  osip_mutex_lock (osip->nist_ready->mutex);
+}
+
+static void
+__osip_executor_unlock_all (osip_t * osip)
+{
+  osip_mutex_unlock (osip->nist_ready->mutex);
+  osip_mutex_unlock (osip->nict_ready->mutex);
+  osip_mutex_unlock (osip->ist_ready->mutex);
+  osip_mutex_unlock (osip->ict_ready->mutex);
+}
+
+/* move the queued transactions from one queue to their home, or back
+   to the queue of their type of transaction when executor is NULL */
+static void
+__osip_executor_move (struct osip_executor *executor, struct osip_ready_queue *from)
+{
+  while (from->head.next != &from->head) {
+    osip_ready_entry_t *entry = from->head.next;
+
+    __osip_ready_queue_unlink (from, entry);
+    if (executor != NULL)
+      __osip_executor_push (executor, (osip_transaction_t *) entry->data);
+    else
+      __osip_ready_queue_push (entry->queue, entry);
+  }
+}
+
+int
+osip_executor_start (osip_t * osip, int nthreads)
+{
+  struct osip_executor *executor;
+  int i;
+
+  if (osip == NULL || nthreads <= 0)
+    return OSIP_BADPARAMETER;
+  if (osip->executor != NULL)
+    return OSIP_WRONG_STATE;
+
+  executor = (struct osip_executor *) osip_malloc (sizeof (struct osip_executor));
+  if (executor == NULL)
+    return OSIP_NOMEM;
+  memset (executor, 0, sizeof (struct osip_executor));
+  executor->workers = (struct osip_executor_worker *) osip_malloc (nthreads * sizeof (struct osip_executor_worker));
+  if (executor->workers == NULL) {
+    osip_free (executor);
+    return OSIP_NOMEM;
+  }
+  memset (executor->workers, 0, nthreads * sizeof (struct osip_executor_worker));
+  executor->osip = osip;
+  executor->sem = osip_sem_init (0);
+  executor->mutex = osip_mutex_init ();
+  if (executor->sem == NULL || executor->mutex == NULL) {
+    __osip_executor_free (executor);
+    return OSIP_NOMEM;
+  }
+  for (i = 0; i < nthreads; i++) {
+    executor->workers[i].executor = executor;
+    executor->workers[i].index = i;
+    if (__osip_ready_queue_init (&executor->workers[i].queue) != OSIP_SUCCESS) {
+      __osip_executor_free (executor);
+      return OSIP_NOMEM;
+    }
+    executor->nthreads++;
+  }
+
+  for (i = 0; i < nthreads; i++) {
+    executor->workers[i].thread = osip_thread_create (20000, __osip_executor_thread, &executor->workers[i]);
+    if (executor->workers[i].thread == NULL) {
+      OSIP_TRACE (osip_trace (__FILE__, __LINE__, OSIP_ERROR, NULL, "executor: cannot start thread!\n"));
+      osip_mutex_lock (executor->mutex);
+      executor->stop = 1;
+      osip_mutex_unlock (executor->mutex);
+      while (--i >= 0) {
+        osip_sem_post (executor->sem);
+        osip_thread_join (executor->workers[i].thread);
+        osip_free (executor->workers[i].thread);
+      }
+      __osip_executor_free (executor);
+      return OSIP_UNDEFINED_ERROR;
+    }
+  }
+
+  __osip_executor_lock_all (osip);
+  osip->executor = executor;
+  __osip_executor_move (executor, osip->ict_ready);
+  __osip_executor_move (executor, osip->ist_ready);
+  __osip_executor_move (executor, osip->nict_ready);
+  __osip_executor_move (executor, osip->nist_ready);
+  __osip_executor_unlock_all (osip);
+  return OSIP_SUCCESS;
+}
+
+int
+osip_executor_stop (osip_t * osip)
+{
+  struct osip_executor *executor;
+  int i;
+
+  if (osip == NULL)
+    return OSIP_BADPARAMETER;
+  executor = osip->executor;
+  if (executor == NULL)
+    return OSIP_WRONG_STATE;
+
+  /* each thread finishes the transaction it is processing */
+  osip_mutex_lock (executor->mutex);
+  executor->stop = 1;
+  osip_mutex_unlock (executor->mutex);
+  for (i = 0; i < executor->nthreads; i++)
+    osip_sem_post (executor->sem);
+  for (i = 0; i < executor->nthreads; i++) {
+    osip_thread_join (executor->workers[i].thread);
+    osip_free (executor->workers[i].thread);
+  }
+
+  __osip_executor_lock_all (osip);
+  osip->executor = NULL;
+  for (i = 0; i < executor->nthreads; i++) {
+    osip_mutex_lock (executor->workers[i].queue->mutex);
+    __osip_executor_move (NULL, executor->workers[i].queue);
+    osip_mutex_unlock (executor->workers[i].queue->mutex);
+  }
+  if (osip->ict_ready->count + osip->ist_ready->count + osip->nict_ready->count + osip->nist_ready->count > 0)
+    __osip_wakeup_signal (osip);
+  __osip_executor_unlock_all (osip);
+
+  __osip_executor_free (executor);
+  osip_send_batch_flush (osip);
+  return OSIP_SUCCESS;
+}
+
+#endif
+
+static struct osip_transaction_index *
+__osip_transaction_index_of (osip_t * osip, osip_list_t * transactions)
+{
+  if (transactions == &osip->osip_ict_transactions)
+    return osip->ict_index;
+  if (transactions == &osip->osip_ist_transactions)
+    return osip->ist_index;
+  if (transactions == &osip->osip_nict_transactions)
+    return osip->nict_index;
+  if (transactions == &osip->osip_nist_transactions)
+    return osip->nist_index;
+  return NULL;
+}
+
+static osip_transaction_t *__osip_transaction_list_find (osip_list_t * transactions, osip_event_t * evt);
+
+/* keep the earliest active timer */
+static void
+__osip_min_timer (struct timeval *lower, struct timeval *timer)
+{
+  if (timer->tv_sec == -1)
+    return;
+  if (lower->tv_sec == -1 || osip_timercmp (lower, timer, >)) {
+    lower->tv_sec = timer->tv_sec;
+    lower->tv_usec = timer->tv_usec;
+  }
+}
+
+/* next timer the state machine of this transaction is waiting for */
+static int
+__osip_transaction_next_timer (osip_transaction_t * tr, struct timeval *deadline)
+{
+  deadline->tv_sec = -1;
+  deadline->tv_usec = 0;
+
+  if (tr->ctx_type == ICT && tr->ict_context != NULL) {
+    if (tr->state == ICT_CALLING) {
+      __osip_min_timer (deadline, &tr->ict_context->timer_b_start);
+      __osip_min_timer (deadline, &tr->ict_context->timer_a_start);
+    }
+    else if (tr->state == ICT_COMPLETED)
+      __osip_min_timer (deadline, &tr->ict_context->timer_d_start);
+  }
+  else if (tr->ctx_type == IST && tr->ist_context != NULL) {
+    if (tr->state == IST_CONFIRMED)
+      __osip_min_timer (deadline, &tr->ist_context->timer_i_start);
+    else if (tr->state == IST_COMPLETED) {
+      __osip_min_timer (deadline, &tr->ist_context->timer_h_start);
+      __osip_min_timer (deadline, &tr->ist_context->timer_g_start);
+    }
+  }
+  else if (tr->ctx_type == NICT && tr->nict_context != NULL) {
+    if (tr->state == NICT_COMPLETED)
+      __osip_min_timer (deadline, &tr->nict_context->timer_k_start);
+    else if (tr->state == NICT_PROCEEDING || tr->state == NICT_TRYING) {
+      __osip_min_timer (deadline, &tr->nict_context->timer_f_start);
+      __osip_min_timer (deadline, &tr->nict_context->timer_e_start);
+    }
+  }
+  else if (tr->ctx_type == NIST && tr->nist_context != NULL) {
+    if (tr->state == NIST_COMPLETED)
+      __osip_min_timer (deadline, &tr->nist_context->timer_j_start);
+  }
+
+  if (deadline->tv_sec == -1)
+    return OSIP_NOTFOUND;
+  return OSIP_SUCCESS;
+}
+
+/* the list of transactions of this type must be locked */
+static void
+__osip_transaction_arm_timers (osip_transaction_t * tr)
+{
+  struct timeval deadline;
+
+  if (tr->timers.wheel == NULL)
+    return;
+  if (__osip_transaction_next_timer (tr, &deadline) == OSIP_SUCCESS) {
+    __osip_timer_wheel_add (&tr->timers, &deadline);
+    __osip_wakeup_timer ((osip_t *) tr->config, &deadline);
+  }
+  else
+    __osip_timer_wheel_del (&tr->timers);
+}
+
+void
+__osip_transaction_update_timers (osip_transaction_t * tr)
+{
+  osip_t *osip = (osip_t *) tr->config;
+
+  if (osip == NULL || tr->timers.wheel == NULL)
+    return;
+
+  if (tr->ctx_type == ICT) {
+    osip_ict_lock (osip);
+    __osip_transaction_arm_timers (tr);
+    osip_ict_unlock (osip);
+  }
+  else if (tr->ctx_type == IST) {
+    osip_ist_lock (osip);
+    __osip_transaction_arm_timers (tr);
+    osip_ist_unlock (osip);
+  }
+  else if (tr->ctx_type == NICT) {
+    osip_nict_lock (osip);
+    __osip_transaction_arm_timers (tr);
+    osip_nict_unlock (osip);
+  }
+  else if (tr->ctx_type == NIST) {
+    osip_nist_lock (osip);
+    __osip_transaction_arm_timers (tr);
+    osip_nist_unlock (osip);
+  }
+}
+
+/*
+  The lists of transactions of osip_t. A transaction keeps where it is
+  in its list, so that it is removed without walking the list: the
+  link pointing to its node, or its position in the array. The lists
+  must not be modified with the osip_list_* functions.
+  Transactions are added at the end of the list. A removed transaction
+  is unlinked from the list of nodes, or replaced by the last one of
+  the array.
+*/
+
+#ifndef OSIP_LIST_ARRAY
+
+/* tail is the link to the end of the list */
+static int
+__osip_transaction_list_add (osip_list_t * transactions, __node_t *** tail, osip_transaction_t * tr)
+{
+  __node_t *node;
+
+  node = (__node_t *) __osip_pool_malloc (sizeof (__node_t));
+  if (node == NULL)
+    return OSIP_NOMEM;
+  node->element = tr;
+  node->next = NULL;
+  **tail = node;
+  tr->list_link = *tail;
+  *tail = &node->next;
+  transactions->nb_elt++;
+  return OSIP_SUCCESS;
+}
+
+static int
+__osip_transaction_list_remove (osip_list_t * transactions, __node_t *** tail, osip_transaction_t * tr)
+{
+  __node_t *node;
+
+  if (tr->list_link == NULL)
+    return OSIP_NOTFOUND;
+  node = *tr->list_link;
+  *tr->list_link = node->next;
+  if (node->next != NULL)
+    ((osip_transaction_t *) node->next->element)->list_link = tr->list_link;
+  else
+    *tail = tr->list_link;
+  tr->list_link = NULL;
+  transactions->nb_elt--;
+  __osip_pool_free (node, sizeof (__node_t));
+  return OSIP_SUCCESS;
+}
+
+#define __osip_transaction_list_tail(osip, type) (&(osip)->type##_tail)
+
+#else
+
+#define __osip_transaction_list_tail(osip, type) NULL
+
+static int
+__osip_transaction_list_add (osip_list_t * transactions, void *tail, osip_transaction_t * tr)
+{
+  int i;
 
-#ifndef OSIP_MONOTHREAD
-  osip_mutex_lock (osip->ist_fastmutex);
-#endif
+  i = osip_list_add (transactions, tr, -1);
+  if (i < 0)
+    return i;
+  tr->list_pos = i - 1;
+  return OSIP_SUCCESS;
+}
 
-#if defined(HAVE_DICT_DICT_H)
-  {
-    osip_generic_param_t *b_request = NULL;
-    int rv;
+/* the last transaction of the list takes the place of the removed one */
+static int
+__osip_transaction_list_remove (osip_list_t * transactions, void *tail, osip_transaction_t * tr)
+{
+  osip_transaction_t *last;
+
+  if (tr->list_pos < 0)
+    return OSIP_NOTFOUND;
+  last = (osip_transaction_t *) osip_list_get (transactions, transactions->nb_elt - 1);
+  transactions->array[(transactions->start + tr->list_pos) & (transactions->size - 1)] = last;
+  last->list_pos = tr->list_pos;
+  osip_list_remove (transactions, transactions->nb_elt - 1);
+  tr->list_pos = -1;
+  return OSIP_SUCCESS;
+}
 
-    osip_via_param_get_byname (ist->topvia, "branch", &b_request);
-    if (b_request != NULL && b_request->gvalue != NULL) {
-      rv = dict_remove (osip->osip_ist_hastable, b_request->gvalue, TRUE);
+#endif
 
-      if (rv == 0) {
-        OSIP_TRACE (osip_trace (__FILE__, __LINE__, OSIP_INFO1, NULL, "New key deleted in ist hastable `%s'\n", b_request->gvalue));
-      }
-      else {
-        OSIP_TRACE (osip_trace (__FILE__, __LINE__, OSIP_WARNING, NULL, "key not removed `%s'\n", b_request->gvalue));
-      }
-    }
+int
+__osip_add_ict (osip_t * osip, osip_transaction_t * ict)
+{
+#ifndef OSIP_MONOTHREAD
+  osip_mutex_lock (osip->ict_fastmutex);
+#endif
+  if (__osip_transaction_list_add (&osip->osip_ict_transactions, __osip_transaction_list_tail (osip, ict), ict) != OSIP_SUCCESS) {
+#ifndef OSIP_MONOTHREAD
+    osip_mutex_unlock (osip->ict_fastmutex);
+#endif
+    return OSIP_NOMEM;
   }
+  __osip_transaction_index_add (osip->ict_index, ict);
+  __osip_transaction_ids_add (osip, ict);
+  ict->timers.wheel = osip->ict_timers;
+  ict->timers.data = ict;
+  __osip_transaction_arm_timers (ict);
+  __osip_ready_queue_attach (osip->ict_ready, ict);
+#ifndef OSIP_MONOTHREAD
+  osip_mutex_unlock (osip->ict_fastmutex);
 #endif
+  return OSIP_SUCCESS;
+}
 
-  tmp = (osip_transaction_t *) osip_list_get_first (&osip->osip_ist_transactions, &iterator);
-  while (osip_list_iterator_has_elem (iterator)) {
-    if (tmp->transactionid == ist->transactionid) {
-      osip_list_iterator_remove (&iterator);
+int
+__osip_add_ist (osip_t * osip, osip_transaction_t * ist)
+{
+#ifndef OSIP_MONOTHREAD
+  osip_mutex_lock (osip->ist_fastmutex);
+#endif
+  if (__osip_transaction_list_add (&osip->osip_ist_transactions, __osip_transaction_list_tail (osip, ist), ist) != OSIP_SUCCESS) {
 #ifndef OSIP_MONOTHREAD
-      osip_mutex_unlock (osip->ist_fastmutex);
+    osip_mutex_unlock (osip->ist_fastmutex);
 #endif
-      return OSIP_SUCCESS;
-    }
-    tmp = (osip_transaction_t *) osip_list_get_next (&iterator);
+    return OSIP_NOMEM;
   }
+  __osip_transaction_index_add (osip->ist_index, ist);
+  __osip_transaction_ids_add (osip, ist);
+  ist->timers.wheel = osip->ist_timers;
+  ist->timers.data = ist;
+  __osip_transaction_arm_timers (ist);
+  __osip_ready_queue_attach (osip->ist_ready, ist);
 #ifndef OSIP_MONOTHREAD
   osip_mutex_unlock (osip->ist_fastmutex);
 #endif
-  return OSIP_UNDEFINED_ERROR;
+  return OSIP_SUCCESS;
 }
 
 int
-__osip_remove_nict_transaction (osip_t * osip, osip_transaction_t * nict)
+__osip_add_nict (osip_t * osip, osip_transaction_t * nict)
 {
-  osip_list_iterator_t iterator;
-  osip_transaction_t *tmp;
-
 #ifndef OSIP_MONOTHREAD
   osip_mutex_lock (osip->nict_fastmutex);
 #endif
-
-#if defined(HAVE_DICT_DICT_H)
-  {
-    osip_generic_param_t *b_request = NULL;
-    int rv;
-
-    osip_via_param_get_byname (nict->topvia, "branch", &b_request);
-    if (b_request != NULL && b_request->gvalue != NULL) {
-      rv = dict_remove (osip->osip_nict_hastable, b_request->gvalue, TRUE);
-
-      if (rv == 0) {
-        OSIP_TRACE (osip_trace (__FILE__, __LINE__, OSIP_INFO1, NULL, "New key deleted in nict hastable `%s'\n", b_request->gvalue));
-      }
-      else {
-        OSIP_TRACE (osip_trace (__FILE__, __LINE__, OSIP_WARNING, NULL, "key not removed `%s'\n", b_request->gvalue));
-      }
-    }
+  if (__osip_transaction_list_add (&osip->osip_nict_transactions, __osip_transaction_list_tail (osip, nict), nict) != OSIP_SUCCESS) {
+#ifndef OSIP_MONOTHREAD
+    osip_mutex_unlock (osip->nict_fastmutex);
+#endif
+    return OSIP_NOMEM;
   }
+  __osip_transaction_index_add (osip->nict_index, nict);
+  __osip_transaction_ids_add (osip, nict);
+  nict->timers.wheel = osip->nict_timers;
+  nict->timers.data = nict;
+  __osip_transaction_arm_timers (nict);
+  __osip_ready_queue_attach (osip->nict_ready, nict);
+#ifndef OSIP_MONOTHREAD
+  osip_mutex_unlock (osip->nict_fastmutex);
 #endif
+  return OSIP_SUCCESS;
+}
 
-  tmp = (osip_transaction_t *) osip_list_get_first (&osip->osip_nict_transactions, &iterator);
-  while (osip_list_iterator_has_elem (iterator)) {
-    if (tmp->transactionid == nict->transactionid) {
-      osip_list_iterator_remove (&iterator);
+int
+__osip_add_nist (osip_t * osip, osip_transaction_t * nist)
+{
 #ifndef OSIP_MONOTHREAD
-      osip_mutex_unlock (osip->nict_fastmutex);
+  osip_mutex_lock (osip->nist_fastmutex);
 #endif
-      return OSIP_SUCCESS;
-    }
-    tmp = (osip_transaction_t *) osip_list_get_next (&iterator);
+  if (__osip_transaction_list_add (&osip->osip_nist_transactions, __osip_transaction_list_tail (osip, nist), nist) != OSIP_SUCCESS) {
+#ifndef OSIP_MONOTHREAD
+    osip_mutex_unlock (osip->nist_fastmutex);
+#endif
+    return OSIP_NOMEM;
   }
+  __osip_transaction_index_add (osip->nist_index, nist);
+  __osip_transaction_ids_add (osip, nist);
+  nist->timers.wheel = osip->nist_timers;
+  nist->timers.data = nist;
+  __osip_transaction_arm_timers (nist);
+  __osip_ready_queue_attach (osip->nist_ready, nist);
 #ifndef OSIP_MONOTHREAD
-  osip_mutex_unlock (osip->nict_fastmutex);
+  osip_mutex_unlock (osip->nist_fastmutex);
 #endif
-  return OSIP_UNDEFINED_ERROR;
+  return OSIP_SUCCESS;
 }
 
 int
-__osip_remove_nist_transaction (osip_t * osip, osip_transaction_t * nist)
+osip_remove_transaction (osip_t * osip, osip_transaction_t * tr)
 {
-  osip_list_iterator_t iterator;
-  osip_transaction_t *tmp;
+  int i = -1;
 
+  if (tr == NULL)
+    return OSIP_BADPARAMETER;
+  if (tr->ctx_type == ICT)
+    i = __osip_remove_ict_transaction (osip, tr);
+  else if (tr->ctx_type == IST)
+    i = __osip_remove_ist_transaction (osip, tr);
+  else if (tr->ctx_type == NICT)
+    i = __osip_remove_nict_transaction (osip, tr);
+  else if (tr->ctx_type == NIST)
+    i = __osip_remove_nist_transaction (osip, tr);
+  else
+    return OSIP_BADPARAMETER;
+  return i;
+}
+
+int
+__osip_remove_ict_transaction (osip_t * osip, osip_transaction_t * ict)
+{
 #ifndef OSIP_MONOTHREAD
-  osip_mutex_lock (osip->nist_fastmutex);
+  osip_mutex_lock (osip->ict_fastmutex);
 #endif
+  if (__osip_transaction_list_remove (&osip->osip_ict_transactions, __osip_transaction_list_tail (osip, ict), ict) != OSIP_SUCCESS) {
+#ifndef OSIP_MONOTHREAD
+    osip_mutex_unlock (osip->ict_fastmutex);
+#endif
+    return OSIP_UNDEFINED_ERROR;        /* not added or already removed */
+  }
+  if (__osip_transaction_ids_remove (osip, ict) != OSIP_SUCCESS)
+    __osip_transaction_ids_remove_legacy (osip);
+  __osip_timer_wheel_del (&ict->timers);
+  ict->timers.wheel = NULL;
+  __osip_transaction_index_remove (osip->ict_index, ict);
+  __osip_ready_queue_detach (osip->ict_ready, ict);
+#ifndef OSIP_MONOTHREAD
+  osip_mutex_unlock (osip->ict_fastmutex);
+#endif
+  return OSIP_SUCCESS;
+}
 
-#if defined(HAVE_DICT_DICT_H)
-  {
-    osip_generic_param_t *b_request = NULL;
-    int rv;
-
-    osip_via_param_get_byname (nist->topvia, "branch", &b_request);
-    if (b_request != NULL && b_request->gvalue != NULL) {
-      rv = dict_remove (osip->osip_nist_hastable, b_request->gvalue, TRUE);
+int
+__osip_remove_ist_transaction (osip_t * osip, osip_transaction_t * ist)
+{
+#ifndef OSIP_MONOTHREAD
+  osip_mutex_lock (osip->ist_fastmutex);
+#endif
+  if (__osip_transaction_list_remove (&osip->osip_ist_transactions, __osip_transaction_list_tail (osip, ist), ist) != OSIP_SUCCESS) {
+#ifndef OSIP_MONOTHREAD
+    osip_mutex_unlock (osip->ist_fastmutex);
+#endif
+    return OSIP_UNDEFINED_ERROR;        /* not added or already removed */
+  }
+  if (__osip_transaction_ids_remove (osip, ist) != OSIP_SUCCESS)
+    __osip_transaction_ids_remove_legacy (osip);
+  __osip_timer_wheel_del (&ist->timers);
+  ist->timers.wheel = NULL;
+  __osip_transaction_index_remove (osip->ist_index, ist);
+  __osip_ready_queue_detach (osip->ist_ready, ist);
+#ifndef OSIP_MONOTHREAD
+  osip_mutex_unlock (osip->ist_fastmutex);
+#endif
+  return OSIP_SUCCESS;
+}
 
-      if (rv == 0) {
-        OSIP_TRACE (osip_trace (__FILE__, __LINE__, OSIP_INFO1, NULL, "New key deleted in ict hastable `%s'\n", b_request->gvalue));
-      }
-      else {
-        OSIP_TRACE (osip_trace (__FILE__, __LINE__, OSIP_WARNING, NULL, "key not removed `%s'\n", b_request->gvalue));
-      }
-    }
+int
+__osip_remove_nict_transaction (osip_t * osip, osip_transaction_t * nict)
+{
+#ifndef OSIP_MONOTHREAD
+  osip_mutex_lock (osip->nict_fastmutex);
+#endif
+  if (__osip_transaction_list_remove (&osip->osip_nict_transactions, __osip_transaction_list_tail (osip, nict), nict) != OSIP_SUCCESS) {
+#ifndef OSIP_MONOTHREAD
+    osip_mutex_unlock (osip->nict_fastmutex);
+#endif
+    return OSIP_UNDEFINED_ERROR;        /* not added or already removed */
   }
+  if (__osip_transaction_ids_remove (osip, nict) != OSIP_SUCCESS)
+    __osip_transaction_ids_remove_legacy (osip);
+  __osip_timer_wheel_del (&nict->timers);
+  nict->timers.wheel = NULL;
+  __osip_transaction_index_remove (osip->nict_index, nict);
+  __osip_ready_queue_detach (osip->nict_ready, nict);
+#ifndef OSIP_MONOTHREAD
+  osip_mutex_unlock (osip->nict_fastmutex);
 #endif
+  return OSIP_SUCCESS;
+}
 
-  tmp = (osip_transaction_t *) osip_list_get_first (&osip->osip_nist_transactions, &iterator);
-  while (osip_list_iterator_has_elem (iterator)) {
-    if (tmp->transactionid == nist->transactionid) {
-      osip_list_iterator_remove (&iterator);
+int
+__osip_remove_nist_transaction (osip_t * osip, osip_transaction_t * nist)
+{
 #ifndef OSIP_MONOTHREAD
-      osip_mutex_unlock (osip->nist_fastmutex);
+  osip_mutex_lock (osip->nist_fastmutex);
 #endif
-      return OSIP_SUCCESS;
-    }
-    tmp = (osip_transaction_t *) osip_list_get_next (&iterator);
+  if (__osip_transaction_list_remove (&osip->osip_nist_transactions, __osip_transaction_list_tail (osip, nist), nist) != OSIP_SUCCESS) {
+#ifndef OSIP_MONOTHREAD
+    osip_mutex_unlock (osip->nist_fastmutex);
+#endif
+    return OSIP_UNDEFINED_ERROR;        /* not added or already removed */
   }
+  if (__osip_transaction_ids_remove (osip, nist) != OSIP_SUCCESS)
+    __osip_transaction_ids_remove_legacy (osip);
+  __osip_timer_wheel_del (&nist->timers);
+  nist->timers.wheel = NULL;
+  __osip_transaction_index_remove (osip->nist_index, nist);
+  __osip_ready_queue_detach (osip->nist_ready, nist);
 #ifndef OSIP_MONOTHREAD
   osip_mutex_unlock (osip->nist_fastmutex);
 #endif
-  return OSIP_UNDEFINED_ERROR;
+  return OSIP_SUCCESS;
 }
 
 int
@@ -727,6 +2173,8 @@ __osip_find_transaction (osip_t * osip, osip_event_t * evt, int consume)
 {
   osip_transaction_t *transaction = NULL;
   osip_list_t *transactions = NULL;
+  struct osip_transaction_index *index;
+  int indexed;
 
 #ifndef OSIP_MONOTHREAD
   struct osip_mutex *mut = NULL;
@@ -737,8 +2185,8 @@ __osip_find_transaction (osip_t * osip, osip_event_t * evt, int consume)
 
   if (EVT_IS_INCOMINGMSG (evt)) {
     if (MSG_IS_REQUEST (evt->sip)) {
-      if (0 == strcmp (evt->sip->cseq->method, "INVITE")
-          || 0 == strcmp (evt->sip->cseq->method, "ACK")) {
+      if (__osip_cseq_is_method (evt->sip->cseq, OSIP_METHOD_INVITE, "INVITE")
+          || __osip_cseq_is_method (evt->sip->cseq, OSIP_METHOD_ACK, "ACK")) {
         transactions = &osip->osip_ist_transactions;
 #ifndef OSIP_MONOTHREAD
         mut = osip->ist_fastmutex;
@@ -752,7 +2200,7 @@ __osip_find_transaction (osip_t * osip, osip_event_t * evt, int consume)
       }
     }
     else {
-      if (0 == strcmp (evt->sip->cseq->method, "INVITE")) {
+      if (__osip_cseq_is_method (evt->sip->cseq, OSIP_METHOD_INVITE, "INVITE")) {
         transactions = &osip->osip_ict_transactions;
 #ifndef OSIP_MONOTHREAD
         mut = osip->ict_fastmutex;
@@ -768,7 +2216,7 @@ __osip_find_transaction (osip_t * osip, osip_event_t * evt, int consume)
   }
   else if (EVT_IS_OUTGOINGMSG (evt)) {
     if (MSG_IS_RESPONSE (evt->sip)) {
-      if (0 == strcmp (evt->sip->cseq->method, "INVITE")) {
+      if (__osip_cseq_is_method (evt->sip->cseq, OSIP_METHOD_INVITE, "INVITE")) {
         transactions = &osip->osip_ist_transactions;
 #ifndef OSIP_MONOTHREAD
         mut = osip->ist_fastmutex;
@@ -782,8 +2230,8 @@ __osip_find_transaction (osip_t * osip, osip_event_t * evt, int consume)
       }
     }
     else {
-      if (0 == strcmp (evt->sip->cseq->method, "INVITE")
-          || 0 == strcmp (evt->sip->cseq->method, "ACK")) {
+      if (__osip_cseq_is_method (evt->sip->cseq, OSIP_METHOD_INVITE, "INVITE")
+          || __osip_cseq_is_method (evt->sip->cseq, OSIP_METHOD_ACK, "ACK")) {
         transactions = &osip->osip_ict_transactions;
 #ifndef OSIP_MONOTHREAD
         mut = osip->ict_fastmutex;
@@ -800,10 +2248,22 @@ __osip_find_transaction (osip_t * osip, osip_event_t * evt, int consume)
   if (transactions == NULL)
     return NULL;                /* not a message??? */
 
+  /* most messages are matched with the lock of one shard of the index */
+  index = __osip_transaction_index_of (osip, transactions);
+  indexed = OSIP_NOTFOUND;
+  if (EVT_IS_INCOMINGMSG (evt))
+    indexed = __osip_transaction_index_find (index, evt, consume, &transaction);
+  if (indexed == OSIP_SUCCESS && transaction != NULL)
+    return transaction;
+
 #ifndef OSIP_MONOTHREAD
   osip_mutex_lock (mut);
 #endif
-  transaction = osip_transaction_find (transactions, evt);
+  /* a transaction created meanwhile is not found, as before */
+  if (indexed == OSIP_SUCCESS && index->legacy <= 0)
+    transaction = NULL;
+  else
+    transaction = __osip_transaction_list_find (transactions, evt);
   if (consume == 1) {           /* we add the event before releasing the mutex!! */
     if (transaction != NULL) {
       osip_transaction_add_event (transaction, evt);
@@ -850,13 +2310,13 @@ osip_create_transaction (osip_t * osip, osip_event_t * evt)
 
   if (EVT_IS_INCOMINGREQ (evt)) {
     /* we create a new context for this incoming request */
-    if (0 == strcmp (evt->sip->cseq->method, "INVITE"))
+    if (__osip_cseq_is_method (evt->sip->cseq, OSIP_METHOD_INVITE, "INVITE"))
       ctx_type = IST;
     else
       ctx_type = NIST;
   }
   else if (EVT_IS_OUTGOINGREQ (evt)) {
-    if (0 == strcmp (evt->sip->cseq->method, "INVITE"))
+    if (__osip_cseq_is_method (evt->sip->cseq, OSIP_METHOD_INVITE, "INVITE"))
       ctx_type = ICT;
     else
       ctx_type = NICT;
@@ -877,44 +2337,30 @@ osip_create_transaction (osip_t * osip, osip_event_t * evt)
 osip_transaction_t *
 osip_transaction_find (osip_list_t * transactions, osip_event_t * evt)
 {
-  osip_list_iterator_t iterator;
   osip_transaction_t *transaction;
+  struct osip_transaction_index *index;
   osip_t *osip = NULL;
 
-  transaction = (osip_transaction_t *) osip_list_get_first (transactions, &iterator);
+  transaction = (osip_transaction_t *) osip_list_get (transactions, 0);
   if (transaction != NULL)
     osip = (osip_t *) transaction->config;
   if (osip == NULL)
     return NULL;
 
-  if (EVT_IS_INCOMINGREQ (evt)) {
-#ifdef HAVE_DICT_DICT_H
-    /* search in hastable! */
-    osip_generic_param_t *b_request;
-    osip_via_t *topvia_request;
-
-    topvia_request = osip_list_get (&evt->sip->vias, 0);
-    if (topvia_request == NULL) {
-      OSIP_TRACE (osip_trace (__FILE__, __LINE__, OSIP_ERROR, NULL, "Remote UA is not compliant: missing a Via header!\n"));
-      return NULL;
-    }
-    osip_via_param_get_byname (topvia_request, "branch", &b_request);
-    if (b_request != NULL && b_request->gvalue != NULL) {
-      if (MSG_IS_INVITE (evt->sip) || MSG_IS_ACK (evt->sip)) {
-        transaction = (osip_transaction_t *) dict_search (osip->osip_ist_hastable, b_request->gvalue);
-        OSIP_TRACE (osip_trace (__FILE__, __LINE__, OSIP_INFO2, NULL, "Find matching Via header for INVITE(ACK) REQUEST!\n"));
-        if (transaction != NULL)
-          return transaction;
-      }
-      else {
-        transaction = (osip_transaction_t *) dict_search (osip->osip_nist_hastable, b_request->gvalue);
-        OSIP_TRACE (osip_trace (__FILE__, __LINE__, OSIP_INFO2, NULL, "Find matching Via header for NON-INVITE REQUEST!\n"));
-        if (transaction != NULL)
-          return transaction;
-      }
-    }
-#endif
+  /* the lock of the list is held by the caller */
+  index = __osip_transaction_index_of (osip, transactions);
+  if (EVT_IS_INCOMINGMSG (evt) && __osip_transaction_index_find (index, evt, 0, &transaction) == OSIP_SUCCESS && (transaction != NULL || index->legacy <= 0))
+    return transaction;
+  return __osip_transaction_list_find (transactions, evt);
+}
+
+static osip_transaction_t *
+__osip_transaction_list_find (osip_list_t * transactions, osip_event_t * evt)
+{
+  osip_list_iterator_t iterator;
+  osip_transaction_t *transaction;
 
+  if (EVT_IS_INCOMINGREQ (evt)) {
     transaction = (osip_transaction_t *) osip_list_get_first (transactions, &iterator);
     while (osip_list_iterator_has_elem (iterator)) {
       if (0 == __osip_transaction_matching_request_osip_to_xist_17_2_3 (transaction, evt->sip))
@@ -923,33 +2369,6 @@ osip_transaction_find (osip_list_t * transactions, osip_event_t * evt)
     }
   }
   else if (EVT_IS_INCOMINGRESP (evt)) {
-#ifdef HAVE_DICT_DICT_H
-    /* search in hastable! */
-    osip_generic_param_t *b_request;
-    osip_via_t *topvia_request;
-
-    topvia_request = osip_list_get (&evt->sip->vias, 0);
-    if (topvia_request == NULL) {
-      OSIP_TRACE (osip_trace (__FILE__, __LINE__, OSIP_ERROR, NULL, "Remote UA is not compliant: missing a Via header!\n"));
-      return NULL;
-    }
-    osip_via_param_get_byname (topvia_request, "branch", &b_request);
-    if (b_request != NULL && b_request->gvalue != NULL) {
-      if (MSG_IS_RESPONSE_FOR (evt->sip, "INVITE")) {
-        transaction = (osip_transaction_t *) dict_search (osip->osip_ict_hastable, b_request->gvalue);
-        OSIP_TRACE (osip_trace (__FILE__, __LINE__, OSIP_INFO2, NULL, "Find matching Via header for INVITE ANSWER!\n"));
-        if (transaction != NULL)
-          return transaction;
-      }
-      else {
-        transaction = (osip_transaction_t *) dict_search (osip->osip_nict_hastable, b_request->gvalue);
-        OSIP_TRACE (osip_trace (__FILE__, __LINE__, OSIP_INFO2, NULL, "Find matching Via header for NON-INVITE ANSWER!\n"));
-        if (transaction != NULL)
-          return transaction;
-      }
-    }
-#endif
-
     transaction = (osip_transaction_t *) osip_list_get_first (transactions, &iterator);
     while (osip_list_iterator_has_elem (iterator)) {
       if (0 == __osip_transaction_matching_response_osip_to_xict_17_1_3 (transaction, evt->sip))
@@ -979,6 +2398,8 @@ osip_init (osip_t ** osip)
     /* load the parser configuration */
     parser_init ();
   }
+  if (__osip_dns_cache_init () != OSIP_SUCCESS)
+    return OSIP_NOMEM;
 
   *osip = (osip_t *) osip_malloc (sizeof (osip_t));
   if (*osip == NULL)
@@ -1000,16 +2421,24 @@ osip_init (osip_t ** osip)
   osip_list_init (&(*osip)->osip_ist_transactions);
   osip_list_init (&(*osip)->osip_nict_transactions);
   osip_list_init (&(*osip)->osip_nist_transactions);
-  osip_list_init (&(*osip)->ixt_retransmissions);
+#ifndef OSIP_LIST_ARRAY
+  (*osip)->ict_tail = &(*osip)->osip_ict_transactions.node;
+  (*osip)->ist_tail = &(*osip)->osip_ist_transactions.node;
+  (*osip)->nict_tail = &(*osip)->osip_nict_transactions.node;
+  (*osip)->nist_tail = &(*osip)->osip_nist_transactions.node;
+#endif
 
   (*osip)->transactionid = 1;
 
-#if defined(HAVE_DICT_DICT_H)
-  (*osip)->osip_ict_hastable = hashtable_dict_new ((dict_cmp_func) strcmp, (dict_hsh_func) s_hash, NULL, NULL, HSIZE);
-  (*osip)->osip_ist_hastable = hashtable_dict_new ((dict_cmp_func) strcmp, (dict_hsh_func) s_hash, NULL, NULL, HSIZE);
-  (*osip)->osip_nict_hastable = hashtable_dict_new ((dict_cmp_func) strcmp, (dict_hsh_func) s_hash, NULL, NULL, HSIZE);
-  (*osip)->osip_nist_hastable = hashtable_dict_new ((dict_cmp_func) strcmp, (dict_hsh_func) s_hash, NULL, NULL, HSIZE);
-#endif
+  if (__osip_timer_wheel_init (&(*osip)->ict_timers) != OSIP_SUCCESS || __osip_timer_wheel_init (&(*osip)->ist_timers) != OSIP_SUCCESS || __osip_timer_wheel_init (&(*osip)->nict_timers) != OSIP_SUCCESS || __osip_timer_wheel_init (&(*osip)->nist_timers) != OSIP_SUCCESS
+      || __osip_transaction_index_init (&(*osip)->ict_index, 0) != OSIP_SUCCESS || __osip_transaction_index_init (&(*osip)->ist_index, 1) != OSIP_SUCCESS || __osip_transaction_index_init (&(*osip)->nict_index, 0) != OSIP_SUCCESS || __osip_transaction_index_init (&(*osip)->nist_index, 1) != OSIP_SUCCESS
+      || __osip_ready_queue_init (&(*osip)->ict_ready) != OSIP_SUCCESS || __osip_ready_queue_init (&(*osip)->ist_ready) != OSIP_SUCCESS || __osip_ready_queue_init (&(*osip)->nict_ready) != OSIP_SUCCESS || __osip_ready_queue_init (&(*osip)->nist_ready) != OSIP_SUCCESS
+      || __osip_ixt_table_init (&(*osip)->ixt_table) != OSIP_SUCCESS || __osip_send_batch_init (&(*osip)->send_batch) != OSIP_SUCCESS
+      || __osip_transaction_pool_init (&(*osip)->transaction_pool) != OSIP_SUCCESS || __osip_transaction_index_init (&(*osip)->ids, 0) != OSIP_SUCCESS) {
+    osip_release (*osip);
+    *osip = NULL;
+    return OSIP_NOMEM;
+  }
 
   return OSIP_SUCCESS;
 }
@@ -1018,6 +2447,9 @@ void
 osip_release (osip_t * osip)
 {
 #ifndef OSIP_MONOTHREAD
+  if (osip->executor != NULL)
+    osip_executor_stop (osip);
+
   osip_mutex_destroy (osip->ict_fastmutex);
   osip_mutex_destroy (osip->ist_fastmutex);
   osip_mutex_destroy (osip->nict_fastmutex);
@@ -1027,6 +2459,42 @@ osip_release (osip_t * osip)
   osip_mutex_destroy (osip->id_mutex);
 #endif
 
+  __osip_timer_wheel_free (osip->ict_timers);
+  __osip_timer_wheel_free (osip->ist_timers);
+  __osip_timer_wheel_free (osip->nict_timers);
+  __osip_timer_wheel_free (osip->nist_timers);
+
+  __osip_transaction_index_free (osip->ict_index);
+  __osip_transaction_index_free (osip->ist_index);
+  __osip_transaction_index_free (osip->nict_index);
+  __osip_transaction_index_free (osip->nist_index);
+  __osip_transaction_index_free (osip->ids);
+
+  __osip_ready_queue_free (osip->ict_ready);
+  __osip_ready_queue_free (osip->ist_ready);
+  __osip_ready_queue_free (osip->nict_ready);
+  __osip_ready_queue_free (osip->nist_ready);
+
+  if (osip->ixt_table != NULL) {
+    unsigned int i;
+
+    for (i = 0; i < osip->ixt_table->size; i++) {
+      while (osip->ixt_table->by_dialog[i] != NULL) {
+        ixt_t *ixt = osip->ixt_table->by_dialog[i];
+
+        osip->ixt_table->by_dialog[i] = ixt->next_by_dialog;
+        ixt_free (ixt);
+      }
+    }
+    __osip_ixt_table_free (osip->ixt_table);
+  }
+
+  __osip_send_batch_free (osip->send_batch);
+  __osip_transaction_pool_free (osip->transaction_pool);
+#ifdef OSIP_WAKEUP
+  __osip_wakeup_free (osip->wakeup);
+#endif
+
   osip_free (osip);
 }
 
@@ -1044,274 +2512,61 @@ osip_get_application_context (osip_t * osip)
   return osip->application_context;
 }
 
-int
-osip_ict_execute (osip_t * osip)
-{
-  osip_transaction_t *transaction;
-  osip_event_t *se;
-  int more_event;
-  osip_list_iterator_t iterator;
-  void **array;
-  int len;
-  int index = 0;
-
-  /* list must be copied because osip_transaction_execute() may change it */
-#ifndef OSIP_MONOTHREAD
-  osip_mutex_lock (osip->ict_fastmutex);
-#endif
-  len = osip_list_size (&osip->osip_ict_transactions);
-  if (0 >= len) {
-#ifndef OSIP_MONOTHREAD
-    osip_mutex_unlock (osip->ict_fastmutex);
-#endif
-    return OSIP_SUCCESS;
-  }
-  array = osip_malloc (sizeof (void *) * len);
-  if (array == NULL) {
-#ifndef OSIP_MONOTHREAD
-    osip_mutex_unlock (osip->ict_fastmutex);
-#endif
-    return OSIP_NOMEM;          /* OSIP_SUCCESS; */
-  }
-  transaction = (osip_transaction_t *) osip_list_get_first (&osip->osip_ict_transactions, &iterator);
-  while (osip_list_iterator_has_elem (iterator)) {
-    array[index++] = transaction;
-    transaction = (osip_transaction_t *) osip_list_get_next (&iterator);
-  }
-#ifndef OSIP_MONOTHREAD
-  osip_mutex_unlock (osip->ict_fastmutex);
-#endif
-
-  for (index = 0; index < len; ++index) {
-    transaction = (osip_transaction_t *) array[index];
-    more_event = 1;
-    do {
-      se = (osip_event_t *) osip_fifo_tryget (transaction->transactionff);
-      if (se == NULL)           /* no more event for this transaction */
-        more_event = 0;
-      else
-        osip_transaction_execute (transaction, se);
-    }
-    while (more_event == 1);
-  }
-
-  osip_free (array);
-
-  return OSIP_SUCCESS;
-}
-
-int
-osip_ist_execute (osip_t * osip)
-{
-  osip_transaction_t *transaction;
-  osip_event_t *se;
-  int more_event;
-  osip_list_iterator_t iterator;
-  void **array;
-  int len;
-  int index = 0;
-
-  /* list must be copied because osip_transaction_execute() may change it */
-#ifndef OSIP_MONOTHREAD
-  osip_mutex_lock (osip->ist_fastmutex);
-#endif
-  len = osip_list_size (&osip->osip_ist_transactions);
-  if (0 >= len) {
-#ifndef OSIP_MONOTHREAD
-    osip_mutex_unlock (osip->ist_fastmutex);
-#endif
-    return OSIP_SUCCESS;
-  }
-  array = osip_malloc (sizeof (void *) * len);
-  if (array == NULL) {
-#ifndef OSIP_MONOTHREAD
-    osip_mutex_unlock (osip->ist_fastmutex);
-#endif
-    return OSIP_NOMEM;          /* OSIP_SUCCESS; */
-  }
-  transaction = (osip_transaction_t *) osip_list_get_first (&osip->osip_ist_transactions, &iterator);
-  while (osip_list_iterator_has_elem (iterator)) {
-    array[index++] = transaction;
-    transaction = (osip_transaction_t *) osip_list_get_next (&iterator);
-  }
-#ifndef OSIP_MONOTHREAD
-  osip_mutex_unlock (osip->ist_fastmutex);
-#endif
-
-  for (index = 0; index < len; ++index) {
-    transaction = (osip_transaction_t *) array[index];
-    more_event = 1;
-    do {
-      se = (osip_event_t *) osip_fifo_tryget (transaction->transactionff);
-      if (se == NULL)           /* no more event for this transaction */
-        more_event = 0;
-      else
-        osip_transaction_execute (transaction, se);
-    }
-    while (more_event == 1);
-
-  }
-
-  osip_free (array);
+int
+osip_ict_execute (osip_t * osip)
+{
+  int i;
 
-  return OSIP_SUCCESS;
+  i = __osip_ready_queue_execute (osip->ict_ready);
+  osip_send_batch_flush (osip);
+  return i;
 }
 
 int
-osip_nict_execute (osip_t * osip)
+osip_ist_execute (osip_t * osip)
 {
-  osip_transaction_t *transaction;
-  osip_event_t *se;
-  int more_event;
-  osip_list_iterator_t iterator;
-  void **array;
-  int len;
-  int index = 0;
-
-  /* list must be copied because osip_transaction_execute() may change it */
-#ifndef OSIP_MONOTHREAD
-  osip_mutex_lock (osip->nict_fastmutex);
-#endif
-  len = osip_list_size (&osip->osip_nict_transactions);
-  if (0 >= len) {
-#ifndef OSIP_MONOTHREAD
-    osip_mutex_unlock (osip->nict_fastmutex);
-#endif
-    return OSIP_SUCCESS;
-  }
-  array = osip_malloc (sizeof (void *) * len);
-  if (array == NULL) {
-#ifndef OSIP_MONOTHREAD
-    osip_mutex_unlock (osip->nict_fastmutex);
-#endif
-    return OSIP_NOMEM;          /* OSIP_SUCCESS; */
-  }
-  transaction = (osip_transaction_t *) osip_list_get_first (&osip->osip_nict_transactions, &iterator);
-  while (osip_list_iterator_has_elem (iterator)) {
-    array[index++] = transaction;
-    transaction = (osip_transaction_t *) osip_list_get_next (&iterator);
-  }
-#ifndef OSIP_MONOTHREAD
-  osip_mutex_unlock (osip->nict_fastmutex);
-#endif
+  int i;
 
-  for (index = 0; index < len; ++index) {
-    transaction = (osip_transaction_t *) array[index];
-    more_event = 1;
-    do {
-      se = (osip_event_t *) osip_fifo_tryget (transaction->transactionff);
-      if (se == NULL)           /* no more event for this transaction */
-        more_event = 0;
-      else
-        osip_transaction_execute (transaction, se);
-    }
-    while (more_event == 1);
-  }
+  i = __osip_ready_queue_execute (osip->ist_ready);
+  osip_send_batch_flush (osip);
+  return i;
+}
 
-  osip_free (array);
+int
+osip_nict_execute (osip_t * osip)
+{
+  int i;
 
-  return OSIP_SUCCESS;
+  i = __osip_ready_queue_execute (osip->nict_ready);
+  osip_send_batch_flush (osip);
+  return i;
 }
 
 int
 osip_nist_execute (osip_t * osip)
 {
-  osip_transaction_t *transaction;
-  osip_event_t *se;
-  int more_event;
-  osip_list_iterator_t iterator;
-  void **array;
-  int len;
-  int index = 0;
-
-  /* list must be copied because osip_transaction_execute() may change it */
-#ifndef OSIP_MONOTHREAD
-  osip_mutex_lock (osip->nist_fastmutex);
-#endif
-  len = osip_list_size (&osip->osip_nist_transactions);
-  if (0 >= len) {
-#ifndef OSIP_MONOTHREAD
-    osip_mutex_unlock (osip->nist_fastmutex);
-#endif
-    return OSIP_SUCCESS;
-  }
-  array = osip_malloc (sizeof (void *) * len);
-  if (array == NULL) {
-#ifndef OSIP_MONOTHREAD
-    osip_mutex_unlock (osip->nist_fastmutex);
-#endif
-    return OSIP_NOMEM;          /* OSIP_SUCCESS; */
-  }
-  transaction = (osip_transaction_t *) osip_list_get_first (&osip->osip_nist_transactions, &iterator);
-  while (osip_list_iterator_has_elem (iterator)) {
-    array[index++] = transaction;
-    transaction = (osip_transaction_t *) osip_list_get_next (&iterator);
-  }
-#ifndef OSIP_MONOTHREAD
-  osip_mutex_unlock (osip->nist_fastmutex);
-#endif
-
-  for (index = 0; index < len; ++index) {
-    transaction = (osip_transaction_t *) array[index];
-    more_event = 1;
-    do {
-      se = (osip_event_t *) osip_fifo_tryget (transaction->transactionff);
-      if (se == NULL)           /* no more event for this transaction */
-        more_event = 0;
-      else
-        osip_transaction_execute (transaction, se);
-    }
-    while (more_event == 1);
-  }
-
-  osip_free (array);
+  int i;
 
-  return OSIP_SUCCESS;
+  i = __osip_ready_queue_execute (osip->nist_ready);
+  osip_send_batch_flush (osip);
+  return i;
 }
 
-void
-osip_timers_gettimeout (osip_t * osip, struct timeval *lower_tv)
+/* earliest deadline of the timers of transactions and of the ixt */
+static int
+__osip_timers_next (osip_t * osip, const struct timeval *now, struct timeval *lower_tv)
 {
-  struct timeval now;
-  osip_transaction_t *tr;
-  osip_list_iterator_t iterator;
-
-  osip_gettimeofday (&now, NULL);
-  lower_tv->tv_sec = now.tv_sec + 3600 * 24 * 365;      /* wake up evry year :-) */
-  lower_tv->tv_usec = now.tv_usec;
+  struct timeval deadline;
+  int found = 0;
 
+  /* next expiration of ict, ist, nict and nist timers */
 #ifndef OSIP_MONOTHREAD
   osip_mutex_lock (osip->ict_fastmutex);
 #endif
-  /* handle ict timers */
-  tr = (osip_transaction_t *) osip_list_get_first (&osip->osip_ict_transactions, &iterator);
-  while (osip_list_iterator_has_elem (iterator)) {
-    if (1 <= osip_fifo_size (tr->transactionff)) {
-      OSIP_TRACE (osip_trace (__FILE__, __LINE__, OSIP_INFO4, NULL, "1 Pending event already in transaction !\n"));
-      lower_tv->tv_sec = 0;
-      lower_tv->tv_usec = 0;
-#ifndef OSIP_MONOTHREAD
-      osip_mutex_unlock (osip->ict_fastmutex);
-#endif
-      return;
-    }
-    else {
-      if (tr->state == ICT_CALLING)
-        min_timercmp (lower_tv, &tr->ict_context->timer_b_start);
-      if (tr->state == ICT_CALLING)
-        min_timercmp (lower_tv, &tr->ict_context->timer_a_start);
-      if (tr->state == ICT_COMPLETED)
-        min_timercmp (lower_tv, &tr->ict_context->timer_d_start);
-      if (osip_timercmp (&now, lower_tv, >)) {
-        lower_tv->tv_sec = 0;
-        lower_tv->tv_usec = 0;
-#ifndef OSIP_MONOTHREAD
-        osip_mutex_unlock (osip->ict_fastmutex);
-#endif
-        return;
-      }
-    }
-    tr = (osip_transaction_t *) osip_list_get_next (&iterator);
+  if (__osip_timer_wheel_next (osip->ict_timers, now, &deadline) == OSIP_SUCCESS) {
+    if (found++ == 0)
+      *lower_tv = deadline;
+    min_timercmp (lower_tv, &deadline);
   }
 #ifndef OSIP_MONOTHREAD
   osip_mutex_unlock (osip->ict_fastmutex);
@@ -1320,24 +2575,10 @@ osip_timers_gettimeout (osip_t * osip, struct timeval *lower_tv)
 #ifndef OSIP_MONOTHREAD
   osip_mutex_lock (osip->ist_fastmutex);
 #endif
-  /* handle ist timers */
-  tr = (osip_transaction_t *) osip_list_get_first (&osip->osip_ist_transactions, &iterator);
-  while (osip_list_iterator_has_elem (iterator)) {
-    if (tr->state == IST_CONFIRMED)
-      min_timercmp (lower_tv, &tr->ist_context->timer_i_start);
-    if (tr->state == IST_COMPLETED)
-      min_timercmp (lower_tv, &tr->ist_context->timer_h_start);
-    if (tr->state == IST_COMPLETED)
-      min_timercmp (lower_tv, &tr->ist_context->timer_g_start);
-    if (osip_timercmp (&now, lower_tv, >)) {
-      lower_tv->tv_sec = 0;
-      lower_tv->tv_usec = 0;
-#ifndef OSIP_MONOTHREAD
-      osip_mutex_unlock (osip->ist_fastmutex);
-#endif
-      return;
-    }
-    tr = (osip_transaction_t *) osip_list_get_next (&iterator);
+  if (__osip_timer_wheel_next (osip->ist_timers, now, &deadline) == OSIP_SUCCESS) {
+    if (found++ == 0)
+      *lower_tv = deadline;
+    min_timercmp (lower_tv, &deadline);
   }
 #ifndef OSIP_MONOTHREAD
   osip_mutex_unlock (osip->ist_fastmutex);
@@ -1346,24 +2587,10 @@ osip_timers_gettimeout (osip_t * osip, struct timeval *lower_tv)
 #ifndef OSIP_MONOTHREAD
   osip_mutex_lock (osip->nict_fastmutex);
 #endif
-  /* handle nict timers */
-  tr = (osip_transaction_t *) osip_list_get_first (&osip->osip_nict_transactions, &iterator);
-  while (osip_list_iterator_has_elem (iterator)) {
-    if (tr->state == NICT_COMPLETED)
-      min_timercmp (lower_tv, &tr->nict_context->timer_k_start);
-    if (tr->state == NICT_PROCEEDING || tr->state == NICT_TRYING)
-      min_timercmp (lower_tv, &tr->nict_context->timer_f_start);
-    if (tr->state == NICT_PROCEEDING || tr->state == NICT_TRYING)
-      min_timercmp (lower_tv, &tr->nict_context->timer_e_start);
-    if (osip_timercmp (&now, lower_tv, >)) {
-      lower_tv->tv_sec = 0;
-      lower_tv->tv_usec = 0;
-#ifndef OSIP_MONOTHREAD
-      osip_mutex_unlock (osip->nict_fastmutex);
-#endif
-      return;
-    }
-    tr = (osip_transaction_t *) osip_list_get_next (&iterator);
+  if (__osip_timer_wheel_next (osip->nict_timers, now, &deadline) == OSIP_SUCCESS) {
+    if (found++ == 0)
+      *lower_tv = deadline;
+    min_timercmp (lower_tv, &deadline);
   }
 #ifndef OSIP_MONOTHREAD
   osip_mutex_unlock (osip->nict_fastmutex);
@@ -1372,49 +2599,38 @@ osip_timers_gettimeout (osip_t * osip, struct timeval *lower_tv)
 #ifndef OSIP_MONOTHREAD
   osip_mutex_lock (osip->nist_fastmutex);
 #endif
-  /* handle nist timers */
-  tr = (osip_transaction_t *) osip_list_get_first (&osip->osip_nist_transactions, &iterator);
-  while (osip_list_iterator_has_elem (iterator)) {
-    if (tr->state == NIST_COMPLETED)
-      min_timercmp (lower_tv, &tr->nist_context->timer_j_start);
-    if (osip_timercmp (&now, lower_tv, >)) {
-      lower_tv->tv_sec = 0;
-      lower_tv->tv_usec = 0;
-#ifndef OSIP_MONOTHREAD
-      osip_mutex_unlock (osip->nist_fastmutex);
-#endif
-      return;
-    }
-    tr = (osip_transaction_t *) osip_list_get_next (&iterator);
+  if (__osip_timer_wheel_next (osip->nist_timers, now, &deadline) == OSIP_SUCCESS) {
+    if (found++ == 0)
+      *lower_tv = deadline;
+    min_timercmp (lower_tv, &deadline);
   }
 #ifndef OSIP_MONOTHREAD
   osip_mutex_unlock (osip->nist_fastmutex);
 #endif
 
-#ifndef OSIP_MONOTHREAD
-  osip_mutex_lock (osip->ixt_fastmutex);
-#endif
-  {
-    ixt_t *ixt;
+  osip_ixt_lock (osip);
+  if (__osip_timer_wheel_next (osip->ixt_table->timers, now, &deadline) == OSIP_SUCCESS) {
+    if (found++ == 0)
+      *lower_tv = deadline;
+    min_timercmp (lower_tv, &deadline);
+  }
+  osip_ixt_unlock (osip);
 
-    ixt = (ixt_t *) osip_list_get_first (&osip->ixt_retransmissions, &iterator);
-    while (osip_list_iterator_has_elem (iterator)) {
-      min_timercmp (lower_tv, &ixt->start);
-      if (osip_timercmp (&now, lower_tv, >)) {
-        lower_tv->tv_sec = 0;
-        lower_tv->tv_usec = 0;
-#ifndef OSIP_MONOTHREAD
-        osip_mutex_unlock (osip->ixt_fastmutex);
-#endif
-        return;
-      }
+  if (found == 0)
+    return OSIP_NOTFOUND;
+  return OSIP_SUCCESS;
+}
 
-      ixt = (ixt_t *) osip_list_get_next (&iterator);
-    }
+void
+osip_timers_gettimeout (osip_t * osip, struct timeval *lower_tv)
+{
+  struct timeval now;
+
+  osip_gettimeofday (&now, NULL);
+  if (__osip_timers_next (osip, &now, lower_tv) != OSIP_SUCCESS) {
+    lower_tv->tv_sec = now.tv_sec + 3600 * 24 * 365;    /* wake up evry year :-) */
+    lower_tv->tv_usec = now.tv_usec;
   }
-#ifndef OSIP_MONOTHREAD
-  osip_mutex_unlock (osip->ixt_fastmutex);
-#endif
 
   lower_tv->tv_sec = lower_tv->tv_sec - now.tv_sec;
   lower_tv->tv_usec = lower_tv->tv_usec - now.tv_usec;
@@ -1435,136 +2651,253 @@ osip_timers_gettimeout (osip_t * osip, struct timeval *lower_tv)
   return;
 }
 
+#ifdef OSIP_WAKEUP
+
+/* timers were executed: arm the timerfd on the next deadline */
+static void
+__osip_wakeup_rearm (osip_t * osip)
+{
+  struct osip_wakeup *wakeup = osip->wakeup;
+  struct timeval now;
+  struct timeval deadline;
+  int i;
+
+  if (wakeup == NULL || wakeup->timer_fd < 0)
+    return;
+  osip_gettimeofday (&now, NULL);
+  i = __osip_timers_next (osip, &now, &deadline);
+#ifndef OSIP_MONOTHREAD
+  osip_mutex_lock (wakeup->mutex);
+#endif
+  /* a timer added meanwhile may have armed it earlier */
+  if (wakeup->deadline.tv_sec == -1 || !osip_timercmp (&now, &wakeup->deadline, <)) {
+    if (i == OSIP_SUCCESS)
+      __osip_wakeup_arm (wakeup, &now, &deadline);
+    else {
+      struct itimerspec its;
+
+      memset (&its, 0, sizeof (its));
+      timerfd_settime (wakeup->timer_fd, 0, &its, NULL);
+      wakeup->deadline.tv_sec = -1;
+    }
+  }
+  else if (i == OSIP_SUCCESS && osip_timercmp (&deadline, &wakeup->deadline, <))
+    __osip_wakeup_arm (wakeup, &now, &deadline);
+#ifndef OSIP_MONOTHREAD
+  osip_mutex_unlock (wakeup->mutex);
+#endif
+}
+
+int
+osip_get_wakeup_fd (osip_t * osip)
+{
+  struct osip_wakeup *wakeup;
+
+  if (osip == NULL)
+    return OSIP_BADPARAMETER;
+  wakeup = __osip_wakeup_get (osip);
+  if (wakeup == NULL)
+    return OSIP_NOMEM;
+  if (wakeup->event_fd < 0)
+    return OSIP_UNDEFINED_ERROR;
+  return wakeup->event_fd;
+}
+
+int
+osip_get_timer_fd (osip_t * osip)
+{
+  struct osip_wakeup *wakeup;
+
+  if (osip == NULL)
+    return OSIP_BADPARAMETER;
+  wakeup = __osip_wakeup_get (osip);
+  if (wakeup == NULL)
+    return OSIP_NOMEM;
+  if (wakeup->timer_fd < 0)
+    return OSIP_UNDEFINED_ERROR;
+  __osip_wakeup_rearm (osip);   /* timers added before */
+  return wakeup->timer_fd;
+}
+
+int
+osip_wakeup_clear (osip_t * osip)
+{
+  struct osip_wakeup *wakeup;
+  uint64_t count;
+
+  if (osip == NULL)
+    return OSIP_BADPARAMETER;
+  wakeup = osip->wakeup;
+  if (wakeup == NULL)
+    return OSIP_WRONG_STATE;
+#ifndef OSIP_MONOTHREAD
+  osip_mutex_lock (wakeup->mutex);
+#endif
+  if (wakeup->event_fd >= 0 && read (wakeup->event_fd, &count, sizeof (count)) == sizeof (count))
+    wakeup->signalled = 0;
+  if (wakeup->timer_fd >= 0 && read (wakeup->timer_fd, &count, sizeof (count)) == sizeof (count))
+    wakeup->deadline.tv_sec = -1;
+#ifndef OSIP_MONOTHREAD
+  osip_mutex_unlock (wakeup->mutex);
+#endif
+  return OSIP_SUCCESS;
+}
+
+#else
+
+int
+osip_get_wakeup_fd (osip_t * osip)
+{
+  return OSIP_UNDEFINED_ERROR;
+}
+
+int
+osip_get_timer_fd (osip_t * osip)
+{
+  return OSIP_UNDEFINED_ERROR;
+}
+
+int
+osip_wakeup_clear (osip_t * osip)
+{
+  return OSIP_UNDEFINED_ERROR;
+}
+
+#endif
+
 void
 osip_timers_ict_execute (osip_t * osip)
 {
-  osip_transaction_t *tr;
-  osip_list_iterator_t iterator;
+  osip_timer_entry_t expired;
+  osip_timer_entry_t *entry;
+  struct timeval now;
 
+  osip_gettimeofday (&now, NULL);
 #ifndef OSIP_MONOTHREAD
   osip_mutex_lock (osip->ict_fastmutex);
 #endif
   /* handle ict timers */
-  tr = (osip_transaction_t *) osip_list_get_first (&osip->osip_ict_transactions, &iterator);
-  while (osip_list_iterator_has_elem (iterator)) {
-    osip_event_t *evt;
+  __osip_timer_wheel_expire (osip->ict_timers, &now, &expired);
+  while ((entry = __osip_timer_wheel_pop (&expired)) != NULL) {
+    osip_transaction_t *tr = (osip_transaction_t *) entry->data;
+    osip_event_t *evt = NULL;
 
     if (1 <= osip_fifo_size (tr->transactionff)) {
       OSIP_TRACE (osip_trace (__FILE__, __LINE__, OSIP_INFO4, NULL, "1 Pending event already in transaction !\n"));
     }
     else {
       evt = __osip_ict_need_timer_b_event (tr->ict_context, tr->state, tr->transactionid);
-      if (evt != NULL)
-        osip_fifo_add (tr->transactionff, evt);
-      else {
+      if (evt == NULL)
         evt = __osip_ict_need_timer_a_event (tr->ict_context, tr->state, tr->transactionid);
-        if (evt != NULL)
-          osip_fifo_add (tr->transactionff, evt);
-        else {
-          evt = __osip_ict_need_timer_d_event (tr->ict_context, tr->state, tr->transactionid);
-          if (evt != NULL)
-            osip_fifo_add (tr->transactionff, evt);
-        }
-      }
+      if (evt == NULL)
+        evt = __osip_ict_need_timer_d_event (tr->ict_context, tr->state, tr->transactionid);
     }
-    tr = (osip_transaction_t *) osip_list_get_next (&iterator);
+    /* the state machine re-arms the timers when the event is processed */
+    if (evt != NULL)
+      osip_transaction_add_event (tr, evt);
+    else
+      __osip_transaction_arm_timers (tr);
   }
 #ifndef OSIP_MONOTHREAD
   osip_mutex_unlock (osip->ict_fastmutex);
 #endif
+  __osip_wakeup_rearm (osip);
 }
 
 void
 osip_timers_ist_execute (osip_t * osip)
 {
-  osip_transaction_t *tr;
-  osip_list_iterator_t iterator;
+  osip_timer_entry_t expired;
+  osip_timer_entry_t *entry;
+  struct timeval now;
 
+  osip_gettimeofday (&now, NULL);
 #ifndef OSIP_MONOTHREAD
   osip_mutex_lock (osip->ist_fastmutex);
 #endif
   /* handle ist timers */
-  tr = (osip_transaction_t *) osip_list_get_first (&osip->osip_ist_transactions, &iterator);
-  while (osip_list_iterator_has_elem (iterator)) {
+  __osip_timer_wheel_expire (osip->ist_timers, &now, &expired);
+  while ((entry = __osip_timer_wheel_pop (&expired)) != NULL) {
+    osip_transaction_t *tr = (osip_transaction_t *) entry->data;
     osip_event_t *evt;
 
     evt = __osip_ist_need_timer_i_event (tr->ist_context, tr->state, tr->transactionid);
-    if (evt != NULL)
-      osip_fifo_add (tr->transactionff, evt);
-    else {
+    if (evt == NULL)
       evt = __osip_ist_need_timer_h_event (tr->ist_context, tr->state, tr->transactionid);
-      if (evt != NULL)
-        osip_fifo_add (tr->transactionff, evt);
-      else {
-        evt = __osip_ist_need_timer_g_event (tr->ist_context, tr->state, tr->transactionid);
-        if (evt != NULL)
-          osip_fifo_add (tr->transactionff, evt);
-      }
-    }
-    tr = (osip_transaction_t *) osip_list_get_next (&iterator);
+    if (evt == NULL)
+      evt = __osip_ist_need_timer_g_event (tr->ist_context, tr->state, tr->transactionid);
+    if (evt != NULL)
+      osip_transaction_add_event (tr, evt);
+    else
+      __osip_transaction_arm_timers (tr);
   }
 #ifndef OSIP_MONOTHREAD
   osip_mutex_unlock (osip->ist_fastmutex);
 #endif
+  __osip_wakeup_rearm (osip);
 }
 
 void
 osip_timers_nict_execute (osip_t * osip)
 {
-  osip_transaction_t *tr;
-  osip_list_iterator_t iterator;
+  osip_timer_entry_t expired;
+  osip_timer_entry_t *entry;
+  struct timeval now;
 
+  osip_gettimeofday (&now, NULL);
 #ifndef OSIP_MONOTHREAD
   osip_mutex_lock (osip->nict_fastmutex);
 #endif
   /* handle nict timers */
-  tr = (osip_transaction_t *) osip_list_get_first (&osip->osip_nict_transactions, &iterator);
-  while (osip_list_iterator_has_elem (iterator)) {
+  __osip_timer_wheel_expire (osip->nict_timers, &now, &expired);
+  while ((entry = __osip_timer_wheel_pop (&expired)) != NULL) {
+    osip_transaction_t *tr = (osip_transaction_t *) entry->data;
     osip_event_t *evt;
 
     evt = __osip_nict_need_timer_k_event (tr->nict_context, tr->state, tr->transactionid);
-    if (evt != NULL)
-      osip_fifo_add (tr->transactionff, evt);
-    else {
+    if (evt == NULL)
       evt = __osip_nict_need_timer_f_event (tr->nict_context, tr->state, tr->transactionid);
-      if (evt != NULL)
-        osip_fifo_add (tr->transactionff, evt);
-      else {
-        evt = __osip_nict_need_timer_e_event (tr->nict_context, tr->state, tr->transactionid);
-        if (evt != NULL)
-          osip_fifo_add (tr->transactionff, evt);
-      }
-    }
-    tr = (osip_transaction_t *) osip_list_get_next (&iterator);
+    if (evt == NULL)
+      evt = __osip_nict_need_timer_e_event (tr->nict_context, tr->state, tr->transactionid);
+    if (evt != NULL)
+      osip_transaction_add_event (tr, evt);
+    else
+      __osip_transaction_arm_timers (tr);
   }
 #ifndef OSIP_MONOTHREAD
   osip_mutex_unlock (osip->nict_fastmutex);
 #endif
+  __osip_wakeup_rearm (osip);
 }
 
 
 void
 osip_timers_nist_execute (osip_t * osip)
 {
-  osip_transaction_t *tr;
-  osip_list_iterator_t iterator;
+  osip_timer_entry_t expired;
+  osip_timer_entry_t *entry;
+  struct timeval now;
 
+  osip_gettimeofday (&now, NULL);
 #ifndef OSIP_MONOTHREAD
   osip_mutex_lock (osip->nist_fastmutex);
 #endif
   /* handle nist timers */
-  tr = (osip_transaction_t *) osip_list_get_first (&osip->osip_nist_transactions, &iterator);
-  while (osip_list_iterator_has_elem (iterator)) {
+  __osip_timer_wheel_expire (osip->nist_timers, &now, &expired);
+  while ((entry = __osip_timer_wheel_pop (&expired)) != NULL) {
+    osip_transaction_t *tr = (osip_transaction_t *) entry->data;
     osip_event_t *evt;
 
     evt = __osip_nist_need_timer_j_event (tr->nist_context, tr->state, tr->transactionid);
     if (evt != NULL)
-      osip_fifo_add (tr->transactionff, evt);
-    tr = (osip_transaction_t *) osip_list_get_next (&iterator);
+      osip_transaction_add_event (tr, evt);
+    else
+      __osip_transaction_arm_timers (tr);
   }
 #ifndef OSIP_MONOTHREAD
   osip_mutex_unlock (osip->nist_fastmutex);
 #endif
+  __osip_wakeup_rearm (osip);
 }
 
 void
@@ -1573,6 +2906,26 @@ osip_set_cb_send_message (osip_t * cf, int (*cb) (osip_transaction_t *, osip_mes
   cf->cb_send_message = cb;
 }
 
+void
+osip_set_cb_send_raw (osip_t * cf, int (*cb) (osip_transaction_t *, const char *, size_t, char *, int, int))
+{
+  cf->cb_send_raw = cb;
+}
+
+void
+osip_set_cb_send_batch (osip_t * cf, int (*cb) (osip_t *, osip_batch_message_t *, int))
+{
+  /* the messages of the batch are sent with the previous callback */
+  osip_send_batch_flush (cf);
+  cf->cb_send_batch = cb;
+}
+
+void
+osip_set_tombstone_mode (osip_t * osip, int enabled)
+{
+  osip->tombstone_mode = enabled;
+}
+
 void
 __osip_message_callback (int type, osip_transaction_t * tr, osip_message_t * msg)
 {
@@ -0,0 +1,575 @@
+/*
+  The oSIP library implements the Session Initiation Protocol (SIP -rfc3261-)
+  Copyright (C) 2001-2012 Aymeric MOIZARD amoizard@antisip.com
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <osip2/internal.h>
+#include <osip2/osip.h>
+
+#include <stddef.h>
+
+#include "fsm.h"
+
+/*
+  Cache of DNS results shared by transactions.
+
+  SRV records: a transaction holds a reference on a cached record
+  instead of its own copy: transactions toward the same destination
+  share a single record, and transactions which never resolve
+  anything have none. Records are indexed by name and protocol.
+
+  NAPTR records: results of the resolver installed with
+  osip_dns_cache_set_resolver(), indexed by domain. A domain is
+  resolved once at a time: lookups made while the resolution is in
+  progress get the same pending record and their callbacks are called
+  when the resolver gives the result. Failures are kept for the time
+  to live given by the resolver too (negative caching).
+
+  The cache holds one reference on each indexed record: when a record
+  expires or is replaced by a new result, it is removed from the index
+  and freed once the last user releases it. Expired records are
+  removed from the index when their bucket is used and by a periodic
+  sweep of the whole index.
+*/
+
+#define DNS_CACHE_SIZE 256
+#define DNS_CACHE_SWEEP_INTERVAL 60
+#define DNS_CACHE_PENDING_TIMEOUT 32    /* a new resolution is started after */
+
+struct osip_dns_entry {
+  struct osip_dns_entry *next;
+  unsigned int hash;
+  int refcount;
+  int indexed;
+  time_t expires;
+};
+
+struct osip_dns_srv_entry {
+  struct osip_dns_entry entry;  /* first: entries are freed as a whole */
+  osip_srv_record_t record;
+};
+
+struct osip_dns_waiter {
+  struct osip_dns_waiter *next;
+  osip_dns_callback_t *cb;
+  void *arg;
+};
+
+struct osip_dns_naptr_entry {
+  struct osip_dns_entry entry;  /* first: entries are freed as a whole */
+  osip_naptr_t naptr;
+  struct osip_dns_waiter *waiters;
+};
+
+#define SRV_ENTRY(R) ((struct osip_dns_srv_entry *) ((char *) (R) - offsetof (struct osip_dns_srv_entry, record)))
+#define NAPTR_ENTRY(N) ((struct osip_dns_naptr_entry *) ((char *) (N) - offsetof (struct osip_dns_naptr_entry, naptr)))
+
+static struct osip_dns_entry *srv_cache[DNS_CACHE_SIZE];
+static struct osip_dns_entry *naptr_cache[DNS_CACHE_SIZE];
+static time_t dns_cache_sweep;
+
+static osip_dns_resolver_t *dns_resolver;
+static void *dns_resolver_arg;
+static int dns_pending_timeout = DNS_CACHE_PENDING_TIMEOUT;
+
+#ifndef OSIP_MONOTHREAD
+static struct osip_mutex *dns_cache_mutex;
+#define DNS_CACHE_LOCK() osip_mutex_lock (dns_cache_mutex)
+#define DNS_CACHE_UNLOCK() osip_mutex_unlock (dns_cache_mutex)
+#else
+#define DNS_CACHE_LOCK()
+#define DNS_CACHE_UNLOCK()
+#endif
+
+int
+__osip_dns_cache_init (void)
+{
+#ifndef OSIP_MONOTHREAD
+  if (dns_cache_mutex == NULL)
+    dns_cache_mutex = osip_mutex_init ();
+  if (dns_cache_mutex == NULL)
+    return OSIP_NOMEM;
+#endif
+  return OSIP_SUCCESS;
+}
+
+/* names are compared without case */
+static unsigned int
+__osip_dns_hash_str (unsigned int hash, const char *str)
+{
+  for (; *str != '\0'; str++) {
+    unsigned char c = (unsigned char) *str;
+
+    if (c >= 'A' && c <= 'Z')
+      c += 'a' - 'A';
+    hash ^= c;
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+static unsigned int
+__osip_dns_hash (const char *name, const char *protocol)
+{
+  unsigned int hash = __osip_dns_hash_str (2166136261u, name);
+
+  if (protocol != NULL)
+    hash = __osip_dns_hash_str (hash ^ 0xff, protocol);
+  return hash;
+}
+
+/* compare the results of two records, the index is not compared */
+static int
+__osip_dns_srv_equal (const osip_srv_record_t * a, const osip_srv_record_t * b)
+{
+  int i;
+
+  if (a == b)
+    return 1;
+  if (a->srv_state != b->srv_state || a->order != b->order || a->preference != b->preference)
+    return 0;
+  if (osip_strcasecmp (a->name, b->name) != 0 || osip_strcasecmp (a->protocol, b->protocol) != 0)
+    return 0;
+  for (i = 0; i < 10; i++) {
+    const osip_srv_entry_t *ea = &a->srventry[i];
+    const osip_srv_entry_t *eb = &b->srventry[i];
+
+    if (ea->priority != eb->priority || ea->weight != eb->weight || ea->rweight != eb->rweight || ea->port != eb->port)
+      return 0;
+    if (strcmp (ea->srv, eb->srv) != 0 || strcmp (ea->ipaddress, eb->ipaddress) != 0)
+      return 0;
+  }
+  return 1;
+}
+
+/* drop a reference: the cache is locked */
+static void
+__osip_dns_entry_unref (struct osip_dns_entry *entry)
+{
+  entry->refcount--;
+  if (entry->refcount == 0)
+    osip_free (entry);
+}
+
+/* remove an entry from the index: the cache is locked */
+static void
+__osip_dns_entry_unindex (struct osip_dns_entry **prev)
+{
+  struct osip_dns_entry *entry = *prev;
+
+  *prev = entry->next;
+  entry->next = NULL;
+  entry->indexed = 0;
+  __osip_dns_entry_unref (entry);
+}
+
+/* add an entry in the index: the cache is locked */
+static void
+__osip_dns_entry_index (struct osip_dns_entry **cache, struct osip_dns_entry *entry)
+{
+  struct osip_dns_entry **prev = &cache[entry->hash % DNS_CACHE_SIZE];
+
+  entry->next = *prev;
+  *prev = entry;
+  entry->indexed = 1;
+  entry->refcount++;
+}
+
+/* remove the expired entries of a bucket: the cache is locked */
+static void
+__osip_dns_bucket_purge (struct osip_dns_entry **prev, time_t now)
+{
+  while (*prev != NULL) {
+    if ((*prev)->expires <= now)
+      __osip_dns_entry_unindex (prev);
+    else
+      prev = &(*prev)->next;
+  }
+}
+
+static void
+__osip_dns_cache_purge (time_t now)
+{
+  int i;
+
+  if (now - dns_cache_sweep < DNS_CACHE_SWEEP_INTERVAL)
+    return;
+  dns_cache_sweep = now;
+  for (i = 0; i < DNS_CACHE_SIZE; i++) {
+    __osip_dns_bucket_purge (&srv_cache[i], now);
+    __osip_dns_bucket_purge (&naptr_cache[i], now);
+  }
+}
+
+/* find a valid SRV entry: the cache is locked */
+static struct osip_dns_entry **
+__osip_dns_srv_find (const char *name, const char *protocol, unsigned int hash, time_t now)
+{
+  struct osip_dns_entry **prev = &srv_cache[hash % DNS_CACHE_SIZE];
+
+  __osip_dns_bucket_purge (prev, now);
+  for (; *prev != NULL; prev = &(*prev)->next) {
+    osip_srv_record_t *record = &((struct osip_dns_srv_entry *) *prev)->record;
+
+    if ((*prev)->hash == hash && osip_strcasecmp (record->name, name) == 0 && osip_strcasecmp (record->protocol, protocol) == 0)
+      return prev;
+  }
+  return NULL;
+}
+
+/* find a valid NAPTR entry: the cache is locked */
+static struct osip_dns_entry **
+__osip_dns_naptr_find (const char *domain, unsigned int hash, time_t now)
+{
+  struct osip_dns_entry **prev = &naptr_cache[hash % DNS_CACHE_SIZE];
+
+  __osip_dns_bucket_purge (prev, now);
+  for (; *prev != NULL; prev = &(*prev)->next) {
+    if ((*prev)->hash == hash && osip_strcasecmp (((struct osip_dns_naptr_entry *) *prev)->naptr.domain, domain) == 0)
+      return prev;
+  }
+  return NULL;
+}
+
+static osip_srv_record_t *
+__osip_dns_cache_add_srv (const osip_srv_record_t * record, int ttl, int share)
+{
+  struct osip_dns_entry **prev;
+  struct osip_dns_srv_entry *entry;
+  unsigned int hash;
+  time_t now;
+
+  if (record == NULL || ttl < 0)
+    return NULL;
+
+  hash = __osip_dns_hash (record->name, record->protocol);
+  now = osip_getsystemtime (NULL);
+
+  DNS_CACHE_LOCK ();
+  __osip_dns_cache_purge (now);
+  prev = __osip_dns_srv_find (record->name, record->protocol, hash, now);
+  if (prev != NULL && share && __osip_dns_srv_equal (&((struct osip_dns_srv_entry *) *prev)->record, record)) {
+    entry = (struct osip_dns_srv_entry *) *prev;
+    entry->entry.refcount++;
+    DNS_CACHE_UNLOCK ();
+    return &entry->record;
+  }
+
+  entry = (struct osip_dns_srv_entry *) osip_malloc (sizeof (struct osip_dns_srv_entry));
+  if (entry == NULL) {
+    DNS_CACHE_UNLOCK ();
+    return NULL;
+  }
+  memset (&entry->entry, 0, sizeof (struct osip_dns_entry));
+  memcpy (&entry->record, record, sizeof (osip_srv_record_t));
+  entry->entry.hash = hash;
+  entry->entry.expires = now + ttl;
+  entry->entry.refcount = 1;    /* caller */
+
+  /* the new result replaces the previous one for this name */
+  if (prev != NULL)
+    __osip_dns_entry_unindex (prev);
+  if (ttl > 0)
+    __osip_dns_entry_index (srv_cache, &entry->entry);
+  DNS_CACHE_UNLOCK ();
+  return &entry->record;
+}
+
+osip_srv_record_t *
+osip_dns_cache_add_srv (const osip_srv_record_t * record, int ttl)
+{
+  return __osip_dns_cache_add_srv (record, ttl, 0);
+}
+
+osip_srv_record_t *
+__osip_dns_cache_share_srv (const osip_srv_record_t * record)
+{
+  return __osip_dns_cache_add_srv (record, OSIP_DNS_CACHE_DEFAULT_TTL, 1);
+}
+
+osip_srv_record_t *
+osip_dns_cache_get_srv (const char *name, const char *protocol)
+{
+  struct osip_dns_entry **prev;
+  struct osip_dns_srv_entry *entry = NULL;
+
+  if (name == NULL || protocol == NULL)
+    return NULL;
+
+  DNS_CACHE_LOCK ();
+  prev = __osip_dns_srv_find (name, protocol, __osip_dns_hash (name, protocol), osip_getsystemtime (NULL));
+  if (prev != NULL) {
+    entry = (struct osip_dns_srv_entry *) *prev;
+    entry->entry.refcount++;
+  }
+  DNS_CACHE_UNLOCK ();
+  return entry != NULL ? &entry->record : NULL;
+}
+
+void
+osip_dns_cache_release_srv (osip_srv_record_t * record)
+{
+  if (record == NULL)
+    return;
+  DNS_CACHE_LOCK ();
+  __osip_dns_entry_unref (&SRV_ENTRY (record)->entry);
+  DNS_CACHE_UNLOCK ();
+}
+
+void
+osip_dns_cache_set_resolver (osip_dns_resolver_t * resolver, void *arg)
+{
+  DNS_CACHE_LOCK ();
+  dns_resolver = resolver;
+  dns_resolver_arg = arg;
+  DNS_CACHE_UNLOCK ();
+}
+
+int
+osip_dns_cache_set_pending_timeout (int timeout)
+{
+  if (timeout <= 0)
+    return OSIP_BADPARAMETER;
+  DNS_CACHE_LOCK ();
+  dns_pending_timeout = timeout;
+  DNS_CACHE_UNLOCK ();
+  return OSIP_SUCCESS;
+}
+
+osip_naptr_t *
+osip_dns_cache_lookup (const char *domain, osip_dns_callback_t * cb, void *arg)
+{
+  struct osip_dns_entry **prev;
+  struct osip_dns_naptr_entry *entry;
+  struct osip_dns_waiter *waiter = NULL;
+  osip_dns_resolver_t *resolver;
+  void *resolver_arg;
+  unsigned int hash;
+  time_t now;
+
+  if (domain == NULL || domain[0] == '\0' || strlen (domain) >= sizeof (entry->naptr.domain))
+    return NULL;
+  if (cb != NULL) {
+    waiter = (struct osip_dns_waiter *) osip_malloc (sizeof (struct osip_dns_waiter));
+    if (waiter == NULL)
+      return NULL;
+    waiter->next = NULL;
+    waiter->cb = cb;
+    waiter->arg = arg;
+  }
+
+  hash = __osip_dns_hash (domain, NULL);
+  now = osip_getsystemtime (NULL);
+
+  DNS_CACHE_LOCK ();
+  __osip_dns_cache_purge (now);
+  prev = __osip_dns_naptr_find (domain, hash, now);
+  if (prev != NULL) {
+    entry = (struct osip_dns_naptr_entry *) *prev;
+    entry->entry.refcount++;
+    if (entry->naptr.naptr_state == OSIP_NAPTR_STATE_INPROGRESS && waiter != NULL) {
+      /* join the resolution in progress */
+      waiter->next = entry->waiters;
+      entry->waiters = waiter;
+      waiter = NULL;
+    }
+    DNS_CACHE_UNLOCK ();
+    osip_free (waiter);
+    return &entry->naptr;
+  }
+
+  resolver = dns_resolver;
+  resolver_arg = dns_resolver_arg;
+  entry = NULL;
+  if (resolver != NULL)
+    entry = (struct osip_dns_naptr_entry *) osip_malloc (sizeof (struct osip_dns_naptr_entry));
+  if (entry == NULL) {
+    DNS_CACHE_UNLOCK ();
+    osip_free (waiter);
+    return NULL;
+  }
+  memset (entry, 0, sizeof (struct osip_dns_naptr_entry));
+  osip_strncpy (entry->naptr.domain, domain, sizeof (entry->naptr.domain) - 1);
+  entry->naptr.naptr_state = OSIP_NAPTR_STATE_INPROGRESS;
+  entry->entry.hash = hash;
+  entry->entry.expires = now + dns_pending_timeout;
+  entry->entry.refcount = 2;    /* caller and resolver */
+  entry->waiters = waiter;
+  __osip_dns_entry_index (naptr_cache, &entry->entry);
+  DNS_CACHE_UNLOCK ();
+
+  if (resolver (&entry->naptr, resolver_arg) != OSIP_SUCCESS)
+    osip_dns_cache_resolved (&entry->naptr, NULL, 0);
+  return &entry->naptr;
+}
+
+int
+osip_dns_cache_resolved (osip_naptr_t * naptr, const osip_naptr_t * result, int ttl)
+{
+  struct osip_dns_naptr_entry *entry;
+  struct osip_dns_waiter *waiters;
+  osip_srv_record_t *records[5];
+  int i;
+
+  if (naptr == NULL || ttl < 0)
+    return OSIP_BADPARAMETER;
+  entry = NAPTR_ENTRY (naptr);
+
+  DNS_CACHE_LOCK ();
+  if (naptr->naptr_state != OSIP_NAPTR_STATE_INPROGRESS) {
+    DNS_CACHE_UNLOCK ();
+    return OSIP_WRONG_STATE;
+  }
+  if (result != NULL && result != naptr) {
+    naptr->keep_in_cache = result->keep_in_cache;
+    memcpy (&naptr->sipudp_record, &result->sipudp_record, sizeof (osip_srv_record_t));
+    memcpy (&naptr->siptcp_record, &result->siptcp_record, sizeof (osip_srv_record_t));
+    memcpy (&naptr->siptls_record, &result->siptls_record, sizeof (osip_srv_record_t));
+    memcpy (&naptr->sipdtls_record, &result->sipdtls_record, sizeof (osip_srv_record_t));
+    memcpy (&naptr->sipsctp_record, &result->sipsctp_record, sizeof (osip_srv_record_t));
+  }
+  if (result == NULL || result->naptr_state == OSIP_NAPTR_STATE_INPROGRESS)
+    naptr->naptr_state = OSIP_NAPTR_STATE_RETRYLATER;
+  else
+    naptr->naptr_state = result->naptr_state;
+
+  if (entry->entry.indexed) {
+    if (ttl > 0)
+      entry->entry.expires = osip_getsystemtime (NULL) + ttl;
+    else {
+      struct osip_dns_entry **prev = &naptr_cache[entry->entry.hash % DNS_CACHE_SIZE];
+
+      while (*prev != &entry->entry)
+        prev = &(*prev)->next;
+      __osip_dns_entry_unindex (prev);
+    }
+  }
+  waiters = entry->waiters;
+  entry->waiters = NULL;
+  DNS_CACHE_UNLOCK ();
+
+  /* SRV results are shared with transactions through the SRV cache */
+  records[0] = &naptr->sipudp_record;
+  records[1] = &naptr->siptcp_record;
+  records[2] = &naptr->siptls_record;
+  records[3] = &naptr->sipdtls_record;
+  records[4] = &naptr->sipsctp_record;
+  for (i = 0; i < 5 && ttl > 0; i++) {
+    if (records[i]->srv_state == OSIP_SRV_STATE_COMPLETED && records[i]->name[0] != '\0')
+      osip_dns_cache_release_srv (osip_dns_cache_add_srv (records[i], ttl));
+  }
+
+  while (waiters != NULL) {
+    struct osip_dns_waiter *waiter = waiters;
+
+    waiters = waiter->next;
+    waiter->cb (naptr, waiter->arg);
+    osip_free (waiter);
+  }
+
+  /* reference of the resolver */
+  osip_dns_cache_release_naptr (naptr);
+  return OSIP_SUCCESS;
+}
+
+void
+osip_dns_cache_release_naptr (osip_naptr_t * naptr)
+{
+  if (naptr == NULL)
+    return;
+  DNS_CACHE_LOCK ();
+  __osip_dns_entry_unref (&NAPTR_ENTRY (naptr)->entry);
+  DNS_CACHE_UNLOCK ();
+}
+
+void
+osip_dns_cache_flush (void)
+{
+  int i;
+
+  DNS_CACHE_LOCK ();
+  for (i = 0; i < DNS_CACHE_SIZE; i++) {
+    while (srv_cache[i] != NULL)
+      __osip_dns_entry_unindex (&srv_cache[i]);
+    while (naptr_cache[i] != NULL)
+      __osip_dns_entry_unindex (&naptr_cache[i]);
+  }
+  DNS_CACHE_UNLOCK ();
+}
+
+/*
+  RFC 2782: the entries with the lowest priority are tried first.
+  Among them, zero weight entries are placed first, then one is
+  selected at random with a probability proportional to its weight.
+*/
+int
+osip_dns_srv_select (const osip_srv_record_t * record, int tried)
+{
+  int candidates[10];
+  int nb = 0;
+  int priority = -1;
+  unsigned int sum = 0;
+  unsigned int value;
+  int i;
+
+  if (record == NULL)
+    return OSIP_BADPARAMETER;
+
+  for (i = 0; i < 10; i++) {
+    const osip_srv_entry_t *entry = &record->srventry[i];
+
+    if (entry->srv[0] == '\0' || (tried & (1 << i)) != 0)
+      continue;
+    if (priority == -1 || entry->priority < priority) {
+      priority = entry->priority;
+      nb = 0;
+    }
+    if (entry->priority == priority)
+      candidates[nb++] = i;
+  }
+  if (nb == 0)
+    return OSIP_NOTFOUND;
+
+  /* zero weight entries first, in their order */
+  for (i = 0; i < nb; i++) {
+    int j;
+
+    if (record->srventry[candidates[i]].weight > 0)
+      continue;
+    for (j = i; j > 0 && record->srventry[candidates[j - 1]].weight > 0; j--) {
+      int tmp = candidates[j - 1];
+
+      candidates[j - 1] = candidates[j];
+      candidates[j] = tmp;
+    }
+  }
+
+  for (i = 0; i < nb; i++) {
+    if (record->srventry[candidates[i]].weight > 0)
+      sum += record->srventry[candidates[i]].weight;
+  }
+  value = sum > 0 ? osip_build_random_number () % (sum + 1) : 0;
+
+  sum = 0;
+  for (i = 0; i < nb; i++) {
+    if (record->srventry[candidates[i]].weight > 0)
+      sum += record->srventry[candidates[i]].weight;
+    if (sum >= value)
+      return candidates[i];
+  }
+  return candidates[nb - 1];
+}
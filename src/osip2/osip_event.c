@@ -22,6 +22,290 @@
 
 #include "fsm.h"
 
+/*
+  Pool of events: events are allocated with osip_malloc, so that they
+  may still be released with osip_free, and the released ones are kept
+  for the next allocations. A thread takes events from its own cache
+  without any lock. When the cache is empty, a batch of events is taken
+  from the depot and when the cache holds too many events, a batch is
+  given back to the depot; beyond max_cached events, the depot releases
+  them to the heap.
+
+  Free events are linked through their first word; batches in the
+  depot are linked through the second word of their first event.
+  Statistics of a thread are added to the depot when it exchanges a
+  batch, so they lag by at most one batch per thread. With pthreads,
+  the cache of a thread is given back to the depot when it exits.
+*/
+
+#ifdef OSIP_POOL
+
+#if defined(HAVE_PTHREAD) || defined(HAVE_PTH_PTHREAD_H)
+#include <pthread.h>
+#define EVENT_POOL_THREAD_KEY
+#endif
+
+#define EVENT_POOL_BATCH 32
+#define EVENT_POOL_MAX_CACHED 4096
+
+struct osip_event_free {
+  struct osip_event_free *next; /* next event of the batch */
+  struct osip_event_free *next_batch;   /* next batch of the depot */
+};
+
+struct osip_event_depot {
+  int lock;
+  struct osip_event_free *batches;
+  unsigned long cached;
+  unsigned long max_cached;
+  unsigned long allocations;
+  unsigned long frees;
+  unsigned long hits;
+};
+
+struct osip_event_cache {
+  struct osip_event_free *events;
+  int count;
+  unsigned long allocations;
+  unsigned long frees;
+  unsigned long hits;
+};
+
+static struct osip_event_depot event_depot = { 0, NULL, 0, EVENT_POOL_MAX_CACHED, 0, 0, 0 };
+static __thread struct osip_event_cache event_cache;
+
+#ifdef EVENT_POOL_THREAD_KEY
+static pthread_key_t event_cache_key;
+static pthread_once_t event_cache_once = PTHREAD_ONCE_INIT;
+static __thread int event_cache_registered;
+
+static void
+__osip_event_cache_exit (void *arg)
+{
+  osip_event_pool_thread_release ();
+}
+
+static void
+__osip_event_cache_key_init (void)
+{
+  pthread_key_create (&event_cache_key, &__osip_event_cache_exit);
+}
+
+/* release the cache when the thread exits */
+static void
+__osip_event_cache_register (void)
+{
+  event_cache_registered = 1;
+  pthread_once (&event_cache_once, &__osip_event_cache_key_init);
+  pthread_setspecific (event_cache_key, &event_cache);
+}
+#endif
+
+static void
+__osip_event_pool_lock (struct osip_event_depot *depot)
+{
+  while (__sync_lock_test_and_set (&depot->lock, 1))
+    ;
+}
+
+static void
+__osip_event_pool_unlock (struct osip_event_depot *depot)
+{
+  __sync_lock_release (&depot->lock);
+}
+
+/* move the statistics of a thread to the depot, which is locked */
+static void
+__osip_event_pool_account (struct osip_event_depot *depot, struct osip_event_cache *cache)
+{
+  depot->allocations += cache->allocations;
+  depot->frees += cache->frees;
+  depot->hits += cache->hits;
+  cache->allocations = 0;
+  cache->frees = 0;
+  cache->hits = 0;
+}
+
+static void
+__osip_event_pool_refill (struct osip_event_cache *cache)
+{
+  struct osip_event_depot *depot = &event_depot;
+  struct osip_event_free *batch;
+  struct osip_event_free *evt;
+
+#ifdef EVENT_POOL_THREAD_KEY
+  if (!event_cache_registered)
+    __osip_event_cache_register ();
+#endif
+  __osip_event_pool_lock (depot);
+  batch = depot->batches;
+  if (batch != NULL)
+    depot->batches = batch->next_batch;
+  __osip_event_pool_account (depot, cache);
+  cache->count = 0;
+  for (evt = batch; evt != NULL; evt = evt->next)
+    cache->count++;
+  depot->cached -= cache->count;
+  __osip_event_pool_unlock (depot);
+  cache->events = batch;
+}
+
+/* give at most nb events of the cache to the depot */
+static void
+__osip_event_pool_flush (struct osip_event_cache *cache, int nb)
+{
+  struct osip_event_depot *depot = &event_depot;
+  struct osip_event_free *first = cache->events;
+  struct osip_event_free *last = first;
+  int i;
+
+  if (first == NULL)
+    return;
+  for (i = 1; i < nb && last->next != NULL; i++)
+    last = last->next;
+  cache->events = last->next;
+  cache->count -= i;
+  last->next = NULL;
+
+  __osip_event_pool_lock (depot);
+  __osip_event_pool_account (depot, cache);
+  if (depot->cached + i <= depot->max_cached) {
+    first->next_batch = depot->batches;
+    depot->batches = first;
+    depot->cached += i;
+    first = NULL;
+  }
+  __osip_event_pool_unlock (depot);
+
+  /* the depot is full */
+  while (first != NULL) {
+    last = first->next;
+    osip_free (first);
+    first = last;
+  }
+}
+
+#endif
+
+static osip_event_t *
+__osip_event_alloc (void)
+{
+  osip_event_t *evt;
+
+#ifdef OSIP_POOL
+  struct osip_event_cache *cache = &event_cache;
+
+  if (cache->events == NULL)
+    __osip_event_pool_refill (cache);
+  if (cache->events != NULL) {
+    evt = (osip_event_t *) cache->events;
+    cache->events = cache->events->next;
+    cache->count--;
+    cache->allocations++;
+    cache->hits++;
+    return evt;
+  }
+  evt = (osip_event_t *) osip_malloc (sizeof (osip_event_t));
+  if (evt != NULL)
+    cache->allocations++;
+  return evt;
+#else
+  evt = (osip_event_t *) osip_malloc (sizeof (osip_event_t));
+  return evt;
+#endif
+}
+
+void
+__osip_event_release (osip_event_t * evt)
+{
+#ifdef OSIP_POOL
+  struct osip_event_cache *cache = &event_cache;
+  struct osip_event_free *free_evt = (struct osip_event_free *) evt;
+
+  if (evt == NULL)
+    return;
+#ifdef EVENT_POOL_THREAD_KEY
+  if (!event_cache_registered)
+    __osip_event_cache_register ();
+#endif
+  free_evt->next = cache->events;
+  cache->events = free_evt;
+  cache->count++;
+  cache->frees++;
+  if (cache->count >= 2 * EVENT_POOL_BATCH)
+    __osip_event_pool_flush (cache, EVENT_POOL_BATCH);
+#else
+  osip_free (evt);
+#endif
+}
+
+void
+osip_event_pool_thread_release (void)
+{
+#ifdef OSIP_POOL
+  while (event_cache.events != NULL)
+    __osip_event_pool_flush (&event_cache, EVENT_POOL_BATCH);
+  if (event_cache.allocations > 0 || event_cache.frees > 0) {
+    __osip_event_pool_lock (&event_depot);
+    __osip_event_pool_account (&event_depot, &event_cache);
+    __osip_event_pool_unlock (&event_depot);
+  }
+#endif
+}
+
+int
+osip_event_pool_set_max (unsigned long max_cached)
+{
+#ifdef OSIP_POOL
+  struct osip_event_free *list = NULL;
+
+  __osip_event_pool_lock (&event_depot);
+  event_depot.max_cached = max_cached;
+  /* release the batches over the new limit */
+  while (event_depot.cached > max_cached && event_depot.batches != NULL) {
+    struct osip_event_free *batch = event_depot.batches;
+    struct osip_event_free *evt;
+
+    event_depot.batches = batch->next_batch;
+    for (evt = batch; evt->next != NULL; evt = evt->next)
+      event_depot.cached--;
+    event_depot.cached--;
+    evt->next = list;
+    list = batch;
+  }
+  __osip_event_pool_unlock (&event_depot);
+
+  while (list != NULL) {
+    struct osip_event_free *next = list->next;
+
+    osip_free (list);
+    list = next;
+  }
+  return OSIP_SUCCESS;
+#else
+  return OSIP_UNDEFINED_ERROR;  /* events are allocated with osip_malloc */
+#endif
+}
+
+int
+osip_event_pool_get_stats (osip_event_pool_stats_t * stats)
+{
+  if (stats == NULL)
+    return OSIP_BADPARAMETER;
+#ifdef OSIP_POOL
+  __osip_event_pool_lock (&event_depot);
+  stats->allocations = event_depot.allocations;
+  stats->frees = event_depot.frees;
+  stats->hits = event_depot.hits;
+  stats->cached = event_depot.cached;
+  stats->max_cached = event_depot.max_cached;
+  __osip_event_pool_unlock (&event_depot);
+  return OSIP_SUCCESS;
+#else
+  return OSIP_NOTFOUND;         /* events are allocated with osip_malloc */
+#endif
+}
+
 /* Create a sipevent according to the SIP message buf. */
 /* INPUT : char *buf | message as a string.            */
 /* return NULL  if message cannot be parsed            */
@@ -37,13 +321,13 @@ osip_parse (const char *buf, size_t length)
   /* parse message and set up an event */
   i = osip_message_init (&(se->sip));
   if (i != 0) {
-    osip_free (se);
+    __osip_event_release (se);
     return NULL;
   }
   if (osip_message_parse (se->sip, buf, length) != 0) {
     OSIP_TRACE (osip_trace (__FILE__, __LINE__, OSIP_ERROR, NULL, "could not parse message\n"));
     osip_message_free (se->sip);
-    osip_free (se);
+    __osip_event_release (se);
     return NULL;
   }
   else {
@@ -54,7 +338,7 @@ osip_parse (const char *buf, size_t length)
     if (MSG_IS_REQUEST (se->sip)) {
       if (se->sip->sip_method == NULL || se->sip->req_uri == NULL) {
         osip_message_free (se->sip);
-        osip_free (se);
+        __osip_event_release (se);
         return NULL;
       }
     }
@@ -75,7 +359,7 @@ __osip_event_new (type_t type, int transactionid)
 {
   osip_event_t *sipevent;
 
-  sipevent = (osip_event_t *) osip_malloc (sizeof (osip_event_t));
+  sipevent = __osip_event_alloc ();
   if (sipevent == NULL)
     return NULL;
   sipevent->type = type;
@@ -101,7 +385,7 @@ osip_new_outgoing_sipmessage (osip_message_t * sip)
     if (sip->req_uri == NULL)
       return NULL;
   }
-  sipevent = (osip_event_t *) osip_malloc (sizeof (osip_event_t));
+  sipevent = __osip_event_alloc ();
   if (sipevent == NULL)
     return NULL;
 
@@ -155,6 +439,6 @@ osip_event_free (osip_event_t * event)
 {
   if (event != NULL) {
     osip_message_free (event->sip);
-    osip_free (event);
+    __osip_event_release (event);
   }
 }
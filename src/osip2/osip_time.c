@@ -18,9 +18,12 @@
 */
 
 #include <osip2/internal.h>
+#include <osip2/osip.h>
 #include <osip2/osip_time.h>
 #include <osipparser2/osip_port.h>
 
+#include "xixt.h"
+
 #ifdef __MACH__
 #include <mach/clock.h>
 #include <mach/mach.h>
@@ -275,3 +278,282 @@ osip_getsystemtime (time_t * t)
 
   return now_monotonic.tv_sec;
 }
+
+/*
+  Hierarchical timer wheel with a resolution of 1ms.
+
+  Level 0 has one slot per tick for the next 256ms. Levels 1, 2 and 3
+  have 64 slots each, covering 2^14, 2^20 and 2^26 ticks (18 hours):
+  their entries are moved down one level when level 0 starts a new
+  round. A bitmap of non empty slots gives the next expiration without
+  looking at the entries themselves.
+
+  Ticks are unsigned and compared by difference, so they may wrap.
+*/
+
+#define TW_LVL0_BITS 8
+#define TW_LVL_BITS 6
+#define TW_LVL0_SIZE (1 << TW_LVL0_BITS)
+#define TW_LVL_SIZE (1 << TW_LVL_BITS)
+#define TW_LEVELS 4
+#define TW_SLOTS (TW_LVL0_SIZE + (TW_LEVELS - 1) * TW_LVL_SIZE)
+#define TW_MAX_DELAY ((1u << (TW_LVL0_BITS + (TW_LEVELS - 1) * TW_LVL_BITS)) - 1)
+
+/* first slot and shift of each level */
+#define TW_LVL_FIRST(l) (TW_LVL0_SIZE + ((l) - 1) * TW_LVL_SIZE)
+#define TW_LVL_SHIFT(l) (TW_LVL0_BITS + ((l) - 1) * TW_LVL_BITS)
+
+struct osip_timer_wheel {
+  struct timeval base;          /* date of tick 0 */
+  unsigned int current;         /* next tick to process */
+  int count;                    /* number of entries, expired ones included until popped */
+  osip_timer_entry_t slots[TW_SLOTS];
+  unsigned int map[TW_SLOTS / 32];      /* non empty slots */
+};
+
+static unsigned int
+__tw_ticks (struct osip_timer_wheel *wheel, const struct timeval *tv, int round_up)
+{
+  unsigned int ticks = (unsigned int) (tv->tv_sec - wheel->base.tv_sec) * 1000;
+
+  if (round_up)
+    return ticks + (unsigned int) (tv->tv_usec + 999) / 1000;
+  return ticks + (unsigned int) tv->tv_usec / 1000;
+}
+
+/* offset of the first non empty slot of a level, starting at slot start
+   and wrapping around; -1 if the level is empty. */
+static int
+__tw_find (struct osip_timer_wheel *wheel, unsigned int first, unsigned int size, unsigned int start)
+{
+  unsigned int k = 0;
+
+  while (k < size) {
+    unsigned int i = (start + k) & (size - 1);
+    unsigned int bits = wheel->map[(first + i) >> 5] >> (i & 31);
+
+    if (bits != 0) {
+      while ((bits & 1) == 0) {
+        bits >>= 1;
+        k++;
+      }
+      return k < size ? (int) k : -1;
+    }
+    k += 32 - (i & 31);
+  }
+  return -1;
+}
+
+static void
+__tw_link (struct osip_timer_wheel *wheel, osip_timer_entry_t * entry)
+{
+  unsigned int delta;
+  unsigned int slot;
+  osip_timer_entry_t *head;
+
+  if ((int) (entry->expires - wheel->current) < 0)
+    entry->expires = wheel->current;
+  delta = entry->expires - wheel->current;
+  if (delta > TW_MAX_DELAY) {
+    /* will be checked, and re-armed, at the end of the wheel */
+    entry->expires = wheel->current + TW_MAX_DELAY;
+    delta = TW_MAX_DELAY;
+  }
+
+  if (delta < TW_LVL0_SIZE)
+    slot = entry->expires & (TW_LVL0_SIZE - 1);
+  else {
+    int level = 1;
+
+    while (delta >= 1u << TW_LVL_SHIFT (level + 1))
+      level++;
+    slot = TW_LVL_FIRST (level) + ((entry->expires >> TW_LVL_SHIFT (level)) & (TW_LVL_SIZE - 1));
+  }
+
+  head = &wheel->slots[slot];
+  entry->detached = 0;
+  entry->next = head;
+  entry->prev = head->prev;
+  head->prev->next = entry;
+  head->prev = entry;
+  wheel->map[slot >> 5] |= 1u << (slot & 31);
+}
+
+/* move all entries of a slot at the end of list, marked as detached
+   from the wheel */
+static void
+__tw_splice (struct osip_timer_wheel *wheel, unsigned int slot, osip_timer_entry_t * list)
+{
+  osip_timer_entry_t *head = &wheel->slots[slot];
+  osip_timer_entry_t *entry;
+
+  if (head->next == head)
+    return;
+  for (entry = head->next; entry != head; entry = entry->next)
+    entry->detached = 1;
+  head->next->prev = list->prev;
+  list->prev->next = head->next;
+  head->prev->next = list;
+  list->prev = head->prev;
+  head->next = head->prev = head;
+  wheel->map[slot >> 5] &= ~(1u << (slot & 31));
+}
+
+/* level 0 starts a new round: move entries of upper levels down */
+static void
+__tw_cascade (struct osip_timer_wheel *wheel)
+{
+  osip_timer_entry_t list;
+  int level;
+
+  list.next = list.prev = &list;
+  for (level = 1; level < TW_LEVELS; level++) {
+    unsigned int idx = (wheel->current >> TW_LVL_SHIFT (level)) & (TW_LVL_SIZE - 1);
+
+    __tw_splice (wheel, TW_LVL_FIRST (level) + idx, &list);
+    if (idx != 0)
+      break;
+  }
+  while (list.next != &list) {
+    osip_timer_entry_t *entry = list.next;
+
+    list.next = entry->next;
+    entry->next->prev = &list;
+    __tw_link (wheel, entry);
+  }
+}
+
+int
+__osip_timer_wheel_init (struct osip_timer_wheel **wheel)
+{
+  int i;
+
+  *wheel = (struct osip_timer_wheel *) osip_malloc (sizeof (struct osip_timer_wheel));
+  if (*wheel == NULL)
+    return OSIP_NOMEM;
+  memset (*wheel, 0, sizeof (struct osip_timer_wheel));
+  osip_gettimeofday (&(*wheel)->base, NULL);
+  (*wheel)->base.tv_usec = 0;
+  for (i = 0; i < TW_SLOTS; i++)
+    (*wheel)->slots[i].next = (*wheel)->slots[i].prev = &(*wheel)->slots[i];
+  return OSIP_SUCCESS;
+}
+
+void
+__osip_timer_wheel_free (struct osip_timer_wheel *wheel)
+{
+  osip_free (wheel);
+}
+
+void
+__osip_timer_wheel_add (osip_timer_entry_t * entry, const struct timeval *deadline)
+{
+  struct osip_timer_wheel *wheel = entry->wheel;
+
+  if (wheel == NULL)
+    return;
+  __osip_timer_wheel_del (entry);
+  entry->expires = __tw_ticks (wheel, deadline, 1);
+  __tw_link (wheel, entry);
+  wheel->count++;
+}
+
+void
+__osip_timer_wheel_del (osip_timer_entry_t * entry)
+{
+  struct osip_timer_wheel *wheel = entry->wheel;
+
+  if (entry->next == NULL)
+    return;
+  if (!entry->detached && entry->prev == entry->next) {
+    /* the slot is now empty */
+    unsigned int slot = (unsigned int) (entry->next - wheel->slots);
+
+    wheel->map[slot >> 5] &= ~(1u << (slot & 31));
+  }
+  entry->prev->next = entry->next;
+  entry->next->prev = entry->prev;
+  entry->next = entry->prev = NULL;
+  wheel->count--;
+}
+
+void
+__osip_timer_wheel_expire (struct osip_timer_wheel *wheel, const struct timeval *now, osip_timer_entry_t * expired)
+{
+  unsigned int target = __tw_ticks (wheel, now, 0);
+
+  expired->next = expired->prev = expired;
+  if (wheel->count == 0) {
+    if ((int) (target - wheel->current) >= 0)
+      wheel->current = target + 1;
+    return;
+  }
+
+  while ((int) (target - wheel->current) >= 0) {
+    unsigned int idx = wheel->current & (TW_LVL0_SIZE - 1);
+    unsigned int next;
+    int k;
+
+    __tw_splice (wheel, idx, expired);
+
+    /* skip empty slots up to the end of this round */
+    k = __tw_find (wheel, 0, TW_LVL0_SIZE, idx);
+    if (k < 0 || idx + k >= TW_LVL0_SIZE)
+      next = wheel->current + (TW_LVL0_SIZE - idx);
+    else
+      next = wheel->current + k;
+    if ((int) (next - target) > 0)
+      next = target + 1;
+    wheel->current = next;
+    if ((wheel->current & (TW_LVL0_SIZE - 1)) == 0)
+      __tw_cascade (wheel);
+  }
+}
+
+osip_timer_entry_t *
+__osip_timer_wheel_pop (osip_timer_entry_t * expired)
+{
+  osip_timer_entry_t *entry = expired->next;
+
+  if (entry == expired)
+    return NULL;
+  expired->next = entry->next;
+  entry->next->prev = expired;
+  entry->next = entry->prev = NULL;
+  entry->wheel->count--;
+  return entry;
+}
+
+int
+__osip_timer_wheel_next (struct osip_timer_wheel *wheel, const struct timeval *now, struct timeval *deadline)
+{
+  unsigned int expires;
+  int delay;
+  int level;
+  int k;
+
+  if (wheel->count == 0)
+    return OSIP_NOTFOUND;
+
+  /* entries of upper levels expire after the start of their slot: they
+     may expire before entries added later in level 0 */
+  expires = wheel->current + TW_MAX_DELAY;
+  k = __tw_find (wheel, 0, TW_LVL0_SIZE, wheel->current & (TW_LVL0_SIZE - 1));
+  if (k >= 0)
+    expires = wheel->current + k;
+  for (level = 1; level < TW_LEVELS; level++) {
+    unsigned int round = wheel->current >> TW_LVL_SHIFT (level);
+
+    k = __tw_find (wheel, TW_LVL_FIRST (level), TW_LVL_SIZE, (round + 1) & (TW_LVL_SIZE - 1));
+    if (k >= 0 && (int) (((round + 1 + k) << TW_LVL_SHIFT (level)) - expires) < 0)
+      expires = (round + 1 + k) << TW_LVL_SHIFT (level);
+  }
+
+  delay = (int) (expires - __tw_ticks (wheel, now, 0));
+  if (delay < 0)
+    delay = 0;
+  deadline->tv_sec = now->tv_sec;
+  deadline->tv_usec = now->tv_usec;
+  add_gettimeofday (deadline, delay);
+  return OSIP_SUCCESS;
+}
@@ -23,10 +23,12 @@
 #include "fsm.h"
 #include "xixt.h"
 
-extern osip_statemachine_t ict_fsm;
-extern osip_statemachine_t ist_fsm;
-extern osip_statemachine_t nict_fsm;
-extern osip_statemachine_t nist_fsm;
+extern const osip_statemachine_t ict_fsm;
+extern const osip_statemachine_t ist_fsm;
+extern const osip_statemachine_t nict_fsm;
+extern const osip_statemachine_t nist_fsm;
+
+static void __osip_transaction_shell_free (osip_transaction_t * tr);
 
 int osip_id_mutex_lock (osip_t * osip);
 int osip_id_mutex_unlock (osip_t * osip);
@@ -107,6 +109,12 @@ __osip_transaction_set_cseq (osip_transaction_t * transaction, osip_cseq_t * cse
   return i;
 }
 
+static void
+__osip_transaction_event_added (void *arg)
+{
+  __osip_transaction_set_ready ((osip_transaction_t *) arg);
+}
+
 int
 osip_transaction_init (osip_transaction_t ** transaction, osip_fsm_type_t ctx_type, osip_t * osip, osip_message_t * request)
 {
@@ -122,25 +130,35 @@ osip_transaction_init (osip_transaction_t ** transaction, osip_fsm_type_t ctx_ty
   if (request->call_id->number == NULL)
     return OSIP_BADPARAMETER;
 
-  *transaction = (osip_transaction_t *) osip_malloc (sizeof (osip_transaction_t));
-  if (*transaction == NULL)
-    return OSIP_NOMEM;
+  /* a recycled transaction keeps its fifo and the context of its state machine */
+  *transaction = __osip_transaction_pool_get (osip, ctx_type);
+  if (*transaction == NULL) {
+    *transaction = (osip_transaction_t *) osip_malloc (sizeof (osip_transaction_t));
+    if (*transaction == NULL)
+      return OSIP_NOMEM;
 
-  memset (*transaction, 0, sizeof (osip_transaction_t));
+    memset (*transaction, 0, sizeof (osip_transaction_t));
+  }
+  /* not in a list of osip_t until __osip_add_* (also for a recycled one) */
+#ifndef OSIP_LIST_ARRAY
+  (*transaction)->list_link = NULL;
+#else
+  (*transaction)->list_pos = -1;
+#endif
 
   (*transaction)->birth_time = osip_getsystemtime (NULL);
 
+#if !defined(OSIP_MONOTHREAD) && defined(OSIP_HAVE_ATOMICS)
+  (*transaction)->transactionid = osip_atomic_add_int (&osip->transactionid, 1) - 1;
+#else
   osip_id_mutex_lock (osip);
   (*transaction)->transactionid = osip->transactionid++;
   osip_id_mutex_unlock (osip);
+#endif
   OSIP_TRACE (osip_trace (__FILE__, __LINE__, OSIP_INFO2, NULL, "allocating transaction ressource %i %s\n", (*transaction)->transactionid, request->call_id->number));
 
   /* those lines must be called before "osip_transaction_free" */
   (*transaction)->ctx_type = ctx_type;
-  (*transaction)->ict_context = NULL;
-  (*transaction)->ist_context = NULL;
-  (*transaction)->nict_context = NULL;
-  (*transaction)->nist_context = NULL;
   (*transaction)->config = osip;
 
   topvia = osip_list_get (&request->vias, 0);
@@ -187,13 +205,18 @@ osip_transaction_init (osip_transaction_t ** transaction, osip_fsm_type_t ctx_ty
   /* (*transaction)->orig_request = request; */
   (*transaction)->orig_request = NULL;
 
-  (*transaction)->transactionff = (osip_fifo_t *) osip_malloc (sizeof (osip_fifo_t));
   if ((*transaction)->transactionff == NULL) {
-    osip_transaction_free (*transaction);
-    *transaction = NULL;
-    return OSIP_NOMEM;
+    (*transaction)->transactionff = (osip_fifo_t *) osip_malloc (sizeof (osip_fifo_t));
+    if ((*transaction)->transactionff == NULL) {
+      osip_transaction_free (*transaction);
+      *transaction = NULL;
+      return OSIP_NOMEM;
+    }
+    osip_fifo_init ((*transaction)->transactionff);
   }
-  osip_fifo_init ((*transaction)->transactionff);
+  /* events added in the fifo, even with osip_fifo_add(), queue the transaction */
+  (*transaction)->transactionff->added = &__osip_transaction_event_added;
+  (*transaction)->transactionff->added_arg = *transaction;
 
   if (ctx_type == ICT) {
     (*transaction)->state = ICT_PRE_CALLING;
@@ -203,7 +226,12 @@ osip_transaction_init (osip_transaction_t ** transaction, osip_fsm_type_t ctx_ty
       *transaction = NULL;
       return i;
     }
-    __osip_add_ict (osip, *transaction);
+    i = __osip_add_ict (osip, *transaction);
+    if (i != 0) {
+      osip_transaction_free (*transaction);
+      *transaction = NULL;
+      return i;
+    }
   }
   else if (ctx_type == IST) {
     (*transaction)->state = IST_PRE_PROCEEDING;
@@ -213,7 +241,12 @@ osip_transaction_init (osip_transaction_t ** transaction, osip_fsm_type_t ctx_ty
       *transaction = NULL;
       return i;
     }
-    __osip_add_ist (osip, *transaction);
+    i = __osip_add_ist (osip, *transaction);
+    if (i != 0) {
+      osip_transaction_free (*transaction);
+      *transaction = NULL;
+      return i;
+    }
   }
   else if (ctx_type == NICT) {
     (*transaction)->state = NICT_PRE_TRYING;
@@ -223,7 +256,12 @@ osip_transaction_init (osip_transaction_t ** transaction, osip_fsm_type_t ctx_ty
       *transaction = NULL;
       return i;
     }
-    __osip_add_nict (osip, *transaction);
+    i = __osip_add_nict (osip, *transaction);
+    if (i != 0) {
+      osip_transaction_free (*transaction);
+      *transaction = NULL;
+      return i;
+    }
   }
   else {
     (*transaction)->state = NIST_PRE_TRYING;
@@ -233,7 +271,12 @@ osip_transaction_init (osip_transaction_t ** transaction, osip_fsm_type_t ctx_ty
       *transaction = NULL;
       return i;
     }
-    __osip_add_nist (osip, *transaction);
+    i = __osip_add_nist (osip, *transaction);
+    if (i != 0) {
+      osip_transaction_free (*transaction);
+      *transaction = NULL;
+      return i;
+    }
   }
   return OSIP_SUCCESS;
 }
@@ -280,28 +323,15 @@ osip_transaction_free2 (osip_transaction_t * transaction)
   if (transaction->orig_request != NULL && transaction->orig_request->call_id != NULL && transaction->orig_request->call_id->number != NULL) {
     OSIP_TRACE (osip_trace (__FILE__, __LINE__, OSIP_INFO2, NULL, "free transaction ressource %i %s\n", transaction->transactionid, transaction->orig_request->call_id->number));
   }
-  if (transaction->ctx_type == ICT) {
-    __osip_ict_free (transaction->ict_context);
-  }
-  else if (transaction->ctx_type == IST) {
-    __osip_ist_free (transaction->ist_context);
-  }
-  else if (transaction->ctx_type == NICT) {
-    __osip_nict_free (transaction->nict_context);
-  }
-  else {
-    __osip_nist_free (transaction->nist_context);
-  }
 
   /* empty the fifo */
   if (transaction->transactionff != NULL) {
     evt = osip_fifo_tryget (transaction->transactionff);
     while (evt != NULL) {
       osip_message_free (evt->sip);
-      osip_free (evt);
+      __osip_event_release (evt);
       evt = osip_fifo_tryget (transaction->transactionff);
     }
-    osip_fifo_free (transaction->transactionff);
   }
 
   osip_message_free (transaction->orig_request);
@@ -314,7 +344,14 @@ osip_transaction_free2 (osip_transaction_t * transaction)
   osip_call_id_free (transaction->callid);
   osip_cseq_free (transaction->cseq);
 
-  osip_free (transaction);
+  osip_dns_cache_release_srv (transaction->record);
+  osip_free (transaction->tombstone);
+
+  /* keep the transaction with its fifo and context if the pool has room */
+  if (__osip_transaction_pool_put (transaction) == OSIP_SUCCESS)
+    return OSIP_SUCCESS;
+
+  __osip_transaction_shell_free (transaction);
   return OSIP_SUCCESS;
 }
 
@@ -326,14 +363,14 @@ osip_transaction_add_event (osip_transaction_t * transaction, osip_event_t * evt
   if (transaction == NULL)
     return OSIP_BADPARAMETER;
   evt->transactionid = transaction->transactionid;
-  osip_fifo_add (transaction->transactionff, evt);
-  return OSIP_SUCCESS;
+  /* the transaction is queued by __osip_transaction_event_added */
+  return osip_fifo_add_node (transaction->transactionff, &evt->node, evt);
 }
 
 int
 osip_transaction_execute (osip_transaction_t * transaction, osip_event_t * evt)
 {
-  osip_statemachine_t *statemachine;
+  const osip_statemachine_t *statemachine;
 
   /* to kill the process, simply send this type of event. */
   if (EVT_IS_KILL_TRANSACTION (evt)) {
@@ -342,7 +379,7 @@ osip_transaction_execute (osip_transaction_t * transaction, osip_event_t * evt)
        So Any usefull data can be save and re-used */
     /* osip_transaction_free(transaction);
        osip_free(transaction); */
-    osip_free (evt);
+    __osip_event_release (evt);
     return OSIP_SUCCESS;
   }
 
@@ -372,7 +409,7 @@ osip_transaction_execute (osip_transaction_t * transaction, osip_event_t * evt)
   else {
     OSIP_TRACE (osip_trace (__FILE__, __LINE__, OSIP_INFO4, NULL, "sipevent evt: method called!\n"));
   }
-  osip_free (evt);              /* this is the ONLY place for freeing event!! */
+  __osip_event_release (evt);   /* this is the ONLY place for freeing event!! */
   return 1;
 }
 
@@ -399,9 +436,17 @@ osip_transaction_get_destination (osip_transaction_t * transaction, char **ip, i
 int
 osip_transaction_set_srv_record (osip_transaction_t * transaction, osip_srv_record_t * record)
 {
-  if (transaction == NULL)
+  osip_srv_record_t *shared;
+
+  if (transaction == NULL || record == NULL)
     return OSIP_BADPARAMETER;
-  memcpy (&transaction->record, record, sizeof (osip_srv_record_t));
+  /* transactions with the same results share the same record */
+  shared = __osip_dns_cache_share_srv (record);
+  if (shared == NULL)
+    return OSIP_NOMEM;
+  osip_dns_cache_release_srv (transaction->record);
+  transaction->record = shared;
+  transaction->record_index = record->index;
   return OSIP_SUCCESS;
 }
 
@@ -541,6 +586,7 @@ __osip_transaction_set_state (osip_transaction_t * transaction, state_t state)
   if (transaction == NULL)
     return OSIP_BADPARAMETER;
   transaction->state = state;
+  __osip_transaction_update_timers (transaction);
   return OSIP_SUCCESS;
 }
 
@@ -643,7 +689,7 @@ __osip_transaction_matching_response_osip_to_xict_17_1_3 (osip_transaction_t * t
      branch parameter.
      AMD NOTE: cseq->method is ALWAYS the same than the METHOD of the request.
    */
-  if (0 == strcmp (response->cseq->method, tr->cseq->method))   /* general case */
+  if (__osip_cseq_same_method (response->cseq, tr->cseq))      /* general case */
     return OSIP_SUCCESS;
   return OSIP_UNDEFINED_ERROR;
 }
@@ -734,8 +780,8 @@ __osip_transaction_matching_request_osip_to_xist_17_2_3 (osip_transaction_t * tr
 #endif
       if (                      /* MSG_IS_CANCEL(request)&& <<-- BUG from the spec?
                                    I always check the CSeq */
-           (!(0 == strcmp (tr->cseq->method, "INVITE") && 0 == strcmp (request->cseq->method, "ACK")))
-           && 0 != strcmp (tr->cseq->method, request->cseq->method))
+           (!(__osip_cseq_is_method (tr->cseq, OSIP_METHOD_INVITE, "INVITE") && __osip_cseq_is_method (request->cseq, OSIP_METHOD_ACK, "ACK")))
+           && !__osip_cseq_same_method (tr->cseq, request->cseq))
         return OSIP_UNDEFINED_ERROR;
       return OSIP_SUCCESS;
     }
@@ -792,13 +838,284 @@ __osip_transaction_need_timer_x_event (void *xixt, struct timeval * timer, int c
   return NULL;
 }
 
+/* get the wire bytes of msg: they are built once by osip_message_to_str
+   and kept in the message. */
+static int
+__osip_message_get_wire (osip_message_t * msg, const char **buf, size_t * length)
+{
+  if (osip_message_get__property (msg) != 1 || msg->message == NULL) {
+    char *dest;
+    size_t dest_length;
+    int i;
+
+    i = osip_message_to_str (msg, &dest, &dest_length);
+    if (i != 0)
+      return i;
+    osip_free (dest);
+    if (msg->message == NULL)
+      return OSIP_NOMEM;
+  }
+  *buf = msg->message;
+  *length = msg->message_length;
+  return OSIP_SUCCESS;
+}
+
+#define OSIP_SEND_BATCH_MAX 64  /* the batch is flushed when it is full */
+
+struct osip_batch_entry {
+  size_t offset;                /* of the message in data */
+  size_t length;
+  size_t host_offset;           /* of the host in data, or -1 */
+  int port;
+  int out_socket;
+  int transactionid;
+};
+
+struct osip_send_batch {
+#ifndef OSIP_MONOTHREAD
+  struct osip_mutex *mutex;
+#endif
+  struct osip_batch_entry entries[OSIP_SEND_BATCH_MAX];
+  int nb;
+  char *data;                   /* copies of the messages and hosts */
+  size_t length;
+  size_t size;
+};
+
 int
-__osip_transaction_snd_xxx (osip_transaction_t * ist, osip_message_t * msg)
+__osip_send_batch_init (struct osip_send_batch **batch)
+{
+  *batch = (struct osip_send_batch *) osip_malloc (sizeof (struct osip_send_batch));
+  if (*batch == NULL)
+    return OSIP_NOMEM;
+  memset (*batch, 0, sizeof (struct osip_send_batch));
+#ifndef OSIP_MONOTHREAD
+  (*batch)->mutex = osip_mutex_init ();
+  if ((*batch)->mutex == NULL) {
+    osip_free (*batch);
+    *batch = NULL;
+    return OSIP_NOMEM;
+  }
+#endif
+  return OSIP_SUCCESS;
+}
+
+void
+__osip_send_batch_free (struct osip_send_batch *batch)
+{
+  if (batch == NULL)
+    return;
+#ifndef OSIP_MONOTHREAD
+  osip_mutex_destroy (batch->mutex);
+#endif
+  osip_free (batch->data);
+  osip_free (batch);
+}
+
+static void
+__osip_send_batch_post_error (osip_transaction_t * tr, void *arg)
+{
+  osip_transaction_add_event (tr, (osip_event_t *) arg);
+}
+
+/* the event is executed by the transaction like its other events */
+static void
+__osip_send_batch_report (osip_t * osip, int transactionid, int error)
+{
+  osip_event_t *evt;
+
+  if (transactionid <= 0)
+    return;
+  evt = __osip_event_new (TRANSPORT_ERROR, transactionid);
+  if (evt == NULL)
+    return;
+  evt->error = error;
+  if (osip_transaction_call_by_id (osip, transactionid, &__osip_send_batch_post_error, evt) != OSIP_SUCCESS)
+    __osip_event_release (evt);     /* already released */
+}
+
+int
+osip_send_batch_flush (osip_t * osip)
+{
+  struct osip_send_batch *batch;
+  struct osip_batch_entry entries[OSIP_SEND_BATCH_MAX];
+  osip_batch_message_t messages[OSIP_SEND_BATCH_MAX];
+  char *data;
+  size_t size;
+  int nb;
+  int i;
+  int k;
+
+  if (osip == NULL)
+    return OSIP_BADPARAMETER;
+  if (osip->cb_send_batch == NULL)
+    return OSIP_SUCCESS;
+  batch = osip->send_batch;
+
+  /* take the messages: others may fill the batch again meanwhile */
+#ifndef OSIP_MONOTHREAD
+  osip_mutex_lock (batch->mutex);
+#endif
+  nb = batch->nb;
+  if (nb == 0) {
+#ifndef OSIP_MONOTHREAD
+    osip_mutex_unlock (batch->mutex);
+#endif
+    return OSIP_SUCCESS;
+  }
+  memcpy (entries, batch->entries, nb * sizeof (struct osip_batch_entry));
+  data = batch->data;
+  size = batch->size;
+  batch->nb = 0;
+  batch->data = NULL;
+  batch->length = 0;
+  batch->size = 0;
+#ifndef OSIP_MONOTHREAD
+  osip_mutex_unlock (batch->mutex);
+#endif
+
+  for (i = 0; i < nb; i++) {
+    messages[i].buf = data + entries[i].offset;
+    messages[i].length = entries[i].length;
+    messages[i].host = (entries[i].host_offset == (size_t) - 1) ? NULL : data + entries[i].host_offset;
+    messages[i].port = entries[i].port;
+    messages[i].out_socket = entries[i].out_socket;
+    messages[i].transactionid = entries[i].transactionid;
+    messages[i].result = OSIP_SUCCESS;
+  }
+  i = osip->cb_send_batch (osip, messages, nb);
+  for (k = 0; k < nb; k++) {
+    if (messages[k].result == OSIP_SUCCESS && i < 0)
+      messages[k].result = i;
+    if (messages[k].result != OSIP_SUCCESS)
+      __osip_send_batch_report (osip, messages[k].transactionid, messages[k].result);
+  }
+
+  /* keep the buffer for the next batch */
+#ifndef OSIP_MONOTHREAD
+  osip_mutex_lock (batch->mutex);
+#endif
+  if (batch->data == NULL) {
+    batch->data = data;
+    batch->size = size;
+    data = NULL;
+  }
+#ifndef OSIP_MONOTHREAD
+  osip_mutex_unlock (batch->mutex);
+#endif
+  osip_free (data);
+  return i;
+}
+
+static int
+__osip_send_batch_add (osip_t * osip, osip_transaction_t * tr, const char *buf, size_t length, char *host, int port, int out_socket)
+{
+  struct osip_send_batch *batch = osip->send_batch;
+  struct osip_batch_entry *entry;
+  size_t host_length;
+  int full;
+
+  host_length = (host != NULL) ? strlen (host) + 1 : 0;
+
+  for (;;) {
+#ifndef OSIP_MONOTHREAD
+    osip_mutex_lock (batch->mutex);
+#endif
+    if (batch->nb < OSIP_SEND_BATCH_MAX)
+      break;
+#ifndef OSIP_MONOTHREAD
+    osip_mutex_unlock (batch->mutex);
+#endif
+    osip_send_batch_flush (osip);
+  }
+
+  if (batch->length + length + host_length > batch->size) {
+    size_t size = batch->size * 2;
+    char *data;
+
+    if (size < batch->length + length + host_length)
+      size = batch->length + length + host_length;
+    if (size < SIP_MESSAGE_MAX_LENGTH)
+      size = SIP_MESSAGE_MAX_LENGTH;
+    data = (char *) osip_realloc (batch->data, size);
+    if (data == NULL) {
+#ifndef OSIP_MONOTHREAD
+      osip_mutex_unlock (batch->mutex);
+#endif
+      return OSIP_NOMEM;
+    }
+    batch->data = data;
+    batch->size = size;
+  }
+
+  entry = &batch->entries[batch->nb++];
+  entry->offset = batch->length;
+  entry->length = length;
+  memcpy (batch->data + batch->length, buf, length);
+  batch->length += length;
+  entry->host_offset = (size_t) - 1;
+  if (host != NULL) {
+    entry->host_offset = batch->length;
+    memcpy (batch->data + batch->length, host, host_length);
+    batch->length += host_length;
+  }
+  entry->port = port;
+  entry->out_socket = out_socket;
+  entry->transactionid = (tr != NULL) ? tr->transactionid : 0;
+  full = (batch->nb == OSIP_SEND_BATCH_MAX);
+#ifndef OSIP_MONOTHREAD
+  osip_mutex_unlock (batch->mutex);
+#endif
+
+  if (full)
+    osip_send_batch_flush (osip);
+  return OSIP_SUCCESS;
+}
+
+/* send the wire bytes of a message with cb_send_batch or cb_send_raw */
+static int
+__osip_transaction_send_wire (osip_t * osip, osip_transaction_t * tr, const char *buf, size_t length, char *host, int port, int out_socket)
+{
+  if (osip->cb_send_batch != NULL)
+    return __osip_send_batch_add (osip, tr, buf, length, host, port, out_socket);
+  return osip->cb_send_raw (tr, buf, length, host, port, out_socket);
+}
+
+int
+__osip_transaction_send (osip_t * osip, osip_transaction_t * tr, osip_message_t * msg, char *host, int port, int out_socket)
+{
+  const char *buf;
+  size_t length;
+  int i;
+
+  if (osip->cb_send_batch == NULL)
+    return osip->cb_send_message (tr, msg, host, port, out_socket);
+  i = __osip_message_get_wire (msg, &buf, &length);
+  if (i != 0)
+    return i;
+  return __osip_send_batch_add (osip, tr, buf, length, host, port, out_socket);
+}
+
+int
+__osip_transaction_resend (osip_t * osip, osip_transaction_t * tr, osip_message_t * msg, char *host, int port, int out_socket)
+{
+  const char *buf;
+  size_t length;
+  int i;
+
+  if (osip->cb_send_batch == NULL && osip->cb_send_raw == NULL)
+    return osip->cb_send_message (tr, msg, host, port, out_socket);
+  i = __osip_message_get_wire (msg, &buf, &length);
+  if (i != 0)
+    return i;
+  return __osip_transaction_send_wire (osip, tr, buf, length, host, port, out_socket);
+}
+
+/* get the destination of a response from its top Via */
+static int
+__osip_response_destination (osip_message_t * msg, char **host, int *port)
 {
-  osip_t *osip = (osip_t *) ist->config;
   osip_via_t *via;
-  char *host;
-  int port;
   osip_generic_param_t *maddr;
   osip_generic_param_t *received;
   osip_generic_param_t *rport;
@@ -816,24 +1133,329 @@ __osip_transaction_snd_xxx (osip_transaction_t * ist, osip_message_t * msg)
      open socket attached to this transaction. */
   /* 2: check maddr and multicast usage */
   if (maddr != NULL)
-    host = maddr->gvalue;
+    *host = maddr->gvalue;
   /* we should check if this is a multicast address and use
      set the "ttl" in this case. (this must be done in the
      UDP message (not at the SIP layer) */
   else if (received != NULL)
-    host = received->gvalue;
+    *host = received->gvalue;
   else
-    host = via->host;
+    *host = via->host;
 
   if (rport == NULL || rport->gvalue == NULL) {
     if (via->port != NULL)
-      port = osip_atoi (via->port);
+      *port = osip_atoi (via->port);
     else
-      port = 5060;
+      *port = 5060;
   }
   else
-    port = osip_atoi (rport->gvalue);
+    *port = osip_atoi (rport->gvalue);
+  return OSIP_SUCCESS;
+}
+
+static int
+__osip_transaction_snd_response (osip_transaction_t * ist, osip_message_t * msg, int resend)
+{
+  osip_t *osip = (osip_t *) ist->config;
+  char *host;
+  int port;
+  int i;
 
-  return osip->cb_send_message (ist, msg, host, port, ist->out_socket);
+  i = __osip_response_destination (msg, &host, &port);
+  if (i != 0)
+    return i;
+  if (resend)
+    return __osip_transaction_resend (osip, ist, msg, host, port, ist->out_socket);
+  return __osip_transaction_send (osip, ist, msg, host, port, ist->out_socket);
+}
+
+int
+__osip_transaction_snd_xxx (osip_transaction_t * ist, osip_message_t * msg)
+{
+  return __osip_transaction_snd_response (ist, msg, 0);
+}
+
+int
+__osip_transaction_resnd_xxx (osip_transaction_t * ist, osip_message_t * msg)
+{
+  return __osip_transaction_snd_response (ist, msg, 1);
+}
+
+int
+__osip_transaction_compact (osip_transaction_t * tr)
+{
+  osip_t *osip = (osip_t *) tr->config;
+  osip_generic_param_t *branch = NULL;
+  struct osip_tombstone *tombstone;
+  const char *buf = NULL;
+  size_t length = 0;
+  char *host = NULL;
+  size_t host_length = 0;
+  int port = 0;
+  int i;
+
+  if (!osip->tombstone_mode || tr->tombstone != NULL || tr->topvia == NULL || tr->cseq == NULL || tr->last_response == NULL)
+    return OSIP_SUCCESS;
+  /* the retransmissions must be matched with the branch only */
+  osip_via_param_get_byname (tr->topvia, "branch", &branch);
+  if (branch == NULL || branch->gvalue == NULL || 0 != strncmp (branch->gvalue, "z9hG4bK", 7))
+    return OSIP_SUCCESS;
+
+  if (tr->ctx_type == NIST) {
+    /* the response is sent again without its structure */
+    if (osip->cb_send_raw == NULL && osip->cb_send_batch == NULL)
+      return OSIP_SUCCESS;
+    i = __osip_response_destination (tr->last_response, &host, &port);
+    if (i != 0)
+      return i;
+    i = __osip_message_get_wire (tr->last_response, &buf, &length);
+    if (i != 0)
+      return i;
+    host_length = (host != NULL) ? strlen (host) + 1 : 0;
+  }
+
+  tombstone = (struct osip_tombstone *) osip_malloc (sizeof (struct osip_tombstone) + length + host_length);
+  if (tombstone == NULL)
+    return OSIP_NOMEM;
+  tombstone->status_code = tr->last_response->status_code;
+  tombstone->response = NULL;
+  tombstone->length = length;
+  tombstone->host = NULL;
+  tombstone->port = port;
+  if (buf != NULL) {
+    tombstone->response = (char *) (tombstone + 1);
+    memcpy (tombstone->response, buf, length);
+  }
+  if (host != NULL) {
+    tombstone->host = (char *) (tombstone + 1) + length;
+    memcpy (tombstone->host, host, host_length);
+  }
+  tr->tombstone = tombstone;
+
+  /* the top Via and the CSeq are kept to match the requests */
+  osip_message_free (tr->orig_request);
+  tr->orig_request = NULL;
+  osip_message_free (tr->last_response);
+  tr->last_response = NULL;
+  osip_message_free (tr->ack);
+  tr->ack = NULL;
+  osip_from_free (tr->from);
+  tr->from = NULL;
+  osip_to_free (tr->to);
+  tr->to = NULL;
+  osip_call_id_free (tr->callid);
+  tr->callid = NULL;
+  return OSIP_SUCCESS;
+}
+
+int
+__osip_transaction_resnd_tombstone (osip_transaction_t * tr)
+{
+  struct osip_tombstone *tombstone = tr->tombstone;
+  osip_t *osip = (osip_t *) tr->config;
+
+  if (tombstone->response == NULL)
+    return OSIP_SUCCESS;
+  /* both callbacks were removed after the compaction: the response
+     is lost and the transaction is terminated */
+  if (osip->cb_send_raw == NULL && osip->cb_send_batch == NULL)
+    return OSIP_NO_NETWORK;
+  return __osip_transaction_send_wire (osip, tr, tombstone->response, tombstone->length, tombstone->host, tombstone->port, tr->out_socket);
+}
 
+/*
+  Pool of transactions: osip_transaction_free2() keeps the released
+  transactions with their fifo and the context of their state machine,
+  and osip_transaction_init() resets them in place. Each type of
+  transaction has its own stack of idle transactions, bounded by a
+  high-water mark (0: the pool is not used).
+*/
+
+#define OSIP_TRANSACTION_POOL_TYPES 4   /* ICT, IST, NICT and NIST */
+
+struct osip_transaction_stack {
+  osip_transaction_t **shells;
+  int count;
+  int high_water;
+};
+
+struct osip_transaction_pool {
+#ifndef OSIP_MONOTHREAD
+  struct osip_mutex *mutex;
+#endif
+  struct osip_transaction_stack types[OSIP_TRANSACTION_POOL_TYPES];
+};
+
+int
+__osip_transaction_pool_init (struct osip_transaction_pool **pool)
+{
+  *pool = (struct osip_transaction_pool *) osip_malloc (sizeof (struct osip_transaction_pool));
+  if (*pool == NULL)
+    return OSIP_NOMEM;
+  memset (*pool, 0, sizeof (struct osip_transaction_pool));
+#ifndef OSIP_MONOTHREAD
+  (*pool)->mutex = osip_mutex_init ();
+  if ((*pool)->mutex == NULL) {
+    osip_free (*pool);
+    *pool = NULL;
+    return OSIP_NOMEM;
+  }
+#endif
+  return OSIP_SUCCESS;
+}
+
+static void
+__osip_transaction_shell_free (osip_transaction_t * tr)
+{
+  if (tr->ctx_type == ICT)
+    __osip_ict_free (tr->ict_context);
+  else if (tr->ctx_type == IST)
+    __osip_ist_free (tr->ist_context);
+  else if (tr->ctx_type == NICT)
+    __osip_nict_free (tr->nict_context);
+  else
+    __osip_nist_free (tr->nist_context);
+  osip_fifo_free (tr->transactionff);
+  osip_free (tr);
+}
+
+void
+__osip_transaction_pool_free (struct osip_transaction_pool *pool)
+{
+  int i;
+
+  if (pool == NULL)
+    return;
+  for (i = 0; i < OSIP_TRANSACTION_POOL_TYPES; i++) {
+    while (pool->types[i].count > 0)
+      __osip_transaction_shell_free (pool->types[i].shells[--pool->types[i].count]);
+    osip_free (pool->types[i].shells);
+  }
+#ifndef OSIP_MONOTHREAD
+  osip_mutex_destroy (pool->mutex);
+#endif
+  osip_free (pool);
+}
+
+osip_transaction_t *
+__osip_transaction_pool_get (osip_t * osip, osip_fsm_type_t type)
+{
+  struct osip_transaction_pool *pool;
+  osip_transaction_t *tr = NULL;
+
+  if (osip == NULL || osip->transaction_pool == NULL || (int) type < 0 || type >= OSIP_TRANSACTION_POOL_TYPES)
+    return NULL;
+  pool = osip->transaction_pool;
+#ifndef OSIP_MONOTHREAD
+  osip_mutex_lock (pool->mutex);
+#endif
+  if (pool->types[type].count > 0)
+    tr = pool->types[type].shells[--pool->types[type].count];
+#ifndef OSIP_MONOTHREAD
+  osip_mutex_unlock (pool->mutex);
+#endif
+  return tr;
+}
+
+/* the messages and elements of the transaction must be released */
+int
+__osip_transaction_pool_put (osip_transaction_t * tr)
+{
+  osip_t *osip = (osip_t *) tr->config;
+  struct osip_transaction_pool *pool;
+  struct osip_transaction_stack *stack;
+  osip_fsm_type_t type = tr->ctx_type;
+  osip_fifo_t *ff = tr->transactionff;
+  void *context;
+
+  if (osip == NULL || osip->transaction_pool == NULL || (int) type < 0 || type >= OSIP_TRANSACTION_POOL_TYPES || ff == NULL)
+    return OSIP_UNDEFINED_ERROR;
+  if (type == ICT)
+    context = tr->ict_context;
+  else if (type == IST)
+    context = tr->ist_context;
+  else if (type == NICT)
+    context = tr->nict_context;
+  else
+    context = tr->nist_context;
+  if (context == NULL)
+    return OSIP_UNDEFINED_ERROR;
+
+  pool = osip->transaction_pool;
+  stack = &pool->types[type];
+
+  /* the context is cleared by __osip_*_init */
+  if (type == ICT) {
+    osip_free (tr->ict_context->destination);
+    tr->ict_context->destination = NULL;
+  }
+  else if (type == NICT) {
+    osip_free (tr->nict_context->destination);
+    tr->nict_context->destination = NULL;
+  }
+  memset (tr, 0, sizeof (osip_transaction_t));
+  tr->ctx_type = type;
+  tr->transactionff = ff;
+  if (type == ICT)
+    tr->ict_context = (osip_ict_t *) context;
+  else if (type == IST)
+    tr->ist_context = (osip_ist_t *) context;
+  else if (type == NICT)
+    tr->nict_context = (osip_nict_t *) context;
+  else
+    tr->nist_context = (osip_nist_t *) context;
+#ifndef OSIP_LIST_ARRAY
+  tr->list_link = NULL;
+#else
+  tr->list_pos = -1;
+#endif
+
+#ifndef OSIP_MONOTHREAD
+  osip_mutex_lock (pool->mutex);
+#endif
+  /* high_water is 0 when the pool is not used */
+  if (stack->count < stack->high_water) {
+    stack->shells[stack->count++] = tr;
+    tr = NULL;
+  }
+#ifndef OSIP_MONOTHREAD
+  osip_mutex_unlock (pool->mutex);
+#endif
+  if (tr != NULL)               /* the pool is full or not used */
+    __osip_transaction_shell_free (tr);
+  return OSIP_SUCCESS;
+}
+
+int
+osip_set_transaction_pool (osip_t * osip, osip_fsm_type_t type, int high_water)
+{
+  struct osip_transaction_pool *pool;
+  struct osip_transaction_stack *stack;
+  osip_transaction_t **shells = NULL;
+
+  if (osip == NULL || osip->transaction_pool == NULL || (int) type < 0 || type >= OSIP_TRANSACTION_POOL_TYPES || high_water < 0)
+    return OSIP_BADPARAMETER;
+  if (high_water > 0) {
+    shells = (osip_transaction_t **) osip_malloc (high_water * sizeof (osip_transaction_t *));
+    if (shells == NULL)
+      return OSIP_NOMEM;
+  }
+
+  pool = osip->transaction_pool;
+  stack = &pool->types[type];
+#ifndef OSIP_MONOTHREAD
+  osip_mutex_lock (pool->mutex);
+#endif
+  /* release the transactions over the new mark */
+  while (stack->count > high_water)
+    __osip_transaction_shell_free (stack->shells[--stack->count]);
+  if (stack->count > 0)
+    memcpy (shells, stack->shells, stack->count * sizeof (osip_transaction_t *));
+  osip_free (stack->shells);
+  stack->shells = shells;
+  stack->high_water = high_water;
+#ifndef OSIP_MONOTHREAD
+  osip_mutex_unlock (pool->mutex);
+#endif
+  return OSIP_SUCCESS;
 }
@@ -22,6 +22,57 @@
 #include <osipparser2/osip_port.h>
 #include <osip2/osip_fifo.h>
 
+/*
+  Multi-producer queue of nodes (D. Vyukov): osip_fifo_add exchanges the
+  tail of the fifo with the new node, then links the previous tail to
+  it. The thread getting an element walks from the head; the stub node
+  keeps one node in the fifo when it is empty.
+
+  Getting elements is protected by a spin lock (consumer), which is only
+  contended when several threads get elements from the same fifo.
+  Without atomic operations, all calls are protected by a mutex.
+*/
+
+#if defined(OSIP_MONOTHREAD) || !defined(OSIP_HAVE_ATOMICS)
+
+static osip_fifo_node_t *
+__osip_fifo_exchange (osip_fifo_node_t ** pp, osip_fifo_node_t * v)
+{
+  osip_fifo_node_t *old = *pp;
+
+  *pp = v;
+  return old;
+}
+
+#define __fifo_load_int(p) (*(p))
+#define __fifo_add_int(p, v) (*(p) += (v))
+#define __fifo_load_ptr(pp) (*(pp))
+#define __fifo_store_ptr(pp, v) (*(pp) = (v))
+#define __fifo_exchange_ptr(pp, v) __osip_fifo_exchange ((pp), (v))
+#else
+#define __fifo_load_int(p) osip_atomic_load_int (p)
+#define __fifo_add_int(p, v) osip_atomic_add_int ((p), (v))
+#define __fifo_load_ptr(pp) osip_atomic_load_ptr (pp)
+#define __fifo_store_ptr(pp, v) osip_atomic_store_ptr ((pp), (v))
+#define __fifo_exchange_ptr(pp, v) osip_atomic_exchange_ptr ((pp), (v))
+#endif
+
+#if defined(OSIP_MONOTHREAD)
+#define __fifo_lock(ff)
+#define __fifo_unlock(ff)
+#define __fifo_consumer_lock(ff)
+#define __fifo_consumer_unlock(ff)
+#elif !defined(OSIP_HAVE_ATOMICS)
+#define __fifo_lock(ff) osip_mutex_lock ((ff)->qislocked)
+#define __fifo_unlock(ff) osip_mutex_unlock ((ff)->qislocked)
+#define __fifo_consumer_lock(ff) osip_mutex_lock ((ff)->qislocked)
+#define __fifo_consumer_unlock(ff) osip_mutex_unlock ((ff)->qislocked)
+#else
+#define __fifo_lock(ff)
+#define __fifo_unlock(ff)
+#define __fifo_consumer_lock(ff) do {} while (osip_atomic_exchange_int (&(ff)->consumer, 1) != 0)
+#define __fifo_consumer_unlock(ff) osip_atomic_store_int (&(ff)->consumer, 0)
+#endif
 
 /* always use this method to initiate osip_fifo_t.
 */
@@ -29,47 +80,137 @@ void
 osip_fifo_init (osip_fifo_t * ff)
 {
 #ifndef OSIP_MONOTHREAD
+#ifdef OSIP_HAVE_ATOMICS
+  ff->qislocked = NULL;
+#else
   ff->qislocked = osip_mutex_init ();
-  /*INIT SEMA TO BLOCK ON GET() WHEN QUEUE IS EMPTY */
-  ff->qisempty = osip_sem_init (0);
 #endif
-  osip_list_init (&ff->queue);
-  /* ff->nb_elt = 0; */
-  ff->state = osip_empty;
+  /* the semaphore is only needed to block in osip_fifo_get() */
+  ff->qisempty = NULL;
+  ff->waiters = 0;
+  ff->consumer = 0;
+#endif
+  ff->stub.next = NULL;
+  ff->stub.element = NULL;
+  ff->stub.allocated = 0;
+  ff->head = &ff->stub;
+  ff->tail = &ff->stub;
+  ff->nb_elt = 0;
+  ff->added = NULL;
+  ff->added_arg = NULL;
 }
 
-int
-osip_fifo_add (osip_fifo_t * ff, void *el)
+static void
+__osip_fifo_push (osip_fifo_t * ff, osip_fifo_node_t * node)
+{
+  osip_fifo_node_t *prev;
+
+  node->next = NULL;
+  prev = __fifo_exchange_ptr (&ff->tail, node);
+  /* until then, the node can't be reached from the head */
+  __fifo_store_ptr (&prev->next, node);
+}
+
+/* the consumer lock must be held */
+static osip_fifo_node_t *
+__osip_fifo_pop (osip_fifo_t * ff)
 {
+  osip_fifo_node_t *head = ff->head;
+  osip_fifo_node_t *next = __fifo_load_ptr (&head->next);
+
+  if (head == &ff->stub) {
+    if (next == NULL)
+      return NULL;
+    ff->head = next;
+    head = next;
+    next = __fifo_load_ptr (&next->next);
+  }
+  if (next != NULL) {
+    ff->head = next;
+    return head;
+  }
+  if (head != __fifo_load_ptr (&ff->tail))
+    return NULL;                /* an element is being added */
+  /* head is the last node: put the stub behind it */
+  __osip_fifo_push (ff, &ff->stub);
+  next = __fifo_load_ptr (&head->next);
+  if (next != NULL) {
+    ff->head = next;
+    return head;
+  }
+  return NULL;
+}
+
+/* wake up the threads blocked in osip_fifo_get() after adding an element */
 #ifndef OSIP_MONOTHREAD
-  osip_mutex_lock (ff->qislocked);
+#define __osip_fifo_wakeup(ff, waiters) do { if ((waiters) > 0) osip_sem_post (__fifo_load_ptr (&(ff)->qisempty)); } while (0)
+#else
+#define __osip_fifo_wakeup(ff, waiters) (void) (waiters)
 #endif
 
-  osip_list_add (&ff->queue, el, -1);   /* insert at end of queue */
-  ff->state = osip_ok;
+static int
+__osip_fifo_add (osip_fifo_t * ff, osip_fifo_node_t * node, void *el)
+{
+  int waiters = 0;
 
+  node->element = el;
+  __fifo_lock (ff);
+  __fifo_add_int (&ff->nb_elt, 1);
+  __osip_fifo_push (ff, node);
 #ifndef OSIP_MONOTHREAD
-  osip_sem_post (ff->qisempty);
-  osip_mutex_unlock (ff->qislocked);
+  waiters = __fifo_load_int (&ff->waiters);
 #endif
+  __fifo_unlock (ff);
+  __osip_fifo_wakeup (ff, waiters);
+  if (ff->added != NULL)
+    ff->added (ff->added_arg);
   return OSIP_SUCCESS;
 }
 
+int
+osip_fifo_add (osip_fifo_t * ff, void *el)
+{
+  osip_fifo_node_t *node = (osip_fifo_node_t *) osip_malloc (sizeof (osip_fifo_node_t));
+
+  if (node == NULL)
+    return OSIP_NOMEM;
+  node->allocated = 1;
+  return __osip_fifo_add (ff, node, el);
+}
+
+int
+osip_fifo_add_node (osip_fifo_t * ff, osip_fifo_node_t * node, void *el)
+{
+  if (ff == NULL || node == NULL)
+    return OSIP_BADPARAMETER;
+  node->allocated = 0;
+  return __osip_fifo_add (ff, node, el);
+}
+
 
 int
 osip_fifo_insert (osip_fifo_t * ff, void *el)
 {
-#ifndef OSIP_MONOTHREAD
-  osip_mutex_lock (ff->qislocked);
-#endif
+  osip_fifo_node_t *node = (osip_fifo_node_t *) osip_malloc (sizeof (osip_fifo_node_t));
+  int waiters = 0;
 
-  osip_list_add (&ff->queue, el, 0);    /* insert at end of queue */
-  ff->state = osip_ok;
+  if (node == NULL)
+    return OSIP_NOMEM;
+  node->allocated = 1;
+  node->element = el;
 
+  /* the head is only used by the threads getting elements */
+  __fifo_consumer_lock (ff);
+  node->next = ff->head;
+  ff->head = node;
+  __fifo_add_int (&ff->nb_elt, 1);
 #ifndef OSIP_MONOTHREAD
-  osip_sem_post (ff->qisempty);
-  osip_mutex_unlock (ff->qislocked);
+  waiters = __fifo_load_int (&ff->waiters);
 #endif
+  __fifo_consumer_unlock (ff);
+  __osip_fifo_wakeup (ff, waiters);
+  if (ff->added != NULL)
+    ff->added (ff->added_arg);
   return OSIP_SUCCESS;
 }
 
@@ -79,104 +220,94 @@ osip_fifo_size (osip_fifo_t * ff)
 {
   int i;
 
-#ifndef OSIP_MONOTHREAD
-  osip_mutex_lock (ff->qislocked);
-#endif
-
-  i = osip_list_size (&ff->queue);
-#ifndef OSIP_MONOTHREAD
-  osip_mutex_unlock (ff->qislocked);
-#endif
+  __fifo_lock (ff);
+  i = __fifo_load_int (&ff->nb_elt);
+  __fifo_unlock (ff);
   return i;
 }
 
 
 void *
-osip_fifo_get (osip_fifo_t * ff)
+osip_fifo_tryget (osip_fifo_t * ff)
 {
-  void *el = NULL;
+  osip_fifo_node_t *node;
+  void *el;
 
-#ifndef OSIP_MONOTHREAD
-  int i = osip_sem_wait (ff->qisempty);
+  __fifo_consumer_lock (ff);
+  node = __osip_fifo_pop (ff);
+  if (node != NULL)
+    __fifo_add_int (&ff->nb_elt, -1);
+  __fifo_consumer_unlock (ff);
 
-  if (i != 0)
+  if (node == NULL)
     return NULL;
-  osip_mutex_lock (ff->qislocked);
-#endif
-
-  if (ff->state != osip_empty) {
-    el = osip_list_get (&ff->queue, 0);
-    osip_list_remove (&ff->queue, 0);
-    /* ff->nb_elt--; */
-  }
-  else {
-    OSIP_TRACE (osip_trace (__FILE__, __LINE__, OSIP_ERROR, NULL, "no element in fifo.\n"));
-#ifndef OSIP_MONOTHREAD
-    osip_mutex_unlock (ff->qislocked);
-#endif
-    return OSIP_SUCCESS;        /* pile vide */
-  }
-  /* if (ff->nb_elt <= 0) */
-  if (osip_list_size (&ff->queue) <= 0)
-    ff->state = osip_empty;
-  else
-    ff->state = osip_ok;
-
-#ifndef OSIP_MONOTHREAD
-  osip_mutex_unlock (ff->qislocked);
-#endif
+  el = node->element;
+  if (node->allocated)
+    osip_free (node);
   return el;
 }
 
+#ifndef OSIP_MONOTHREAD
 void *
-osip_fifo_tryget (osip_fifo_t * ff)
+osip_fifo_get (osip_fifo_t * ff)
 {
-  void *el = NULL;
+  for (;;) {
+    void *el = osip_fifo_tryget (ff);
+    int i = 0;
 
-#ifndef OSIP_MONOTHREAD
-  if (0 != osip_sem_trywait (ff->qisempty)) {   /* no elements... */
-    return NULL;
-  }
-  osip_mutex_lock (ff->qislocked);
+    if (el != NULL)
+      return el;
+
+    __fifo_lock (ff);
+    if (__fifo_load_ptr (&ff->qisempty) == NULL) {
+      struct osip_sem *sem = osip_sem_init (0);
+
+      if (sem == NULL) {
+        __fifo_unlock (ff);
+        return NULL;
+      }
+#if defined(OSIP_HAVE_ATOMICS)
+      if (!osip_atomic_cas_ptr (&ff->qisempty, NULL, sem))
+        osip_sem_destroy (sem);
 #else
-  if (ff->state == osip_empty)
-    return NULL;
+      ff->qisempty = sem;
 #endif
+    }
+    /* an element added from now on posts the semaphore */
+    __fifo_add_int (&ff->waiters, 1);
+    __fifo_unlock (ff);
 
-  if (ff->state != osip_empty) {
-    el = osip_list_get (&ff->queue, 0);
-    osip_list_remove (&ff->queue, 0);
-    /* ff->nb_elt--; */
-  }
-#ifndef OSIP_MONOTHREAD
-  else {                        /* this case MUST never happen... */
-    OSIP_TRACE (osip_trace (__FILE__, __LINE__, OSIP_INFO4, NULL, "no element in fifo.\n"));
-    osip_mutex_unlock (ff->qislocked);
-    return OSIP_SUCCESS;
+    el = osip_fifo_tryget (ff);
+    if (el == NULL)
+      i = osip_sem_wait (ff->qisempty);
+    __fifo_lock (ff);
+    __fifo_add_int (&ff->waiters, -1);
+    __fifo_unlock (ff);
+    if (el != NULL)
+      return el;
+    if (i != 0)
+      return NULL;
   }
-#endif
-
-  /* if (ff->nb_elt <= 0) */
-  if (osip_list_size (&ff->queue) <= 0)
-    ff->state = osip_empty;
-  else
-    ff->state = osip_ok;
-
-#ifndef OSIP_MONOTHREAD
-  osip_mutex_unlock (ff->qislocked);
-#endif
-  return el;
 }
+#endif
 
 void
 osip_fifo_free (osip_fifo_t * ff)
 {
+  osip_fifo_node_t *node;
+
   if (ff == NULL)
     return;
+  /* elements still in the fifo are not released */
+  while ((node = __osip_fifo_pop (ff)) != NULL) {
+    if (node->allocated)
+      osip_free (node);
+  }
 #ifndef OSIP_MONOTHREAD
-  osip_mutex_destroy (ff->qislocked);
-  /* seems that pthread_mutex_destroy does not free space by itself */
-  osip_sem_destroy (ff->qisempty);
+  if (ff->qislocked != NULL)
+    osip_mutex_destroy (ff->qislocked);
+  if (ff->qisempty != NULL)
+    osip_sem_destroy (ff->qisempty);
 #endif
   osip_free (ff);
 }
@@ -28,6 +28,16 @@
 extern "C" {
 #endif
 
+/* compare the method of a CSeq header with a known method: the
+   name is compared when no code was computed for the method. */
+#define __osip_cseq_is_method(cseq,code,name) ((cseq)->method_code!=OSIP_METHOD_UNKNOWN ? \
+			(cseq)->method_code==(code) : 0==strcmp((cseq)->method,(name)))
+/* compare the methods of two CSeq headers: the names are compared
+   when a method has no code. */
+#define __osip_cseq_same_method(cseq1,cseq2) \
+			((cseq1)->method_code!=OSIP_METHOD_UNKNOWN && (cseq2)->method_code!=OSIP_METHOD_UNKNOWN ? \
+			 (cseq1)->method_code==(cseq2)->method_code : 0==strcmp((cseq1)->method,(cseq2)->method))
+
 
   void __osip_message_callback (int type, osip_transaction_t *, osip_message_t *);
   void __osip_kill_transaction_callback (int type, osip_transaction_t *);
@@ -303,6 +313,112 @@ extern "C" {
  */
   int __osip_remove_nist_transaction (osip_t * osip, osip_transaction_t * nist);
 
+/**
+ * Allocate an index of transactions.
+ * NOTE: THIS IS AN INTERNAL METHOD ONLY
+ * @param index The element to allocate.
+ * @param server 1 for server transactions (ist, nist), 0 for client transactions.
+ */
+  int __osip_transaction_index_init (struct osip_transaction_index **index, int server);
+/**
+ * Free an index of transactions.
+ * NOTE: THIS IS AN INTERNAL METHOD ONLY
+ * @param index The element to free.
+ */
+  void __osip_transaction_index_free (struct osip_transaction_index *index);
+/**
+ * Add a transaction in an index of transactions.
+ * NOTE: THIS IS AN INTERNAL METHOD ONLY
+ * @param index The element to work on.
+ * @param transaction The transaction to add.
+ */
+  void __osip_transaction_index_add (struct osip_transaction_index *index, osip_transaction_t * transaction);
+/**
+ * Remove a transaction from an index of transactions.
+ * NOTE: THIS IS AN INTERNAL METHOD ONLY
+ * @param index The element to work on.
+ * @param transaction The transaction to remove.
+ */
+  void __osip_transaction_index_remove (struct osip_transaction_index *index, osip_transaction_t * transaction);
+
+/**
+ * Queue the transaction in the ready queue of osip_t after an event
+ * was added in its fifo.
+ * NOTE: THIS IS AN INTERNAL METHOD ONLY
+ * @param transaction The element to work on.
+ */
+  void __osip_transaction_set_ready (osip_transaction_t * transaction);
+
+/**
+ * Re-arm the transaction in the timer wheel of osip_t after a timer
+ * was started or stopped, or after a change of state.
+ * NOTE: THIS IS AN INTERNAL METHOD ONLY
+ * @param transaction The element to work on.
+ */
+  void __osip_transaction_update_timers (osip_transaction_t * transaction);
+
+/**
+ * Allocate a timer wheel.
+ * NOTE: THIS IS AN INTERNAL METHOD ONLY
+ * @param wheel The element to allocate.
+ */
+  int __osip_timer_wheel_init (struct osip_timer_wheel **wheel);
+/**
+ * Free a timer wheel.
+ * NOTE: THIS IS AN INTERNAL METHOD ONLY
+ * @param wheel The element to free.
+ */
+  void __osip_timer_wheel_free (struct osip_timer_wheel *wheel);
+/**
+ * Arm (or re-arm) an entry of a timer wheel.
+ * NOTE: THIS IS AN INTERNAL METHOD ONLY
+ * @param entry The entry to arm (entry->wheel must be set).
+ * @param deadline The date of expiration.
+ */
+  void __osip_timer_wheel_add (osip_timer_entry_t * entry, const struct timeval *deadline);
+/**
+ * Disarm an entry of a timer wheel.
+ * NOTE: THIS IS AN INTERNAL METHOD ONLY
+ * @param entry The entry to disarm.
+ */
+  void __osip_timer_wheel_del (osip_timer_entry_t * entry);
+/**
+ * Move all entries expired at date now in the list expired.
+ * NOTE: THIS IS AN INTERNAL METHOD ONLY
+ * @param wheel The element to work on.
+ * @param now The current date.
+ * @param expired Head of the list of expired entries (initialized here).
+ */
+  void __osip_timer_wheel_expire (struct osip_timer_wheel *wheel, const struct timeval *now, osip_timer_entry_t * expired);
+/**
+ * Remove the first entry from a list of expired entries.
+ * NOTE: THIS IS AN INTERNAL METHOD ONLY
+ * @param expired Head of the list of expired entries.
+ */
+  osip_timer_entry_t *__osip_timer_wheel_pop (osip_timer_entry_t * expired);
+/**
+ * Get the date of the next expiration in a timer wheel.
+ * The date may be early for entries expiring in more than 256ms.
+ * NOTE: THIS IS AN INTERNAL METHOD ONLY
+ * @param wheel The element to work on.
+ * @param now The current date.
+ * @param deadline The date of the next expiration.
+ */
+  int __osip_timer_wheel_next (struct osip_timer_wheel *wheel, const struct timeval *now, struct timeval *deadline);
+
+/**
+ * Initialize the DNS cache shared by all osip_t.
+ * NOTE: THIS IS AN INTERNAL METHOD ONLY
+ */
+  int __osip_dns_cache_init (void);
+/**
+ * Get a cached SRV record with the same results as record, or add
+ * a copy of record with the default time to live.
+ * NOTE: THIS IS AN INTERNAL METHOD ONLY
+ * @param record The SRV lookup results.
+ */
+  osip_srv_record_t *__osip_dns_cache_share_srv (const osip_srv_record_t * record);
+
 /**
  * Allocate a sipevent.
  * NOTE: THIS IS AN INTERNAL METHOD ONLY
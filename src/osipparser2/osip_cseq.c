@@ -31,6 +31,7 @@ osip_cseq_init (osip_cseq_t ** cseq)
     return OSIP_NOMEM;
   (*cseq)->method = NULL;
   (*cseq)->number = NULL;
+  (*cseq)->method_code = OSIP_METHOD_UNKNOWN;
   return OSIP_SUCCESS;
 }
 
@@ -76,6 +77,7 @@ osip_cseq_parse (osip_cseq_t * cseq, const char *hvalue)
 
   cseq->number = NULL;
   cseq->method = NULL;
+  cseq->method_code = OSIP_METHOD_UNKNOWN;
 
   method = strchr (hvalue, ' ');        /* SEARCH FOR SPACE */
   if (method == NULL)
@@ -96,6 +98,7 @@ osip_cseq_parse (osip_cseq_t * cseq, const char *hvalue)
   if (cseq->method == NULL)
     return OSIP_NOMEM;
   osip_clrncpy (cseq->method, method + 1, end - method);
+  cseq->method_code = osip_method_code (cseq->method);
 
   return OSIP_SUCCESS;          /* ok */
 }
@@ -133,6 +136,7 @@ void
 osip_cseq_set_method (osip_cseq_t * cseq, char *method)
 {
   cseq->method = (char *) method;
+  cseq->method_code = osip_method_code (method);
 }
 
 /* returns the cseq header as a string.          */
@@ -186,6 +190,7 @@ osip_cseq_clone (const osip_cseq_t * cseq, osip_cseq_t ** dest)
     return i;
   }
   cs->method = osip_strdup (cseq->method);
+  cs->method_code = osip_method_code (cs->method);
   cs->number = osip_strdup (cseq->number);
 
   *dest = cs;
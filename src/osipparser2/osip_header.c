@@ -201,7 +201,7 @@ osip_message_header_get_byname (const osip_message_t * sip, const char *hname, i
 int
 osip_header_init (osip_header_t ** header)
 {
-  *header = (osip_header_t *) osip_malloc (sizeof (osip_header_t));
+  *header = (osip_header_t *) __osip_pool_malloc (sizeof (osip_header_t));
   if (*header == NULL)
     return OSIP_NOMEM;
   (*header)->hname = NULL;
@@ -219,7 +219,7 @@ osip_header_free (osip_header_t * header)
   header->hname = NULL;
   header->hvalue = NULL;
 
-  osip_free (header);
+  __osip_pool_free (header, sizeof (osip_header_t));
 }
 
 /* returns the header as a string.    */
@@ -97,6 +97,8 @@ osip_list_eol (const osip_list_t * li, int i)
   return 1;                     /* end of list */
 }
 
+#ifndef OSIP_LIST_ARRAY
+
 /* index starts from 0; */
 int
 osip_list_add (osip_list_t * li, void *el, int pos)
@@ -109,7 +111,7 @@ osip_list_add (osip_list_t * li, void *el, int pos)
 
   if (li->nb_elt == 0) {
 
-    li->node = (__node_t *) osip_malloc (sizeof (__node_t));
+    li->node = (__node_t *) __osip_pool_malloc (sizeof (__node_t));
     if (li->node == NULL)
       return OSIP_NOMEM;
     li->node->element = el;
@@ -125,7 +127,7 @@ osip_list_add (osip_list_t * li, void *el, int pos)
   ntmp = li->node;              /* exist because nb_elt>0  */
 
   if (pos == 0) {               /* pos = 0 insert before first elt  */
-    li->node = (__node_t *) osip_malloc (sizeof (__node_t));
+    li->node = (__node_t *) __osip_pool_malloc (sizeof (__node_t));
     if (li->node == NULL) {
       /* leave the list unchanged */
       li->node = ntmp;
@@ -146,7 +148,7 @@ osip_list_add (osip_list_t * li, void *el, int pos)
 
   /* if pos==nb_elt next node does not exist  */
   if (pos == li->nb_elt) {
-    ntmp->next = osip_malloc (sizeof (__node_t));
+    ntmp->next = __osip_pool_malloc (sizeof (__node_t));
     if (ntmp->next == NULL)
       return OSIP_NOMEM;        /* leave the list unchanged */
     ntmp = ntmp->next;
@@ -160,7 +162,7 @@ osip_list_add (osip_list_t * li, void *el, int pos)
   {
     __node_t *nextnode = ntmp->next;
 
-    ntmp->next = osip_malloc (sizeof (__node_t));
+    ntmp->next = __osip_pool_malloc (sizeof (__node_t));
     if (ntmp->next == NULL) {
       /* leave the list unchanged */
       ntmp->next = nextnode;
@@ -240,7 +242,7 @@ osip_list_iterator_remove (osip_list_iterator_t * iterator)
 
     *(iterator->prev) = iterator->actual->next;
 
-    osip_free (iterator->actual);
+    __osip_pool_free (iterator->actual, sizeof (__node_t));
     iterator->actual = *(iterator->prev);
   }
 
@@ -271,7 +273,7 @@ osip_list_remove (osip_list_t * li, int pos)
   if (pos == 0) {               /* special case  */
     li->node = ntmp->next;
     li->nb_elt--;
-    osip_free (ntmp);
+    __osip_pool_free (ntmp, sizeof (__node_t));
     return li->nb_elt;
   }
 
@@ -286,8 +288,149 @@ osip_list_remove (osip_list_t * li, int pos)
 
     remnode = ntmp->next;
     ntmp->next = (ntmp->next)->next;
-    osip_free (remnode);
+    __osip_pool_free (remnode, sizeof (__node_t));
     li->nb_elt--;
   }
   return li->nb_elt;
 }
+
+#else /* OSIP_LIST_ARRAY */
+
+/*
+  Growable circular array: element i is array[(start + i) & (size - 1)].
+  Elements are moved on the side of the array closest to pos. The array
+  is released when the list becomes empty, because lists are released
+  by removing their elements.
+*/
+
+#define __list_at(li, i) ((li)->array[((li)->start + (i)) & ((li)->size - 1)])
+
+static int
+__osip_list_resize (osip_list_t * li, int size)
+{
+  void **array;
+  int i;
+
+  array = (void **) osip_malloc (size * sizeof (void *));
+  if (array == NULL)
+    return OSIP_NOMEM;
+  for (i = 0; i < li->nb_elt; i++)
+    array[i] = __list_at (li, i);
+  osip_free (li->array);
+  li->array = array;
+  li->size = size;
+  li->start = 0;
+  return OSIP_SUCCESS;
+}
+
+/* index starts from 0; */
+int
+osip_list_add (osip_list_t * li, void *el, int pos)
+{
+  int i;
+
+  if (li == NULL)
+    return OSIP_BADPARAMETER;
+
+  if (li->nb_elt == li->size) {
+    i = __osip_list_resize (li, li->size > 0 ? li->size * 2 : 4);
+    if (i != 0)
+      return i;                 /* leave the list unchanged */
+  }
+
+  if (pos < 0 || pos >= li->nb_elt)     /* insert at the end  */
+    pos = li->nb_elt;
+
+  if (pos < li->nb_elt / 2) {
+    li->start = (li->start - 1) & (li->size - 1);
+    for (i = 0; i < pos; i++)
+      __list_at (li, i) = __list_at (li, i + 1);
+  }
+  else {
+    for (i = li->nb_elt; i > pos; i--)
+      __list_at (li, i) = __list_at (li, i - 1);
+  }
+  __list_at (li, pos) = el;
+  li->nb_elt++;
+  return li->nb_elt;
+}
+
+/* index starts from 0 */
+void *
+osip_list_get (const osip_list_t * li, int pos)
+{
+  if (li == NULL)
+    return NULL;
+
+  if (pos < 0 || pos >= li->nb_elt)
+    /* element does not exist */
+    return NULL;
+
+  return __list_at (li, pos);
+}
+
+void *
+osip_list_get_first (osip_list_t * li, osip_list_iterator_t * iterator)
+{
+  iterator->li = li;
+  iterator->pos = 0;
+  if (0 >= li->nb_elt)
+    return OSIP_SUCCESS;
+  return __list_at (li, 0);
+}
+
+void *
+osip_list_get_next (osip_list_iterator_t * iterator)
+{
+  ++(iterator->pos);
+  if (osip_list_iterator_has_elem (*iterator))
+    return __list_at (iterator->li, iterator->pos);
+  return OSIP_SUCCESS;
+}
+
+void *
+osip_list_iterator_remove (osip_list_iterator_t * iterator)
+{
+  if (osip_list_iterator_has_elem (*iterator))
+    osip_list_remove (iterator->li, iterator->pos);
+  if (osip_list_iterator_has_elem (*iterator))
+    return __list_at (iterator->li, iterator->pos);
+  return OSIP_SUCCESS;
+}
+
+/* return -1 if failed */
+int
+osip_list_remove (osip_list_t * li, int pos)
+{
+  int i;
+
+  if (li == NULL)
+    return OSIP_BADPARAMETER;
+
+  if (pos < 0 || pos >= li->nb_elt)
+    /* element does not exist */
+    return OSIP_UNDEFINED_ERROR;
+
+  if (pos < li->nb_elt / 2) {
+    for (i = pos; i > 0; i--)
+      __list_at (li, i) = __list_at (li, i - 1);
+    li->start = (li->start + 1) & (li->size - 1);
+  }
+  else {
+    for (i = pos; i < li->nb_elt - 1; i++)
+      __list_at (li, i) = __list_at (li, i + 1);
+  }
+  li->nb_elt--;
+
+  if (li->nb_elt == 0) {
+    osip_free (li->array);
+    li->array = NULL;
+    li->size = 0;
+    li->start = 0;
+  }
+  else if (li->size > 16 && li->nb_elt * 4 < li->size)
+    __osip_list_resize (li, li->size / 2);
+  return li->nb_elt;
+}
+
+#endif
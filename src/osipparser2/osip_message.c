@@ -76,6 +76,9 @@ osip_message_init (osip_message_t ** sip)
   osip_list_init (&(*sip)->bodies);
 
   osip_list_init (&(*sip)->headers);
+  osip_list_init (&(*sip)->lazy_headers);
+  (*sip)->lazy_mask[0] = 0;
+  (*sip)->lazy_mask[1] = 0;
 
   (*sip)->message_property = 3;
   (*sip)->message = NULL;       /* buffer to avoid calling osip_message_to_str many times (for retransmission) */
@@ -85,6 +88,31 @@ osip_message_init (osip_message_t ** sip)
   return OSIP_SUCCESS;          /* ok */
 }
 
+int
+osip_message_init_arena (osip_message_t ** sip)
+{
+#ifdef OSIP_ARENA
+  struct osip_arena *arena;
+  struct osip_arena *previous;
+  int i;
+
+  arena = __osip_arena_create ();
+  if (arena == NULL)
+    return OSIP_NOMEM;
+  previous = __osip_arena_bind (arena);
+  i = osip_message_init (sip);
+  __osip_arena_bind (previous);
+  if (i != 0) {
+    __osip_arena_release (arena);
+    return i;
+  }
+  (*sip)->arena = arena;
+  return OSIP_SUCCESS;
+#else
+  return osip_message_init (sip);
+#endif
+}
+
 
 void
 osip_message_set_reason_phrase (osip_message_t * sip, char *reason)
@@ -98,10 +126,74 @@ osip_message_set_status_code (osip_message_t * sip, int status_code)
   sip->status_code = status_code;
 }
 
+int
+osip_method_code (const char *method)
+{
+  if (method == NULL)
+    return OSIP_METHOD_UNKNOWN;
+  /* the first letter selects the candidates */
+  switch (method[0]) {
+  case 'A':
+    if (0 == strcmp (method, "ACK"))
+      return OSIP_METHOD_ACK;
+    break;
+  case 'B':
+    if (0 == strcmp (method, "BYE"))
+      return OSIP_METHOD_BYE;
+    break;
+  case 'C':
+    if (0 == strcmp (method, "CANCEL"))
+      return OSIP_METHOD_CANCEL;
+    break;
+  case 'I':
+    if (0 == strcmp (method, "INVITE"))
+      return OSIP_METHOD_INVITE;
+    if (0 == strcmp (method, "INFO"))
+      return OSIP_METHOD_INFO;
+    break;
+  case 'M':
+    if (0 == strcmp (method, "MESSAGE"))
+      return OSIP_METHOD_MESSAGE;
+    break;
+  case 'N':
+    if (0 == strcmp (method, "NOTIFY"))
+      return OSIP_METHOD_NOTIFY;
+    break;
+  case 'O':
+    if (0 == strcmp (method, "OPTIONS"))
+      return OSIP_METHOD_OPTIONS;
+    break;
+  case 'P':
+    if (0 == strcmp (method, "PRACK"))
+      return OSIP_METHOD_PRACK;
+    if (0 == strcmp (method, "PUBLISH"))
+      return OSIP_METHOD_PUBLISH;
+    break;
+  case 'R':
+    if (0 == strcmp (method, "REGISTER"))
+      return OSIP_METHOD_REGISTER;
+    if (0 == strcmp (method, "REFER"))
+      return OSIP_METHOD_REFER;
+    break;
+  case 'S':
+    if (0 == strcmp (method, "SUBSCRIBE"))
+      return OSIP_METHOD_SUBSCRIBE;
+    break;
+  case 'U':
+    if (0 == strcmp (method, "UPDATE"))
+      return OSIP_METHOD_UPDATE;
+    break;
+  default:
+    break;
+  }
+  return OSIP_METHOD_UNKNOWN;
+}
+
 void
 osip_message_set_method (osip_message_t * sip, char *sip_method)
 {
   sip->sip_method = sip_method;
+  sip->sip_method_code = osip_method_code (sip_method);
 }
 
 void
@@ -122,6 +214,16 @@ osip_message_free (osip_message_t * sip)
   if (sip == NULL)
     return;
 
+#ifdef OSIP_ARENA
+  if (sip->arena != NULL) {
+    /* the elements were taken from the arena: give back its pages at
+       once (the buffer of osip_message_to_str is on the heap) */
+    osip_free (sip->message);
+    __osip_arena_release (sip->arena);
+    return;
+  }
+#endif
+
   osip_free (sip->sip_method);
   osip_free (sip->sip_version);
   if (sip->req_uri != NULL)
@@ -166,49 +268,34 @@ osip_message_free (osip_message_t * sip)
   osip_list_special_free (&sip->vias, (void (*)(void *)) &osip_via_free);
   osip_list_special_free (&sip->www_authenticates, (void (*)(void *)) &osip_www_authenticate_free);
   osip_list_special_free (&sip->headers, (void (*)(void *)) &osip_header_free);
+  osip_list_special_free (&sip->lazy_headers, (void (*)(void *)) &osip_header_free);
   osip_list_special_free (&sip->bodies, (void (*)(void *)) &osip_body_free);
   osip_free (sip->message);
   osip_free (sip);
 }
 
 
-int
-osip_message_clone (const osip_message_t * sip, osip_message_t ** dest)
+static int
+__osip_message_clone (const osip_message_t * sip, osip_message_t * copy)
 {
-  osip_message_t *copy;
   int pos = 0;
   int i;
 
-  *dest = NULL;
-  if (sip == NULL)
-    return OSIP_BADPARAMETER;
-
-  i = osip_message_init (&copy);
-  if (i != 0)
-    return i;
-
   copy->sip_method = osip_strdup (sip->sip_method);
-  if (sip->sip_method != NULL && copy->sip_method == NULL) {
-    osip_message_free (copy);
+  if (sip->sip_method != NULL && copy->sip_method == NULL)
     return OSIP_NOMEM;
-  }
+  copy->sip_method_code = osip_method_code (copy->sip_method);
   copy->sip_version = osip_strdup (sip->sip_version);
-  if (sip->sip_version != NULL && copy->sip_version == NULL) {
-    osip_message_free (copy);
+  if (sip->sip_version != NULL && copy->sip_version == NULL)
     return OSIP_NOMEM;
-  }
   copy->status_code = sip->status_code;
   copy->reason_phrase = osip_strdup (sip->reason_phrase);
-  if (sip->reason_phrase != NULL && copy->reason_phrase == NULL) {
-    osip_message_free (copy);
+  if (sip->reason_phrase != NULL && copy->reason_phrase == NULL)
     return OSIP_NOMEM;
-  }
   if (sip->req_uri != NULL) {
     i = osip_uri_clone (sip->req_uri, &(copy->req_uri));
-    if (i != 0) {
-      osip_message_free (copy);
+    if (i != 0)
       return i;
-    }
   }
 #ifndef MINISIZE
   {
@@ -219,10 +306,8 @@ osip_message_clone (const osip_message_t * sip, osip_message_t ** dest)
     while (!osip_list_eol (&sip->accepts, pos)) {
       accept = (osip_accept_t *) osip_list_get (&sip->accepts, pos);
       i = osip_accept_clone (accept, &accept2);
-      if (i != 0) {
-        osip_message_free (copy);
+      if (i != 0)
         return i;
-      }
       osip_list_add (&copy->accepts, accept2, -1);      /* insert as last element */
       pos++;
     }
@@ -235,10 +320,8 @@ osip_message_clone (const osip_message_t * sip, osip_message_t ** dest)
     while (!osip_list_eol (&sip->accept_encodings, pos)) {
       accept_encoding = (osip_accept_encoding_t *) osip_list_get (&sip->accept_encodings, pos);
       i = osip_accept_encoding_clone (accept_encoding, &accept_encoding2);
-      if (i != 0) {
-        osip_message_free (copy);
+      if (i != 0)
         return i;
-      }
       osip_list_add (&copy->accept_encodings, accept_encoding2, -1);
       pos++;
     }
@@ -251,10 +334,8 @@ osip_message_clone (const osip_message_t * sip, osip_message_t ** dest)
     while (!osip_list_eol (&sip->accept_languages, pos)) {
       accept_language = (osip_accept_language_t *) osip_list_get (&sip->accept_languages, pos);
       i = osip_accept_language_clone (accept_language, &accept_language2);
-      if (i != 0) {
-        osip_message_free (copy);
+      if (i != 0)
         return i;
-      }
       osip_list_add (&copy->accept_languages, accept_language2, -1);
       pos++;
     }
@@ -267,10 +348,8 @@ osip_message_clone (const osip_message_t * sip, osip_message_t ** dest)
     while (!osip_list_eol (&sip->alert_infos, pos)) {
       alert_info = (osip_alert_info_t *) osip_list_get (&sip->alert_infos, pos);
       i = osip_alert_info_clone (alert_info, &alert_info2);
-      if (i != 0) {
-        osip_message_free (copy);
+      if (i != 0)
         return i;
-      }
       osip_list_add (&copy->alert_infos, alert_info2, -1);
       pos++;
     }
@@ -283,10 +362,8 @@ osip_message_clone (const osip_message_t * sip, osip_message_t ** dest)
     while (!osip_list_eol (&sip->allows, pos)) {
       allow = (osip_allow_t *) osip_list_get (&sip->allows, pos);
       i = osip_allow_clone (allow, &allow2);
-      if (i != 0) {
-        osip_message_free (copy);
+      if (i != 0)
         return i;
-      }
       osip_list_add (&copy->allows, allow2, -1);
       pos++;
     }
@@ -300,10 +377,8 @@ osip_message_clone (const osip_message_t * sip, osip_message_t ** dest)
       authentication_info = (osip_authentication_info_t *)
         osip_list_get (&sip->authentication_infos, pos);
       i = osip_authentication_info_clone (authentication_info, &authentication_info2);
-      if (i != 0) {
-        osip_message_free (copy);
+      if (i != 0)
         return i;
-      }
       osip_list_add (&copy->authentication_infos, authentication_info2, -1);
       pos++;
     }
@@ -316,10 +391,8 @@ osip_message_clone (const osip_message_t * sip, osip_message_t ** dest)
     while (!osip_list_eol (&sip->call_infos, pos)) {
       call_info = (osip_call_info_t *) osip_list_get (&sip->call_infos, pos);
       i = osip_call_info_clone (call_info, &call_info2);
-      if (i != 0) {
-        osip_message_free (copy);
+      if (i != 0)
         return i;
-      }
       osip_list_add (&copy->call_infos, call_info2, -1);
       pos++;
     }
@@ -332,10 +405,8 @@ osip_message_clone (const osip_message_t * sip, osip_message_t ** dest)
     while (!osip_list_eol (&sip->content_encodings, pos)) {
       content_encoding = (osip_content_encoding_t *) osip_list_get (&sip->content_encodings, pos);
       i = osip_content_encoding_clone (content_encoding, &content_encoding2);
-      if (i != 0) {
-        osip_message_free (copy);
+      if (i != 0)
         return i;
-      }
       osip_list_add (&copy->content_encodings, content_encoding2, -1);
       pos++;
     }
@@ -348,10 +419,8 @@ osip_message_clone (const osip_message_t * sip, osip_message_t ** dest)
     while (!osip_list_eol (&sip->error_infos, pos)) {
       error_info = (osip_error_info_t *) osip_list_get (&sip->error_infos, pos);
       i = osip_error_info_clone (error_info, &error_info2);
-      if (i != 0) {
-        osip_message_free (copy);
+      if (i != 0)
         return i;
-      }
       osip_list_add (&copy->error_infos, error_info2, -1);
       pos++;
     }
@@ -365,124 +434,112 @@ osip_message_clone (const osip_message_t * sip, osip_message_t ** dest)
       proxy_authentication_info = (osip_proxy_authentication_info_t *)
         osip_list_get (&sip->proxy_authentication_infos, pos);
       i = osip_proxy_authentication_info_clone (proxy_authentication_info, &proxy_authentication_info2);
-      if (i != 0) {
-        osip_message_free (copy);
+      if (i != 0)
         return i;
-      }
       osip_list_add (&copy->proxy_authentication_infos, proxy_authentication_info2, -1);
       pos++;
     }
   }
 #endif
   i = osip_list_clone (&sip->authorizations, &copy->authorizations, (int (*)(void *, void **)) &osip_authorization_clone);
-  if (i != 0) {
-    osip_message_free (copy);
+  if (i != 0)
     return i;
-  }
   if (sip->call_id != NULL) {
     i = osip_call_id_clone (sip->call_id, &(copy->call_id));
-    if (i != 0) {
-      osip_message_free (copy);
+    if (i != 0)
       return i;
-    }
   }
   i = osip_list_clone (&sip->contacts, &copy->contacts, (int (*)(void *, void **)) &osip_contact_clone);
-  if (i != 0) {
-    osip_message_free (copy);
+  if (i != 0)
     return i;
-  }
   if (sip->content_length != NULL) {
     i = osip_content_length_clone (sip->content_length, &(copy->content_length));
-    if (i != 0) {
-      osip_message_free (copy);
+    if (i != 0)
       return i;
-    }
   }
   if (sip->content_type != NULL) {
     i = osip_content_type_clone (sip->content_type, &(copy->content_type));
-    if (i != 0) {
-      osip_message_free (copy);
+    if (i != 0)
       return i;
-    }
   }
   if (sip->cseq != NULL) {
     i = osip_cseq_clone (sip->cseq, &(copy->cseq));
-    if (i != 0) {
-      osip_message_free (copy);
+    if (i != 0)
       return i;
-    }
   }
   if (sip->from != NULL) {
     i = osip_from_clone (sip->from, &(copy->from));
-    if (i != 0) {
-      osip_message_free (copy);
+    if (i != 0)
       return i;
-    }
   }
   if (sip->mime_version != NULL) {
     i = osip_mime_version_clone (sip->mime_version, &(copy->mime_version));
-    if (i != 0) {
-      osip_message_free (copy);
+    if (i != 0)
       return i;
-    }
   }
   i = osip_list_clone (&sip->proxy_authenticates, &copy->proxy_authenticates, (int (*)(void *, void **)) &osip_proxy_authenticate_clone);
-  if (i != 0) {
-    osip_message_free (copy);
+  if (i != 0)
     return i;
-  }
   i = osip_list_clone (&sip->proxy_authorizations, &copy->proxy_authorizations, (int (*)(void *, void **))
                        &osip_proxy_authorization_clone);
-  if (i != 0) {
-    osip_message_free (copy);
+  if (i != 0)
     return i;
-  }
   i = osip_list_clone (&sip->record_routes, &copy->record_routes, (int (*)(void *, void **)) &osip_record_route_clone);
-  if (i != 0) {
-    osip_message_free (copy);
+  if (i != 0)
     return i;
-  }
   i = osip_list_clone (&sip->routes, &copy->routes, (int (*)(void *, void **)) &osip_route_clone);
-  if (i != 0) {
-    osip_message_free (copy);
+  if (i != 0)
     return i;
-  }
   if (sip->to != NULL) {
     i = osip_to_clone (sip->to, &(copy->to));
-    if (i != 0) {
-      osip_message_free (copy);
+    if (i != 0)
       return i;
-    }
   }
   i = osip_list_clone (&sip->vias, &copy->vias, (int (*)(void *, void **)) &osip_via_clone);
-  if (i != 0) {
-    osip_message_free (copy);
+  if (i != 0)
     return i;
-  }
   i = osip_list_clone (&sip->www_authenticates, &copy->www_authenticates, (int (*)(void *, void **)) &osip_www_authenticate_clone);
-  if (i != 0) {
-    osip_message_free (copy);
+  if (i != 0)
     return i;
-  }
   i = osip_list_clone (&sip->headers, &copy->headers, (int (*)(void *, void **)) &osip_header_clone);
-  if (i != 0) {
-    osip_message_free (copy);
+  if (i != 0)
     return i;
-  }
+  i = osip_list_clone (&sip->lazy_headers, &copy->lazy_headers, (int (*)(void *, void **)) &osip_header_clone);
+  if (i != 0)
+    return i;
+  copy->lazy_mask[0] = sip->lazy_mask[0];
+  copy->lazy_mask[1] = sip->lazy_mask[1];
   i = osip_list_clone (&sip->bodies, &copy->bodies, (int (*)(void *, void **)) &osip_body_clone);
-  if (i != 0) {
-    osip_message_free (copy);
+  if (i != 0)
     return i;
-  }
 
   copy->message_length = sip->message_length;
   copy->message = osip_strdup (sip->message);
-  if (copy->message == NULL && sip->message != NULL) {
-    osip_message_free (copy);
+  if (copy->message == NULL && sip->message != NULL)
     return OSIP_NOMEM;
-  }
   copy->message_property = sip->message_property;
+  return OSIP_SUCCESS;
+}
 
+int
+osip_message_clone (const osip_message_t * sip, osip_message_t ** dest)
+{
+  osip_message_t *copy;
+  int i;
+
+  *dest = NULL;
+  if (sip == NULL)
+    return OSIP_BADPARAMETER;
+
+  /* the copy of an arena message is allocated on the heap: it can be modified */
+  i = osip_message_init (&copy);
+  if (i != 0)
+    return i;
+  i = __osip_message_clone (sip, copy);
+  if (i != 0) {
+    osip_message_free (copy);
+    return i;
+  }
   *dest = copy;
   return OSIP_SUCCESS;
 }
@@ -23,9 +23,49 @@
 #include <osipparser2/osip_parser.h>
 #include "parser.h"
 
-static void osip_util_replace_all_lws (char *sip_message);
+/* the AVX2 scan is compiled with -mavx2, or compiled for AVX2 only
+   and used when the CPU has it */
+#if defined(__GNUC__) && defined(__AVX2__)
+#define OSIP_SCAN_WITH_AVX2
+#elif defined(__GNUC__) && !defined(__clang__) && (defined(__x86_64__) || defined(__i386__)) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define OSIP_SCAN_WITH_AVX2
+#define OSIP_SCAN_AVX2_DISPATCH
+#endif
+#if defined(__GNUC__) && defined(__SSE2__)
+#define OSIP_SCAN_WITH_SSE2
+#endif
+
+#if defined(OSIP_SCAN_WITH_AVX2)
+#include <immintrin.h>
+#elif defined(OSIP_SCAN_WITH_SSE2)
+#include <emmintrin.h>
+#endif
+
+#ifndef OSIP_SCAN_STATIC_LINES
+#define OSIP_SCAN_STATIC_LINES 32       /* lines indexed without allocation */
+#endif
+
+/* one logical line of the header block: a line and its
+   folded (LWS) continuation lines. */
+typedef struct ___osip_line_t {
+  char *start;                  /* first character of the line */
+  char *colon;                  /* first ':' of the line or NULL */
+  char *end;                    /* terminator (CR or LF) of the last physical line */
+  int folded;                   /* 1 if the line contains LWS to replace */
+} __osip_line_t;
+
+/* index of the start line and headers built in a single pass */
+typedef struct ___osip_header_index_t {
+  __osip_line_t *lines;         /* lines[nb_lines] is the line being scanned */
+  int nb_lines;                 /* number of complete lines */
+  int max_lines;
+  char *end_of_headers;         /* the empty line, or NULL if not found */
+  int truncated;                /* last line has no terminator */
+  __osip_line_t static_lines[OSIP_SCAN_STATIC_LINES];
+} __osip_header_index_t;
+
 static int osip_message_set__header (osip_message_t * sip, const char *hname, const char *hvalue);
-static int msg_headers_parse (osip_message_t * sip, const char *start_of_header, const char **body);
+static int msg_headers_parse (osip_message_t * sip, __osip_header_index_t * idx, const char *start_of_header, const char **body);
 static int msg_osip_body_parse (osip_message_t * sip, const char *start_of_buf, const char **next_body, size_t length);
 
 
@@ -38,6 +78,7 @@ __osip_message_startline_parsereq (osip_message_t * dest, const char *buf, const
   int i;
 
   dest->sip_method = NULL;
+  dest->sip_method_code = OSIP_METHOD_UNKNOWN;
   dest->status_code = 0;
   dest->reason_phrase = NULL;
 
@@ -173,6 +214,7 @@ __osip_message_startline_parsereq (osip_message_t * dest, const char *buf, const
       hp++;
     (*headers) = hp;
   }
+  dest->sip_method_code = osip_method_code (dest->sip_method);
   return OSIP_SUCCESS;
 }
 
@@ -184,6 +226,7 @@ __osip_message_startline_parseresp (osip_message_t * dest, const char *buf, cons
 
   dest->req_uri = NULL;
   dest->sip_method = NULL;
+  dest->sip_method_code = OSIP_METHOD_UNKNOWN;
 
   *headers = buf;
 
@@ -277,37 +320,301 @@ __osip_find_next_occurence (const char *str, const char *buf, const char **index
   return OSIP_SYNTAXERROR;
 }
 
-/* This method replace all LWS with SP located before the
-   initial CRLFCRLF found or the end of the string.
-*/
-static void
-osip_util_replace_all_lws (char *sip_message)
+static int
+__osip_header_index_newline (__osip_header_index_t * idx, char *start)
 {
-  /* const char *end_of_message; */
-  char *tmp;
+  __osip_line_t *line;
 
-  if (sip_message == NULL)
-    return;
+  idx->nb_lines++;
+  if (idx->nb_lines == idx->max_lines) {
+    __osip_line_t *lines;
 
-  /* end_of_message = sip_message + strlen (sip_message); */
+    if (idx->lines == idx->static_lines) {
+      lines = (__osip_line_t *) osip_malloc (2 * idx->max_lines * sizeof (__osip_line_t));
+      if (lines != NULL)
+        memcpy (lines, idx->static_lines, idx->max_lines * sizeof (__osip_line_t));
+    }
+    else
+      lines = (__osip_line_t *) osip_realloc (idx->lines, 2 * idx->max_lines * sizeof (__osip_line_t));
+    if (lines == NULL)
+      return OSIP_NOMEM;
+    idx->lines = lines;
+    idx->max_lines = 2 * idx->max_lines;
+  }
+  line = &idx->lines[idx->nb_lines];
+  line->start = start;
+  line->colon = NULL;
+  line->end = NULL;
+  line->folded = 0;
+  return OSIP_SUCCESS;
+}
 
-  tmp = sip_message;
-  for (; tmp[0] != '\0'; tmp++) {
-    if (('\0' == tmp[0])
-        || ('\0' == tmp[1]) || ('\0' == tmp[2]) || ('\0' == tmp[3]))
-      return;
+/* Process one of the bytes the scanner stops on: CR, LF, ':' or NUL.
+   returns 1 when the end of the header block is reached, 0 to go on.
+   *resume is the first byte that remains to be examined. */
+static int
+__osip_header_index_byte (__osip_header_index_t * idx, char *p, char **resume)
+{
+  __osip_line_t *line = &idx->lines[idx->nb_lines];
+  char *next;
+  int i;
 
-    if ((('\r' == tmp[0]) && ('\n' == tmp[1])
-         && ('\r' == tmp[2]) && ('\n' == tmp[3]))
-        || (('\r' == tmp[0]) && ('\r' == tmp[1]))
-        || (('\n' == tmp[0]) && ('\n' == tmp[1])))
-      return;                   /* end of message */
+  if (*p == ':') {
+    if (line->colon == NULL)
+      line->colon = p;
+    *resume = p + 1;
+    return 0;
+  }
+  if (*p == '\0') {
+    /* a complete message without CRLFCRLF ends at the beginning of a line */
+    if (p != line->start)
+      idx->truncated = 1;
+    return 1;
+  }
 
-    if ((('\r' == tmp[0]) && ('\n' == tmp[1])
-         && ((' ' == tmp[2]) || ('\t' == tmp[2])))
-        || (('\r' == tmp[0])
-            && ((' ' == tmp[1]) || ('\t' == tmp[1])))
-        || (('\n' == tmp[0]) && ((' ' == tmp[1]) || ('\t' == tmp[1])))) {
+  /* CRLF, CR or LF */
+  next = p + 1;
+  if (p[0] == '\r' && p[1] == '\n')
+    next++;
+  if (*next == ' ' || *next == '\t') {
+    /* LWS: the header continues on the next line */
+    line->folded = 1;
+    *resume = next;
+    return 0;
+  }
+  line->end = p;
+  i = __osip_header_index_newline (idx, next);
+  if (i != 0)
+    return i;
+  if (*next == '\r' || *next == '\n') {
+    idx->end_of_headers = next;
+    return 1;
+  }
+  *resume = next;
+  return 0;
+}
+
+#ifdef OSIP_SCAN_WITH_AVX2
+/* scan the blocks of 32 bytes from *pp: returns 0 when the tail of
+   the buffer remains to be scanned from *pp */
+#ifdef OSIP_SCAN_AVX2_DISPATCH
+__attribute__ ((target ("avx2")))
+#endif
+static int
+__osip_header_index_scan_avx2 (__osip_header_index_t * idx, char **pp, char *end, char **resume)
+{
+  const __m256i cr = _mm256_set1_epi8 ('\r');
+  const __m256i lf = _mm256_set1_epi8 ('\n');
+  const __m256i colon = _mm256_set1_epi8 (':');
+  const __m256i zero = _mm256_setzero_si256 ();
+  char *p;
+  int i;
+
+  for (p = *pp; p + 32 <= end; p += 32) {
+    __m256i v = _mm256_loadu_si256 ((const __m256i *) p);
+    unsigned int mask = (unsigned int) _mm256_movemask_epi8 (_mm256_or_si256 (_mm256_or_si256 (_mm256_cmpeq_epi8 (v, cr),
+                                                                                                  _mm256_cmpeq_epi8 (v, lf)),
+                                                                                  _mm256_or_si256 (_mm256_cmpeq_epi8 (v, colon),
+                                                                                                  _mm256_cmpeq_epi8 (v, zero))));
+
+    while (mask != 0) {
+      char *c = p + __builtin_ctz (mask);
+
+      mask &= mask - 1;
+      if (c < *resume)
+        continue;
+      i = __osip_header_index_byte (idx, c, resume);
+      if (i != 0)
+        return i;
+    }
+  }
+  *pp = p;
+  return 0;
+}
+#endif
+
+#ifdef OSIP_SCAN_WITH_SSE2
+/* scan the blocks of 16 bytes from *pp: returns 0 when the tail of
+   the buffer remains to be scanned from *pp */
+static int
+__osip_header_index_scan_sse2 (__osip_header_index_t * idx, char **pp, char *end, char **resume)
+{
+  const __m128i cr = _mm_set1_epi8 ('\r');
+  const __m128i lf = _mm_set1_epi8 ('\n');
+  const __m128i colon = _mm_set1_epi8 (':');
+  const __m128i zero = _mm_setzero_si128 ();
+  char *p;
+  int i;
+
+  for (p = *pp; p + 16 <= end; p += 16) {
+    __m128i v = _mm_loadu_si128 ((const __m128i *) p);
+    unsigned int mask = (unsigned int) _mm_movemask_epi8 (_mm_or_si128 (_mm_or_si128 (_mm_cmpeq_epi8 (v, cr),
+                                                                                       _mm_cmpeq_epi8 (v, lf)),
+                                                                         _mm_or_si128 (_mm_cmpeq_epi8 (v, colon),
+                                                                                       _mm_cmpeq_epi8 (v, zero))));
+
+    while (mask != 0) {
+      char *c = p + __builtin_ctz (mask);
+
+      mask &= mask - 1;
+      if (c < *resume)
+        continue;
+      i = __osip_header_index_byte (idx, c, resume);
+      if (i != 0)
+        return i;
+    }
+  }
+  *pp = p;
+  return 0;
+}
+#endif
+
+/* scan used by the parser: the best one compiled in, until
+   __osip_message_header_scan_select() checks the CPU */
+#if defined(OSIP_SCAN_WITH_AVX2) && !defined(OSIP_SCAN_AVX2_DISPATCH)
+static int header_scan = OSIP_HEADER_SCAN_AVX2;
+#elif defined(OSIP_SCAN_WITH_SSE2)
+static int header_scan = OSIP_HEADER_SCAN_SSE2;
+#else
+static int header_scan = OSIP_HEADER_SCAN_SCALAR;
+#endif
+
+static int
+__osip_header_scan_available (int scan)
+{
+  if (scan == OSIP_HEADER_SCAN_SCALAR)
+    return 1;
+#ifdef OSIP_SCAN_WITH_SSE2
+  if (scan == OSIP_HEADER_SCAN_SSE2)
+    return 1;
+#endif
+#if defined(OSIP_SCAN_AVX2_DISPATCH)
+  if (scan == OSIP_HEADER_SCAN_AVX2) {
+    __builtin_cpu_init ();
+    return __builtin_cpu_supports ("avx2");
+  }
+#elif defined(OSIP_SCAN_WITH_AVX2)
+  if (scan == OSIP_HEADER_SCAN_AVX2)
+    return 1;
+#endif
+  return 0;
+}
+
+int
+__osip_message_header_scan_select (void)
+{
+  if (__osip_header_scan_available (OSIP_HEADER_SCAN_AVX2))
+    header_scan = OSIP_HEADER_SCAN_AVX2;
+  else if (__osip_header_scan_available (OSIP_HEADER_SCAN_SSE2))
+    header_scan = OSIP_HEADER_SCAN_SSE2;
+  else
+    header_scan = OSIP_HEADER_SCAN_SCALAR;
+  return header_scan;
+}
+
+/* Build the index of the start line and headers in one pass over
+   the header block: line boundaries, position of the first colon
+   and lines that contain LWS. buf must be NUL terminated at buf[length].
+   scan must be available. */
+static int
+__osip_header_index_build (__osip_header_index_t * idx, char *buf, size_t length, int scan)
+{
+  char *end = buf + length + 1; /* include the final NUL */
+  char *resume = buf;
+  char *p = buf;
+  int i;
+
+  idx->lines = idx->static_lines;
+  idx->max_lines = OSIP_SCAN_STATIC_LINES;
+  idx->nb_lines = -1;
+  idx->end_of_headers = NULL;
+  idx->truncated = 0;
+  i = __osip_header_index_newline (idx, buf);
+  if (i != 0)
+    return i;
+
+#ifdef OSIP_SCAN_WITH_AVX2
+  if (scan == OSIP_HEADER_SCAN_AVX2)
+    i = __osip_header_index_scan_avx2 (idx, &p, end, &resume);
+#endif
+#ifdef OSIP_SCAN_WITH_SSE2
+  if (scan == OSIP_HEADER_SCAN_SSE2)
+    i = __osip_header_index_scan_sse2 (idx, &p, end, &resume);
+#endif
+  if (i != 0)
+    return (i < 0) ? i : OSIP_SUCCESS;
+
+  /* scalar version, also used for the tail of the buffer */
+  if (p < resume)
+    p = resume;
+  for (; p < end; p++) {
+    if (p < resume)
+      continue;
+    if (*p == '\r' || *p == '\n' || *p == ':' || *p == '\0') {
+      i = __osip_header_index_byte (idx, p, &resume);
+      if (i != 0)
+        return (i < 0) ? i : OSIP_SUCCESS;
+    }
+  }
+  return OSIP_SUCCESS;          /* not reached: buf[length] is NUL */
+}
+
+static void
+__osip_header_index_free (__osip_header_index_t * idx)
+{
+  if (idx->lines != idx->static_lines)
+    osip_free (idx->lines);
+}
+
+int
+__osip_message_header_index_dump (int scan, const char *buf, size_t length, char **dest)
+{
+  __osip_header_index_t idx;
+  char *copy;
+  char *out;
+  size_t size;
+  size_t len;
+  int i;
+  int k;
+
+  *dest = NULL;
+  if (!__osip_header_scan_available (scan))
+    return OSIP_NOTFOUND;
+  copy = (char *) osip_malloc (length + 1);
+  if (copy == NULL)
+    return OSIP_NOMEM;
+  memcpy (copy, buf, length);
+  copy[length] = '\0';
+
+  i = __osip_header_index_build (&idx, copy, length, scan);
+  size = 96 + (idx.nb_lines + 1) * 96;
+  out = (char *) osip_malloc (size);
+  if (out == NULL) {
+    __osip_header_index_free (&idx);
+    osip_free (copy);
+    return OSIP_NOMEM;
+  }
+  len = snprintf (out, size, "%i %i %li %i", i, idx.nb_lines, idx.end_of_headers ? (long) (idx.end_of_headers - copy) : -1L, idx.truncated);
+  /* the complete lines and the line being scanned */
+  for (k = 0; k <= idx.nb_lines && len < size; k++) {
+    __osip_line_t *line = &idx.lines[k];
+
+    len += snprintf (out + len, size - len, " [%li %li %li %i]", (long) (line->start - copy),
+              line->colon ? (long) (line->colon - copy) : -1L, line->end ? (long) (line->end - copy) : -1L, line->folded);
+  }
+  __osip_header_index_free (&idx);
+  osip_free (copy);
+  *dest = out;
+  return OSIP_SUCCESS;
+}
+
+/* This method replace all LWS with SP inside one line: the
+   CRLF (or CR or LF) and the following SP and HT are replaced. */
+static void
+__osip_line_replace_lws (char *tmp, const char *end)
+{
+  for (; tmp < end; tmp++) {
+    if ('\r' == tmp[0] || '\n' == tmp[0]) {
       /* replace line end and TAB symbols by SP */
       tmp[0] = ' ';
       tmp[1] = ' ';
@@ -317,6 +624,7 @@ osip_util_replace_all_lws (char *sip_message)
         tmp[0] = ' ';
         tmp++;
       }
+      tmp--;
     }
   }
 }
@@ -422,8 +730,10 @@ osip_message_set__header (osip_message_t * sip, const char *hname, const char *h
   return OSIP_SUCCESS;
 }
 
-int
-osip_message_set_multiple_header (osip_message_t * sip, char *hname, char *hvalue)
+/* with in_place, the values are terminated inside hvalue instead of
+   being copied (hvalue is a header of the buffer being parsed) */
+static int
+__osip_message_set_multiple_header (osip_message_t * sip, char *hname, char *hvalue, int in_place)
 {
   int i;
   char *ptr;                    /* current location of the search */
@@ -553,17 +863,24 @@ osip_message_set_multiple_header (osip_message_t * sip, char *hname, char *hvalu
     }
 
     if (end != NULL) {
-      char *avalue;
-
       if (end - beg + 1 < 2)
         return OSIP_SYNTAXERROR;
-      avalue = (char *) osip_malloc (end - beg + 1);
-      if (avalue == NULL)
-        return OSIP_NOMEM;
-      osip_clrncpy (avalue, beg, end - beg);
-      /* really store the header in the sip structure */
-      i = osip_message_set__header (sip, hname, avalue);
-      osip_free (avalue);
+      if (in_place) {
+        /* the separator is not needed any more */
+        osip_clrncpy (beg, beg, end - beg);
+        i = osip_message_set__header (sip, hname, beg);
+      }
+      else {
+        char *avalue;
+
+        avalue = (char *) osip_malloc (end - beg + 1);
+        if (avalue == NULL)
+          return OSIP_NOMEM;
+        osip_clrncpy (avalue, beg, end - beg);
+        /* really store the header in the sip structure */
+        i = osip_message_set__header (sip, hname, avalue);
+        osip_free (avalue);
+      }
       if (i != 0)
         return i;
       beg = end + 1;
@@ -589,98 +906,75 @@ osip_message_set_multiple_header (osip_message_t * sip, char *hname, char *hvalu
   return OSIP_SYNTAXERROR;      /* if comma is NULL, we should have already return 0 */
 }
 
+int
+osip_message_set_multiple_header (osip_message_t * sip, char *hname, char *hvalue)
+{
+  return __osip_message_set_multiple_header (sip, hname, hvalue, 0);
+}
+
 /* set all headers */
+/* The header block is modified in place: header names and values
+   are trimmed and NUL terminated inside the buffer. */
 static int
-msg_headers_parse (osip_message_t * sip, const char *start_of_header, const char **body)
+msg_headers_parse (osip_message_t * sip, __osip_header_index_t * idx, const char *start_of_header, const char **body)
 {
-  const char *colon_index;      /* index of ':' */
+  char *colon_index;            /* index of ':' */
   char *hname;
   char *hvalue;
-  const char *end_of_header;
+  int pos;
   int i;
 
-  for (;;) {
-    if (start_of_header[0] == '\0') {   /* final CRLF is missing */
-      OSIP_TRACE (osip_trace (__FILE__, __LINE__, OSIP_INFO1, NULL, "SIP message does not end with CRLFCRLF\n"));
-      return OSIP_SUCCESS;
-    }
-
-    i = __osip_find_next_crlf (start_of_header, &end_of_header);
-    if (i == -2) {
-    }
-    else if (i != 0) {
-      OSIP_TRACE (osip_trace (__FILE__, __LINE__, OSIP_ERROR, NULL, "End of header Not found\n"));
-      return i;                 /* this is an error case!     */
-    }
+  /* find the first header line */
+  for (pos = 0; pos < idx->nb_lines && idx->lines[pos].start != start_of_header; pos++) {
+  }
+  if (idx->lines[pos].start != start_of_header) {
+    OSIP_TRACE (osip_trace (__FILE__, __LINE__, OSIP_ERROR, NULL, "Malformed message\n"));
+    return OSIP_SYNTAXERROR;
+  }
 
-    /* the list of headers MUST always end with  */
-    /* CRLFCRLF (also CRCR and LFLF are allowed) */
-    if ((start_of_header[0] == '\r') || (start_of_header[0] == '\n')) {
-      *body = start_of_header;
-      return OSIP_SUCCESS;      /* end of header found        */
-    }
+  for (; pos < idx->nb_lines; pos++) {
+    __osip_line_t *line = &idx->lines[pos];
 
     /* find the header name */
-    colon_index = strchr (start_of_header, ':');
+    colon_index = line->colon;
     if (colon_index == NULL) {
       OSIP_TRACE (osip_trace (__FILE__, __LINE__, OSIP_ERROR, NULL, "End of header Not found\n"));
       return OSIP_SYNTAXERROR;  /* this is also an error case */
     }
-    if (colon_index - start_of_header + 1 < 2)
+    if (colon_index - line->start + 1 < 2)
       return OSIP_SYNTAXERROR;
-    if (end_of_header <= colon_index) {
-      OSIP_TRACE (osip_trace (__FILE__, __LINE__, OSIP_ERROR, NULL, "Malformed message\n"));
-      return OSIP_SYNTAXERROR;
-    }
-    hname = (char *) osip_malloc (colon_index - start_of_header + 1);
-    if (hname == NULL)
-      return OSIP_NOMEM;
-    osip_clrncpy (hname, start_of_header, colon_index - start_of_header);
-
-    {
-      const char *end;
 
-      /* END of header is (end_of_header-2) if header separation is CRLF */
-      /* END of header is (end_of_header-1) if header separation is CR or LF */
-      if ((end_of_header[-2] == '\r') || (end_of_header[-2] == '\n'))
-        end = end_of_header - 2;
-      else
-        end = end_of_header - 1;
-      if ((end) - colon_index < 2)
-        hvalue = NULL;          /* some headers (subject) can be empty */
-      else {
-        hvalue = (char *) osip_malloc ((end) - colon_index + 1);
-        if (hvalue == NULL) {
-          osip_free (hname);
-          return OSIP_NOMEM;
-        }
-        osip_clrncpy (hvalue, colon_index + 1, (end) - colon_index - 1);
-      }
-    }
+    if ((line->end) - colon_index < 2)
+      hvalue = NULL;            /* some headers (subject) can be empty */
+    else
+      hvalue = osip_clrncpy (colon_index + 1, colon_index + 1, (line->end) - colon_index - 1);
+    /* the ':' is overwritten by the terminating NUL of hname */
+    hname = osip_clrncpy (line->start, line->start, colon_index - line->start);
 
     /* hvalue MAY contains multiple value. In this case, they   */
     /* are separated by commas. But, a comma may be part of a   */
     /* quoted-string ("here, and there" is an example where the */
     /* comma is not a separator!) */
-    i = osip_message_set_multiple_header (sip, hname, hvalue);
+    i = __osip_message_set_multiple_header (sip, hname, hvalue, 1);
 
-    osip_free (hname);
-    if (hvalue != NULL)
-      osip_free (hvalue);
     if (i != 0) {
       OSIP_TRACE (osip_trace (__FILE__, __LINE__, OSIP_ERROR, NULL, "End of header Not found\n"));
       return OSIP_SYNTAXERROR;
     }
-
-    /* continue on the next header */
-    start_of_header = end_of_header;
   }
 
-/* Unreachable code
- OSIP_TRACE (osip_trace
-	      (__FILE__, __LINE__, OSIP_BUG, NULL,
-	       "This code cannot be reached\n")); */
-  return OSIP_SYNTAXERROR;
+  if (idx->truncated) {
+    OSIP_TRACE (osip_trace (__FILE__, __LINE__, OSIP_ERROR, NULL, "End of header Not found\n"));
+    return OSIP_SYNTAXERROR;
+  }
+  if (idx->end_of_headers == NULL) {    /* final CRLF is missing */
+    OSIP_TRACE (osip_trace (__FILE__, __LINE__, OSIP_INFO1, NULL, "SIP message does not end with CRLFCRLF\n"));
+    return OSIP_SUCCESS;
+  }
+  /* the list of headers MUST always end with  */
+  /* CRLFCRLF (also CRCR and LFLF are allowed) */
+  *body = idx->end_of_headers;
+  return OSIP_SUCCESS;
 }
 
 static int
@@ -747,14 +1041,8 @@ msg_osip_body_parse (osip_message_t * sip, const char *start_of_buf, const char
     }
 
     end_of_body = start_of_body + osip_body_len;
-    tmp = osip_malloc (end_of_body - start_of_body + 2);
-    if (tmp == NULL)
-      return OSIP_NOMEM;
-    memcpy (tmp, start_of_body, end_of_body - start_of_body);
-    tmp[end_of_body - start_of_body] = '\0';
-
-    i = osip_message_set_body (sip, tmp, end_of_body - start_of_body);
-    osip_free (tmp);
+    /* osip_body_parse() makes its own terminated copy */
+    i = osip_message_set_body (sip, start_of_body, end_of_body - start_of_body);
     if (i != 0)
       return i;
     return OSIP_SUCCESS;
@@ -847,41 +1135,51 @@ msg_osip_body_parse (osip_message_t * sip, const char *start_of_buf, const char
   return OSIP_SYNTAXERROR;
 }
 
-/* osip_message_t *sip is filled while analysing buf */
+/* osip_message_t *sip is filled while analysing buf.
+   buf is parsed in place: it must be writable, hold length+1 bytes
+   and it is modified (LWS folding, NUL terminated header values). */
 static int
-_osip_message_parse (osip_message_t * sip, const char *buf, size_t length, int sipfrag)
+__osip_message_parse_buffer2 (osip_message_t * sip, char *buf, size_t length, int sipfrag)
 {
+  __osip_header_index_t idx;
   int i;
+  int pos;
   const char *next_header_index;
   char *tmp;
   char *beg;
 
-  tmp = osip_malloc (length + 2);
-  if (tmp == NULL) {
-    OSIP_TRACE (osip_trace (__FILE__, __LINE__, OSIP_ERROR, NULL, "Could not allocate memory.\n"));
-    return OSIP_NOMEM;
-  }
-  beg = tmp;
-  memcpy (tmp, buf, length);    /* may contain binary data */
+  beg = buf;
+  tmp = buf;
   tmp[length] = '\0';
   /* skip initial \r\n */
   while (tmp[0] == '\r' || tmp[0] == '\n')
     tmp++;
-  osip_util_replace_all_lws (tmp);
+
+  /* find lines, colons and LWS of the start line and headers */
+  i = __osip_header_index_build (&idx, tmp, length - (tmp - beg), header_scan);
+  if (i != 0) {
+    __osip_header_index_free (&idx);
+    return i;
+  }
+  for (pos = 0; pos < idx.nb_lines; pos++) {
+    if (idx.lines[pos].folded)
+      __osip_line_replace_lws (idx.lines[pos].start, idx.lines[pos].end);
+  }
+
   /* parse request or status line */
   i = __osip_message_startline_parse (sip, tmp, &next_header_index);
   if (i != 0 && !sipfrag) {
     OSIP_TRACE (osip_trace (__FILE__, __LINE__, OSIP_ERROR, NULL, "Could not parse start line of message.\n"));
-    osip_free (beg);
+    __osip_header_index_free (&idx);
     return i;
   }
   tmp = (char *) next_header_index;
 
   /* parse headers */
-  i = msg_headers_parse (sip, tmp, &next_header_index);
+  i = msg_headers_parse (sip, &idx, tmp, &next_header_index);
+  __osip_header_index_free (&idx);
   if (i != 0) {
     OSIP_TRACE (osip_trace (__FILE__, __LINE__, OSIP_ERROR, NULL, "error in msg_headers_parse()\n"));
-    osip_free (beg);
     return i;
   }
   tmp = (char *) next_header_index;
@@ -891,12 +1189,10 @@ _osip_message_parse (osip_message_t * sip, const char *buf, size_t length, int s
     /* this is mantory in the oSIP stack */
     if (sip->content_length == NULL)
       osip_message_set_content_length (sip, "0");
-    osip_free (beg);
     return OSIP_SUCCESS;        /* no body found */
   }
 
   i = msg_osip_body_parse (sip, tmp, &next_header_index, length - (tmp - beg));
-  osip_free (beg);
   if (i != 0) {
     OSIP_TRACE (osip_trace (__FILE__, __LINE__, OSIP_ERROR, NULL, "error in msg_osip_body_parse()\n"));
     return i;
@@ -909,30 +1205,70 @@ _osip_message_parse (osip_message_t * sip, const char *buf, size_t length, int s
   return OSIP_SUCCESS;
 }
 
+static int
+__osip_message_parse_buffer (osip_message_t * sip, char *buf, size_t length, int sipfrag)
+{
+#ifdef OSIP_ARENA
+  if (sip->arena != NULL) {
+    struct osip_arena *previous;
+    int i;
+
+    /* elements of the message are allocated in its arena */
+    previous = __osip_arena_bind (sip->arena);
+    i = __osip_message_parse_buffer2 (sip, buf, length, sipfrag);
+    __osip_arena_bind (previous);
+    return i;
+  }
+#endif
+  return __osip_message_parse_buffer2 (sip, buf, length, sipfrag);
+}
+
+/* osip_message_t *sip is filled while analysing a private copy of buf */
+static int
+_osip_message_parse (osip_message_t * sip, const char *buf, size_t length, int sipfrag)
+{
+  int i;
+  char *tmp;
+
+  tmp = osip_malloc (length + 2);
+  if (tmp == NULL) {
+    OSIP_TRACE (osip_trace (__FILE__, __LINE__, OSIP_ERROR, NULL, "Could not allocate memory.\n"));
+    return OSIP_NOMEM;
+  }
+  memcpy (tmp, buf, length);    /* may contain binary data */
+  i = __osip_message_parse_buffer (sip, tmp, length, sipfrag);
+  osip_free (tmp);
+  return i;
+}
+
 int
 osip_message_parse (osip_message_t * sip, const char *buf, size_t length)
 {
   return _osip_message_parse (sip, buf, length, 0);
 }
 
+int
+osip_message_parse_view (osip_message_t * sip, char *buf, size_t length)
+{
+  if (sip == NULL || buf == NULL)
+    return OSIP_BADPARAMETER;
+  return __osip_message_parse_buffer (sip, buf, length, 0);
+}
+
 int
 osip_message_parse_sipfrag (osip_message_t * sip, const char *buf, size_t length)
 {
   return _osip_message_parse (sip, buf, length, 1);
 }
 
-
 /* This method just add a received parameter in the Via
    as requested by rfc3261 */
-int
-osip_message_fix_last_via_header (osip_message_t * request, const char *ip_addr, int port)
+static int
+__osip_message_fix_last_via_header (osip_message_t * request, const char *ip_addr, int port)
 {
   osip_generic_param_t *rport;
   osip_via_t *via;
 
-  /* get Top most Via header: */
-  if (request == NULL)
-    return OSIP_BADPARAMETER;
   if (MSG_IS_RESPONSE (request))
     return OSIP_SUCCESS;        /* Don't fix Via header */
 
@@ -963,6 +1299,26 @@ osip_message_fix_last_via_header (osip_message_t * request, const char *ip_addr,
   return OSIP_SUCCESS;
 }
 
+int
+osip_message_fix_last_via_header (osip_message_t * request, const char *ip_addr, int port)
+{
+  if (request == NULL)
+    return OSIP_BADPARAMETER;
+#ifdef OSIP_ARENA
+  if (request->arena != NULL) {
+    struct osip_arena *previous;
+    int i;
+
+    /* the parameters are released with the arena */
+    previous = __osip_arena_bind (request->arena);
+    i = __osip_message_fix_last_via_header (request, ip_addr, port);
+    __osip_arena_bind (previous);
+    return i;
+  }
+#endif
+  return __osip_message_fix_last_via_header (request, ip_addr, port);
+}
+
 const char *
 osip_message_get_reason (int replycode)
 {
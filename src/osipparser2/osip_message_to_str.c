@@ -428,6 +428,13 @@ _osip_message_to_str (osip_message_t * sip, char **dest, size_t * message_length
     }
   }
 
+  /* headers not parsed yet are printed from their parsed form */
+  if (!osip_list_eol (&sip->lazy_headers, 0)) {
+    i = osip_message_parse_lazy_headers (sip);
+    if (i != 0)
+      return i;
+  }
+
   message = (char *) osip_malloc (SIP_MESSAGE_MAX_LENGTH);      /* ???? message could be > 4000  */
   if (message == NULL)
     return OSIP_NOMEM;
@@ -197,6 +197,7 @@ parser_init (void)
     }
   }
 
+  __osip_message_header_scan_select ();
   return OSIP_SUCCESS;
 }
 
@@ -229,6 +230,23 @@ __osip_message_call_method (int i, osip_message_t * dest, const char *hvalue)
 {
   int err;
 
+  if (hvalue != NULL && __osip_message_is_lazy (dest, i)) {
+    osip_header_t *header;
+
+    /* parsed later by __osip_message_parse_lazy() */
+    err = osip_header_init (&header);
+    if (err != 0)
+      return err;
+    header->hname = osip_strdup (pconfig[i].hname);
+    header->hvalue = osip_strdup (hvalue);
+    if (header->hname == NULL || header->hvalue == NULL) {
+      osip_header_free (header);
+      return OSIP_NOMEM;
+    }
+    osip_list_add (&dest->lazy_headers, header, -1);
+    return OSIP_SUCCESS;
+  }
+
   err = pconfig[i].setheader (dest, hvalue);
   if (err < 0) {
     OSIP_TRACE (osip_trace (__FILE__, __LINE__, OSIP_WARNING, NULL, "Could not set header: %s: %s\n", pconfig[i].hname, hvalue));
@@ -237,3 +255,114 @@ __osip_message_call_method (int i, osip_message_t * dest, const char *hvalue)
     return OSIP_SUCCESS;
   return err;
 }
+
+/* index of a known header, whatever the case of hname */
+static int
+__osip_message_known_header_index (const char *hname)
+{
+  char name[32];
+
+  if (hname == NULL || strlen (hname) >= sizeof (name))
+    return OSIP_BADPARAMETER;
+  osip_strncpy (name, hname, strlen (hname));
+  osip_tolower (name);
+
+  return __osip_message_is_known_header (name);
+}
+
+int
+osip_message_set_lazy_header (osip_message_t * sip, const char *hname, int lazy)
+{
+  int i;
+  int k;
+
+  if (sip == NULL || hname == NULL)
+    return OSIP_BADPARAMETER;
+  i = __osip_message_known_header_index (hname);
+  if (i == OSIP_BADPARAMETER)
+    return i;
+  if (i < 0)
+    return OSIP_NOTFOUND;
+
+  /* only headers whose parse errors are ignored can be delayed: a
+     message is accepted or rejected exactly as before. Route and
+     Record-Route lists are read directly by the transaction and
+     dialog layers. */
+  if (pconfig[i].ignored_when_invalid != 1 || pconfig[i].setheader == &osip_message_set_route || pconfig[i].setheader == &osip_message_set_record_route)
+    return OSIP_BADPARAMETER;
+
+  /* the compact form of the header shares its setter */
+  for (k = 0; k < NUMBER_OF_HEADERS; k++) {
+    if (pconfig[k].setheader != pconfig[i].setheader)
+      continue;
+    if (lazy)
+      sip->lazy_mask[k / 32] |= 1U << (k % 32);
+    else
+      sip->lazy_mask[k / 32] &= ~(1U << (k % 32));
+  }
+  return OSIP_SUCCESS;
+}
+
+/* Parse the headers kept by __osip_message_call_method(): all of
+   them, or only the ones handled by setheader. */
+int
+__osip_message_parse_lazy (osip_message_t * sip, int (*setheader) (osip_message_t *, const char *))
+{
+  int property;
+  int pos = 0;
+
+#ifdef OSIP_ARENA
+  struct osip_arena *previous = __osip_arena_bind (sip->arena);
+#endif
+
+  /* the message content is the same: keep the buffer built by osip_message_to_str() */
+  property = sip->message_property;
+  while (!osip_list_eol (&sip->lazy_headers, pos)) {
+    osip_header_t *header;
+    int i;
+
+    header = (osip_header_t *) osip_list_get (&sip->lazy_headers, pos);
+    i = __osip_message_is_known_header (header->hname);
+    if (i < 0 || (setheader != NULL && pconfig[i].setheader != setheader)) {
+      pos++;
+      continue;
+    }
+    osip_list_remove (&sip->lazy_headers, pos);
+    if (pconfig[i].setheader (sip, header->hvalue) < 0) {
+      OSIP_TRACE (osip_trace (__FILE__, __LINE__, OSIP_WARNING, NULL, "Could not set header: %s: %s\n", header->hname, header->hvalue));
+    }
+    osip_header_free (header);
+  }
+  sip->message_property = property;
+#ifdef OSIP_ARENA
+  __osip_arena_bind (previous);
+#endif
+  return OSIP_SUCCESS;
+}
+
+int
+osip_message_parse_lazy_header (osip_message_t * sip, const char *hname)
+{
+  int i;
+
+  if (sip == NULL || hname == NULL)
+    return OSIP_BADPARAMETER;
+  i = __osip_message_known_header_index (hname);
+  if (i == OSIP_BADPARAMETER)
+    return i;
+  if (i < 0)
+    return OSIP_NOTFOUND;
+  if (osip_list_eol (&sip->lazy_headers, 0))
+    return OSIP_SUCCESS;
+  return __osip_message_parse_lazy (sip, pconfig[i].setheader);
+}
+
+int
+osip_message_parse_lazy_headers (osip_message_t * sip)
+{
+  if (sip == NULL)
+    return OSIP_BADPARAMETER;
+  if (osip_list_eol (&sip->lazy_headers, 0))
+    return OSIP_SUCCESS;
+  return __osip_message_parse_lazy (sip, NULL);
+}
@@ -1195,8 +1195,643 @@ osip_set_allocators (osip_malloc_func_t * malloc_func, osip_realloc_func_t * rea
 }
 #endif
 
+#ifdef OSIP_ARENA
+
+/*
+  Pages for arenas and pools.
+
+  Pages are cut out of a few large regions, so that the owner of a
+  pointer can be found by comparing addresses only. Arenas and pools
+  use distinct sets of regions. Regions of pools are never released;
+  regions of arenas are released when all their pages are free.
+*/
+
+#define PAGE_SIZE_BYTES 4096
+#define PAGES_MAX_REGIONS 16
+#define PAGES_FIRST_REGION_PAGES 16     /* doubled for each new region */
+
+struct osip_page_set {
+  char *regions[PAGES_MAX_REGIONS];
+  size_t regions_size[PAGES_MAX_REGIONS];
+  int nb_regions;
+  char *free_pages;             /* pages are linked through their first word */
+  size_t nb_pages;              /* pages of all regions */
+  size_t nb_free_pages;
+  int lock;
+};
+
+static void *
+__osip_heap_malloc (size_t size)
+{
+  return osip_malloc_func ? osip_malloc_func (size) : malloc (size);
+}
+
+static char *
+__osip_pages_get (struct osip_page_set *set)
+{
+  char *page;
+
+  while (__sync_lock_test_and_set (&set->lock, 1))
+    ;
+  if (set->free_pages == NULL && set->nb_regions < PAGES_MAX_REGIONS) {
+    size_t nb_pages = (size_t) PAGES_FIRST_REGION_PAGES << set->nb_regions;
+    char *region = (char *) __osip_heap_malloc (nb_pages * PAGE_SIZE_BYTES);
+
+    if (region != NULL) {
+      size_t i;
+
+      for (i = 0; i < nb_pages; i++) {
+        page = region + i * PAGE_SIZE_BYTES;
+        *(char **) page = set->free_pages;
+        set->free_pages = page;
+      }
+      set->regions[set->nb_regions] = region;
+      set->regions_size[set->nb_regions] = nb_pages * PAGE_SIZE_BYTES;
+      set->nb_pages += nb_pages;
+      set->nb_free_pages += nb_pages;
+      /* publish the region after its bounds for __osip_pages_owns() */
+      __atomic_store_n (&set->nb_regions, set->nb_regions + 1, __ATOMIC_RELEASE);
+    }
+  }
+  page = set->free_pages;
+  if (page != NULL) {
+    set->free_pages = *(char **) page;
+    set->nb_free_pages--;
+  }
+  __sync_lock_release (&set->lock);
+  return page;
+}
+
+/* give back a list of nb pages linked through their first word; when
+   all pages are free, regions but the first are released (the set
+   must not be used with __osip_pages_owns) */
+static void
+__osip_pages_put (struct osip_page_set *set, char *first, char *last, size_t nb, int release)
+{
+  char *regions[PAGES_MAX_REGIONS];
+  int nb_regions = 0;
+  size_t i;
+
+  while (__sync_lock_test_and_set (&set->lock, 1))
+    ;
+  *(char **) last = set->free_pages;
+  set->free_pages = first;
+  set->nb_free_pages += nb;
+  if (release && set->nb_regions > 1 && set->nb_free_pages == set->nb_pages) {
+    /* keep the pages of the first region only */
+    nb_regions = set->nb_regions - 1;
+    memcpy (regions, set->regions + 1, nb_regions * sizeof (char *));
+    set->free_pages = NULL;
+    for (i = 0; i < PAGES_FIRST_REGION_PAGES; i++) {
+      *(char **) (set->regions[0] + i * PAGE_SIZE_BYTES) = set->free_pages;
+      set->free_pages = set->regions[0] + i * PAGE_SIZE_BYTES;
+    }
+    set->nb_regions = 1;
+    set->nb_pages = PAGES_FIRST_REGION_PAGES;
+    set->nb_free_pages = PAGES_FIRST_REGION_PAGES;
+  }
+  __sync_lock_release (&set->lock);
+  while (nb_regions > 0) {
+    nb_regions--;
+    if (osip_free_func)
+      osip_free_func (regions[nb_regions]);
+    else
+      free (regions[nb_regions]);
+  }
+}
+
+#ifdef OSIP_POOL
+static int
+__osip_pages_owns (struct osip_page_set *set, const void *ptr)
+{
+  int nb_regions = __atomic_load_n (&set->nb_regions, __ATOMIC_ACQUIRE);
+  int i;
+
+  for (i = 0; i < nb_regions; i++) {
+    if ((const char *) ptr >= set->regions[i] && (const char *) ptr < set->regions[i] + set->regions_size[i])
+      return 1;
+  }
+  return 0;
+}
 #endif
 
+/*
+  Per-message memory arenas.
+
+  An arena is a list of pages: memory is taken from the current page
+  by moving a pointer and is never given back individually. Blocks
+  larger than a page are taken from the heap and linked in the arena.
+  All of them are released at once with the arena.
+
+  An arena is used for the allocations made by the current thread
+  while it is bound with __osip_arena_bind(). osip_free() of a block
+  of the bound arena does nothing (elements freed while parsing);
+  blocks of an arena must not be freed while it is not bound.
+*/
+
+#define ARENA_ALIGN 8
+#define ARENA_HEADER_SIZE 8     /* size of block, used by realloc */
+
+struct osip_arena_block {
+  struct osip_arena_block *next;
+  struct osip_arena_block *prev;
+  size_t size;
+  size_t align;                 /* keep the block aligned as malloc() */
+};
+
+struct osip_arena {
+  char *pages;                  /* pages are linked through their first word */
+  char *pos;
+  char *end;
+  int nb_pages;
+  struct osip_arena_block *blocks;      /* blocks larger than a page */
+};
+
+int osip_arena_used = 0;
+
+static __thread struct osip_arena *arena_current = NULL;
+
+static struct osip_page_set arena_pages;
+
+#define ARENA_ROUND(S) (((S) + ARENA_ALIGN - 1) & ~((size_t) ARENA_ALIGN - 1))
+
+/* the page of the arena holding ptr, if any */
+static int
+__osip_arena_has_page (struct osip_arena *arena, const void *ptr)
+{
+  char *page;
+
+  for (page = arena->pages; page != NULL; page = *(char **) page) {
+    if ((const char *) ptr >= page && (const char *) ptr < page + PAGE_SIZE_BYTES)
+      return 1;
+  }
+  return 0;
+}
+
+/* the large block of the arena for ptr, if any */
+static struct osip_arena_block *
+__osip_arena_find_block (struct osip_arena *arena, const void *ptr)
+{
+  struct osip_arena_block *block;
+
+  for (block = arena->blocks; block != NULL; block = block->next) {
+    if ((const void *) (block + 1) == ptr)
+      return block;
+  }
+  return NULL;
+}
+
+static void
+__osip_arena_unlink_block (struct osip_arena *arena, struct osip_arena_block *block)
+{
+  if (block->prev != NULL)
+    block->prev->next = block->next;
+  else
+    arena->blocks = block->next;
+  if (block->next != NULL)
+    block->next->prev = block->prev;
+}
+
+static void
+__osip_arena_link_block (struct osip_arena *arena, struct osip_arena_block *block)
+{
+  block->prev = NULL;
+  block->next = arena->blocks;
+  if (arena->blocks != NULL)
+    arena->blocks->prev = block;
+  arena->blocks = block;
+}
+
+/* a block taken from the heap, released with the arena */
+static void *
+__osip_arena_block_malloc (struct osip_arena *arena, size_t size)
+{
+  struct osip_arena_block *block;
+
+  block = (struct osip_arena_block *) __osip_heap_malloc (sizeof (struct osip_arena_block) + size);
+  if (block == NULL)
+    return NULL;
+  block->size = size;
+  __osip_arena_link_block (arena, block);
+  return block + 1;
+}
+
+static void
+__osip_heap_free (void *ptr)
+{
+  if (osip_free_func)
+    osip_free_func (ptr);
+  else
+    free (ptr);
+}
+
+static void *
+__osip_heap_realloc (void *ptr, size_t size)
+{
+  return osip_realloc_func ? osip_realloc_func (ptr, size) : realloc (ptr, size);
+}
+
+struct osip_arena *
+__osip_arena_create (void)
+{
+  struct osip_arena *arena;
+  char *page;
+
+  page = __osip_pages_get (&arena_pages);
+  if (page == NULL)
+    return NULL;
+  *(char **) page = NULL;
+  arena = (struct osip_arena *) (page + ARENA_ALIGN);
+  arena->pages = page;
+  arena->pos = page + ARENA_ALIGN + ARENA_ROUND (sizeof (struct osip_arena));
+  arena->end = page + PAGE_SIZE_BYTES;
+  arena->nb_pages = 1;
+  arena->blocks = NULL;
+  osip_arena_used = 1;
+  return arena;
+}
+
+void
+__osip_arena_release (struct osip_arena *arena)
+{
+  struct osip_arena_block *block;
+
+  if (arena == NULL)
+    return;
+  if (arena_current == arena)
+    arena_current = NULL;
+  while (arena->blocks != NULL) {
+    block = arena->blocks;
+    arena->blocks = block->next;
+    __osip_heap_free (block);
+  }
+  /* the arena itself is stored in its first page, the last of the list */
+  __osip_pages_put (&arena_pages, arena->pages, (char *) arena - ARENA_ALIGN, arena->nb_pages, 1);
+}
+
+struct osip_arena *
+__osip_arena_bind (struct osip_arena *arena)
+{
+  struct osip_arena *previous = arena_current;
+
+  arena_current = arena;
+  return previous;
+}
+
+void *
+__osip_arena_malloc (size_t size)
+{
+  struct osip_arena *arena = arena_current;
+  size_t needed = ARENA_HEADER_SIZE + ARENA_ROUND (size);
+  char *ptr;
+
+  if (arena == NULL)
+    return __osip_heap_malloc (size);
+
+  if (needed > PAGE_SIZE_BYTES - ARENA_ALIGN)
+    return __osip_arena_block_malloc (arena, size);
+
+  if ((size_t) (arena->end - arena->pos) < needed) {
+    char *page = __osip_pages_get (&arena_pages);
+
+    if (page == NULL)
+      return __osip_arena_block_malloc (arena, size);
+    *(char **) page = arena->pages;
+    arena->pages = page;
+    arena->pos = page + ARENA_ALIGN;
+    arena->end = page + PAGE_SIZE_BYTES;
+    arena->nb_pages++;
+  }
+  ptr = arena->pos;
+  arena->pos += needed;
+  *(size_t *) ptr = size;
+  return ptr + ARENA_HEADER_SIZE;
+}
+
+void *
+__osip_arena_realloc (void *ptr, size_t size)
+{
+  struct osip_arena *arena = arena_current;
+  struct osip_arena_block *block;
+  size_t old_size;
+  void *mem;
+
+  if (ptr == NULL)
+    return __osip_arena_malloc (size);
+  if (arena == NULL)
+    return __osip_heap_realloc (ptr, size);
+
+  if (__osip_arena_has_page (arena, ptr))
+    old_size = *(size_t *) ((char *) ptr - ARENA_HEADER_SIZE);
+  else {
+    block = __osip_arena_find_block (arena, ptr);
+    if (block == NULL)
+      return __osip_heap_realloc (ptr, size);   /* allocated out of the arena */
+    old_size = block->size;
+  }
+  mem = __osip_arena_malloc (size);
+  if (mem == NULL)
+    return NULL;
+  memcpy (mem, ptr, old_size < size ? old_size : size);
+  __osip_arena_free (ptr);
+  return mem;
+}
+
+void
+__osip_arena_free (void *ptr)
+{
+  struct osip_arena *arena = arena_current;
+  struct osip_arena_block *block;
+
+  if (arena != NULL) {
+    if (__osip_arena_has_page (arena, ptr))
+      return;                   /* given back with the arena */
+    block = __osip_arena_find_block (arena, ptr);
+    if (block != NULL) {
+      __osip_arena_unlink_block (arena, block);
+      ptr = block;
+    }
+  }
+  __osip_heap_free (ptr);
+}
+
+#endif
+
+#ifdef OSIP_POOL
+
+/*
+  Pools of small objects (list nodes, parameters, headers).
+
+  Objects are grouped by size class; each page of the pool holds
+  objects of a single class. A thread takes objects from its own
+  cache without any lock. When the cache is empty, a batch of
+  objects is taken from the depot of the class (or a new page is
+  cut) and when the cache holds too many objects, a batch is given
+  back to the depot.
+
+  Free objects are linked through their first word; batches in the
+  depot are linked through the second word of their first object.
+  Pages are never released: memory of freed objects is reused for
+  objects of the same class only, which keeps the heap from being
+  fragmented by these small blocks.
+
+  Statistics of a thread are added to the depot when it exchanges
+  a batch, so they lag by at most one batch per thread. With pthreads,
+  the caches of a thread are given back to the depots when it exits.
+*/
+
+#if defined(HAVE_PTHREAD) || defined(HAVE_PTH_PTHREAD_H)
+#include <pthread.h>
+#define POOL_THREAD_KEY
+#endif
+
+#define POOL_GRANULARITY 16
+#define POOL_BATCH 32
+
+struct osip_pool_depot {
+  int lock;
+  char *batches;
+  unsigned long nb_pages;
+  unsigned long new_objects;    /* objects cut from new pages */
+  unsigned long allocations;
+  unsigned long frees;
+};
+
+struct osip_pool_cache {
+  char *objects;
+  int count;
+  unsigned long allocations;
+  unsigned long frees;
+};
+
+static struct osip_page_set pool_pages;
+static struct osip_pool_depot pool_depots[OSIP_POOL_NB_CLASSES];
+static __thread struct osip_pool_cache pool_caches[OSIP_POOL_NB_CLASSES];
+
+#ifdef POOL_THREAD_KEY
+static pthread_key_t pool_caches_key;
+static pthread_once_t pool_caches_once = PTHREAD_ONCE_INIT;
+static __thread int pool_caches_registered;
+
+static void
+__osip_pool_caches_exit (void *arg)
+{
+  osip_pool_thread_release ();
+}
+
+static void
+__osip_pool_caches_key_init (void)
+{
+  pthread_key_create (&pool_caches_key, &__osip_pool_caches_exit);
+}
+
+/* release the caches when the thread exits */
+static void
+__osip_pool_caches_register (void)
+{
+  pool_caches_registered = 1;
+  pthread_once (&pool_caches_once, &__osip_pool_caches_key_init);
+  pthread_setspecific (pool_caches_key, pool_caches);
+}
+#endif
+
+#define POOL_CLASS(S) ((int) (((S) + POOL_GRANULARITY - 1) / POOL_GRANULARITY) - 1)
+#define POOL_OBJECT_SIZE(C) ((size_t) ((C) + 1) * POOL_GRANULARITY)
+
+static void
+__osip_pool_lock (struct osip_pool_depot *depot)
+{
+  while (__sync_lock_test_and_set (&depot->lock, 1))
+    ;
+}
+
+static void
+__osip_pool_unlock (struct osip_pool_depot *depot)
+{
+  __sync_lock_release (&depot->lock);
+}
+
+/* move the statistics of a thread to the depot, which is locked */
+static void
+__osip_pool_account (struct osip_pool_depot *depot, struct osip_pool_cache *cache)
+{
+  depot->allocations += cache->allocations;
+  depot->frees += cache->frees;
+  cache->allocations = 0;
+  cache->frees = 0;
+}
+
+static int
+__osip_pool_refill (int cls, struct osip_pool_cache *cache)
+{
+  struct osip_pool_depot *depot = &pool_depots[cls];
+  size_t size = POOL_OBJECT_SIZE (cls);
+  char *batch;
+  char *page;
+  char *obj;
+  int i;
+
+#ifdef POOL_THREAD_KEY
+  if (!pool_caches_registered)
+    __osip_pool_caches_register ();
+#endif
+  __osip_pool_lock (depot);
+  batch = depot->batches;
+  if (batch != NULL)
+    depot->batches = ((char **) batch)[1];
+  __osip_pool_account (depot, cache);
+  __osip_pool_unlock (depot);
+
+  if (batch != NULL) {
+    cache->objects = batch;
+    cache->count = 0;
+    for (obj = batch; obj != NULL; obj = *(char **) obj)
+      cache->count++;
+    return OSIP_SUCCESS;
+  }
+
+  page = __osip_pages_get (&pool_pages);
+  if (page == NULL)
+    return OSIP_NOMEM;
+  cache->objects = NULL;
+  cache->count = 0;
+  /* link the objects of the page, the first one at the head */
+  for (i = (int) (PAGE_SIZE_BYTES / size) - 1; i >= 0; i--) {
+    obj = page + i * size;
+    *(char **) obj = cache->objects;
+    cache->objects = obj;
+    cache->count++;
+  }
+
+  __osip_pool_lock (depot);
+  depot->nb_pages++;
+  depot->new_objects += cache->count;
+  __osip_pool_unlock (depot);
+  return OSIP_SUCCESS;
+}
+
+/* give at most nb objects of the cache to the depot */
+static void
+__osip_pool_flush (int cls, struct osip_pool_cache *cache, int nb)
+{
+  struct osip_pool_depot *depot = &pool_depots[cls];
+  char *first = cache->objects;
+  char *last = first;
+  int i;
+
+  if (first == NULL)
+    return;
+  for (i = 1; i < nb && *(char **) last != NULL; i++)
+    last = *(char **) last;
+  cache->objects = *(char **) last;
+  cache->count -= i;
+  *(char **) last = NULL;
+
+  __osip_pool_lock (depot);
+  ((char **) first)[1] = depot->batches;
+  depot->batches = first;
+  __osip_pool_account (depot, cache);
+  __osip_pool_unlock (depot);
+}
+
+void *
+__osip_pool_malloc (size_t size)
+{
+  struct osip_pool_cache *cache;
+  char *obj;
+  int cls;
+
+  if (size == 0 || size > OSIP_POOL_MAX_SIZE)
+    return osip_malloc (size);
+  if (arena_current != NULL)
+    return __osip_arena_malloc (size);  /* element of an arena message */
+
+  cls = POOL_CLASS (size);
+  cache = &pool_caches[cls];
+  if (cache->objects == NULL && __osip_pool_refill (cls, cache) != OSIP_SUCCESS)
+    return __osip_heap_malloc (size);
+  obj = cache->objects;
+  cache->objects = *(char **) obj;
+  cache->count--;
+  cache->allocations++;
+  return obj;
+}
+
+void
+__osip_pool_free (void *ptr, size_t size)
+{
+  struct osip_pool_cache *cache;
+  int cls;
+
+  if (ptr == NULL)
+    return;
+  if (size == 0 || size > OSIP_POOL_MAX_SIZE || !__osip_pages_owns (&pool_pages, ptr)) {
+    osip_free (ptr);
+    return;
+  }
+
+#ifdef POOL_THREAD_KEY
+  if (!pool_caches_registered)
+    __osip_pool_caches_register ();
+#endif
+  cls = POOL_CLASS (size);
+  cache = &pool_caches[cls];
+  *(char **) ptr = cache->objects;
+  cache->objects = (char *) ptr;
+  cache->count++;
+  cache->frees++;
+  if (cache->count >= 2 * POOL_BATCH)
+    __osip_pool_flush (cls, cache, POOL_BATCH);
+}
+
+#endif
+
+#endif
+
+void
+osip_pool_thread_release (void)
+{
+#ifdef OSIP_POOL
+  int cls;
+
+  for (cls = 0; cls < OSIP_POOL_NB_CLASSES; cls++) {
+    while (pool_caches[cls].objects != NULL)
+      __osip_pool_flush (cls, &pool_caches[cls], POOL_BATCH);
+    if (pool_caches[cls].allocations > 0 || pool_caches[cls].frees > 0) {
+      __osip_pool_lock (&pool_depots[cls]);
+      __osip_pool_account (&pool_depots[cls], &pool_caches[cls]);
+      __osip_pool_unlock (&pool_depots[cls]);
+    }
+  }
+#endif
+}
+
+int
+osip_pool_get_stats (int size_class, osip_pool_stats_t * stats)
+{
+#ifdef OSIP_POOL
+  struct osip_pool_depot *depot;
+
+  if (stats == NULL || size_class < 0)
+    return OSIP_BADPARAMETER;
+  if (size_class >= OSIP_POOL_NB_CLASSES)
+    return OSIP_NOTFOUND;
+  depot = &pool_depots[size_class];
+  __osip_pool_lock (depot);
+  stats->object_size = POOL_OBJECT_SIZE (size_class);
+  stats->allocations = depot->allocations;
+  stats->frees = depot->frees;
+  stats->hits = depot->allocations > depot->new_objects ? depot->allocations - depot->new_objects : 0;
+  stats->resident_bytes = (size_t) depot->nb_pages * PAGE_SIZE_BYTES;
+  __osip_pool_unlock (depot);
+  return OSIP_SUCCESS;
+#else
+  if (stats == NULL || size_class < 0)
+    return OSIP_BADPARAMETER;
+  return OSIP_NOTFOUND;         /* objects are allocated with osip_malloc */
+#endif
+}
+
 #if defined(__VXWORKS_OS__)
 
 typedef struct {
@@ -0,0 +1,316 @@
+/*
+  The oSIP library implements the Session Initiation Protocol (SIP -rfc3261-)
+  Copyright (C) 2001-2012 Aymeric MOIZARD amoizard@antisip.com
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <osipparser2/internal.h>
+
+#include <osipparser2/osip_port.h>
+#include <osipparser2/osip_message.h>
+#include <osipparser2/osip_parser.h>
+
+/*
+  Framing of SIP messages received on a stream (TCP/TLS).
+
+  Received bytes are appended to a buffer. The parser remembers how
+  far the buffer was examined: the end of the headers is searched in
+  new bytes only, and once the headers are complete, the parser only
+  waits for Content-Length bytes of body. A complete message is parsed
+  in place (osip_message_parse_view) and removed from the buffer.
+
+  CRLF received between messages are RFC 5626 keep-alives: a double
+  CRLF ("ping") is counted and must be answered by a single CRLF
+  ("pong"), a single CRLF is a "pong" and is discarded.
+*/
+
+#define STREAM_STATE_START   0  /* between messages, skipping CRLF */
+#define STREAM_STATE_HEADERS 1  /* searching the end of headers */
+#define STREAM_STATE_BODY    2  /* waiting for the body */
+#define STREAM_STATE_BROKEN  3  /* framing lost: stream must be closed */
+
+#define STREAM_MIN_SIZE 4096
+#define STREAM_DEFAULT_MAX_SIZE 65536
+
+struct osip_stream_parser {
+  char *buf;                    /* always one extra byte for parsing in place */
+  size_t size;                  /* allocated size of buf, minus one */
+  size_t start;                 /* first byte not consumed */
+  size_t end;                   /* end of received data */
+  size_t max_size;              /* maximum size of a message */
+
+  int state;
+  size_t pos;                   /* next byte to examine */
+  int newlines;                 /* consecutive newlines in STREAM_STATE_START */
+  size_t message_length;        /* headers + body, in STREAM_STATE_BODY */
+  int pings;
+};
+
+int
+osip_stream_parser_init (osip_stream_parser_t ** parser, size_t max_size)
+{
+  if (parser == NULL)
+    return OSIP_BADPARAMETER;
+  *parser = (osip_stream_parser_t *) osip_malloc (sizeof (osip_stream_parser_t));
+  if (*parser == NULL)
+    return OSIP_NOMEM;
+  memset (*parser, 0, sizeof (osip_stream_parser_t));
+  (*parser)->max_size = max_size > 0 ? max_size : STREAM_DEFAULT_MAX_SIZE;
+  (*parser)->state = STREAM_STATE_START;
+  return OSIP_SUCCESS;
+}
+
+void
+osip_stream_parser_free (osip_stream_parser_t * parser)
+{
+  if (parser == NULL)
+    return;
+  osip_free (parser->buf);
+  osip_free (parser);
+}
+
+int
+osip_stream_parser_feed (osip_stream_parser_t * parser, const char *buf, size_t length)
+{
+  if (parser == NULL || (buf == NULL && length > 0))
+    return OSIP_BADPARAMETER;
+  if (parser->state == STREAM_STATE_BROKEN)
+    return OSIP_WRONG_STATE;
+  if (length == 0)
+    return OSIP_SUCCESS;
+
+  if (parser->size - parser->end < length) {
+    size_t pending = parser->end - parser->start;
+
+    if (parser->start > 0) {
+      /* drop consumed bytes: positions are relative to start */
+      memmove (parser->buf, parser->buf + parser->start, pending);
+      parser->pos -= parser->start;
+      parser->end = pending;
+      parser->start = 0;
+    }
+    if (parser->size - parser->end < length) {
+      size_t size = parser->size > 0 ? parser->size : STREAM_MIN_SIZE;
+      char *tmp;
+
+      while (size - parser->end < length)
+        size *= 2;
+      tmp = (char *) osip_realloc (parser->buf, size + 1);
+      if (tmp == NULL)
+        return OSIP_NOMEM;
+      parser->buf = tmp;
+      parser->size = size;
+    }
+  }
+  memcpy (parser->buf + parser->end, buf, length);
+  parser->end += length;
+  return OSIP_SUCCESS;
+}
+
+/* Find the Content-Length value in the header block [hdr, end[. */
+static int
+__osip_stream_content_length (const char *hdr, const char *end, size_t * content_length)
+{
+  const char *line;
+  int found = 0;
+
+  *content_length = 0;
+  for (line = hdr; line < end;) {
+    const char *eol = memchr (line, '\n', end - line);
+    const char *p = NULL;
+
+    if (eol == NULL)
+      eol = end;
+    if (eol - line > 14 && osip_strncasecmp (line, "content-length", 14) == 0)
+      p = line + 14;
+    else if (eol - line > 1 && (line[0] == 'l' || line[0] == 'L'))
+      p = line + 1;
+    if (p != NULL) {
+      while (p < eol && (*p == ' ' || *p == '\t'))
+        p++;
+      if (p < eol && *p == ':') {
+        size_t value = 0;
+
+        p++;
+        while (p < eol && (*p == ' ' || *p == '\t'))
+          p++;
+        if (p == eol || *p < '0' || *p > '9')
+          return OSIP_SYNTAXERROR;
+        while (p < eol && *p >= '0' && *p <= '9') {
+          if (value > ((size_t) -1 - 9) / 10)
+            return OSIP_SYNTAXERROR;
+          value = value * 10 + (*p - '0');
+          p++;
+        }
+        while (p < eol && (*p == ' ' || *p == '\t' || *p == '\r'))
+          p++;
+        if (p != eol)
+          return OSIP_SYNTAXERROR;
+        /* two different values make the framing ambiguous */
+        if (found && value != *content_length)
+          return OSIP_SYNTAXERROR;
+        *content_length = value;
+        found = 1;
+      }
+    }
+    line = eol + 1;
+  }
+  return OSIP_SUCCESS;
+}
+
+/* Move forward in the buffer: returns OSIP_SUCCESS when a complete
+   message is at start, OSIP_NOTFOUND when more data is needed. */
+static int
+__osip_stream_frame (osip_stream_parser_t * parser)
+{
+  char *buf = parser->buf;
+
+  if (parser->state == STREAM_STATE_START) {
+    while (parser->pos < parser->end) {
+      char c = buf[parser->pos];
+
+      if (c == '\n') {
+        parser->newlines++;
+        if (parser->newlines == 2) {
+          parser->pings++;
+          parser->newlines = 0;
+        }
+      }
+      else if (c != '\r')
+        break;
+      parser->pos++;
+    }
+    parser->start = parser->pos;
+    if (parser->pos == parser->end) {
+      /* everything is consumed: reuse the buffer from its beginning */
+      parser->start = parser->pos = parser->end = 0;
+      return OSIP_NOTFOUND;
+    }
+    parser->newlines = 0;
+    parser->state = STREAM_STATE_HEADERS;
+  }
+
+  if (parser->state == STREAM_STATE_HEADERS) {
+    const char *p = buf + parser->pos;
+    const char *end = buf + parser->end;
+    const char *eoh = NULL;
+    size_t content_length;
+
+    while (p < end) {
+      const char *nl = memchr (p, '\n', end - p);
+
+      if (nl == NULL) {
+        p = end;
+        break;
+      }
+      /* an empty line ends the headers: \n\n or \n\r\n */
+      if (nl + 1 < end && nl[1] == '\n') {
+        eoh = nl + 2;
+        break;
+      }
+      if (nl + 2 < end && nl[1] == '\r' && nl[2] == '\n') {
+        eoh = nl + 3;
+        break;
+      }
+      if (nl + 1 == end || (nl + 2 == end && nl[1] == '\r')) {
+        p = nl;                 /* look at this newline again with more data */
+        break;
+      }
+      p = nl + 1;
+    }
+    parser->pos = p - buf;
+
+    if (eoh == NULL) {
+      if (parser->end - parser->start > parser->max_size) {
+        OSIP_TRACE (osip_trace (__FILE__, __LINE__, OSIP_ERROR, NULL, "SIP headers too large on stream.\n"));
+        parser->state = STREAM_STATE_BROKEN;
+        return OSIP_WRONG_STATE;
+      }
+      return OSIP_NOTFOUND;
+    }
+
+    if (__osip_stream_content_length (buf + parser->start, eoh, &content_length) != 0 || content_length > parser->max_size || (size_t) (eoh - (buf + parser->start)) > parser->max_size - content_length) {
+      OSIP_TRACE (osip_trace (__FILE__, __LINE__, OSIP_ERROR, NULL, "Bad or too large Content-Length on stream.\n"));
+      parser->state = STREAM_STATE_BROKEN;
+      return OSIP_WRONG_STATE;
+    }
+    parser->message_length = (eoh - (buf + parser->start)) + content_length;
+    parser->state = STREAM_STATE_BODY;
+  }
+
+  if (parser->state == STREAM_STATE_BODY) {
+    if (parser->end - parser->start < parser->message_length)
+      return OSIP_NOTFOUND;
+    return OSIP_SUCCESS;
+  }
+
+  return OSIP_WRONG_STATE;
+}
+
+int
+osip_stream_parser_get_message (osip_stream_parser_t * parser, osip_message_t ** sip)
+{
+  char *msg;
+  size_t length;
+  char saved;
+  int i;
+
+  if (sip != NULL)
+    *sip = NULL;
+  if (parser == NULL || sip == NULL)
+    return OSIP_BADPARAMETER;
+  if (parser->state == STREAM_STATE_BROKEN)
+    return OSIP_WRONG_STATE;
+
+  i = __osip_stream_frame (parser);
+  if (i != OSIP_SUCCESS)
+    return i;
+
+  msg = parser->buf + parser->start;
+  length = parser->message_length;
+  parser->start += length;
+  parser->pos = parser->start;
+  parser->state = STREAM_STATE_START;
+
+  i = osip_message_init (sip);
+  if (i != 0)
+    return i;
+  /* parse in place: the byte after the message is restored */
+  saved = msg[length];
+  i = osip_message_parse_view (*sip, msg, length);
+  msg[length] = saved;
+  if (i != 0) {
+    osip_message_free (*sip);
+    *sip = NULL;
+    return OSIP_SYNTAXERROR;
+  }
+  return OSIP_SUCCESS;
+}
+
+int
+osip_stream_parser_get_pings (osip_stream_parser_t * parser)
+{
+  int pings;
+
+  if (parser == NULL)
+    return OSIP_BADPARAMETER;
+  /* keep-alives received after the last complete message */
+  if (parser->state == STREAM_STATE_START)
+    __osip_stream_frame (parser);
+  pings = parser->pings;
+  parser->pings = 0;
+  return pings;
+}
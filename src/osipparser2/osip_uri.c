@@ -718,7 +718,7 @@ osip_uri_clone (const osip_uri_t * url, osip_uri_t ** dest)
 int
 osip_uri_param_init (osip_uri_param_t ** url_param)
 {
-  *url_param = (osip_uri_param_t *) osip_malloc (sizeof (osip_uri_param_t));
+  *url_param = (osip_uri_param_t *) __osip_pool_malloc (sizeof (osip_uri_param_t));
   if (*url_param == NULL)
     return OSIP_NOMEM;
   (*url_param)->gname = NULL;
@@ -731,7 +731,7 @@ osip_uri_param_free (osip_uri_param_t * url_param)
 {
   osip_free (url_param->gname);
   osip_free (url_param->gvalue);
-  osip_free (url_param);
+  __osip_pool_free (url_param, sizeof (osip_uri_param_t));
 }
 
 int
@@ -36,8 +36,24 @@ typedef struct ___osip_message_config_t {
   int ignored_when_invalid;
 } __osip_message_config_t;
 
+/* the known header i of the message is kept raw while parsing */
+#define __osip_message_is_lazy(sip,i) (((sip)->lazy_mask[(i) / 32] >> ((i) % 32)) & 1)
+
 int __osip_message_call_method (int i, osip_message_t * dest, const char *hvalue);
 int __osip_message_is_known_header (const char *hname);
+int __osip_message_parse_lazy (osip_message_t * sip, int (*setheader) (osip_message_t *, const char *));
+
+/* implementations of the scan of the header block */
+#define OSIP_HEADER_SCAN_SCALAR 0
+#define OSIP_HEADER_SCAN_SSE2 1
+#define OSIP_HEADER_SCAN_AVX2 2
+
+/* use the fastest scan supported by the CPU; returns the scan used */
+int __osip_message_header_scan_select (void);
+/* build the index of the header block of buf with the given scan, and
+   describe it in *dest (for the tests); OSIP_NOTFOUND if the scan is
+   not compiled in or not supported by the CPU */
+int __osip_message_header_index_dump (int scan, const char *buf, size_t length, char **dest);
 
 int __osip_find_next_occurence (const char *str, const char *buf, const char **index_of_str, const char *end_of_buf);
 int __osip_find_next_crlf (const char *start_of_header, const char **end_of_header);
@@ -0,0 +1,308 @@
+/*
+  The oSIP library implements the Session Initiation Protocol (SIP -rfc3261-)
+  Copyright (C) 2001-2012 Aymeric MOIZARD amoizard@antisip.com
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+#ifdef ENABLE_MPATROL
+#include <mpatrol.h>
+#endif
+
+#include <osip2/internal.h>
+#include <osip2/osip.h>
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+/*
+  Test of the DNS cache with a stub resolver: the resolver only records
+  the lookups it is given, results are given by the test itself.
+*/
+
+#define STUB_MAX_PENDING 16
+
+static osip_naptr_t *stub_pending[STUB_MAX_PENDING];
+static int stub_nb_pending;
+static int stub_calls;
+static int stub_fail;           /* answer OSIP_UNDEFINED_ERROR */
+
+static int nb_errors;
+
+#define CHECK(cond) check ((cond), #cond, __LINE__)
+
+static void
+check (int cond, const char *text, int line)
+{
+  if (cond)
+    return;
+  printf ("line %i: check failed: %s\n", line, text);
+  nb_errors++;
+}
+
+static int
+stub_resolver (osip_naptr_t * naptr, void *arg)
+{
+  stub_calls++;
+  if (stub_fail)
+    return OSIP_UNDEFINED_ERROR;
+  if (stub_nb_pending == STUB_MAX_PENDING)
+    return OSIP_UNDEFINED_ERROR;
+  stub_pending[stub_nb_pending++] = naptr;
+  return OSIP_SUCCESS;
+}
+
+/* give the result of the oldest pending lookup */
+static int
+stub_answer (int state, const char *srv_name, int ttl)
+{
+  osip_naptr_t *naptr;
+  osip_naptr_t *result;
+  int i;
+
+  if (stub_nb_pending == 0)
+    return OSIP_NOTFOUND;
+  naptr = stub_pending[0];
+  stub_nb_pending--;
+  memmove (stub_pending, stub_pending + 1, stub_nb_pending * sizeof (osip_naptr_t *));
+
+  result = (osip_naptr_t *) osip_malloc (sizeof (osip_naptr_t));
+  if (result == NULL)
+    return OSIP_NOMEM;
+  memset (result, 0, sizeof (osip_naptr_t));
+  result->naptr_state = state;
+  if (srv_name != NULL) {
+    osip_strncpy (result->sipudp_record.name, srv_name, sizeof (result->sipudp_record.name) - 1);
+    osip_strncpy (result->sipudp_record.protocol, "UDP", sizeof (result->sipudp_record.protocol) - 1);
+    result->sipudp_record.srv_state = OSIP_SRV_STATE_COMPLETED;
+    osip_strncpy (result->sipudp_record.srventry[0].srv, "sip1.example.org", sizeof (result->sipudp_record.srventry[0].srv) - 1);
+    result->sipudp_record.srventry[0].port = 5060;
+  }
+  i = osip_dns_cache_resolved (naptr, result, ttl);
+  osip_free (result);
+  return i;
+}
+
+static int nb_callbacks;
+
+static void
+lookup_done (osip_naptr_t * naptr, void *arg)
+{
+  nb_callbacks++;
+  CHECK (naptr->naptr_state != OSIP_NAPTR_STATE_INPROGRESS);
+  CHECK (arg == (void *) &nb_callbacks);
+}
+
+/* concurrent lookups of a domain share a single resolution */
+static void
+test_single_flight (void)
+{
+  osip_naptr_t *naptr[3];
+  osip_naptr_t *again;
+  osip_srv_record_t *srv;
+  int i;
+
+  stub_calls = 0;
+  nb_callbacks = 0;
+  for (i = 0; i < 3; i++) {
+    naptr[i] = osip_dns_cache_lookup ("single.example.org", &lookup_done, &nb_callbacks);
+    CHECK (naptr[i] != NULL);
+  }
+  CHECK (stub_calls == 1);
+  CHECK (naptr[0] == naptr[1] && naptr[1] == naptr[2]);
+  CHECK (naptr[0]->naptr_state == OSIP_NAPTR_STATE_INPROGRESS);
+  CHECK (nb_callbacks == 0);
+
+  CHECK (stub_answer (OSIP_NAPTR_STATE_SRVDONE, "_sip._udp.single.example.org", 60) == OSIP_SUCCESS);
+  CHECK (nb_callbacks == 3);
+  CHECK (naptr[0]->naptr_state == OSIP_NAPTR_STATE_SRVDONE);
+  CHECK (osip_dns_cache_resolved (naptr[0], NULL, 60) == OSIP_WRONG_STATE);
+
+  /* the result is cached, and so are its SRV records */
+  again = osip_dns_cache_lookup ("SINGLE.example.org", &lookup_done, &nb_callbacks);
+  CHECK (again == naptr[0]);
+  CHECK (stub_calls == 1);
+  CHECK (nb_callbacks == 3);
+  osip_dns_cache_release_naptr (again);
+
+  srv = osip_dns_cache_get_srv ("_sip._udp.single.example.org", "UDP");
+  CHECK (srv != NULL && srv->srventry[0].port == 5060);
+  osip_dns_cache_release_srv (srv);
+
+  for (i = 0; i < 3; i++)
+    osip_dns_cache_release_naptr (naptr[i]);
+}
+
+/* failures are cached for their time to live */
+static void
+test_negative_caching (void)
+{
+  static const char *domains[2] = { "notsupported.example.org", "retrylater.example.org" };
+  static const int states[2] = { OSIP_NAPTR_STATE_NOTSUPPORTED, OSIP_NAPTR_STATE_RETRYLATER };
+  osip_naptr_t *naptr;
+  int i;
+
+  for (i = 0; i < 2; i++) {
+    stub_calls = 0;
+    naptr = osip_dns_cache_lookup (domains[i], NULL, NULL);
+    CHECK (naptr != NULL);
+    CHECK (stub_answer (states[i], NULL, 60) == OSIP_SUCCESS);
+    CHECK (naptr->naptr_state == states[i]);
+    osip_dns_cache_release_naptr (naptr);
+
+    naptr = osip_dns_cache_lookup (domains[i], NULL, NULL);
+    CHECK (naptr != NULL && naptr->naptr_state == states[i]);
+    CHECK (stub_calls == 1);
+    osip_dns_cache_release_naptr (naptr);
+  }
+
+  /* a resolver failing to start gives an uncached RETRYLATER */
+  stub_calls = 0;
+  stub_fail = 1;
+  naptr = osip_dns_cache_lookup ("failure.example.org", NULL, NULL);
+  CHECK (naptr != NULL && naptr->naptr_state == OSIP_NAPTR_STATE_RETRYLATER);
+  osip_dns_cache_release_naptr (naptr);
+  naptr = osip_dns_cache_lookup ("failure.example.org", NULL, NULL);
+  CHECK (stub_calls == 2);
+  osip_dns_cache_release_naptr (naptr);
+  stub_fail = 0;
+}
+
+/* results expire after their time to live, pending lookups after the
+   pending timeout */
+static void
+test_expiry (void)
+{
+  osip_naptr_t *naptr;
+  osip_naptr_t *stale;
+
+  stub_calls = 0;
+  naptr = osip_dns_cache_lookup ("ttl.example.org", NULL, NULL);
+  CHECK (stub_answer (OSIP_NAPTR_STATE_SRVDONE, NULL, 1) == OSIP_SUCCESS);
+  osip_dns_cache_release_naptr (naptr);
+
+  naptr = osip_dns_cache_lookup ("ttl.example.org", NULL, NULL);
+  CHECK (stub_calls == 1);
+  osip_dns_cache_release_naptr (naptr);
+
+  sleep (2);
+  naptr = osip_dns_cache_lookup ("ttl.example.org", NULL, NULL);
+  CHECK (stub_calls == 2);
+  CHECK (naptr != NULL && naptr->naptr_state == OSIP_NAPTR_STATE_INPROGRESS);
+  CHECK (stub_answer (OSIP_NAPTR_STATE_SRVDONE, NULL, 60) == OSIP_SUCCESS);
+  osip_dns_cache_release_naptr (naptr);
+
+  /* the resolver never answers the first lookup in time */
+  stub_calls = 0;
+  CHECK (osip_dns_cache_set_pending_timeout (1) == OSIP_SUCCESS);
+  stale = osip_dns_cache_lookup ("pending.example.org", NULL, NULL);
+  CHECK (stale != NULL && stale->naptr_state == OSIP_NAPTR_STATE_INPROGRESS);
+  sleep (2);
+  naptr = osip_dns_cache_lookup ("pending.example.org", NULL, NULL);
+  CHECK (stub_calls == 2);
+  CHECK (naptr != NULL && naptr != stale);
+
+  /* the late answer doesn't replace the new resolution */
+  CHECK (stub_answer (OSIP_NAPTR_STATE_NOTSUPPORTED, NULL, 60) == OSIP_SUCCESS);
+  CHECK (naptr->naptr_state == OSIP_NAPTR_STATE_INPROGRESS);
+  CHECK (stub_answer (OSIP_NAPTR_STATE_SRVDONE, NULL, 60) == OSIP_SUCCESS);
+  CHECK (naptr->naptr_state == OSIP_NAPTR_STATE_SRVDONE);
+  osip_dns_cache_release_naptr (stale);
+  osip_dns_cache_release_naptr (naptr);
+
+  naptr = osip_dns_cache_lookup ("pending.example.org", NULL, NULL);
+  CHECK (stub_calls == 2);
+  CHECK (naptr != NULL && naptr->naptr_state == OSIP_NAPTR_STATE_SRVDONE);
+  osip_dns_cache_release_naptr (naptr);
+  CHECK (osip_dns_cache_set_pending_timeout (32) == OSIP_SUCCESS);
+}
+
+static void
+set_entry (osip_srv_record_t * record, int i, int priority, int weight)
+{
+  snprintf (record->srventry[i].srv, sizeof (record->srventry[i].srv), "sip%i.example.org", i);
+  record->srventry[i].priority = priority;
+  record->srventry[i].weight = weight;
+}
+
+/* RFC 2782: lowest priority first, then random by weight */
+static void
+test_srv_select (void)
+{
+  osip_srv_record_t record;
+  int counts[4];
+  int i;
+
+  memset (&record, 0, sizeof (record));
+  set_entry (&record, 0, 20, 10);
+  set_entry (&record, 1, 10, 10);
+  set_entry (&record, 2, 10, 90);
+  set_entry (&record, 3, 30, 0);
+
+  memset (counts, 0, sizeof (counts));
+  for (i = 0; i < 10000; i++) {
+    int k = osip_dns_srv_select (&record, 0);
+
+    CHECK (k == 1 || k == 2);
+    if (k >= 0 && k < 4)
+      counts[k]++;
+  }
+  /* 10/101 and 91/101 expected */
+  CHECK (counts[1] > 500 && counts[1] < 1500);
+  CHECK (counts[2] > 8500 && counts[2] < 9500);
+
+  CHECK (osip_dns_srv_select (&record, 1 << 1) == 2);
+  CHECK (osip_dns_srv_select (&record, (1 << 1) | (1 << 2)) == 0);
+  CHECK (osip_dns_srv_select (&record, (1 << 0) | (1 << 1) | (1 << 2)) == 3);
+  CHECK (osip_dns_srv_select (&record, 0xf) == OSIP_NOTFOUND);
+
+  /* zero weight entries are only selected when the value drawn is 0 */
+  set_entry (&record, 1, 10, 0);
+  memset (counts, 0, sizeof (counts));
+  for (i = 0; i < 10000; i++) {
+    int k = osip_dns_srv_select (&record, 0);
+
+    if (k >= 0 && k < 4)
+      counts[k]++;
+  }
+  CHECK (counts[1] > 0 && counts[1] < 500);
+  CHECK (counts[1] + counts[2] == 10000);
+}
+
+int
+main (int argc, char **argv)
+{
+  osip_t *osip;
+
+  if (osip_init (&osip) != OSIP_SUCCESS) {
+    fprintf (stdout, "Failed to initialize osip.\n");
+    return -1;
+  }
+  osip_dns_cache_set_resolver (&stub_resolver, NULL);
+
+  test_single_flight ();
+  test_negative_caching ();
+  test_expiry ();
+  test_srv_select ();
+
+  osip_dns_cache_set_resolver (NULL, NULL);
+  osip_dns_cache_flush ();
+  osip_release (osip);
+
+  printf ("dns cache: %i error(s)\n", nb_errors);
+  return nb_errors == 0 ? 0 : -1;
+}
@@ -0,0 +1,206 @@
+/*
+  The oSIP library implements the Session Initiation Protocol (SIP -rfc3261-)
+  Copyright (C) 2001-2012 Aymeric MOIZARD amoizard@antisip.com
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+#ifdef ENABLE_MPATROL
+#include <mpatrol.h>
+#endif
+
+#include <osip2/internal.h>
+#include <osipparser2/osip_port.h>
+#include <osip2/osip.h>
+
+#include "fsm.h"
+
+/*
+  Test of the pool of events: events released by another thread than
+  the one allocating them, caches given back to the depot when threads
+  exit, limit of the depot.
+*/
+
+#if defined(OSIP_POOL) && (defined(HAVE_PTHREAD) || defined(HAVE_PTH_PTHREAD_H))
+
+#include <pthread.h>
+
+#define NB_EVENTS 1000
+#define NB_WORKERS 4
+#define NB_ROUNDS 200
+
+static int nb_errors;
+
+#define CHECK(cond) check ((cond), #cond, __LINE__)
+
+static void
+check (int cond, const char *text, int line)
+{
+  if (cond)
+    return;
+  printf ("line %i: check failed: %s\n", line, text);
+  nb_errors++;
+}
+
+static osip_event_t *events[NB_EVENTS];
+
+static void *
+alloc_events (void *arg)
+{
+  int i;
+
+  for (i = 0; i < NB_EVENTS; i++)
+    events[i] = __osip_event_new (TIMEOUT_A, i + 1);
+  return NULL;
+}
+
+static void *
+free_events (void *arg)
+{
+  int errors = 0;
+  int i;
+
+  for (i = 0; i < NB_EVENTS; i++) {
+    if (events[i] == NULL || events[i]->type != TIMEOUT_A || events[i]->transactionid != i + 1 || events[i]->sip != NULL)
+      errors++;
+    if (events[i] != NULL)
+      __osip_event_release (events[i]);
+    events[i] = NULL;
+  }
+  return errors == 0 ? (void *) events : NULL;
+}
+
+/* each worker keeps a few events with its own id and releases them in
+   a different order */
+static void *
+worker (void *arg)
+{
+  int id = (int) (long) arg;
+  osip_event_t *mine[16];
+  int errors = 0;
+  int round;
+  int i;
+
+  for (round = 0; round < NB_ROUNDS; round++) {
+    for (i = 0; i < 16; i++)
+      mine[i] = __osip_event_new (TIMEOUT_B, id * 100 + i);
+    for (i = 15; i >= 0; i--) {
+      if (mine[i] == NULL || mine[i]->transactionid != id * 100 + i) {
+        errors++;
+        continue;
+      }
+      __osip_event_release (mine[i]);
+    }
+  }
+  return errors == 0 ? (void *) mine : NULL;
+}
+
+static void
+run (void *(*func) (void *), void *arg, void **ret)
+{
+  pthread_t thread;
+
+  CHECK (pthread_create (&thread, NULL, func, arg) == 0);
+  CHECK (pthread_join (thread, ret) == 0);
+}
+
+int
+main (int argc, char **argv)
+{
+  osip_event_pool_stats_t before;
+  osip_event_pool_stats_t after;
+  pthread_t threads[NB_WORKERS];
+  osip_event_t *evt;
+  osip_event_t *again;
+  void *ret;
+  int i;
+
+  CHECK (osip_event_pool_get_stats (&before) == OSIP_SUCCESS);
+  CHECK (before.max_cached == 4096);
+
+  /* a released event is given to the next allocation of the thread */
+  evt = __osip_event_new (TIMEOUT_A, 1);
+  CHECK (evt != NULL);
+  __osip_event_release (evt);
+  again = __osip_event_new (TIMEOUT_B, 2);
+  CHECK (again == evt);
+  CHECK (again->type == TIMEOUT_B && again->transactionid == 2 && again->sip == NULL);
+  osip_event_free (again);
+  osip_event_pool_thread_release ();
+  CHECK (osip_event_pool_get_stats (&after) == OSIP_SUCCESS);
+  CHECK (after.allocations - before.allocations == 2);
+  CHECK (after.frees - before.frees == 2);
+  CHECK (after.hits - before.hits == 1);
+
+  /* allocated by a thread, released by another one: the caches of
+     both threads are given back when they exit */
+  before = after;
+  run (&alloc_events, NULL, NULL);
+  run (&free_events, NULL, &ret);
+  CHECK (ret != NULL);
+  CHECK (osip_event_pool_get_stats (&after) == OSIP_SUCCESS);
+  CHECK (after.allocations - before.allocations == NB_EVENTS);
+  CHECK (after.frees - before.frees == NB_EVENTS);
+  CHECK (after.cached >= NB_EVENTS);
+
+  /* a third thread reuses the released events */
+  before = after;
+  run (&alloc_events, NULL, NULL);
+  run (&free_events, NULL, &ret);
+  CHECK (ret != NULL);
+  CHECK (osip_event_pool_get_stats (&after) == OSIP_SUCCESS);
+  CHECK (after.hits - before.hits == NB_EVENTS);
+  CHECK (after.cached == before.cached);
+
+  /* concurrent workers never share an event */
+  before = after;
+  for (i = 0; i < NB_WORKERS; i++)
+    CHECK (pthread_create (&threads[i], NULL, &worker, (void *) (long) (i + 1)) == 0);
+  for (i = 0; i < NB_WORKERS; i++) {
+    CHECK (pthread_join (threads[i], &ret) == 0);
+    CHECK (ret != NULL);
+  }
+  CHECK (osip_event_pool_get_stats (&after) == OSIP_SUCCESS);
+  CHECK (after.allocations - before.allocations == NB_WORKERS * NB_ROUNDS * 16);
+  CHECK (after.frees - before.frees == NB_WORKERS * NB_ROUNDS * 16);
+
+  /* the depot keeps at most max_cached events */
+  CHECK (osip_event_pool_set_max (0) == OSIP_SUCCESS);
+  CHECK (osip_event_pool_get_stats (&after) == OSIP_SUCCESS);
+  CHECK (after.cached == 0);
+  CHECK (after.max_cached == 0);
+  run (&alloc_events, NULL, NULL);
+  run (&free_events, NULL, &ret);
+  CHECK (osip_event_pool_get_stats (&after) == OSIP_SUCCESS);
+  CHECK (after.cached == 0);
+  CHECK (osip_event_pool_set_max (4096) == OSIP_SUCCESS);
+
+  CHECK (osip_event_pool_get_stats (NULL) == OSIP_BADPARAMETER);
+
+  printf ("event pool: %i error(s)\n", nb_errors);
+  return (nb_errors == 0) ? 0 : -1;
+}
+
+#else
+
+int
+main (int argc, char **argv)
+{
+  printf ("event pool: not compiled in\n");
+  return 0;
+}
+
+#endif
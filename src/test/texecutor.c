@@ -0,0 +1,322 @@
+/*
+  The oSIP library implements the Session Initiation Protocol (SIP -rfc3261-)
+  Copyright (C) 2001-2012 Aymeric MOIZARD amoizard@antisip.com
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+#ifdef ENABLE_MPATROL
+#include <mpatrol.h>
+#endif
+
+#include <osip2/internal.h>
+#include <osipparser2/osip_port.h>
+#include <osip2/osip.h>
+#include <osip2/osip_mt.h>
+
+/*
+  Test of the executor (osip_executor_start): the events of a
+  transaction, added by several threads, are processed by one worker
+  at a time and in the order they were added, also when the workers
+  take transactions from the queues of the other workers.
+*/
+
+#ifndef OSIP_MONOTHREAD
+
+#define NB_WORKERS 4
+#define NB_PRODUCERS 4
+#define NB_TRANSACTIONS 32
+#define NB_EVENTS 50
+
+static int nb_errors;
+
+#define CHECK(cond) check ((cond), #cond, __LINE__)
+
+static void
+check (int cond, const char *text, int line)
+{
+  if (cond)
+    return;
+  printf ("line %i: check failed: %s\n", line, text);
+  nb_errors++;
+}
+
+/* the responses processed by a transaction */
+struct record {
+  int busy;                     /* a worker is sending a response */
+  int next;                     /* sequence number of the next response */
+};
+
+static struct osip_mutex *mutex;        /* protects the records and the counters */
+static struct record records[NB_TRANSACTIONS];
+static int nb_processed;
+static int nb_active;
+static int max_active;
+
+/* the application data of each response is its sequence number + 1 */
+static int
+cb_send_message (osip_transaction_t * tr, osip_message_t * sip, char *host, int port, int out_socket)
+{
+  struct record *record = (struct record *) osip_transaction_get_your_instance (tr);
+  int seq = (int) (long) sip->application_data - 1;
+
+  osip_mutex_lock (mutex);
+  CHECK (record->busy == 0);
+  record->busy = 1;
+  nb_active++;
+  if (nb_active > max_active)
+    max_active = nb_active;
+  osip_mutex_unlock (mutex);
+
+  /* another worker processing the same transaction would see busy */
+  osip_usleep (1000);
+
+  osip_mutex_lock (mutex);
+  CHECK (seq == record->next);
+  record->next = seq + 1;
+  record->busy = 0;
+  nb_active--;
+  nb_processed++;
+  osip_mutex_unlock (mutex);
+  return OSIP_SUCCESS;
+}
+
+static osip_transaction_t *transactions[NB_TRANSACTIONS];
+
+static osip_transaction_t *
+new_transaction (osip_t * osip, int branch)
+{
+  osip_transaction_t *tr = NULL;
+  osip_event_t *evt;
+  char buf[512];
+
+  snprintf (buf, sizeof (buf),
+            "OPTIONS sip:bob@example.com SIP/2.0\r\n"
+            "Via: SIP/2.0/UDP 192.168.1.1:5060;branch=z9hG4bK%i\r\n"
+            "From: <sip:alice@example.com>;tag=1\r\n"
+            "To: <sip:bob@example.com>\r\n" "Call-ID: %i@192.168.1.1\r\n" "CSeq: 1 OPTIONS\r\n" "Content-Length: 0\r\n\r\n", branch, branch);
+  evt = osip_parse (buf, strlen (buf));
+  if (evt == NULL)
+    return NULL;
+  if (osip_transaction_init (&tr, NIST, osip, evt->sip) != OSIP_SUCCESS) {
+    osip_event_free (evt);
+    return NULL;
+  }
+  /* NIST_TRYING */
+  osip_transaction_execute (tr, evt);
+  return tr;
+}
+
+/* a response of the transaction i, with its sequence number */
+static osip_message_t *
+new_response (int i, int seq)
+{
+  osip_message_t *sip;
+  char buf[512];
+
+  snprintf (buf, sizeof (buf),
+            "SIP/2.0 100 Trying\r\n"
+            "Via: SIP/2.0/UDP 192.168.1.1:5060;branch=z9hG4bK%i\r\n"
+            "From: <sip:alice@example.com>;tag=1\r\n"
+            "To: <sip:bob@example.com>\r\n" "Call-ID: %i@192.168.1.1\r\n" "CSeq: 1 OPTIONS\r\n" "Content-Length: 0\r\n\r\n", i + 1, i + 1);
+  if (osip_message_init (&sip) != OSIP_SUCCESS)
+    return NULL;
+  if (osip_message_parse (sip, buf, strlen (buf)) != OSIP_SUCCESS) {
+    osip_message_free (sip);
+    return NULL;
+  }
+  sip->application_data = (void *) (long) (seq + 1);
+  return sip;
+}
+
+struct producer {
+  int id;
+  int pause;                    /* between two events of a transaction */
+};
+
+static int selected[NB_TRANSACTIONS];  /* the transactions receiving events */
+static int first[NB_TRANSACTIONS];     /* sequence number of the first response added */
+
+/* each transaction has one producer, which adds its events in order */
+static void *
+produce (void *arg)
+{
+  struct producer *producer = (struct producer *) arg;
+  int seq;
+  int i;
+
+  for (seq = 0; seq < NB_EVENTS; seq++) {
+    for (i = producer->id; i < NB_TRANSACTIONS; i += NB_PRODUCERS) {
+      osip_message_t *sip;
+
+      if (!selected[i])
+        continue;
+      sip = new_response (i, first[i] + seq);
+      if (sip == NULL)
+        return NULL;
+      if (osip_transaction_add_event (transactions[i], osip_new_outgoing_sipmessage (sip)) != OSIP_SUCCESS)
+        return NULL;
+    }
+    osip_usleep (producer->pause);
+  }
+  return arg;
+}
+
+/* wait for the workers to process count responses */
+static void
+wait_processed (int count)
+{
+  int i;
+
+  for (i = 0; i < 3000; i++) {
+    int done;
+
+    osip_mutex_lock (mutex);
+    done = nb_processed;
+    osip_mutex_unlock (mutex);
+    if (done >= count)
+      return;
+    osip_usleep (10000);
+  }
+  CHECK (nb_processed == count);
+}
+
+static void
+run_producers (int pause)
+{
+  struct producer producers[NB_PRODUCERS];
+  struct osip_thread *threads[NB_PRODUCERS];
+  int count = 0;
+  int i;
+
+  for (i = 0; i < NB_TRANSACTIONS; i++) {
+    first[i] = records[i].next;
+    if (selected[i])
+      count += NB_EVENTS;
+  }
+  osip_mutex_lock (mutex);
+  nb_processed = 0;
+  max_active = 0;
+  osip_mutex_unlock (mutex);
+
+  for (i = 0; i < NB_PRODUCERS; i++) {
+    producers[i].id = i;
+    producers[i].pause = pause;
+    threads[i] = osip_thread_create (0, &produce, &producers[i]);
+    CHECK (threads[i] != NULL);
+  }
+  for (i = 0; i < NB_PRODUCERS; i++) {
+    if (threads[i] == NULL)
+      continue;
+    CHECK (osip_thread_join (threads[i]) == 0);
+    osip_free (threads[i]);
+  }
+  wait_processed (count);
+
+  for (i = 0; i < NB_TRANSACTIONS; i++) {
+    if (selected[i])
+      CHECK (records[i].next == first[i] + NB_EVENTS);
+    else
+      CHECK (records[i].next == first[i]);
+    CHECK (records[i].busy == 0);
+  }
+}
+
+int
+main (int argc, char **argv)
+{
+  osip_t *osip;
+  int nb_selected = 0;
+  int i;
+
+  mutex = osip_mutex_init ();
+  if (mutex == NULL || osip_init (&osip) != OSIP_SUCCESS) {
+    printf ("osip_init failed\n");
+    return -1;
+  }
+  osip_set_cb_send_message (osip, &cb_send_message);
+
+  for (i = 0; i < NB_TRANSACTIONS; i++) {
+    transactions[i] = new_transaction (osip, i + 1);
+    CHECK (transactions[i] != NULL);
+    if (transactions[i] == NULL)
+      return -1;
+    CHECK (transactions[i]->state == NIST_TRYING);
+    osip_transaction_set_your_instance (transactions[i], &records[i]);
+    if ((transactions[i]->transactionid % NB_WORKERS) == 0)
+      nb_selected++;
+  }
+  CHECK (nb_selected > 1);
+
+  /* events queued before the executor is started are processed by it */
+  for (i = 0; i < NB_TRANSACTIONS; i++)
+    osip_transaction_add_event (transactions[i], osip_new_outgoing_sipmessage (new_response (i, 0)));
+  CHECK (osip_executor_start (osip, NB_WORKERS) == OSIP_SUCCESS);
+  CHECK (osip_executor_start (osip, NB_WORKERS) == OSIP_WRONG_STATE);
+  wait_processed (NB_TRANSACTIONS);
+  for (i = 0; i < NB_TRANSACTIONS; i++)
+    CHECK (records[i].next == 1);
+
+  /* the events of all transactions, added by several threads */
+  for (i = 0; i < NB_TRANSACTIONS; i++)
+    selected[i] = 1;
+  run_producers (3000);
+  CHECK (max_active > 1);
+
+  /* all events in the queue of the first worker: the other workers
+     take transactions from it */
+  for (i = 0; i < NB_TRANSACTIONS; i++)
+    selected[i] = (transactions[i]->transactionid % NB_WORKERS) == 0;
+  run_producers (3000);
+  CHECK (max_active > 1);
+
+  /* events added faster than processed, to a single transaction: the
+     idle workers must not take it while it is processed */
+  for (i = 0; i < NB_TRANSACTIONS; i++)
+    selected[i] = (i == 0);
+  run_producers (300);
+  CHECK (max_active == 1);
+
+  CHECK (osip_executor_stop (osip) == OSIP_SUCCESS);
+  CHECK (osip_executor_stop (osip) == OSIP_WRONG_STATE);
+  for (i = 0; i < NB_TRANSACTIONS; i++)
+    CHECK (transactions[i]->state == NIST_PROCEEDING);
+
+  /* without executor, the events are processed by osip_nist_execute() */
+  first[0] = records[0].next;
+  osip_transaction_add_event (transactions[0], osip_new_outgoing_sipmessage (new_response (0, first[0])));
+  osip_nist_execute (osip);
+  CHECK (records[0].next == first[0] + 1);
+
+  for (i = 0; i < NB_TRANSACTIONS; i++)
+    osip_transaction_free (transactions[i]);
+  osip_release (osip);
+  osip_mutex_destroy (mutex);
+
+  printf ("executor: %i error(s)\n", nb_errors);
+  return (nb_errors == 0) ? 0 : -1;
+}
+
+#else
+
+int
+main (int argc, char **argv)
+{
+  printf ("executor: not compiled in\n");
+  return 0;
+}
+
+#endif
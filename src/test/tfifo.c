@@ -0,0 +1,247 @@
+/*
+  The oSIP library implements the Session Initiation Protocol (SIP -rfc3261-)
+  Copyright (C) 2001-2012 Aymeric MOIZARD amoizard@antisip.com
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+#ifdef ENABLE_MPATROL
+#include <mpatrol.h>
+#endif
+
+#include <osip2/internal.h>
+#include <osipparser2/osip_port.h>
+#include <osip2/osip_fifo.h>
+#include <osip2/osip_mt.h>
+
+/*
+  Stress test of osip_fifo_t: several threads adding elements while
+  other threads get them, with osip_fifo_insert(), osip_fifo_tryget()
+  and the blocking osip_fifo_get().
+*/
+
+#ifndef OSIP_MONOTHREAD
+
+#define NB_PRODUCERS 4
+#define NB_ELEMENTS 20000
+
+static int nb_errors;
+
+#define CHECK(cond) check ((cond), #cond, __LINE__)
+
+static void
+check (int cond, const char *text, int line)
+{
+  if (cond)
+    return;
+  printf ("line %i: check failed: %s\n", line, text);
+  nb_errors++;
+}
+
+/* an element is (producer, sequence number), never NULL */
+#define ELEMENT(producer, seq) ((void *) (long) (((producer) << 24) | ((seq) + 1)))
+#define ELEMENT_PRODUCER(el) ((int) ((long) (el) >> 24))
+#define ELEMENT_SEQ(el) ((int) ((long) (el) & 0xffffff) - 1)
+
+struct producer {
+  osip_fifo_t *ff;
+  int id;
+};
+
+static void *
+produce (void *arg)
+{
+  struct producer *producer = (struct producer *) arg;
+  int i;
+
+  for (i = 0; i < NB_ELEMENTS; i++) {
+    if (osip_fifo_add (producer->ff, ELEMENT (producer->id, i)) != OSIP_SUCCESS)
+      return NULL;
+  }
+  return arg;
+}
+
+static void
+start_producers (osip_fifo_t * ff, struct producer *producers, struct osip_thread **threads)
+{
+  int i;
+
+  for (i = 0; i < NB_PRODUCERS; i++) {
+    producers[i].ff = ff;
+    producers[i].id = i;
+    threads[i] = osip_thread_create (0, &produce, &producers[i]);
+    CHECK (threads[i] != NULL);
+  }
+}
+
+static void
+join_producers (struct osip_thread **threads)
+{
+  int i;
+
+  for (i = 0; i < NB_PRODUCERS; i++) {
+    if (threads[i] == NULL)
+      continue;
+    CHECK (osip_thread_join (threads[i]) == 0);
+    osip_free (threads[i]);
+  }
+}
+
+/* the elements of each producer are got in the order they were added */
+static void
+test_producers (void)
+{
+  osip_fifo_t *ff = (osip_fifo_t *) osip_malloc (sizeof (osip_fifo_t));
+  struct producer producers[NB_PRODUCERS];
+  struct osip_thread *threads[NB_PRODUCERS];
+  int next[NB_PRODUCERS];
+  int i;
+
+  if (ff == NULL)
+    return;
+  osip_fifo_init (ff);
+  memset (next, 0, sizeof (next));
+  start_producers (ff, producers, threads);
+  for (i = 0; i < NB_PRODUCERS * NB_ELEMENTS; i++) {
+    void *el = osip_fifo_get (ff);
+    int p = ELEMENT_PRODUCER (el);
+
+    CHECK (el != NULL && p >= 0 && p < NB_PRODUCERS);
+    if (el == NULL || p < 0 || p >= NB_PRODUCERS)
+      break;
+    CHECK (ELEMENT_SEQ (el) == next[p]);
+    next[p] = ELEMENT_SEQ (el) + 1;
+  }
+  join_producers (threads);
+  for (i = 0; i < NB_PRODUCERS; i++)
+    CHECK (next[i] == NB_ELEMENTS);
+  CHECK (osip_fifo_size (ff) == 0);
+  CHECK (osip_fifo_tryget (ff) == NULL);
+  osip_fifo_free (ff);
+}
+
+/* an element put back with osip_fifo_insert() is got first */
+static void
+test_insert (void)
+{
+  osip_fifo_t *ff = (osip_fifo_t *) osip_malloc (sizeof (osip_fifo_t));
+  struct producer producers[NB_PRODUCERS];
+  struct osip_thread *threads[NB_PRODUCERS];
+  int next[NB_PRODUCERS];
+  int got = 0;
+  int i;
+
+  if (ff == NULL)
+    return;
+  osip_fifo_init (ff);
+  CHECK (osip_fifo_tryget (ff) == NULL);
+  osip_fifo_add (ff, ELEMENT (0, 1));
+  osip_fifo_insert (ff, ELEMENT (0, 0));
+  CHECK (osip_fifo_size (ff) == 2);
+  CHECK (osip_fifo_tryget (ff) == ELEMENT (0, 0));
+  CHECK (osip_fifo_tryget (ff) == ELEMENT (0, 1));
+  CHECK (osip_fifo_tryget (ff) == NULL);
+
+  /* while producers add elements */
+  memset (next, 0, sizeof (next));
+  start_producers (ff, producers, threads);
+  while (got < NB_PRODUCERS * NB_ELEMENTS) {
+    void *el = osip_fifo_tryget (ff);
+    int p;
+
+    if (el == NULL)
+      continue;
+    p = ELEMENT_PRODUCER (el);
+    CHECK (p >= 0 && p < NB_PRODUCERS);
+    if (p < 0 || p >= NB_PRODUCERS)
+      break;
+    CHECK (ELEMENT_SEQ (el) == next[p]);
+    if ((got % 7) == 0) {
+      /* put back, then get again */
+      CHECK (osip_fifo_insert (ff, el) == OSIP_SUCCESS);
+      CHECK (osip_fifo_tryget (ff) == el);
+    }
+    next[p] = ELEMENT_SEQ (el) + 1;
+    got++;
+  }
+  join_producers (threads);
+  for (i = 0; i < NB_PRODUCERS; i++)
+    CHECK (next[i] == NB_ELEMENTS);
+  CHECK (osip_fifo_size (ff) == 0);
+  osip_fifo_free (ff);
+}
+
+static void *consumed;
+
+static void *
+consume_one (void *arg)
+{
+  consumed = osip_fifo_get ((osip_fifo_t *) arg);
+  return NULL;
+}
+
+/* osip_fifo_get() blocks until an element is added or inserted */
+static void
+test_blocking_get (void)
+{
+  osip_fifo_t *ff = (osip_fifo_t *) osip_malloc (sizeof (osip_fifo_t));
+  struct osip_thread *thread;
+  int round;
+
+  if (ff == NULL)
+    return;
+  osip_fifo_init (ff);
+  for (round = 0; round < 2; round++) {
+    consumed = NULL;
+    thread = osip_thread_create (0, &consume_one, ff);
+    CHECK (thread != NULL);
+    if (thread == NULL)
+      break;
+    /* the consumer is blocked on the empty fifo */
+    osip_usleep (50000);
+    if (round == 0)
+      osip_fifo_add (ff, ELEMENT (0, round));
+    else
+      osip_fifo_insert (ff, ELEMENT (0, round));
+    CHECK (osip_thread_join (thread) == 0);
+    osip_free (thread);
+    CHECK (consumed == ELEMENT (0, round));
+    CHECK (osip_fifo_size (ff) == 0);
+  }
+  osip_fifo_free (ff);
+}
+
+int
+main (int argc, char **argv)
+{
+  test_producers ();
+  test_insert ();
+  test_blocking_get ();
+
+  printf ("fifo: %i error(s)\n", nb_errors);
+  return (nb_errors == 0) ? 0 : -1;
+}
+
+#else
+
+int
+main (int argc, char **argv)
+{
+  printf ("fifo: not compiled in\n");
+  return 0;
+}
+
+#endif
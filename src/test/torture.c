@@ -223,6 +223,159 @@ test_message (char *msg, size_t len, int verbose, int clone)
       else {
         if (verbose)
           fwrite (result, 1, length, stdout);
+        {
+          /* parse again, in place, with osip_message_parse_view() */
+          osip_message_t *view;
+          char *buf;
+          char *tmp;
+          size_t length;
+
+          buf = (char *) osip_malloc (len + 1);
+          memcpy (buf, msg, len);
+          osip_message_init (&view);
+          if (osip_message_parse_view (view, buf, len) != 0) {
+            fprintf (stdout, "ERROR: failed while parsing in place!\n");
+          }
+          else {
+            osip_message_force_update (view);
+            i = osip_message_to_str (view, &tmp, &length);
+            if (i != 0) {
+              fprintf (stdout, "ERROR: failed while printing message!\n");
+            }
+            else {
+              if (0 != strcmp (result, tmp))
+                printf ("ERROR: The osip_message_parse_view method DOES NOT works\n");
+              else if (verbose)
+                printf ("The osip_message_parse_view method works perfectly\n");
+              osip_free (tmp);
+            }
+          }
+          osip_message_free (view);
+          osip_free (buf);
+        }
+        {
+          /* parse again, delaying the parsing of optional headers */
+          static const char *lazy_headers[] = {
+            "accept", "accept-encoding", "accept-language", "alert-info",
+            "allow", "authorization", "call-info", "content-encoding",
+            "error-info", "mime-version", "proxy-authenticate",
+            "proxy-authorization", "www-authenticate", NULL
+          };
+          osip_message_t *lazy;
+          osip_call_info_t *call_info;
+          char *tmp;
+          size_t length;
+          int k;
+
+          osip_message_init (&lazy);
+          for (k = 0; lazy_headers[k] != NULL; k++)
+            osip_message_set_lazy_header (lazy, lazy_headers[k], 1);
+          if (osip_message_parse (lazy, msg, len) != 0) {
+            fprintf (stdout, "ERROR: failed while parsing with lazy headers!\n");
+          }
+          else {
+            osip_message_get_call_info (lazy, 0, &call_info);
+            if (call_info != NULL)
+              printf ("ERROR: Call-Info header was parsed while parsing\n");
+            osip_message_parse_lazy_header (lazy, "Call-Info");
+            osip_message_get_call_info (lazy, 0, &call_info);
+            if (call_info == NULL && !osip_list_eol (&sip->call_infos, 0))
+              printf ("ERROR: Call-Info header was not parsed\n");
+            osip_message_force_update (lazy);
+            i = osip_message_to_str (lazy, &tmp, &length);
+            if (i != 0) {
+              fprintf (stdout, "ERROR: failed while printing message!\n");
+            }
+            else {
+              if (0 != strcmp (result, tmp))
+                printf ("ERROR: The lazy header parsing DOES NOT works\n");
+              osip_free (tmp);
+            }
+          }
+          osip_message_free (lazy);
+        }
+        {
+          /* parse again, in a message with its own memory arena */
+          osip_message_t *arena;
+          osip_message_t *copy;
+          char *tmp;
+          size_t length;
+
+          osip_message_init_arena (&arena);
+          if (osip_message_parse (arena, msg, len) != 0) {
+            fprintf (stdout, "ERROR: failed while parsing in arena!\n");
+          }
+          else if (osip_message_to_str (arena, &tmp, &length) != 0) {
+            fprintf (stdout, "ERROR: failed while printing message!\n");
+          }
+          else {
+            if (0 != strcmp (result, tmp))
+              printf ("ERROR: The osip_message_init_arena method DOES NOT works\n");
+            osip_free (tmp);
+
+            /* the copy is allocated on the heap */
+            if (osip_message_clone (arena, &copy) != 0) {
+              fprintf (stdout, "ERROR: failed while creating copy of message!\n");
+            }
+            else {
+              osip_message_free (arena);
+              arena = copy;
+              osip_message_force_update (arena);
+              i = osip_message_to_str (arena, &tmp, &length);
+              if (i != 0) {
+                fprintf (stdout, "ERROR: failed while printing message!\n");
+              }
+              else {
+                if (0 != strcmp (result, tmp))
+                  printf ("ERROR: The osip_message_init_arena method DOES NOT works\n");
+                osip_free (tmp);
+              }
+            }
+          }
+          osip_message_free (arena);
+
+          /* elements added by osip are released with the arena */
+          osip_message_init_arena (&arena);
+          if (osip_message_parse (arena, msg, len) == 0)
+            osip_message_fix_last_via_header (arena, "192.0.2.1", 5060);
+          osip_message_free (arena);
+        }
+        if (sip->content_length != NULL && sip->content_length->value != NULL && strstr (result, "\r\n\r\n") != NULL && (size_t) atoi (sip->content_length->value) == length - (strstr (result, "\r\n\r\n") + 4 - result)) {
+          /* receive the message twice on a stream, in small chunks */
+          osip_stream_parser_t *stream;
+          osip_message_t *received;
+          char *data;
+          char *tmp;
+          size_t data_length;
+          size_t k;
+          int count = 0;
+          int pings = 0;
+
+          data_length = 4 + 2 * length;
+          data = (char *) osip_malloc (data_length);
+          memcpy (data, "\r\n\r\n", 4);
+          memcpy (data + 4, result, length);
+          memcpy (data + 4 + length, result, length);
+          osip_stream_parser_init (&stream, 0);
+          for (k = 0; k < data_length; k += 7) {
+            osip_stream_parser_feed (stream, data + k, data_length - k < 7 ? data_length - k : 7);
+            while (osip_stream_parser_get_message (stream, &received) == 0) {
+              size_t tmp_length;
+
+              count++;
+              osip_message_force_update (received);
+              if (osip_message_to_str (received, &tmp, &tmp_length) != 0 || strcmp (result, tmp) != 0)
+                printf ("ERROR: The osip_stream_parser_get_message method DOES NOT works\n");
+              osip_free (tmp);
+              osip_message_free (received);
+            }
+            pings += osip_stream_parser_get_pings (stream);
+          }
+          if (count != 2 || pings != 1)
+            printf ("ERROR: %i messages and %i keep-alives received on stream\n", count, pings);
+          osip_stream_parser_free (stream);
+          osip_free (data);
+        }
         if (clone) {
           /* create a clone of message */
           /* int j = 10000; */
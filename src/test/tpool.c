@@ -0,0 +1,199 @@
+/*
+  The oSIP library implements the Session Initiation Protocol (SIP -rfc3261-)
+  Copyright (C) 2001-2012 Aymeric MOIZARD amoizard@antisip.com
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+#ifdef ENABLE_MPATROL
+#include <mpatrol.h>
+#endif
+
+#include <osipparser2/internal.h>
+#include <osipparser2/osip_port.h>
+
+/*
+  Test of the small objects pools: objects allocated by a thread and
+  released by another one, caches given back when threads exit.
+*/
+
+#if defined(OSIP_POOL) && (defined(HAVE_PTHREAD) || defined(HAVE_PTH_PTHREAD_H))
+
+#include <pthread.h>
+
+#define NB_OBJECTS 1000
+#define NB_WORKERS 4
+#define NB_ROUNDS 200
+#define OBJECT_SIZE 32
+
+static int nb_errors;
+
+#define CHECK(cond) check ((cond), #cond, __LINE__)
+
+static void
+check (int cond, const char *text, int line)
+{
+  if (cond)
+    return;
+  printf ("line %i: check failed: %s\n", line, text);
+  nb_errors++;
+}
+
+static void *objects[NB_OBJECTS];
+
+static void *
+alloc_objects (void *arg)
+{
+  int i;
+
+  for (i = 0; i < NB_OBJECTS; i++) {
+    objects[i] = __osip_pool_malloc (OBJECT_SIZE);
+    if (objects[i] != NULL)
+      memset (objects[i], i & 0xff, OBJECT_SIZE);
+  }
+  return NULL;
+}
+
+static void *
+free_objects (void *arg)
+{
+  int errors = 0;
+  int i;
+  int j;
+
+  for (i = 0; i < NB_OBJECTS; i++) {
+    if (objects[i] == NULL) {
+      errors++;
+      continue;
+    }
+    for (j = 0; j < OBJECT_SIZE; j++)
+      if (((unsigned char *) objects[i])[j] != (i & 0xff))
+        break;
+    if (j != OBJECT_SIZE)
+      errors++;
+    __osip_pool_free (objects[i], OBJECT_SIZE);
+    objects[i] = NULL;
+  }
+  return errors == 0 ? (void *) objects : NULL;
+}
+
+/* each worker keeps a few objects with its own pattern and releases
+   them in a different order */
+static void *
+worker (void *arg)
+{
+  unsigned char tag = (unsigned char) (long) arg;
+  unsigned char *mine[16];
+  int errors = 0;
+  int round;
+  int i;
+  int j;
+
+  for (round = 0; round < NB_ROUNDS; round++) {
+    for (i = 0; i < 16; i++) {
+      mine[i] = (unsigned char *) __osip_pool_malloc (OBJECT_SIZE);
+      if (mine[i] == NULL) {
+        errors++;
+        continue;
+      }
+      memset (mine[i], tag, OBJECT_SIZE);
+    }
+    for (i = 15; i >= 0; i--) {
+      if (mine[i] == NULL)
+        continue;
+      for (j = 0; j < OBJECT_SIZE; j++)
+        if (mine[i][j] != tag)
+          break;
+      if (j != OBJECT_SIZE)
+        errors++;
+      __osip_pool_free (mine[i], OBJECT_SIZE);
+    }
+  }
+  return errors == 0 ? (void *) mine : NULL;
+}
+
+static void
+run (void *(*func) (void *), void *arg, void **ret)
+{
+  pthread_t thread;
+
+  CHECK (pthread_create (&thread, NULL, func, arg) == 0);
+  CHECK (pthread_join (thread, ret) == 0);
+}
+
+int
+main (int argc, char **argv)
+{
+  osip_pool_stats_t before;
+  osip_pool_stats_t after;
+  pthread_t threads[NB_WORKERS];
+  void *ret;
+  int cls = (OBJECT_SIZE - 1) / 16;
+  int i;
+
+  CHECK (osip_pool_get_stats (cls, &before) == OSIP_SUCCESS);
+  CHECK (before.object_size == OBJECT_SIZE);
+
+  /* allocated by a thread, released by another one: the caches of
+     both threads are given back when they exit */
+  run (&alloc_objects, NULL, NULL);
+  run (&free_objects, NULL, &ret);
+  CHECK (ret != NULL);
+  CHECK (osip_pool_get_stats (cls, &after) == OSIP_SUCCESS);
+  CHECK (after.allocations - before.allocations == NB_OBJECTS);
+  CHECK (after.frees - before.frees == NB_OBJECTS);
+  CHECK (after.resident_bytes > before.resident_bytes);
+
+  /* a third thread reuses the released objects: no new page */
+  before = after;
+  run (&alloc_objects, NULL, NULL);
+  run (&free_objects, NULL, &ret);
+  CHECK (ret != NULL);
+  CHECK (osip_pool_get_stats (cls, &after) == OSIP_SUCCESS);
+  CHECK (after.allocations - before.allocations == NB_OBJECTS);
+  CHECK (after.frees - before.frees == NB_OBJECTS);
+  CHECK (after.hits > before.hits);
+  CHECK (after.resident_bytes == before.resident_bytes);
+
+  /* concurrent workers never share an object */
+  before = after;
+  for (i = 0; i < NB_WORKERS; i++)
+    CHECK (pthread_create (&threads[i], NULL, &worker, (void *) (long) (i + 1)) == 0);
+  for (i = 0; i < NB_WORKERS; i++) {
+    CHECK (pthread_join (threads[i], &ret) == 0);
+    CHECK (ret != NULL);
+  }
+  CHECK (osip_pool_get_stats (cls, &after) == OSIP_SUCCESS);
+  CHECK (after.allocations - before.allocations == NB_WORKERS * NB_ROUNDS * 16);
+  CHECK (after.frees - before.frees == NB_WORKERS * NB_ROUNDS * 16);
+
+  CHECK (osip_pool_get_stats (-1, &after) == OSIP_BADPARAMETER);
+  CHECK (osip_pool_get_stats (OSIP_POOL_NB_CLASSES, &after) == OSIP_NOTFOUND);
+
+  printf ("pool: %i error(s)\n", nb_errors);
+  return (nb_errors == 0) ? 0 : -1;
+}
+
+#else
+
+int
+main (int argc, char **argv)
+{
+  printf ("pool: not compiled in\n");
+  return 0;
+}
+
+#endif
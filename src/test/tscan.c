@@ -0,0 +1,216 @@
+/*
+  The oSIP library implements the Session Initiation Protocol (SIP -rfc3261-)
+  Copyright (C) 2001-2012 Aymeric MOIZARD amoizard@antisip.com
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+#ifdef ENABLE_MPATROL
+#include <mpatrol.h>
+#endif
+
+#include <osipparser2/internal.h>
+#include <osipparser2/osip_port.h>
+#include <osipparser2/osip_parser.h>
+
+#include "parser.h"
+
+/*
+  Differential test of the scans of the header block: the index built
+  by the SSE2 and AVX2 scans, when compiled in and supported by the
+  CPU, must be the one built by the scalar scan. The buffers are the
+  messages of the torture corpus, their prefixes, copies with
+  random bytes changed, and random buffers made of the bytes the scans
+  stop on.
+
+  usage: tscan [directory of the corpus]
+*/
+
+#define NB_MUTANTS 50
+#define NB_RANDOM 20000
+#define MAX_FILE 65536
+
+static int nb_errors;
+static int nb_compared;
+
+#define CHECK(cond) check ((cond), #cond, __LINE__)
+
+static void
+check (int cond, const char *text, int line)
+{
+  if (cond)
+    return;
+  printf ("line %i: check failed: %s\n", line, text);
+  nb_errors++;
+}
+
+static const char *scan_names[] = { "scalar", "sse2", "avx2" };
+static int scans[3];
+static int nb_scans;
+
+static unsigned int seed = 1;
+
+static unsigned int
+next_random (void)
+{
+  seed = seed * 1103515245 + 12345;
+  return (seed >> 8) & 0xffffff;
+}
+
+/* the bytes the scans stop on, and the bytes around them */
+static char
+random_byte (void)
+{
+  static const char bytes[] = "\r\n\r\n::  \t\0aZ;=,<>@\"";
+
+  if (next_random () % 8 == 0)
+    return (char) next_random ();
+  return bytes[next_random () % (sizeof (bytes) - 1)];
+}
+
+static void
+compare (const char *buf, size_t length, const char *origin)
+{
+  char *ref = NULL;
+  int i;
+
+  CHECK (__osip_message_header_index_dump (OSIP_HEADER_SCAN_SCALAR, buf, length, &ref) == OSIP_SUCCESS);
+  if (ref == NULL)
+    return;
+  for (i = 0; i < nb_scans; i++) {
+    char *index = NULL;
+
+    CHECK (__osip_message_header_index_dump (scans[i], buf, length, &index) == OSIP_SUCCESS);
+    if (index == NULL)
+      continue;
+    if (strcmp (ref, index) != 0) {
+      if (nb_errors < 10)
+        printf ("%s, length %i: %s scan\n  %s\ninstead of\n  %s\n", origin, (int) length, scan_names[scans[i]], index, ref);
+      nb_errors++;
+    }
+    osip_free (index);
+  }
+  osip_free (ref);
+  nb_compared++;
+}
+
+static int
+read_file (const char *name, char *buf, size_t size)
+{
+  FILE *f = fopen (name, "rb");
+  size_t length;
+
+  if (f == NULL)
+    return -1;
+  length = fread (buf, 1, size, f);
+  fclose (f);
+  return (int) length;
+}
+
+/* a file, its prefixes and copies with random bytes changed */
+static void
+test_file (const char *name, char *buf, int length)
+{
+  char *copy = (char *) osip_malloc (length + 1);
+  int i;
+  int k;
+
+  if (copy == NULL)
+    return;
+  /* every third prefix: the tail is at each offset of a block */
+  for (i = length; i >= 0; i -= (i > 64 && i < length - 64) ? 3 : 1)
+    compare (buf, i, name);
+  for (k = 0; k < NB_MUTANTS && length > 0; k++) {
+    memcpy (copy, buf, length);
+    for (i = 0; i < 1 + k % 8; i++)
+      copy[next_random () % length] = random_byte ();
+    compare (copy, length, name);
+  }
+  osip_free (copy);
+}
+
+static int
+test_corpus (const char *dir)
+{
+  static const char *patterns[] = { "%s/sip%i", "%s/sip-malformed%i", "%s/sdp%i" };
+  char *buf = (char *) osip_malloc (MAX_FILE);
+  char name[1024];
+  int nb_files = 0;
+  int p;
+  int i;
+
+  if (buf == NULL)
+    return 0;
+  for (p = 0; p < 3; p++) {
+    for (i = 0; i < 200; i++) {
+      int length;
+
+      snprintf (name, sizeof (name), patterns[p], dir, i);
+      length = read_file (name, buf, MAX_FILE);
+      if (length < 0)
+        continue;
+      test_file (name, buf, length);
+      nb_files++;
+    }
+  }
+  osip_free (buf);
+  return nb_files;
+}
+
+static void
+test_random (void)
+{
+  char buf[600];
+  int k;
+
+  for (k = 0; k < NB_RANDOM; k++) {
+    size_t length = next_random () % sizeof (buf);
+    size_t i;
+
+    for (i = 0; i < length; i++)
+      buf[i] = random_byte ();
+    compare (buf, length, "random buffer");
+  }
+}
+
+int
+main (int argc, char **argv)
+{
+  char *index = NULL;
+  int selected;
+  int i;
+
+  parser_init ();
+
+  /* the scans to compare with the scalar one */
+  for (i = OSIP_HEADER_SCAN_SSE2; i <= OSIP_HEADER_SCAN_AVX2; i++) {
+    if (__osip_message_header_index_dump (i, "", 0, &index) == OSIP_SUCCESS) {
+      scans[nb_scans++] = i;
+      osip_free (index);
+    }
+    else
+      printf ("header scan: %s not available\n", scan_names[i]);
+  }
+  selected = __osip_message_header_scan_select ();
+  CHECK (selected == (nb_scans > 0 ? scans[nb_scans - 1] : OSIP_HEADER_SCAN_SCALAR));
+
+  if (argc > 1)
+    CHECK (test_corpus (argv[1]) > 0);
+  test_random ();
+
+  printf ("header scan: %i buffers, %i error(s)\n", nb_compared, nb_errors);
+  return (nb_errors == 0) ? 0 : -1;
+}
@@ -0,0 +1,276 @@
+/*
+  The oSIP library implements the Session Initiation Protocol (SIP -rfc3261-)
+  Copyright (C) 2001-2012 Aymeric MOIZARD amoizard@antisip.com
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+#ifdef ENABLE_MPATROL
+#include <mpatrol.h>
+#endif
+
+#include <osip2/internal.h>
+#include <osip2/osip.h>
+
+#include "xixt.h"
+
+/*
+  Test of the timer wheel of osip_t: the dates are given by the test,
+  which moves the clock forward by steps of 1ms to several minutes.
+  Each entry must expire at the first step reaching its date, never
+  before, and the entries expiring in the same step must be given in
+  the order of their dates, whatever the level of the wheel they were
+  moved down from.
+*/
+
+#define NB_ITEMS 4000
+#define DURATION (3 * 3600 * 1000)     /* ms */
+
+static int nb_errors;
+
+#define CHECK(cond) check ((cond), #cond, __LINE__)
+
+static void
+check (int cond, const char *text, int line)
+{
+  if (cond)
+    return;
+  printf ("line %i: check failed: %s\n", line, text);
+  nb_errors++;
+}
+
+struct item {
+  osip_timer_entry_t entry;
+  long date;                    /* ms, -1 if not armed */
+};
+
+static struct item items[NB_ITEMS];
+static struct timeval origin;   /* date 0 of the test */
+static unsigned int seed = 1;
+
+static unsigned int
+next_random (void)
+{
+  seed = seed * 1103515245 + 12345;
+  return (seed >> 8) & 0xffffff;
+}
+
+/* a delay from 0 to about 2^max_bits ms, small delays being as likely
+   as large ones */
+static long
+random_delay (int max_bits)
+{
+  int bits = next_random () % (max_bits + 1);
+
+  return (long) (next_random () & ((1u << bits) - 1));
+}
+
+static void
+date_of (long ms, struct timeval *tv)
+{
+  tv->tv_sec = origin.tv_sec + ms / 1000;
+  tv->tv_usec = (ms % 1000) * 1000;
+}
+
+static void
+arm (struct item *item, long date)
+{
+  struct timeval tv;
+
+  date_of (date, &tv);
+  __osip_timer_wheel_add (&item->entry, &tv);
+  item->date = date;
+}
+
+static void
+disarm (struct item *item)
+{
+  __osip_timer_wheel_del (&item->entry);
+  item->date = -1;
+}
+
+/* date of the first armed entry, -1 if none */
+static long
+first_date (void)
+{
+  long first = -1;
+  int i;
+
+  for (i = 0; i < NB_ITEMS; i++)
+    if (items[i].date >= 0 && (first < 0 || items[i].date < first))
+      first = items[i].date;
+  return first;
+}
+
+/* the clock moves from previous to now: pop the expired entries */
+static int
+expire (struct osip_timer_wheel *wheel, long previous, long now)
+{
+  osip_timer_entry_t expired;
+  osip_timer_entry_t *entry;
+  struct timeval tv;
+  long last = -1;
+  long first;
+  int count = 0;
+
+  date_of (now, &tv);
+  __osip_timer_wheel_expire (wheel, &tv, &expired);
+  while ((entry = __osip_timer_wheel_pop (&expired)) != NULL) {
+    struct item *item = (struct item *) entry->data;
+
+    CHECK (item->date >= 0);
+    if (item->date < 0)
+      continue;
+    /* not early, not late, in order */
+    CHECK (item->date <= now);
+    CHECK (item->date > previous);
+    CHECK (item->date >= last);
+    last = item->date;
+    item->date = -1;
+    count++;
+  }
+  /* all entries with a date reached have expired */
+  first = first_date ();
+  CHECK (first < 0 || first > now);
+  return count;
+}
+
+/* the next expiration given by the wheel is never after the first entry */
+static void
+check_next (struct osip_timer_wheel *wheel, long now)
+{
+  struct timeval tv;
+  struct timeval deadline;
+  long first = first_date ();
+  long next;
+
+  date_of (now, &tv);
+  if (first < 0) {
+    CHECK (__osip_timer_wheel_next (wheel, &tv, &deadline) == OSIP_NOTFOUND);
+    return;
+  }
+  CHECK (__osip_timer_wheel_next (wheel, &tv, &deadline) == OSIP_SUCCESS);
+  next = (long) (deadline.tv_sec - origin.tv_sec) * 1000 + deadline.tv_usec / 1000;
+  CHECK (next >= now);
+  CHECK (next <= first);
+}
+
+/* entries at the limits of the levels, all expiring at the same date
+   or one ms apart, with the clock moving past them in one step */
+static void
+test_levels (struct osip_timer_wheel *wheel)
+{
+  static const long delays[] = {
+    1, 255, 256, 257, 16383, 16384, 16385, 65536, 1048575, 1048576, 1048577, 4194304
+  };
+  int nb = (int) (sizeof (delays) / sizeof (delays[0]));
+  long now = 0;
+  int i;
+
+  for (i = 0; i < nb; i++)
+    arm (&items[i], now + delays[i]);
+  /* added later, expire before or with the entries of upper levels */
+  now = 16000;
+  CHECK (expire (wheel, 0, now) == 4);
+  arm (&items[nb], now + 383);  /* with 16383 */
+  arm (&items[nb + 1], now + 200);
+  now = 1048000;
+  arm (&items[nb + 2], 1048576);        /* with 1048576 */
+  CHECK (expire (wheel, 16000, now) == 6);
+  check_next (wheel, now);
+  CHECK (expire (wheel, now, 1048576) == 3);
+  CHECK (expire (wheel, 1048576, 2000000) == 1);
+  check_next (wheel, 2000000);
+  CHECK (expire (wheel, 2000000, 4194304) == 1);
+  CHECK (first_date () < 0);
+  check_next (wheel, 4194304);
+}
+
+/* random entries, added, re-armed and removed while the clock moves */
+static void
+test_random (struct osip_timer_wheel *wheel, long start)
+{
+  long now = start;
+  int nb_expired = 0;
+  int i;
+
+  for (i = 0; i < NB_ITEMS / 2; i++)
+    arm (&items[i], now + 1 + random_delay (22));
+  while (now < start + DURATION) {
+    long previous = now;
+    unsigned int action = next_random () % 8;
+
+    /* move to the next expiration given by the wheel, or by a random step */
+    if (action == 0) {
+      struct timeval tv;
+      struct timeval deadline;
+
+      date_of (now, &tv);
+      if (__osip_timer_wheel_next (wheel, &tv, &deadline) == OSIP_SUCCESS)
+        now = (long) (deadline.tv_sec - origin.tv_sec) * 1000 + deadline.tv_usec / 1000;
+      if (now == previous)
+        now++;
+    }
+    else
+      now += 1 + random_delay (action < 4 ? 8 : 16);
+    nb_expired += expire (wheel, previous, now);
+
+    for (i = 0; i < 4; i++) {
+      struct item *item = &items[next_random () % NB_ITEMS];
+      unsigned int what = next_random () % 4;
+
+      if (what == 0 && item->date >= 0)
+        disarm (item);
+      else                      /* armed again: the previous date is forgotten */
+        arm (item, now + 1 + random_delay (what == 1 ? 8 : 22));
+    }
+    if ((next_random () % 16) == 0)
+      check_next (wheel, now);
+  }
+  CHECK (nb_expired > NB_ITEMS);
+
+  /* the remaining entries */
+  nb_expired += expire (wheel, now, now + (1L << 23));
+  CHECK (first_date () < 0);
+}
+
+int
+main (int argc, char **argv)
+{
+  struct osip_timer_wheel *wheel;
+  int i;
+
+  if (__osip_timer_wheel_init (&wheel) != OSIP_SUCCESS) {
+    printf ("__osip_timer_wheel_init failed\n");
+    return -1;
+  }
+  /* after the date 0 of the wheel, on a ms */
+  osip_gettimeofday (&origin, NULL);
+  origin.tv_sec++;
+  origin.tv_usec = 0;
+  for (i = 0; i < NB_ITEMS; i++) {
+    items[i].entry.wheel = wheel;
+    items[i].entry.data = &items[i];
+    items[i].date = -1;
+  }
+
+  test_levels (wheel);
+  test_random (wheel, 4194304);
+
+  __osip_timer_wheel_free (wheel);
+  printf ("timer wheel: %i error(s)\n", nb_errors);
+  return (nb_errors == 0) ? 0 : -1;
+}
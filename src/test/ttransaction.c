@@ -0,0 +1,486 @@
+/*
+  The oSIP library implements the Session Initiation Protocol (SIP -rfc3261-)
+  Copyright (C) 2001-2012 Aymeric MOIZARD amoizard@antisip.com
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+#ifdef ENABLE_MPATROL
+#include <mpatrol.h>
+#endif
+
+#include <osip2/internal.h>
+#include <osip2/osip.h>
+
+/*
+  Test of the transactions of osip_t: pool of released transactions
+  lists of transactions, compacted transactions and batches.
+*/
+
+static int nb_errors;
+
+#define CHECK(cond) check ((cond), #cond, __LINE__)
+
+static void
+check (int cond, const char *text, int line)
+{
+  if (cond)
+    return;
+  printf ("line %i: check failed: %s\n", line, text);
+  nb_errors++;
+}
+
+static int nb_raw_sent;
+static int nb_transport_errors;
+
+static int
+cb_send_message (osip_transaction_t * tr, osip_message_t * sip, char *host, int port, int out_socket)
+{
+  return OSIP_SUCCESS;
+}
+
+static int
+cb_send_raw (osip_transaction_t * tr, const char *buf, size_t length, char *host, int port, int out_socket)
+{
+  if (length > 12 && 0 == strncmp (buf, "SIP/2.0 200 ", 12))
+    nb_raw_sent++;
+  return OSIP_SUCCESS;
+}
+
+static int nb_batch_sent;
+
+/* the requests sent to port 5070 are not sent */
+static int
+cb_send_batch (osip_t * osip, osip_batch_message_t * messages, int nb)
+{
+  int i;
+
+  for (i = 0; i < nb; i++) {
+    nb_batch_sent++;
+    if (messages[i].port == 5070)
+      messages[i].result = OSIP_NO_NETWORK;
+  }
+  return OSIP_SUCCESS;
+}
+
+static void
+cb_transport_error (int type, osip_transaction_t * tr, int error)
+{
+  if (error == OSIP_NO_NETWORK)
+    nb_transport_errors++;
+}
+
+/* a request; without To header when branch is negative, with a branch
+   of RFC 2543 from 1000 */
+static void
+request_text (char *buf, size_t size, const char *method, int branch)
+{
+  snprintf (buf, size,
+            "%s sip:bob@example.com SIP/2.0\r\n"
+            "Via: SIP/2.0/UDP 192.168.1.1:5060;branch=%s%i\r\n"
+            "From: <sip:alice@example.com>;tag=1\r\n"
+            "%s"
+            "Call-ID: %i@192.168.1.1\r\n" "CSeq: 1 %s\r\n" "Content-Length: 0\r\n\r\n", method, branch >= 1000 ? "old" : "z9hG4bK", branch < 0 ? -branch : branch, branch < 0 ? "" : "To: <sip:bob@example.com>\r\n", branch, method);
+}
+
+static osip_message_t *
+new_request (const char *method, int branch)
+{
+  osip_message_t *sip;
+  char buf[512];
+
+  request_text (buf, sizeof (buf), method, branch);
+  if (osip_message_init (&sip) != OSIP_SUCCESS)
+    return NULL;
+  if (osip_message_parse (sip, buf, strlen (buf)) != OSIP_SUCCESS) {
+    osip_message_free (sip);
+    return NULL;
+  }
+  return sip;
+}
+
+static osip_event_t *
+new_incoming_request (const char *method, int branch)
+{
+  char buf[512];
+
+  request_text (buf, sizeof (buf), method, branch);
+  return osip_parse (buf, strlen (buf));
+}
+
+static osip_message_t *
+new_response (const char *method, int branch)
+{
+  osip_message_t *sip;
+  char buf[512];
+
+  snprintf (buf, sizeof (buf),
+            "SIP/2.0 200 OK\r\n"
+            "Via: SIP/2.0/UDP 192.168.1.1:5060;branch=z9hG4bK%i\r\n"
+            "From: <sip:alice@example.com>;tag=1\r\n"
+            "To: <sip:bob@example.com>;tag=2\r\n" "Call-ID: %i@192.168.1.1\r\n" "CSeq: 1 %s\r\n" "Content-Length: 0\r\n\r\n", branch, branch, method);
+  if (osip_message_init (&sip) != OSIP_SUCCESS)
+    return NULL;
+  if (osip_message_parse (sip, buf, strlen (buf)) != OSIP_SUCCESS) {
+    osip_message_free (sip);
+    return NULL;
+  }
+  return sip;
+}
+
+static osip_transaction_t *
+new_transaction (osip_t * osip, osip_fsm_type_t type, int branch)
+{
+  osip_transaction_t *tr = NULL;
+  osip_message_t *sip = new_request ((type == ICT || type == IST) ? "INVITE" : "OPTIONS", branch);
+
+  if (sip == NULL)
+    return NULL;
+  if (osip_transaction_init (&tr, type, osip, sip) != OSIP_SUCCESS)
+    tr = NULL;
+  osip_message_free (sip);
+  return tr;
+}
+
+static int
+list_has (osip_list_t * transactions, osip_transaction_t * tr)
+{
+  osip_list_iterator_t iterator;
+  osip_transaction_t *tmp;
+
+  tmp = (osip_transaction_t *) osip_list_get_first (transactions, &iterator);
+  while (osip_list_iterator_has_elem (iterator)) {
+    if (tmp == tr)
+      return 1;
+    tmp = (osip_transaction_t *) osip_list_get_next (&iterator);
+  }
+  return 0;
+}
+
+static void
+test_pool_recycle (osip_t * osip)
+{
+  osip_transaction_t *tr;
+  osip_transaction_t *tr2;
+  osip_fifo_t *ff;
+  int id;
+
+  CHECK (osip_set_transaction_pool (osip, NIST, 2) == OSIP_SUCCESS);
+  tr = new_transaction (osip, NIST, 1);
+  CHECK (tr != NULL);
+  if (tr == NULL)
+    return;
+  ff = tr->transactionff;
+  id = tr->transactionid;
+  osip_transaction_free (tr);
+
+  /* the released transaction is given again, with its fifo */
+  tr2 = new_transaction (osip, NIST, 2);
+  CHECK (tr2 == tr);
+  if (tr2 == NULL)
+    return;
+  CHECK (tr2->transactionff == ff);
+  CHECK (tr2->transactionid != id);
+  CHECK (tr2->state == NIST_PRE_TRYING);
+  CHECK (osip_list_size (&osip->osip_nist_transactions) == 1);
+  CHECK (osip_transaction_get_by_id (osip, tr2->transactionid) == tr2);
+  CHECK (osip_transaction_get_by_id (osip, id) == NULL);
+  osip_transaction_free (tr2);
+
+  /* no more recycling once the pool is disabled */
+  CHECK (osip_set_transaction_pool (osip, NIST, 0) == OSIP_SUCCESS);
+  tr = new_transaction (osip, NIST, 3);
+  CHECK (tr != NULL);
+  osip_transaction_free (tr);
+  CHECK (osip_list_size (&osip->osip_nist_transactions) == 0);
+}
+
+/* a recycled transaction that fails its initialization must not
+   remove another transaction of the list */
+static void
+test_pool_failed_init (osip_t * osip)
+{
+  osip_transaction_t *live;
+  osip_transaction_t *tr;
+  int i;
+
+  CHECK (osip_set_transaction_pool (osip, NIST, 4) == OSIP_SUCCESS);
+  for (i = 0; i < 2; i++) {
+    tr = new_transaction (osip, NIST, 10 + i);
+    CHECK (tr != NULL);
+    osip_transaction_free (tr);
+  }
+
+  live = new_transaction (osip, NIST, 20);
+  CHECK (live != NULL);
+  if (live == NULL)
+    return;
+  /* no To header */
+  CHECK (new_transaction (osip, NIST, -21) == NULL);
+  CHECK (osip_list_size (&osip->osip_nist_transactions) == 1);
+  CHECK (list_has (&osip->osip_nist_transactions, live));
+  CHECK (osip_transaction_get_by_id (osip, live->transactionid) == live);
+  osip_transaction_free (live);
+
+  /* same with an empty list */
+  CHECK (new_transaction (osip, NIST, -22) == NULL);
+  CHECK (osip_list_size (&osip->osip_nist_transactions) == 0);
+
+  /* the pool still works */
+  tr = new_transaction (osip, NIST, 23);
+  CHECK (tr != NULL);
+  CHECK (osip_list_size (&osip->osip_nist_transactions) == 1);
+  osip_transaction_free (tr);
+  CHECK (osip_set_transaction_pool (osip, NIST, 0) == OSIP_SUCCESS);
+}
+
+/* the pool keeps at most high_water transactions: the others are
+   released (checked by memory checkers) */
+static void
+test_pool_high_water (osip_t * osip)
+{
+  osip_transaction_t *tr[8];
+  int i;
+
+  CHECK (osip_set_transaction_pool (osip, ICT, 3) == OSIP_SUCCESS);
+  for (i = 0; i < 8; i++) {
+    tr[i] = new_transaction (osip, ICT, 30 + i);
+    CHECK (tr[i] != NULL);
+  }
+  CHECK (osip_list_size (&osip->osip_ict_transactions) == 8);
+  for (i = 0; i < 8; i++)
+    osip_transaction_free (tr[i]);
+  CHECK (osip_list_size (&osip->osip_ict_transactions) == 0);
+
+  /* tr[0..2] were kept, the last one kept is given first */
+  tr[0] = new_transaction (osip, ICT, 40);
+  CHECK (tr[0] == tr[2]);
+  osip_transaction_free (tr[0]);
+  CHECK (osip_set_transaction_pool (osip, ICT, 1) == OSIP_SUCCESS);
+  CHECK (osip_set_transaction_pool (osip, ICT, 0) == OSIP_SUCCESS);
+  CHECK (osip_set_transaction_pool (osip, ICT, -1) == OSIP_BADPARAMETER);
+}
+
+/* transactions are listed in the order they were added */
+static void
+test_list_order (osip_t * osip)
+{
+  osip_transaction_t *tr[4];
+  osip_transaction_t *tmp;
+  int i;
+
+  for (i = 0; i < 4; i++) {
+    tr[i] = new_transaction (osip, NICT, 50 + i);
+    CHECK (tr[i] != NULL);
+  }
+  for (i = 0; i < 4; i++)
+    CHECK (osip_list_get (&osip->osip_nict_transactions, i) == tr[i]);
+
+  /* removing the last one, then the first one */
+  osip_transaction_free (tr[3]);
+  tr[3] = new_transaction (osip, NICT, 54);
+  CHECK (osip_list_get (&osip->osip_nict_transactions, 3) == tr[3]);
+  osip_transaction_free (tr[0]);
+  CHECK (osip_list_size (&osip->osip_nict_transactions) == 3);
+  for (i = 1; i < 4; i++)
+    CHECK (list_has (&osip->osip_nict_transactions, tr[i]));
+#ifndef OSIP_LIST_ARRAY
+  for (i = 1; i < 4; i++)
+    CHECK (osip_list_get (&osip->osip_nict_transactions, i - 1) == tr[i]);
+#endif
+
+  /* a new one goes at the end */
+  tr[0] = new_transaction (osip, NICT, 55);
+  tmp = (osip_transaction_t *) osip_list_get (&osip->osip_nict_transactions, 3);
+  CHECK (tmp == tr[0]);
+  for (i = 0; i < 4; i++)
+    osip_transaction_free (tr[i]);
+  CHECK (osip_list_size (&osip->osip_nict_transactions) == 0);
+  tr[0] = new_transaction (osip, NICT, 56);
+  CHECK (osip_list_get (&osip->osip_nict_transactions, 0) == tr[0]);
+  osip_transaction_free (tr[0]);
+}
+
+/* requests are matched by the index, and by the list for the
+   transactions out of the index */
+static void
+test_find (osip_t * osip)
+{
+  osip_transaction_t *tr[2];
+  osip_event_t *evt;
+
+  tr[0] = new_transaction (osip, NIST, 80);
+  CHECK (tr[0] != NULL);
+  evt = new_incoming_request ("OPTIONS", 80);
+  CHECK (osip_find_transaction_and_add_event (osip, evt) == OSIP_SUCCESS);
+  CHECK (evt->transactionid == tr[0]->transactionid);
+  evt = new_incoming_request ("OPTIONS", 81);
+  CHECK (osip_find_transaction_and_add_event (osip, evt) != OSIP_SUCCESS);
+  osip_event_free (evt);
+
+  /* not indexed */
+  tr[1] = new_transaction (osip, NIST, 1080);
+  CHECK (tr[1] != NULL);
+  evt = new_incoming_request ("OPTIONS", 1080);
+  CHECK (osip_find_transaction_and_add_event (osip, evt) == OSIP_SUCCESS);
+  CHECK (evt->transactionid == tr[1]->transactionid);
+  evt = new_incoming_request ("OPTIONS", 81);
+  CHECK (osip_find_transaction_and_add_event (osip, evt) != OSIP_SUCCESS);
+  osip_event_free (evt);
+
+  osip_transaction_free (tr[0]);
+  osip_transaction_free (tr[1]);
+}
+
+/* a compacted NIST sends its response again, without its messages */
+static void
+test_tombstone (osip_t * osip)
+{
+  osip_transaction_t *tr;
+  osip_message_t *sip;
+  osip_event_t *evt;
+
+  osip_set_tombstone_mode (osip, 1);
+  osip_set_cb_send_raw (osip, &cb_send_raw);
+  osip_set_transport_error_callback (osip, OSIP_NIST_TRANSPORT_ERROR, &cb_transport_error);
+
+  tr = new_transaction (osip, NIST, 60);
+  CHECK (tr != NULL);
+  if (tr == NULL)
+    return;
+  evt = new_incoming_request ("OPTIONS", 60);
+  CHECK (evt != NULL);
+  osip_transaction_execute (tr, evt);
+  CHECK (tr->state == NIST_TRYING);
+  sip = new_response ("OPTIONS", 60);
+  CHECK (sip != NULL);
+  osip_transaction_execute (tr, osip_new_outgoing_sipmessage (sip));
+  CHECK (tr->state == NIST_COMPLETED);
+  CHECK (tr->tombstone != NULL);
+  CHECK (tr->orig_request == NULL);
+  CHECK (tr->last_response == NULL);
+
+  /* the retransmission of the request is answered */
+  nb_raw_sent = 0;
+  osip_transaction_execute (tr, new_incoming_request ("OPTIONS", 60));
+  CHECK (nb_raw_sent == 1);
+  CHECK (tr->state == NIST_COMPLETED);
+
+  /* the callback was removed: the transaction is terminated */
+  osip_set_cb_send_raw (osip, NULL);
+  nb_transport_errors = 0;
+  osip_transaction_execute (tr, new_incoming_request ("OPTIONS", 60));
+  CHECK (nb_raw_sent == 1);
+  CHECK (nb_transport_errors == 1);
+  CHECK (tr->state == NIST_TERMINATED);
+  osip_transaction_free (tr);
+  osip_set_tombstone_mode (osip, 0);
+}
+
+/* the errors of a batch are reported to the transactions */
+static void
+test_batch_errors (osip_t * osip)
+{
+  osip_transaction_t *tr[2];
+  osip_message_t *sip;
+  int i;
+
+  osip_set_cb_send_batch (osip, &cb_send_batch);
+  osip_set_transport_error_callback (osip, OSIP_NICT_TRANSPORT_ERROR, &cb_transport_error);
+  nb_batch_sent = 0;
+  nb_transport_errors = 0;
+
+  for (i = 0; i < 2; i++) {
+    sip = new_request ("OPTIONS", 70 + i);
+    CHECK (sip != NULL);
+    if (sip == NULL)
+      return;
+    if (i == 1)
+      osip_uri_set_port (sip->req_uri, osip_strdup ("5070"));
+    tr[i] = NULL;
+    CHECK (osip_transaction_init (&tr[i], NICT, osip, sip) == OSIP_SUCCESS);
+    if (tr[i] == NULL) {
+      osip_message_free (sip);
+      return;
+    }
+    osip_transaction_add_event (tr[i], osip_new_outgoing_sipmessage (sip));
+  }
+
+  /* the batch is sent at the end of osip_nict_execute() */
+  osip_nict_execute (osip);
+  CHECK (nb_batch_sent == 2);
+  CHECK (tr[0]->state == NICT_TRYING);
+  CHECK (nb_transport_errors == 0);
+
+  /* then the error is executed by the transaction */
+  osip_nict_execute (osip);
+  CHECK (nb_transport_errors == 1);
+  CHECK (tr[0]->state == NICT_TRYING);
+  CHECK (tr[1]->state == NICT_TERMINATED);
+
+  for (i = 0; i < 2; i++)
+    osip_transaction_free (tr[i]);
+  osip_set_cb_send_batch (osip, NULL);
+}
+
+/* the events added directly in the fifo are processed too */
+static void
+test_fifo_add (osip_t * osip)
+{
+  osip_transaction_t *tr;
+  osip_message_t *sip;
+
+  tr = new_transaction (osip, NIST, 80);
+  CHECK (tr != NULL);
+  if (tr == NULL)
+    return;
+  CHECK (osip_fifo_add (tr->transactionff, new_incoming_request ("OPTIONS", 80)) == OSIP_SUCCESS);
+  osip_nist_execute (osip);
+  CHECK (tr->state == NIST_TRYING);
+  CHECK (osip_fifo_size (tr->transactionff) == 0);
+
+  sip = new_response ("OPTIONS", 80);
+  CHECK (sip != NULL);
+  CHECK (osip_fifo_insert (tr->transactionff, osip_new_outgoing_sipmessage (sip)) == OSIP_SUCCESS);
+  osip_nist_execute (osip);
+  CHECK (tr->state == NIST_COMPLETED);
+  osip_transaction_free (tr);
+}
+
+int
+main (int argc, char **argv)
+{
+  osip_t *osip;
+
+  if (osip_init (&osip) != OSIP_SUCCESS) {
+    printf ("osip_init failed\n");
+    return -1;
+  }
+  osip_set_cb_send_message (osip, &cb_send_message);
+
+  test_pool_recycle (osip);
+  test_pool_failed_init (osip);
+  test_pool_high_water (osip);
+  test_list_order (osip);
+  test_find (osip);
+  test_tombstone (osip);
+  test_batch_errors (osip);
+  test_fifo_add (osip);
+
+  osip_release (osip);
+  printf ("transactions: %i error(s)\n", nb_errors);
+  return (nb_errors == 0) ? 0 : -1;
+}